@@ -0,0 +1,223 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+// Counts heap allocations made through operator new, e.g. to check that a render loop allocates
+// nothing once it reached its steady state. Define ALLOCATION_COUNTER_IMPLEMENTATION in exactly one
+// source file before including this header; that file replaces the global operator new and delete.
+// Without it the counters stay at zero.
+class AllocationCounter
+{
+public:
+	struct Counters
+	{
+		unsigned long long allocations;
+		unsigned long long bytes;
+	};
+
+	// Totals of all threads since the start of the process. Subtract two snapshots to count a frame.
+	static Counters counters()
+	{
+		Counters result;
+		result.allocations = allocations().load(std::memory_order_relaxed);
+		result.bytes = bytes().load(std::memory_order_relaxed);
+		return result;
+	}
+
+	// Totals of the calling thread only. A frame check wants these: the FileWatcher, ModelLoader and
+	// OcclusionCuller threads allocate whenever they like and would show up in counters().
+	static Counters threadCounters()
+	{
+		return threadTotals();
+	}
+
+	// Bytes allocated through operator new and not deleted yet, of all threads, as the allocator
+	// rounded them up. Unlike the resident memory this drops as soon as memory is deleted, whether
+	// or not the allocator gives it back to the system.
+	static long long liveBytes()
+	{
+		return live().load(std::memory_order_relaxed);
+	}
+
+	// Called by the replacements with what the allocator really reserved, negative on delete.
+	static void recordLive(long long bytes)
+	{
+		live().fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	static void record(std::size_t size)
+	{
+		allocations().fetch_add(1, std::memory_order_relaxed);
+		bytes().fetch_add(size, std::memory_order_relaxed);
+		Counters & thread = threadTotals();
+		thread.allocations++;
+		thread.bytes += size;
+	}
+
+private:
+	static std::atomic<unsigned long long> & allocations()
+	{
+		static std::atomic<unsigned long long> count(0);
+		return count;
+	}
+
+	static std::atomic<unsigned long long> & bytes()
+	{
+		static std::atomic<unsigned long long> count(0);
+		return count;
+	}
+
+	static std::atomic<long long> & live()
+	{
+		static std::atomic<long long> count(0);
+		return count;
+	}
+
+	// constant initialized, so the first allocation of a thread does not allocate
+	static Counters & threadTotals()
+	{
+		static thread_local Counters totals = { 0, 0 };
+		return totals;
+	}
+};
+
+#ifdef ALLOCATION_COUNTER_IMPLEMENTATION
+// GCC sees operator delete inlined into code that got its memory from operator new and warns about
+// the std::free below, although both are the replacements here and belong together
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// what the allocator reserved for memory, at least what was asked for
+static long long allocatedSize(void* memory)
+{
+#if defined(_MSC_VER)
+	return (long long)_msize(memory);
+#elif defined(__APPLE__)
+	return (long long)malloc_size(memory);
+#else
+	return (long long)malloc_usable_size(memory);
+#endif
+}
+
+// the nothrow forms forward to these by default, the array, sized and aligned forms are replaced as
+// well so every allocation and its deallocation go through the same pair
+void* operator new(std::size_t size)
+{
+	AllocationCounter::record(size);
+	void* memory = std::malloc(size != 0 ? size : 1);
+	if (memory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	AllocationCounter::recordLive(allocatedSize(memory));
+	return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	if (memory != nullptr)
+	{
+		AllocationCounter::recordLive(-allocatedSize(memory));
+	}
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+#ifdef __cpp_aligned_new
+// over-aligned types, e.g. alignas(64) members, come here in C++17
+static long long allocatedSize(void* memory, std::size_t alignment)
+{
+#ifdef _MSC_VER
+	return (long long)_aligned_msize(memory, alignment, 0);
+#else
+	(void)alignment;
+	return allocatedSize(memory);
+#endif
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	AllocationCounter::record(size);
+	std::size_t align = (std::size_t)alignment;
+#ifdef _MSC_VER
+	void* memory = _aligned_malloc(size != 0 ? size : 1, align);
+#else
+	// aligned_alloc wants a multiple of the alignment
+	void* memory = std::aligned_alloc(align, size != 0 ? (size + align - 1) / align * align : align);
+#endif
+	if (memory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	AllocationCounter::recordLive(allocatedSize(memory, align));
+	return memory;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* memory, std::align_val_t alignment) noexcept
+{
+	if (memory != nullptr)
+	{
+		AllocationCounter::recordLive(-allocatedSize(memory, (std::size_t)alignment));
+	}
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
@@ -0,0 +1,834 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+
+// The block formats BlockCompression encodes. All of them store 4x4 pixel blocks, BC1 and BC4 in
+// 8 bytes, the others in 16.
+enum class BlockFormat
+{
+	BC1, // RGB, two 5:6:5 endpoints and 2-bit indices
+	BC3, // RGBA, a BC4 block for alpha in front of a BC1 block for color
+	BC4, // red, two 8-bit endpoints and 3-bit indices
+	BC5, // red and green, two BC4 blocks
+	BC7  // RGBA, mode 6 only: 7-bit endpoints with a shared low bit and 4-bit indices
+};
+
+// CPU encoder and decoder for the BC formats, for cooking textures before they reach the GPU.
+// Images are RGBA8 in and out, a block format keeps the channels it stores. Endpoints are found
+// along the principal axis of the block's colors and refined once by least squares on the chosen
+// indices. compress() splits an image into rows of blocks and encodes them on a pool of threads.
+class BlockCompression
+{
+public:
+	// Worker threads used by compress(). 0 picks one per hardware thread.
+	static unsigned int & threadCount()
+	{
+		static unsigned int count = 0;
+		return count;
+	}
+
+	static unsigned int blockBytes(BlockFormat format)
+	{
+		return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+	}
+
+	// Bytes of one compressed image, partial blocks at the right and bottom edge included.
+	static size_t imageBytes(BlockFormat format, int width, int height)
+	{
+		return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * blockBytes(format);
+	}
+
+	// Encodes width x height RGBA8 pixels into imageBytes() bytes of blocks, row by row. Blocks that
+	// stick out of the image repeat its last row and column.
+	static void compress(BlockFormat format, const unsigned char* rgba, int width, int height, unsigned char* blocks)
+	{
+		int blocksX = (width + 3) / 4;
+		int blocksY = (height + 3) / 4;
+		unsigned int bytes = blockBytes(format);
+
+		std::atomic<int> nextRow(0);
+		auto encodeRows = [&]()
+		{
+			unsigned char block[64];
+			for (int by = nextRow++; by < blocksY; by = nextRow++)
+			{
+				unsigned char* out = blocks + (size_t)by * blocksX * bytes;
+				for (int bx = 0; bx < blocksX; bx++)
+				{
+					loadBlock(rgba, width, height, bx, by, block);
+					encodeBlock(format, block, out + (size_t)bx * bytes);
+				}
+			}
+		};
+
+		// small mips are not worth a thread
+		unsigned int workers = threadCount() != 0 ? threadCount() : std::thread::hardware_concurrency();
+		workers = std::min(std::max(workers, 1u), (unsigned int)std::max(blocksX * blocksY / 256, 1));
+		workers = std::min(workers, (unsigned int)blocksY);
+		std::vector<std::thread> pool;
+		for (unsigned int i = 1; i < workers; i++)
+		{
+			pool.push_back(std::thread(encodeRows));
+		}
+		encodeRows();
+		for (std::thread & worker : pool)
+		{
+			worker.join();
+		}
+	}
+
+	// Decodes blocks back into width x height RGBA8 pixels. Channels the format does not store read
+	// 0, alpha reads 255, like sampling the texture would return.
+	static void decompress(BlockFormat format, const unsigned char* blocks, int width, int height, unsigned char* rgba)
+	{
+		int blocksX = (width + 3) / 4;
+		int blocksY = (height + 3) / 4;
+		unsigned int bytes = blockBytes(format);
+		unsigned char block[64];
+		for (int by = 0; by < blocksY; by++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				decodeBlock(format, blocks + ((size_t)by * blocksX + bx) * bytes, block);
+				for (int y = 0; y < 4 && by * 4 + y < height; y++)
+				{
+					for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+					{
+						memcpy(rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+					}
+				}
+			}
+		}
+	}
+
+	// Encodes 16 RGBA8 pixels, row by row, into one block.
+	static void encodeBlock(BlockFormat format, const unsigned char* block, unsigned char* out)
+	{
+		switch (format)
+		{
+		case BlockFormat::BC1:
+			encodeBC1(block, out);
+			break;
+		case BlockFormat::BC3:
+			encodeBC4(block, 3, out);
+			encodeBC1(block, out + 8);
+			break;
+		case BlockFormat::BC4:
+			encodeBC4(block, 0, out);
+			break;
+		case BlockFormat::BC5:
+			encodeBC4(block, 0, out);
+			encodeBC4(block, 1, out + 8);
+			break;
+		case BlockFormat::BC7:
+			encodeBC7(block, out);
+			break;
+		}
+	}
+
+	static void decodeBlock(BlockFormat format, const unsigned char* in, unsigned char* block)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			block[i * 4 + 0] = block[i * 4 + 1] = block[i * 4 + 2] = 0;
+			block[i * 4 + 3] = 255;
+		}
+		switch (format)
+		{
+		case BlockFormat::BC1:
+			decodeBC1(in, block);
+			break;
+		case BlockFormat::BC3:
+			decodeBC1(in + 8, block);
+			decodeBC4(in, 3, block);
+			break;
+		case BlockFormat::BC4:
+			decodeBC4(in, 0, block);
+			break;
+		case BlockFormat::BC5:
+			decodeBC4(in, 0, block);
+			decodeBC4(in + 8, 1, block);
+			break;
+		case BlockFormat::BC7:
+			decodeBC7(in, block);
+			break;
+		}
+	}
+
+	// Peak signal to noise ratio in dB between two RGBA8 images over the channels set in channelMask,
+	// bit 0 for red to bit 3 for alpha. Infinite when they are equal.
+	static double psnr(const unsigned char* a, const unsigned char* b, int width, int height, unsigned int channelMask = 0x7)
+	{
+		double squaredError = 0.0;
+		size_t samples = 0;
+		for (size_t i = 0; i < (size_t)width * height; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				if (channelMask & (1u << c))
+				{
+					double difference = (double)a[i * 4 + c] - (double)b[i * 4 + c];
+					squaredError += difference * difference;
+					samples++;
+				}
+			}
+		}
+		if (squaredError == 0.0 || samples == 0)
+		{
+			return std::numeric_limits<double>::infinity();
+		}
+		return 10.0 * std::log10(255.0 * 255.0 / (squaredError / (double)samples));
+	}
+
+private:
+	static void loadBlock(const unsigned char* rgba, int width, int height, int bx, int by, unsigned char* block)
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			int sourceY = std::min(by * 4 + y, height - 1);
+			for (int x = 0; x < 4; x++)
+			{
+				int sourceX = std::min(bx * 4 + x, width - 1);
+				memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sourceY * width + sourceX) * 4, 4);
+			}
+		}
+	}
+
+	// Unit direction of largest variance of the 16 points with the given number of channels, found by
+	// power iteration on their covariance. Writes the mean as well.
+	static void principalAxis(const float* points, int channels, float* mean, float* axis)
+	{
+		float covariance[4][4] = {};
+		for (int c = 0; c < channels; c++)
+		{
+			mean[c] = 0.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				mean[c] += points[i * channels + c];
+			}
+			mean[c] /= 16.0f;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			for (int r = 0; r < channels; r++)
+			{
+				for (int c = r; c < channels; c++)
+				{
+					covariance[r][c] += (points[i * channels + r] - mean[r]) * (points[i * channels + c] - mean[c]);
+				}
+			}
+		}
+
+		// start from the channel that varies most, it is rarely orthogonal to the answer
+		int widest = 0;
+		for (int c = 0; c < channels; c++)
+		{
+			axis[c] = 0.0f;
+			widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+		}
+		axis[widest] = 1.0f;
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for (int r = 0; r < channels; r++)
+			{
+				for (int c = 0; c < channels; c++)
+				{
+					next[r] += covariance[std::min(r, c)][std::max(r, c)] * axis[c];
+				}
+				length += next[r] * next[r];
+			}
+			if (length < 1e-12f)
+			{
+				break;
+			}
+			length = 1.0f / std::sqrt(length);
+			for (int c = 0; c < channels; c++)
+			{
+				axis[c] = next[c] * length;
+			}
+		}
+	}
+
+	// Solves for the two endpoints that fit the points best when point i is (1 - t[i]) * e0 + t[i] * e1.
+	// False when every point uses the same weight.
+	static bool leastSquares(const float* points, int channels, const float* t, float* e0, float* e1)
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float a = 1.0f - t[i];
+			float b = t[i];
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < channels; c++)
+			{
+				ax[c] += a * points[i * channels + c];
+				bx[c] += b * points[i * channels + c];
+			}
+		}
+		float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f)
+		{
+			return false;
+		}
+		for (int c = 0; c < channels; c++)
+		{
+			e0[c] = (bb * ax[c] - ab * bx[c]) / determinant;
+			e1[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+		}
+		return true;
+	}
+
+	static int quantize(float value, int levels)
+	{
+		return std::min(std::max((int)(value * (float)levels / 255.0f + 0.5f), 0), levels);
+	}
+
+	// BC1
+
+	static uint16_t pack565(const float* color)
+	{
+		return (uint16_t)((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+	}
+
+	static void unpack565(uint16_t color, int* rgb)
+	{
+		int r = (color >> 11) & 31;
+		int g = (color >> 5) & 63;
+		int b = color & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// The four colors of a block, in the four color mode BC3 always uses and BC1 uses for c0 > c1.
+	static void bc1Palette(uint16_t c0, uint16_t c1, int palette[4][3])
+	{
+		unpack565(c0, palette[0]);
+		unpack565(c1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+	}
+
+	// Picks the nearest palette color for every pixel and returns the squared error.
+	static int bc1Indices(const unsigned char* block, uint16_t c0, uint16_t c1, uint32_t & indices)
+	{
+		int palette[4][3];
+		bc1Palette(c0, c1, palette);
+		int error = 0;
+		indices = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0;
+			int bestError = INT32_MAX;
+			for (int j = 0; j < 4; j++)
+			{
+				int dr = block[i * 4 + 0] - palette[j][0];
+				int dg = block[i * 4 + 1] - palette[j][1];
+				int db = block[i * 4 + 2] - palette[j][2];
+				int distance = dr * dr + dg * dg + db * db;
+				if (distance < bestError)
+				{
+					bestError = distance;
+					best = j;
+				}
+			}
+			indices |= (uint32_t)best << (i * 2);
+			error += bestError;
+		}
+		return error;
+	}
+
+	// Endpoints, 5 or 6 bits, whose first interpolated color is closest to each 8-bit value. A block of
+	// one color uses them instead of rounding the color to 5:6:5.
+	struct SingleColor
+	{
+		unsigned char endpoints5[256][2];
+		unsigned char endpoints6[256][2];
+
+		SingleColor()
+		{
+			fill(endpoints5, 5);
+			fill(endpoints6, 6);
+		}
+
+		static void fill(unsigned char table[256][2], int bits)
+		{
+			int levels = 1 << bits;
+			for (int value = 0; value < 256; value++)
+			{
+				int bestError = INT32_MAX;
+				for (int e0 = 0; e0 < levels; e0++)
+				{
+					for (int e1 = 0; e1 < levels; e1++)
+					{
+						int color0 = (e0 << (8 - bits)) | (e0 >> (2 * bits - 8));
+						int color1 = (e1 << (8 - bits)) | (e1 >> (2 * bits - 8));
+						int error = std::abs((2 * color0 + color1) / 3 - value);
+						if (error < bestError)
+						{
+							bestError = error;
+							table[value][0] = (unsigned char)e0;
+							table[value][1] = (unsigned char)e1;
+						}
+					}
+				}
+			}
+		}
+	};
+
+	static const SingleColor & singleColor()
+	{
+		static SingleColor table;
+		return table;
+	}
+
+	static void encodeBC1(const unsigned char* block, unsigned char* out)
+	{
+		bool uniform = true;
+		for (int i = 1; i < 16 && uniform; i++)
+		{
+			uniform = block[i * 4] == block[0] && block[i * 4 + 1] == block[1] && block[i * 4 + 2] == block[2];
+		}
+		if (uniform)
+		{
+			const SingleColor & table = singleColor();
+			uint16_t c0 = (uint16_t)((table.endpoints5[block[0]][0] << 11) | (table.endpoints6[block[1]][0] << 5) | table.endpoints5[block[2]][0]);
+			uint16_t c1 = (uint16_t)((table.endpoints5[block[0]][1] << 11) | (table.endpoints6[block[1]][1] << 5) | table.endpoints5[block[2]][1]);
+			writeBC1(c0, c1, 0xAAAAAAAAu, out);
+			return;
+		}
+
+		float points[16 * 3];
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				points[i * 3 + c] = (float)block[i * 4 + c];
+			}
+		}
+		float mean[3], axis[3];
+		principalAxis(points, 3, mean, axis);
+		float low = FLT_MAX, high = -FLT_MAX;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = (points[i * 3] - mean[0]) * axis[0] + (points[i * 3 + 1] - mean[1]) * axis[1] + (points[i * 3 + 2] - mean[2]) * axis[2];
+			low = std::min(low, t);
+			high = std::max(high, t);
+		}
+		float e0[3], e1[3];
+		for (int c = 0; c < 3; c++)
+		{
+			e0[c] = mean[c] + axis[c] * high;
+			e1[c] = mean[c] + axis[c] * low;
+		}
+		uint16_t c0 = pack565(e0);
+		uint16_t c1 = pack565(e1);
+		uint32_t indices;
+		int error = bc1Indices(block, c0, c1, indices);
+
+		const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		for (int iteration = 0; iteration < 2 && error > 0; iteration++)
+		{
+			float t[16];
+			for (int i = 0; i < 16; i++)
+			{
+				t[i] = weights[(indices >> (i * 2)) & 3];
+			}
+			if (!leastSquares(points, 3, t, e0, e1))
+			{
+				break;
+			}
+			uint16_t refined0 = pack565(e0);
+			uint16_t refined1 = pack565(e1);
+			uint32_t refinedIndices;
+			int refinedError = bc1Indices(block, refined0, refined1, refinedIndices);
+			if (refinedError >= error)
+			{
+				break;
+			}
+			c0 = refined0;
+			c1 = refined1;
+			indices = refinedIndices;
+			error = refinedError;
+		}
+
+		writeBC1(c0, c1, indices, out);
+	}
+
+	static void writeBC1(uint16_t c0, uint16_t c1, uint32_t indices, unsigned char* out)
+	{
+		// c0 > c1 selects the four color mode, swapping the endpoints swaps indices 0/1 and 2/3
+		if (c0 < c1)
+		{
+			std::swap(c0, c1);
+			indices ^= 0x55555555u;
+		}
+		else if (c0 == c1)
+		{
+			indices = 0;
+		}
+		out[0] = (unsigned char)(c0 & 0xFF);
+		out[1] = (unsigned char)(c0 >> 8);
+		out[2] = (unsigned char)(c1 & 0xFF);
+		out[3] = (unsigned char)(c1 >> 8);
+		for (int i = 0; i < 4; i++)
+		{
+			out[4 + i] = (unsigned char)(indices >> (i * 8));
+		}
+	}
+
+	static void decodeBC1(const unsigned char* in, unsigned char* block)
+	{
+		uint16_t c0 = (uint16_t)(in[0] | (in[1] << 8));
+		uint16_t c1 = (uint16_t)(in[2] | (in[3] << 8));
+		uint32_t indices = (uint32_t)in[4] | ((uint32_t)in[5] << 8) | ((uint32_t)in[6] << 16) | ((uint32_t)in[7] << 24);
+		int palette[4][3];
+		bc1Palette(c0, c1, palette);
+		int alpha[4] = { 255, 255, 255, 255 };
+		if (c0 <= c1)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+			alpha[3] = 0;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			int index = (indices >> (i * 2)) & 3;
+			for (int c = 0; c < 3; c++)
+			{
+				block[i * 4 + c] = (unsigned char)palette[index][c];
+			}
+			block[i * 4 + 3] = (unsigned char)alpha[index];
+		}
+	}
+
+	// BC4
+
+	static void bc4Palette(int a0, int a1, int palette[8])
+	{
+		palette[0] = a0;
+		palette[1] = a1;
+		if (a0 > a1)
+		{
+			for (int j = 2; j < 8; j++)
+			{
+				palette[j] = ((8 - j) * a0 + (j - 1) * a1 + 3) / 7;
+			}
+		}
+		else
+		{
+			for (int j = 2; j < 6; j++)
+			{
+				palette[j] = ((6 - j) * a0 + (j - 1) * a1 + 2) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	static int bc4Indices(const unsigned char* block, int channel, int a0, int a1, uint64_t & indices)
+	{
+		int palette[8];
+		bc4Palette(a0, a1, palette);
+		int error = 0;
+		indices = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int value = block[i * 4 + channel];
+			int best = 0;
+			int bestError = INT32_MAX;
+			for (int j = 0; j < 8; j++)
+			{
+				int distance = (value - palette[j]) * (value - palette[j]);
+				if (distance < bestError)
+				{
+					bestError = distance;
+					best = j;
+				}
+			}
+			indices |= (uint64_t)best << (i * 3);
+			error += bestError;
+		}
+		return error;
+	}
+
+	// Encodes one channel of the block in the eight value mode.
+	static void encodeBC4(const unsigned char* block, int channel, unsigned char* out)
+	{
+		int low = 255, high = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			low = std::min(low, (int)block[i * 4 + channel]);
+			high = std::max(high, (int)block[i * 4 + channel]);
+		}
+		int a0 = high;
+		int a1 = low;
+		uint64_t indices = 0;
+		if (high > low)
+		{
+			int error = bc4Indices(block, channel, a0, a1, indices);
+
+			// the extremes are rarely the best endpoints once values sit between the eight levels
+			float points[16];
+			float t[16];
+			for (int i = 0; i < 16; i++)
+			{
+				int index = (int)((indices >> (i * 3)) & 7);
+				points[i] = (float)block[i * 4 + channel];
+				t[i] = index == 0 ? 0.0f : index == 1 ? 1.0f : (float)(index - 1) / 7.0f;
+			}
+			float e0, e1;
+			if (error > 0 && leastSquares(points, 1, t, &e0, &e1))
+			{
+				int refined0 = std::min(std::max((int)(e0 + 0.5f), 0), 255);
+				int refined1 = std::min(std::max((int)(e1 + 0.5f), 0), 255);
+				uint64_t refinedIndices;
+				if (refined0 > refined1 && bc4Indices(block, channel, refined0, refined1, refinedIndices) < error)
+				{
+					a0 = refined0;
+					a1 = refined1;
+					indices = refinedIndices;
+				}
+			}
+		}
+		out[0] = (unsigned char)a0;
+		out[1] = (unsigned char)a1;
+		for (int i = 0; i < 6; i++)
+		{
+			out[2 + i] = (unsigned char)(indices >> (i * 8));
+		}
+	}
+
+	static void decodeBC4(const unsigned char* in, int channel, unsigned char* block)
+	{
+		int palette[8];
+		bc4Palette(in[0], in[1], palette);
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; i++)
+		{
+			indices |= (uint64_t)in[2 + i] << (i * 8);
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			block[i * 4 + channel] = (unsigned char)palette[(indices >> (i * 3)) & 7];
+		}
+	}
+
+	// BC7 mode 6
+
+	static const int* bc7Weights()
+	{
+		static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+		return weights;
+	}
+
+	// Rounds an endpoint to 7 bits per channel plus the shared low bit that fits it best.
+	static void bc7Quantize(const float* endpoint, int* quantized, int & pBit)
+	{
+		float bestError = FLT_MAX;
+		for (int p = 0; p < 2; p++)
+		{
+			int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				candidate[c] = std::min(std::max((int)((endpoint[c] - (float)p) * 0.5f + 0.5f), 0), 127);
+				float difference = (float)(candidate[c] * 2 + p) - endpoint[c];
+				error += difference * difference;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				pBit = p;
+				std::copy(candidate, candidate + 4, quantized);
+			}
+		}
+	}
+
+	static int bc7Indices(const unsigned char* block, const int* q0, int p0, const int* q1, int p1, unsigned char* indices)
+	{
+		int palette[16][4];
+		for (int c = 0; c < 4; c++)
+		{
+			int e0 = q0[c] * 2 + p0;
+			int e1 = q1[c] * 2 + p1;
+			for (int j = 0; j < 16; j++)
+			{
+				palette[j][c] = ((64 - bc7Weights()[j]) * e0 + bc7Weights()[j] * e1 + 32) >> 6;
+			}
+		}
+		int error = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0;
+			int bestError = INT32_MAX;
+			for (int j = 0; j < 16; j++)
+			{
+				int distance = 0;
+				for (int c = 0; c < 4; c++)
+				{
+					int difference = block[i * 4 + c] - palette[j][c];
+					distance += difference * difference;
+				}
+				if (distance < bestError)
+				{
+					bestError = distance;
+					best = j;
+				}
+			}
+			indices[i] = (unsigned char)best;
+			error += bestError;
+		}
+		return error;
+	}
+
+	static void writeBits(unsigned char* out, int & position, int count, unsigned int value)
+	{
+		for (int i = 0; i < count; i++, position++)
+		{
+			out[position >> 3] |= (unsigned char)(((value >> i) & 1) << (position & 7));
+		}
+	}
+
+	static unsigned int readBits(const unsigned char* in, int & position, int count)
+	{
+		unsigned int value = 0;
+		for (int i = 0; i < count; i++, position++)
+		{
+			value |= (unsigned int)((in[position >> 3] >> (position & 7)) & 1) << i;
+		}
+		return value;
+	}
+
+	static void encodeBC7(const unsigned char* block, unsigned char* out)
+	{
+		float points[16 * 4];
+		for (int i = 0; i < 64; i++)
+		{
+			points[i] = (float)block[i];
+		}
+		float mean[4], axis[4];
+		principalAxis(points, 4, mean, axis);
+		float low = FLT_MAX, high = -FLT_MAX;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				t += (points[i * 4 + c] - mean[c]) * axis[c];
+			}
+			low = std::min(low, t);
+			high = std::max(high, t);
+		}
+		float e0[4], e1[4];
+		for (int c = 0; c < 4; c++)
+		{
+			e0[c] = mean[c] + axis[c] * low;
+			e1[c] = mean[c] + axis[c] * high;
+		}
+		int q0[4], q1[4], p0, p1;
+		bc7Quantize(e0, q0, p0);
+		bc7Quantize(e1, q1, p1);
+		unsigned char indices[16];
+		int error = bc7Indices(block, q0, p0, q1, p1, indices);
+
+		float t[16];
+		for (int i = 0; i < 16; i++)
+		{
+			t[i] = (float)bc7Weights()[indices[i]] / 64.0f;
+		}
+		if (error > 0 && leastSquares(points, 4, t, e0, e1))
+		{
+			int r0[4], r1[4], rp0, rp1;
+			unsigned char refinedIndices[16];
+			bc7Quantize(e0, r0, rp0);
+			bc7Quantize(e1, r1, rp1);
+			if (bc7Indices(block, r0, rp0, r1, rp1, refinedIndices) < error)
+			{
+				std::copy(r0, r0 + 4, q0);
+				std::copy(r1, r1 + 4, q1);
+				p0 = rp0;
+				p1 = rp1;
+				std::copy(refinedIndices, refinedIndices + 16, indices);
+			}
+		}
+
+		// the first index is stored without its top bit, swapping the endpoints clears it
+		if (indices[0] & 8)
+		{
+			std::swap(q0, q1);
+			std::swap(p0, p1);
+			for (int i = 0; i < 16; i++)
+			{
+				indices[i] = (unsigned char)(15 - indices[i]);
+			}
+		}
+
+		memset(out, 0, 16);
+		int position = 0;
+		writeBits(out, position, 7, 1u << 6);
+		for (int c = 0; c < 4; c++)
+		{
+			writeBits(out, position, 7, (unsigned int)q0[c]);
+			writeBits(out, position, 7, (unsigned int)q1[c]);
+		}
+		writeBits(out, position, 1, (unsigned int)p0);
+		writeBits(out, position, 1, (unsigned int)p1);
+		writeBits(out, position, 3, indices[0]);
+		for (int i = 1; i < 16; i++)
+		{
+			writeBits(out, position, 4, indices[i]);
+		}
+	}
+
+	// Decodes mode 6 blocks, the only mode encodeBC7() writes. Other modes decode to black.
+	static void decodeBC7(const unsigned char* in, unsigned char* block)
+	{
+		if ((in[0] & 0x7F) != 0x40)
+		{
+			memset(block, 0, 64);
+			return;
+		}
+		int position = 7;
+		int endpoints[2][4];
+		for (int c = 0; c < 4; c++)
+		{
+			endpoints[0][c] = (int)readBits(in, position, 7) << 1;
+			endpoints[1][c] = (int)readBits(in, position, 7) << 1;
+		}
+		int p0 = (int)readBits(in, position, 1);
+		int p1 = (int)readBits(in, position, 1);
+		for (int c = 0; c < 4; c++)
+		{
+			endpoints[0][c] |= p0;
+			endpoints[1][c] |= p1;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			int weight = bc7Weights()[readBits(in, position, i == 0 ? 3 : 4)];
+			for (int c = 0; c < 4; c++)
+			{
+				block[i * 4 + c] = (unsigned char)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+			}
+		}
+	}
+};
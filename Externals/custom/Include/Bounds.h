@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include <glm.hpp>
+
+// Axis-aligned box from min to max.
+struct BoundingBox
+{
+	glm::vec3 min;
+	glm::vec3 max;
+
+	BoundingBox() : min(0.0f), max(0.0f) {}
+	BoundingBox(const glm::vec3 & min, const glm::vec3 & max) : min(min), max(max) {}
+
+	glm::vec3 center() const
+	{
+		return (min + max) * 0.5f;
+	}
+
+	glm::vec3 extent() const
+	{
+		return (max - min) * 0.5f;
+	}
+
+	// The box around this box moved by transform, e.g. from model to world space. Exact for the
+	// transformed corners, found from the center and the absolute matrix instead of all eight.
+	BoundingBox transformed(const glm::mat4 & transform) const
+	{
+		glm::vec3 newCenter = glm::vec3(transform * glm::vec4(center(), 1.0f));
+		glm::vec3 halfSize = extent();
+		glm::vec3 newExtent = glm::abs(glm::vec3(transform[0])) * halfSize.x + glm::abs(glm::vec3(transform[1])) * halfSize.y
+			+ glm::abs(glm::vec3(transform[2])) * halfSize.z;
+		return BoundingBox(newCenter - newExtent, newCenter + newExtent);
+	}
+};
+
+struct BoundingSphere
+{
+	glm::vec3 center;
+	float radius;
+
+	BoundingSphere() : center(0.0f), radius(0.0f) {}
+	BoundingSphere(const glm::vec3 & center, float radius) : center(center), radius(radius) {}
+
+	// The sphere around center that reaches the farthest of count positions, stride bytes apart.
+	static BoundingSphere around(const glm::vec3 & center, const float* positions, size_t count, size_t stride)
+	{
+		BoundingSphere sphere(center, 0.0f);
+		for (size_t i = 0; i < count; i++)
+		{
+			const float* position = (const float*)((const char*)positions + i * stride);
+			sphere.radius = std::max(sphere.radius, glm::length(glm::vec3(position[0], position[1], position[2]) - center));
+		}
+		return sphere;
+	}
+
+	// The sphere around this sphere moved by transform. Non-uniform scales grow it by the largest axis.
+	BoundingSphere transformed(const glm::mat4 & transform) const
+	{
+		float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+		return BoundingSphere(glm::vec3(transform * glm::vec4(center, 1.0f)), radius * scale);
+	}
+};
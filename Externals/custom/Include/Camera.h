@@ -7,6 +7,8 @@
 #include <gtc/matrix_transform.hpp>
 #include <gtc/type_ptr.hpp>
 
+#include <Frustum.h>
+
 #include <vector>
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -68,6 +70,12 @@ public:
 		return glm::lookAt(Position, Position + Front, Up);
 	}
 
+	// The frustum of the view matrix seen through projection, in world space
+	Frustum GetFrustum(const glm::mat4 & projection)
+	{
+		return Frustum::fromMatrix(projection * GetViewMatrix());
+	}
+
 	// Processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
 	void ProcessKeyboard(Camera_Movement direction, float deltaTime)
 	{
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <map>
+#endif
+
+// Watches files on a background thread and raises a flag when one of them is written. Used by Shader
+// hot reload; the flag is polled from the frame loop so nothing here ever touches GL.
+// Linux uses inotify on the parent directories, since editors often save by renaming a temporary file
+// over the original. Everywhere else the size and the modification time of every file are polled a
+// few times per second, the time at the file system's full resolution: st_mtime only has seconds, so
+// two saves within one second would look like one.
+class FileWatcher
+{
+public:
+	static FileWatcher & instance()
+	{
+		static FileWatcher watcher;
+		return watcher;
+	}
+
+	// Sets *changed to true whenever one of files is modified. Watching a file again with the same
+	// flag is a no-op, so callers can re-register after every reload to pick up new #includes.
+	void watch(const std::vector<std::string> & files, const std::shared_ptr<std::atomic<bool>> & changed)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const std::string & file : files)
+		{
+			bool known = false;
+			for (const Entry & entry : entries)
+			{
+				if (entry.path == file && entry.changed == changed)
+				{
+					known = true;
+					break;
+				}
+			}
+			if (known)
+			{
+				continue;
+			}
+
+			Entry entry;
+			entry.path = file;
+			size_t slash = file.find_last_of("/\\");
+			entry.directory = slash == std::string::npos ? std::string(".") : file.substr(0, slash);
+			entry.name = slash == std::string::npos ? file : file.substr(slash + 1);
+			entry.stamp = fileStamp(file);
+			entry.changed = changed;
+#ifdef __linux__
+			entry.watch = addDirectoryWatch(entry.directory);
+#endif
+			entries.push_back(entry);
+		}
+
+		if (!worker.joinable())
+		{
+			running = true;
+			worker = std::thread(&FileWatcher::run, this);
+		}
+	}
+
+	// Stops setting changed, for files watched with it and no longer used, e.g. by a destroyed Shader.
+	void unwatch(const std::shared_ptr<std::atomic<bool>> & changed)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry & entry) { return entry.changed == changed; }), entries.end());
+#ifdef __linux__
+		// drop the directory watches no file needs any more
+		for (std::map<std::string, int>::iterator it = directoryWatches.begin(); it != directoryWatches.end(); )
+		{
+			bool used = false;
+			for (const Entry & entry : entries)
+			{
+				used = used || entry.watch == it->second;
+			}
+			if (used)
+			{
+				++it;
+				continue;
+			}
+			if (it->second >= 0)
+			{
+				inotify_rm_watch(inotifyFd, it->second);
+			}
+			it = directoryWatches.erase(it);
+		}
+#endif
+	}
+
+	~FileWatcher()
+	{
+		running = false;
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+#ifdef __linux__
+		if (inotifyFd >= 0)
+		{
+			close(inotifyFd);
+		}
+#endif
+	}
+
+private:
+	// what polling compares, a save changes at least one of them
+	struct FileStamp
+	{
+		long long modified;
+		long long size;
+
+		bool operator!=(const FileStamp & other) const
+		{
+			return modified != other.modified || size != other.size;
+		}
+	};
+
+	struct Entry
+	{
+		std::string path;
+		std::string directory;
+		std::string name;
+		FileStamp stamp;
+		std::shared_ptr<std::atomic<bool>> changed;
+		int watch = -1;
+	};
+
+	std::mutex mutex;
+	std::vector<Entry> entries;
+	std::thread worker;
+	std::atomic<bool> running;
+
+	FileWatcher() : running(false)
+	{
+#ifdef __linux__
+		inotifyFd = inotify_init1(IN_NONBLOCK);
+#endif
+	}
+
+	// Zero for both when the file cannot be read, e.g. while an editor replaces it.
+	static FileStamp fileStamp(const std::string & path)
+	{
+		FileStamp stamp = { 0, 0 };
+#ifdef _WIN32
+		// 100 ns ticks, where _stat only has seconds
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+		{
+			stamp.modified = (long long)(((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime);
+			stamp.size = (long long)(((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow);
+		}
+#else
+		struct stat info;
+		if (stat(path.c_str(), &info) == 0)
+		{
+#ifdef __APPLE__
+			stamp.modified = (long long)info.st_mtimespec.tv_sec * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+			stamp.modified = (long long)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+			stamp.size = (long long)info.st_size;
+		}
+#endif
+		return stamp;
+	}
+
+#ifdef __linux__
+	int inotifyFd;
+	std::map<std::string, int> directoryWatches;
+
+	int addDirectoryWatch(const std::string & directory)
+	{
+		if (inotifyFd < 0)
+		{
+			return -1;
+		}
+		std::map<std::string, int>::iterator it = directoryWatches.find(directory);
+		if (it != directoryWatches.end())
+		{
+			return it->second;
+		}
+		int watch = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		directoryWatches[directory] = watch;
+		return watch;
+	}
+
+	void run()
+	{
+		if (inotifyFd < 0)
+		{
+			runPolling();
+			return;
+		}
+
+		char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+		while (running)
+		{
+			pollfd descriptor = { inotifyFd, POLLIN, 0 };
+			if (poll(&descriptor, 1, 100) <= 0)
+			{
+				continue;
+			}
+
+			ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+			for (char* cursor = buffer; length > 0 && cursor < buffer + length; )
+			{
+				const inotify_event* event = (const inotify_event*)cursor;
+				if (event->len > 0)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					for (Entry & entry : entries)
+					{
+						if (entry.watch == event->wd && entry.name == event->name)
+						{
+							entry.changed->store(true);
+						}
+					}
+				}
+				cursor += sizeof(inotify_event) + event->len;
+			}
+		}
+	}
+#else
+	void run()
+	{
+		runPolling();
+	}
+#endif
+
+	void runPolling()
+	{
+		while (running)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+			std::lock_guard<std::mutex> lock(mutex);
+			for (Entry & entry : entries)
+			{
+				FileStamp stamp = fileStamp(entry.path);
+				if (stamp.modified != 0 && stamp != entry.stamp)
+				{
+					entry.stamp = stamp;
+					entry.changed->store(true);
+				}
+			}
+		}
+	}
+};
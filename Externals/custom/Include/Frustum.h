@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm.hpp>
+
+// The six planes of a view-projection matrix, left, right, bottom, top, near, far. Normals point
+// inside and are normalized, so dot(vec3(plane), p) + plane.w is the signed distance of p.
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	static Frustum fromMatrix(const glm::mat4 & viewProjection)
+	{
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++)
+		{
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		}
+		Frustum frustum;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			frustum.planes[axis * 2] = rows[3] + rows[axis];
+			frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+		}
+		return frustum.normalized();
+	}
+
+	// The same planes in the space transform maps from, e.g. model space for a model matrix.
+	Frustum transformed(const glm::mat4 & transform) const
+	{
+		Frustum frustum;
+		for (int i = 0; i < 6; i++)
+		{
+			frustum.planes[i] = glm::transpose(transform) * planes[i];
+		}
+		return frustum.normalized();
+	}
+
+private:
+	Frustum normalized() const
+	{
+		Frustum frustum;
+		for (int i = 0; i < 6; i++)
+		{
+			float length = glm::length(glm::vec3(planes[i]));
+			frustum.planes[i] = length > 0.0f ? planes[i] / length : planes[i];
+		}
+		return frustum;
+	}
+};
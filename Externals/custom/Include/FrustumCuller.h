@@ -0,0 +1,240 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstddef>
+
+#include <glm.hpp>
+
+#include <Frustum.h>
+#include <Bounds.h>
+
+#if defined(__AVX__) || defined(__AVX2__)
+#include <immintrin.h>
+#define FRUSTUM_CULLING_AVX 1
+#endif
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_CULLING_SSE 1
+#endif
+
+// World-space bounds of many objects, stored as columns so the frustum test runs on eight (AVX) or
+// four (SSE) of them at a time. Every entry is a box with an extra radius, a sphere is a box of
+// zero extent. An entry passes a plane when its center lies at most |normal| . extent + radius
+// behind it, which is exact for spheres and conservative for boxes near frustum corners. Without
+// AVX or SSE the scalar loop runs.
+class FrustumCuller
+{
+public:
+	void clear()
+	{
+		count = 0;
+		for (std::vector<float>* column : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius })
+		{
+			column->clear();
+		}
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	// Appends an entry and returns its index. Entries keep their index until clear().
+	size_t add(const BoundingBox & box)
+	{
+		grow();
+		set(count, box);
+		return count++;
+	}
+
+	size_t add(const BoundingSphere & sphere)
+	{
+		grow();
+		set(count, sphere);
+		return count++;
+	}
+
+	// Replaces an entry, e.g. after its object moved.
+	void set(size_t i, const BoundingBox & box)
+	{
+		glm::vec3 center = box.center();
+		glm::vec3 extent = box.extent();
+		store(i, center, extent, 0.0f);
+	}
+
+	void set(size_t i, const BoundingSphere & sphere)
+	{
+		store(i, sphere.center, glm::vec3(0.0f), sphere.radius);
+	}
+
+	// Writes 1 for every entry that intersects frustum and 0 for the others into visible, and returns
+	// how many are visible. visible needs room for size() rounded up to eight.
+	size_t cull(const Frustum & frustum, unsigned char* visible) const
+	{
+#if defined(FRUSTUM_CULLING_AVX)
+		return cullAVX(frustum, visible);
+#elif defined(FRUSTUM_CULLING_SSE)
+		return cullSSE(frustum, visible);
+#else
+		return cullScalar(frustum, visible);
+#endif
+	}
+
+	// Name of the kernel cull() uses.
+	static const char* kernel()
+	{
+#if defined(FRUSTUM_CULLING_AVX)
+		return "AVX";
+#elif defined(FRUSTUM_CULLING_SSE)
+		return "SSE";
+#else
+		return "scalar";
+#endif
+	}
+
+	size_t cullScalar(const Frustum & frustum, unsigned char* visible) const
+	{
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			bool inside = true;
+			for (int p = 0; p < 6; p++)
+			{
+				const glm::vec4 & plane = frustum.planes[p];
+				float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+				float reach = std::abs(plane.x) * extentX[i] + std::abs(plane.y) * extentY[i] + std::abs(plane.z) * extentZ[i] + radius[i];
+				inside = inside && distance + reach >= 0.0f;
+			}
+			visible[i] = (unsigned char)inside;
+			visibleCount += visible[i];
+		}
+		return visibleCount;
+	}
+
+#ifdef FRUSTUM_CULLING_SSE
+	size_t cullSSE(const Frustum & frustum, unsigned char* visible) const
+	{
+		size_t visibleCount = 0;
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+		for (int p = 0; p < 6; p++)
+		{
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+			absX[p] = _mm_set1_ps(std::abs(frustum.planes[p].x));
+			absY[p] = _mm_set1_ps(std::abs(frustum.planes[p].y));
+			absZ[p] = _mm_set1_ps(std::abs(frustum.planes[p].z));
+		}
+		__m128 zero = _mm_setzero_ps();
+		for (size_t i = 0; i < count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&centerX[i]);
+			__m128 y = _mm_loadu_ps(&centerY[i]);
+			__m128 z = _mm_loadu_ps(&centerZ[i]);
+			__m128 ex = _mm_loadu_ps(&extentX[i]);
+			__m128 ey = _mm_loadu_ps(&extentY[i]);
+			__m128 ez = _mm_loadu_ps(&extentZ[i]);
+			__m128 r = _mm_loadu_ps(&radius[i]);
+
+			__m128 inside = _mm_cmpeq_ps(r, r);
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p])), _mm_add_ps(_mm_mul_ps(z, planeZ[p]), planeW[p]));
+				__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, absX[p]), _mm_mul_ps(ey, absY[p])), _mm_add_ps(_mm_mul_ps(ez, absZ[p]), r));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), zero));
+			}
+
+			int mask = _mm_movemask_ps(inside);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				visible[i + lane] = (unsigned char)((mask >> lane) & 1);
+			}
+			visibleCount += (size_t)((mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1));
+		}
+		return visibleCount;
+	}
+#endif
+
+#ifdef FRUSTUM_CULLING_AVX
+	size_t cullAVX(const Frustum & frustum, unsigned char* visible) const
+	{
+		size_t visibleCount = 0;
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+		for (int p = 0; p < 6; p++)
+		{
+			planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+			absX[p] = _mm256_set1_ps(std::abs(frustum.planes[p].x));
+			absY[p] = _mm256_set1_ps(std::abs(frustum.planes[p].y));
+			absZ[p] = _mm256_set1_ps(std::abs(frustum.planes[p].z));
+		}
+		__m256 zero = _mm256_setzero_ps();
+		for (size_t i = 0; i < count; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(&centerX[i]);
+			__m256 y = _mm256_loadu_ps(&centerY[i]);
+			__m256 z = _mm256_loadu_ps(&centerZ[i]);
+			__m256 ex = _mm256_loadu_ps(&extentX[i]);
+			__m256 ey = _mm256_loadu_ps(&extentY[i]);
+			__m256 ez = _mm256_loadu_ps(&extentZ[i]);
+			__m256 r = _mm256_loadu_ps(&radius[i]);
+
+			__m256 inside = _mm256_cmp_ps(r, r, _CMP_EQ_OQ);
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, planeX[p]), _mm256_mul_ps(y, planeY[p])),
+					_mm256_add_ps(_mm256_mul_ps(z, planeZ[p]), planeW[p]));
+				__m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, absX[p]), _mm256_mul_ps(ey, absY[p])),
+					_mm256_add_ps(_mm256_mul_ps(ez, absZ[p]), r));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), zero, _CMP_GE_OQ));
+			}
+
+			int mask = _mm256_movemask_ps(inside);
+			for (int lane = 0; lane < 8; lane++)
+			{
+				visible[i + lane] = (unsigned char)((mask >> lane) & 1);
+			}
+			for (int bits = mask; bits != 0; bits &= bits - 1)
+			{
+				visibleCount++;
+			}
+		}
+		return visibleCount;
+	}
+#endif
+
+private:
+	size_t count = 0;
+	std::vector<float> centerX, centerY, centerZ, extentX, extentY, extentZ, radius;
+
+	// Keeps the columns a multiple of eight long. Padding never passes a plane.
+	void grow()
+	{
+		if (count < centerX.size())
+		{
+			return;
+		}
+		for (std::vector<float>* column : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius })
+		{
+			column->resize(count + 8, 0.0f);
+		}
+		std::fill(radius.begin() + count, radius.end(), -FLT_MAX);
+	}
+
+	void store(size_t i, const glm::vec3 & center, const glm::vec3 & extent, float sphereRadius)
+	{
+		centerX[i] = center.x;
+		centerY[i] = center.y;
+		centerZ[i] = center.z;
+		extentX[i] = extent.x;
+		extentY[i] = extent.y;
+		extentZ[i] = extent.z;
+		radius[i] = sphereRadius;
+	}
+};
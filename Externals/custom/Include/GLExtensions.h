@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <string>
+#include <set>
+
+// The samples' glad.c is generated without extensions, so the GLAD_GL_* flags are never filled in.
+// Query the extension list of the current context directly instead; the result is cached on first use.
+inline bool hasGLExtension(const char* name)
+{
+	static std::set<std::string> extensions;
+	static bool queried = false;
+	if (!queried)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (extension != NULL)
+			{
+				extensions.insert(extension);
+			}
+		}
+		queried = true;
+	}
+	return extensions.count(name) != 0;
+}
+
+// Version of the current context as major * 10 + minor, e.g. 33 or 46.
+inline int glContextVersion()
+{
+	static int version = 0;
+	if (version == 0)
+	{
+		GLint major = 0;
+		GLint minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		version = major * 10 + minor;
+	}
+	return version;
+}
@@ -0,0 +1,593 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <iostream>
+
+// Shadows the bound program, VAO, textures, framebuffers, blend/depth state and viewport, and drops
+// calls that would set what is already set. Samples keep calling gl* as before: install() points the
+// glad entry points at the filters below, so the shadow stays right no matter who binds what.
+// Code on hot paths can use bindTexture(unit, target, texture), which only switches the active texture
+// unit when that unit actually has to change.
+// Hooked: glUseProgram, glBindVertexArray, glActiveTexture, glBindTexture, glBindTextureUnit,
+// glBindTextures, glBindFramebuffer, glEnable/glDisable of GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE,
+// glBlendFunc, glBlendFuncSeparate, glBlendEquation, glBlendEquationSeparate, glDepthFunc,
+// glDepthMask, glViewport and the deletes of those objects. Not hooked, so call invalidate() after
+// using them: the indexed variants (glEnablei, glBlendFunci, ...), glBindProgramPipeline and
+// anything that binds behind glad, e.g. another library with its own loader.
+class GLStateCache
+{
+public:
+	struct Counters
+	{
+		unsigned long long issued;
+		unsigned long long elided;
+	};
+
+	// Call once after gladLoadGLLoader. Without install() every call is forwarded unfiltered.
+	static void install()
+	{
+		State & s = state();
+		if (s.installed)
+		{
+			return;
+		}
+		s.realUseProgram = glad_glUseProgram;
+		s.realBindVertexArray = glad_glBindVertexArray;
+		s.realActiveTexture = glad_glActiveTexture;
+		s.realBindTexture = glad_glBindTexture;
+		s.realBindFramebuffer = glad_glBindFramebuffer;
+		s.realEnable = glad_glEnable;
+		s.realDisable = glad_glDisable;
+		s.realBlendFunc = glad_glBlendFunc;
+		s.realBlendFuncSeparate = glad_glBlendFuncSeparate;
+		s.realBlendEquation = glad_glBlendEquation;
+		s.realBlendEquationSeparate = glad_glBlendEquationSeparate;
+		s.realBindTextureUnit = glad_glBindTextureUnit;
+		s.realBindTextures = glad_glBindTextures;
+		s.realDepthFunc = glad_glDepthFunc;
+		s.realDepthMask = glad_glDepthMask;
+		s.realViewport = glad_glViewport;
+		s.realDeleteProgram = glad_glDeleteProgram;
+		s.realDeleteVertexArrays = glad_glDeleteVertexArrays;
+		s.realDeleteTextures = glad_glDeleteTextures;
+		s.realDeleteFramebuffers = glad_glDeleteFramebuffers;
+
+		glad_glUseProgram = useProgram;
+		glad_glBindVertexArray = bindVertexArray;
+		glad_glActiveTexture = activeTexture;
+		glad_glBindTexture = bindTexture;
+		glad_glBindFramebuffer = bindFramebuffer;
+		glad_glEnable = enable;
+		glad_glDisable = disable;
+		glad_glBlendFunc = blendFunc;
+		glad_glBlendFuncSeparate = blendFuncSeparate;
+		glad_glBlendEquation = blendEquation;
+		glad_glBlendEquationSeparate = blendEquationSeparate;
+		// GL 4.5 and 4.4, only there when the context has them
+		if (s.realBindTextureUnit != nullptr)
+		{
+			glad_glBindTextureUnit = bindTextureUnit;
+		}
+		if (s.realBindTextures != nullptr)
+		{
+			glad_glBindTextures = bindTextures;
+		}
+		glad_glDepthFunc = depthFunc;
+		glad_glDepthMask = depthMask;
+		glad_glViewport = viewport;
+		glad_glDeleteProgram = deleteProgram;
+		glad_glDeleteVertexArrays = deleteVertexArrays;
+		glad_glDeleteTextures = deleteTextures;
+		glad_glDeleteFramebuffers = deleteFramebuffers;
+
+		s.installed = true;
+		invalidate();
+	}
+
+	// Points the glad entry points back at what install() found, e.g. before loading them again.
+	static void uninstall()
+	{
+		State & s = state();
+		if (!s.installed)
+		{
+			return;
+		}
+		glad_glUseProgram = s.realUseProgram;
+		glad_glBindVertexArray = s.realBindVertexArray;
+		glad_glActiveTexture = s.realActiveTexture;
+		glad_glBindTexture = s.realBindTexture;
+		glad_glBindFramebuffer = s.realBindFramebuffer;
+		glad_glEnable = s.realEnable;
+		glad_glDisable = s.realDisable;
+		glad_glBlendFunc = s.realBlendFunc;
+		glad_glBlendFuncSeparate = s.realBlendFuncSeparate;
+		glad_glBlendEquation = s.realBlendEquation;
+		glad_glBlendEquationSeparate = s.realBlendEquationSeparate;
+		glad_glBindTextureUnit = s.realBindTextureUnit;
+		glad_glBindTextures = s.realBindTextures;
+		glad_glDepthFunc = s.realDepthFunc;
+		glad_glDepthMask = s.realDepthMask;
+		glad_glViewport = s.realViewport;
+		glad_glDeleteProgram = s.realDeleteProgram;
+		glad_glDeleteVertexArrays = s.realDeleteVertexArrays;
+		glad_glDeleteTextures = s.realDeleteTextures;
+		glad_glDeleteFramebuffers = s.realDeleteFramebuffers;
+		s.installed = false;
+	}
+
+	// Turning the cache off forwards every call, which is what the benchmark toggle compares against.
+	static void setEnabled(bool enabled)
+	{
+		State & s = state();
+		if (enabled && !s.enabled)
+		{
+			invalidate();
+		}
+		s.enabled = enabled;
+	}
+
+	static bool enabled()
+	{
+		return state().enabled;
+	}
+
+	// Forgets all shadowed state, e.g. after a library changed GL state behind our back.
+	static void invalidate()
+	{
+		state().forget();
+	}
+
+	static Counters counters()
+	{
+		return state().counters;
+	}
+
+	static void resetCounters()
+	{
+		state().counters.issued = 0;
+		state().counters.elided = 0;
+	}
+
+	static void APIENTRY useProgram(GLuint program)
+	{
+		State & s = state();
+		if (filter(s.program == program))
+		{
+			return;
+		}
+		s.program = program;
+		real(s.realUseProgram, glad_glUseProgram)(program);
+	}
+
+	static void APIENTRY bindVertexArray(GLuint vertexArray)
+	{
+		State & s = state();
+		if (filter(s.vertexArray == vertexArray))
+		{
+			return;
+		}
+		s.vertexArray = vertexArray;
+		real(s.realBindVertexArray, glad_glBindVertexArray)(vertexArray);
+	}
+
+	static void APIENTRY activeTexture(GLenum unit)
+	{
+		State & s = state();
+		if (filter(s.activeUnit == unit))
+		{
+			return;
+		}
+		s.activeUnit = unit;
+		real(s.realActiveTexture, glad_glActiveTexture)(unit);
+	}
+
+	// Binds to the active texture unit, like glBindTexture.
+	static void APIENTRY bindTexture(GLenum target, GLuint texture)
+	{
+		State & s = state();
+		GLuint* slot = textureSlot(s.activeUnit, target);
+		if (filter(slot != nullptr && *slot == texture))
+		{
+			return;
+		}
+		if (slot != nullptr)
+		{
+			*slot = texture;
+		}
+		real(s.realBindTexture, glad_glBindTexture)(target, texture);
+	}
+
+	// Binds to GL_TEXTURE0 + unit without changing the active unit. The target comes from the texture,
+	// which the shadow does not know, so only a texture the unit already holds is dropped.
+	static void APIENTRY bindTextureUnit(GLuint unit, GLuint texture)
+	{
+		State & s = state();
+		bool bound = false;
+		for (unsigned int target = 0; unit < MAX_UNITS && texture != 0 && target < TARGET_COUNT; target++)
+		{
+			bound = bound || s.textures[unit][target] == texture;
+		}
+		if (filter(bound))
+		{
+			return;
+		}
+		boundToUnit(unit, texture);
+		real(s.realBindTextureUnit, glad_glBindTextureUnit)(unit, texture);
+	}
+
+	static void APIENTRY bindTextures(GLuint first, GLsizei count, const GLuint* textures)
+	{
+		State & s = state();
+		filter(false);
+		for (GLsizei i = 0; i < count; i++)
+		{
+			boundToUnit(first + i, textures != nullptr ? textures[i] : 0);
+		}
+		real(s.realBindTextures, glad_glBindTextures)(first, count, textures);
+	}
+
+	// Binds texture to GL_TEXTURE0 + unit. When it is already bound there both calls are skipped
+	// and the active unit stays wherever it was.
+	static void bindTexture(GLuint unit, GLenum target, GLuint texture)
+	{
+		State & s = state();
+		GLuint* slot = textureSlot(GL_TEXTURE0 + unit, target);
+		if (slot != nullptr && *slot == texture && s.installed && s.enabled)
+		{
+			s.counters.elided += 2;
+			return;
+		}
+		activeTexture(GL_TEXTURE0 + unit);
+		bindTexture(target, texture);
+	}
+
+	static void APIENTRY bindFramebuffer(GLenum target, GLuint framebuffer)
+	{
+		State & s = state();
+		bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+		bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+		if (filter((draw || read) && (!draw || s.drawFramebuffer == framebuffer) && (!read || s.readFramebuffer == framebuffer)))
+		{
+			return;
+		}
+		if (draw)
+		{
+			s.drawFramebuffer = framebuffer;
+		}
+		if (read)
+		{
+			s.readFramebuffer = framebuffer;
+		}
+		real(s.realBindFramebuffer, glad_glBindFramebuffer)(target, framebuffer);
+	}
+
+	static void APIENTRY enable(GLenum cap)
+	{
+		State & s = state();
+		GLuint* flag = capability(cap);
+		if (filter(flag != nullptr && *flag == GL_TRUE))
+		{
+			return;
+		}
+		if (flag != nullptr)
+		{
+			*flag = GL_TRUE;
+		}
+		real(s.realEnable, glad_glEnable)(cap);
+	}
+
+	static void APIENTRY disable(GLenum cap)
+	{
+		State & s = state();
+		GLuint* flag = capability(cap);
+		if (filter(flag != nullptr && *flag == GL_FALSE))
+		{
+			return;
+		}
+		if (flag != nullptr)
+		{
+			*flag = GL_FALSE;
+		}
+		real(s.realDisable, glad_glDisable)(cap);
+	}
+
+	static void APIENTRY blendFunc(GLenum source, GLenum destination)
+	{
+		State & s = state();
+		if (filter(s.blendSourceRGB == source && s.blendDestinationRGB == destination && s.blendSourceAlpha == source && s.blendDestinationAlpha == destination))
+		{
+			return;
+		}
+		s.blendSourceRGB = s.blendSourceAlpha = source;
+		s.blendDestinationRGB = s.blendDestinationAlpha = destination;
+		real(s.realBlendFunc, glad_glBlendFunc)(source, destination);
+	}
+
+	static void APIENTRY blendFuncSeparate(GLenum sourceRGB, GLenum destinationRGB, GLenum sourceAlpha, GLenum destinationAlpha)
+	{
+		State & s = state();
+		if (filter(s.blendSourceRGB == sourceRGB && s.blendDestinationRGB == destinationRGB && s.blendSourceAlpha == sourceAlpha && s.blendDestinationAlpha == destinationAlpha))
+		{
+			return;
+		}
+		s.blendSourceRGB = sourceRGB;
+		s.blendDestinationRGB = destinationRGB;
+		s.blendSourceAlpha = sourceAlpha;
+		s.blendDestinationAlpha = destinationAlpha;
+		real(s.realBlendFuncSeparate, glad_glBlendFuncSeparate)(sourceRGB, destinationRGB, sourceAlpha, destinationAlpha);
+	}
+
+	static void APIENTRY blendEquation(GLenum mode)
+	{
+		State & s = state();
+		if (filter(s.blendEquationRGB == mode && s.blendEquationAlpha == mode))
+		{
+			return;
+		}
+		s.blendEquationRGB = s.blendEquationAlpha = mode;
+		real(s.realBlendEquation, glad_glBlendEquation)(mode);
+	}
+
+	static void APIENTRY blendEquationSeparate(GLenum modeRGB, GLenum modeAlpha)
+	{
+		State & s = state();
+		if (filter(s.blendEquationRGB == modeRGB && s.blendEquationAlpha == modeAlpha))
+		{
+			return;
+		}
+		s.blendEquationRGB = modeRGB;
+		s.blendEquationAlpha = modeAlpha;
+		real(s.realBlendEquationSeparate, glad_glBlendEquationSeparate)(modeRGB, modeAlpha);
+	}
+
+	static void APIENTRY depthFunc(GLenum function)
+	{
+		State & s = state();
+		if (filter(s.depthFunction == function))
+		{
+			return;
+		}
+		s.depthFunction = function;
+		real(s.realDepthFunc, glad_glDepthFunc)(function);
+	}
+
+	static void APIENTRY depthMask(GLboolean write)
+	{
+		State & s = state();
+		if (filter(s.depthWrite == (GLuint)write))
+		{
+			return;
+		}
+		s.depthWrite = write;
+		real(s.realDepthMask, glad_glDepthMask)(write);
+	}
+
+	static void APIENTRY viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		State & s = state();
+		if (filter(s.viewport[0] == x && s.viewport[1] == y && s.viewport[2] == width && s.viewport[3] == height))
+		{
+			return;
+		}
+		s.viewport[0] = x;
+		s.viewport[1] = y;
+		s.viewport[2] = width;
+		s.viewport[3] = height;
+		real(s.realViewport, glad_glViewport)(x, y, width, height);
+	}
+
+	// Deleting bound objects resets their bindings to 0, so the shadow has to follow.
+	static void APIENTRY deleteProgram(GLuint program)
+	{
+		State & s = state();
+		if (s.program == program)
+		{
+			// stays in use until another program is bound, but the name must not be trusted anymore
+			s.program = UNKNOWN;
+		}
+		real(s.realDeleteProgram, glad_glDeleteProgram)(program);
+	}
+
+	static void APIENTRY deleteVertexArrays(GLsizei count, const GLuint* vertexArrays)
+	{
+		State & s = state();
+		for (GLsizei i = 0; i < count; i++)
+		{
+			if (s.vertexArray == vertexArrays[i])
+			{
+				s.vertexArray = 0;
+			}
+		}
+		real(s.realDeleteVertexArrays, glad_glDeleteVertexArrays)(count, vertexArrays);
+	}
+
+	static void APIENTRY deleteTextures(GLsizei count, const GLuint* textures)
+	{
+		State & s = state();
+		for (GLsizei i = 0; i < count; i++)
+		{
+			for (unsigned int unit = 0; unit < MAX_UNITS; unit++)
+			{
+				for (unsigned int target = 0; target < TARGET_COUNT; target++)
+				{
+					if (s.textures[unit][target] == textures[i])
+					{
+						s.textures[unit][target] = 0;
+					}
+				}
+			}
+		}
+		real(s.realDeleteTextures, glad_glDeleteTextures)(count, textures);
+	}
+
+	static void APIENTRY deleteFramebuffers(GLsizei count, const GLuint* framebuffers)
+	{
+		State & s = state();
+		for (GLsizei i = 0; i < count; i++)
+		{
+			if (s.drawFramebuffer == framebuffers[i])
+			{
+				s.drawFramebuffer = 0;
+			}
+			if (s.readFramebuffer == framebuffers[i])
+			{
+				s.readFramebuffer = 0;
+			}
+		}
+		real(s.realDeleteFramebuffers, glad_glDeleteFramebuffers)(count, framebuffers);
+	}
+
+private:
+	static const GLuint UNKNOWN = 0xFFFFFFFFu;
+	static const unsigned int MAX_UNITS = 32;
+	static const unsigned int TARGET_COUNT = 5;
+
+	struct State
+	{
+		bool installed;
+		bool enabled;
+		Counters counters;
+
+		GLuint program;
+		GLuint vertexArray;
+		GLuint activeUnit;
+		GLuint textures[MAX_UNITS][TARGET_COUNT];
+		GLuint drawFramebuffer;
+		GLuint readFramebuffer;
+		GLuint blend;
+		GLuint depthTest;
+		GLuint cullFace;
+		GLuint blendSourceRGB;
+		GLuint blendDestinationRGB;
+		GLuint blendSourceAlpha;
+		GLuint blendDestinationAlpha;
+		GLuint blendEquationRGB;
+		GLuint blendEquationAlpha;
+		GLuint depthFunction;
+		GLuint depthWrite;
+		GLint viewport[4];
+
+		PFNGLUSEPROGRAMPROC realUseProgram;
+		PFNGLBINDVERTEXARRAYPROC realBindVertexArray;
+		PFNGLACTIVETEXTUREPROC realActiveTexture;
+		PFNGLBINDTEXTUREPROC realBindTexture;
+		PFNGLBINDFRAMEBUFFERPROC realBindFramebuffer;
+		PFNGLENABLEPROC realEnable;
+		PFNGLDISABLEPROC realDisable;
+		PFNGLBLENDFUNCPROC realBlendFunc;
+		PFNGLBLENDFUNCSEPARATEPROC realBlendFuncSeparate;
+		PFNGLBLENDEQUATIONPROC realBlendEquation;
+		PFNGLBLENDEQUATIONSEPARATEPROC realBlendEquationSeparate;
+		PFNGLBINDTEXTUREUNITPROC realBindTextureUnit;
+		PFNGLBINDTEXTURESPROC realBindTextures;
+		PFNGLDEPTHFUNCPROC realDepthFunc;
+		PFNGLDEPTHMASKPROC realDepthMask;
+		PFNGLVIEWPORTPROC realViewport;
+		PFNGLDELETEPROGRAMPROC realDeleteProgram;
+		PFNGLDELETEVERTEXARRAYSPROC realDeleteVertexArrays;
+		PFNGLDELETETEXTURESPROC realDeleteTextures;
+		PFNGLDELETEFRAMEBUFFERSPROC realDeleteFramebuffers;
+
+		State() : installed(false), enabled(true)
+		{
+			counters.issued = 0;
+			counters.elided = 0;
+			forget();
+		}
+
+		void forget()
+		{
+			program = UNKNOWN;
+			vertexArray = UNKNOWN;
+			activeUnit = UNKNOWN;
+			for (unsigned int unit = 0; unit < MAX_UNITS; unit++)
+			{
+				for (unsigned int target = 0; target < TARGET_COUNT; target++)
+				{
+					textures[unit][target] = UNKNOWN;
+				}
+			}
+			drawFramebuffer = UNKNOWN;
+			readFramebuffer = UNKNOWN;
+			blend = UNKNOWN;
+			depthTest = UNKNOWN;
+			cullFace = UNKNOWN;
+			blendSourceRGB = UNKNOWN;
+			blendDestinationRGB = UNKNOWN;
+			blendSourceAlpha = UNKNOWN;
+			blendDestinationAlpha = UNKNOWN;
+			blendEquationRGB = UNKNOWN;
+			blendEquationAlpha = UNKNOWN;
+			depthFunction = UNKNOWN;
+			depthWrite = UNKNOWN;
+			viewport[0] = viewport[1] = viewport[2] = viewport[3] = -1;
+		}
+	};
+
+	static State & state()
+	{
+		static State s;
+		return s;
+	}
+
+	// Counts the call and tells the caller whether it can be dropped.
+	static bool filter(bool redundant)
+	{
+		State & s = state();
+		if (redundant && s.installed && s.enabled)
+		{
+			s.counters.elided++;
+			return true;
+		}
+		s.counters.issued++;
+		return false;
+	}
+
+	// Before install() the glad pointer is still the driver entry point.
+	template <typename Function>
+	static Function real(Function installed, Function current)
+	{
+		return state().installed ? installed : current;
+	}
+
+	static GLuint* textureSlot(GLuint activeUnit, GLenum target)
+	{
+		if (activeUnit < GL_TEXTURE0 || activeUnit >= GL_TEXTURE0 + MAX_UNITS)
+		{
+			return nullptr;
+		}
+		int index;
+		switch (target)
+		{
+		case GL_TEXTURE_2D: index = 0; break;
+		case GL_TEXTURE_CUBE_MAP: index = 1; break;
+		case GL_TEXTURE_2D_MULTISAMPLE: index = 2; break;
+		case GL_TEXTURE_2D_ARRAY: index = 3; break;
+		case GL_TEXTURE_3D: index = 4; break;
+		default: return nullptr;
+		}
+		return &state().textures[activeUnit - GL_TEXTURE0][index];
+	}
+
+	// After a bind by unit: 0 unbinds every target, any other texture replaces one target the shadow
+	// cannot tell, so the whole unit becomes unknown.
+	static void boundToUnit(GLuint unit, GLuint texture)
+	{
+		for (unsigned int target = 0; unit < MAX_UNITS && target < TARGET_COUNT; target++)
+		{
+			state().textures[unit][target] = texture == 0 ? 0 : UNKNOWN;
+		}
+	}
+
+	static GLuint* capability(GLenum cap)
+	{
+		switch (cap)
+		{
+		case GL_BLEND: return &state().blend;
+		case GL_DEPTH_TEST: return &state().depthTest;
+		case GL_CULL_FACE: return &state().cullFace;
+		default: return nullptr;
+		}
+	}
+};
@@ -0,0 +1,461 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include <MappedFile.h>
+#include <GLExtensions.h>
+#include <BlockCompression.h>
+
+// glad is generated without EXT_texture_compression_s3tc and EXT_texture_sRGB
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// A 2D texture in the KTX2 container, block compressed in one of the BlockCompression formats with
+// its whole mip chain. Reads a file through a memory mapping or bytes that were just cooked, so
+// upload() hands the level data to glCompressedTexImage2D without copying it. Only what the cooker
+// writes is accepted: one face, one layer and no supercompression.
+class KtxTexture
+{
+public:
+	struct Level
+	{
+		const unsigned char* data;
+		size_t size;
+		int width;
+		int height;
+	};
+
+	explicit KtxTexture(const std::string & path) : file(new MappedFile(path)), ok(false)
+	{
+		if (file->valid())
+		{
+			parse(file->data(), file->size());
+		}
+	}
+
+	explicit KtxTexture(std::vector<unsigned char> && cooked) : bytes(std::move(cooked)), ok(false)
+	{
+		parse(bytes.data(), bytes.size());
+	}
+
+	KtxTexture(const KtxTexture &) = delete;
+	KtxTexture & operator=(const KtxTexture &) = delete;
+
+	bool valid() const { return ok; }
+	BlockFormat format() const { return blockFormat; }
+	bool srgb() const { return srgbFormat; }
+	int width() const { return levels.empty() ? 0 : levels[0].width; }
+	int height() const { return levels.empty() ? 0 : levels[0].height; }
+	unsigned int levelCount() const { return (unsigned int)levels.size(); }
+	const Level & level(unsigned int i) const { return levels[i]; }
+
+	// Bytes of every level together, what the texture occupies on the GPU.
+	size_t dataSize() const
+	{
+		size_t size = 0;
+		for (const Level & level : levels)
+		{
+			size += level.size;
+		}
+		return size;
+	}
+
+	// Value of a key in the key/value data, empty when it is missing.
+	std::string value(const std::string & key) const
+	{
+		for (const std::pair<std::string, std::string> & entry : keyValues)
+		{
+			if (entry.first == key)
+			{
+				return entry.second;
+			}
+		}
+		return std::string();
+	}
+
+	// Whether the current context samples format natively. BC1 and BC3 need S3TC, BC4 and BC5 are
+	// core since 3.0, BC7 since 4.2.
+	static bool supported(BlockFormat format)
+	{
+		switch (format)
+		{
+		case BlockFormat::BC1:
+		case BlockFormat::BC3:
+			return hasGLExtension("GL_EXT_texture_compression_s3tc");
+		case BlockFormat::BC7:
+			return glContextVersion() >= 42 || hasGLExtension("GL_ARB_texture_compression_bptc");
+		default:
+			return true;
+		}
+	}
+
+	static GLenum glInternalFormat(BlockFormat format, bool srgb)
+	{
+		switch (format)
+		{
+		case BlockFormat::BC1:
+			return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BlockFormat::BC3:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BlockFormat::BC4:
+			return GL_COMPRESSED_RED_RGTC1;
+		case BlockFormat::BC5:
+			return GL_COMPRESSED_RG_RGTC2;
+		default:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+	}
+
+	// Creates a GL texture with every stored level, uploaded as is. A context without the format gets
+	// the levels decoded to RGBA8 instead. The KTXswizzle value, e.g. "rrr1" for gray BC4 textures,
+	// becomes the texture swizzle.
+	unsigned int upload(GLint wrap = GL_REPEAT) const
+	{
+		unsigned int textureID;
+		glGenTextures(1, &textureID);
+		glBindTexture(GL_TEXTURE_2D, textureID);
+
+		bool native = supported(blockFormat);
+		std::vector<unsigned char> decoded;
+		for (unsigned int i = 0; i < levels.size(); i++)
+		{
+			const Level & level = levels[i];
+			if (native)
+			{
+				glCompressedTexImage2D(GL_TEXTURE_2D, i, glInternalFormat(blockFormat, srgbFormat), level.width, level.height, 0, (GLsizei)level.size, level.data);
+			}
+			else
+			{
+				decoded.resize((size_t)level.width * level.height * 4);
+				BlockCompression::decompress(blockFormat, level.data, level.width, level.height, decoded.data());
+				glTexImage2D(GL_TEXTURE_2D, i, srgbFormat ? GL_SRGB8_ALPHA8 : GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, decoded.data());
+			}
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		setSwizzle(GL_TEXTURE_2D, value("KTXswizzle"));
+		return textureID;
+	}
+
+	// Sets the texture swizzle of the texture bound to target from a KTXswizzle value such as "rrr1".
+	// Anything but four characters leaves it alone.
+	static void setSwizzle(GLenum target, const std::string & swizzle)
+	{
+		if (swizzle.size() != 4)
+		{
+			return;
+		}
+		const GLenum parameters[4] = { GL_TEXTURE_SWIZZLE_R, GL_TEXTURE_SWIZZLE_G, GL_TEXTURE_SWIZZLE_B, GL_TEXTURE_SWIZZLE_A };
+		for (int c = 0; c < 4; c++)
+		{
+			GLint source = swizzle[c] == 'r' ? GL_RED : swizzle[c] == 'g' ? GL_GREEN : swizzle[c] == 'b' ? GL_BLUE : swizzle[c] == 'a' ? GL_ALPHA
+				: swizzle[c] == '0' ? GL_ZERO : GL_ONE;
+			glTexParameteri(target, parameters[c], source);
+		}
+	}
+
+	// Builds a KTX2 file from compressed levels, the full size first. keyValues must be sorted by key.
+	static std::vector<unsigned char> serialize(BlockFormat format, bool srgb, int width, int height, const std::vector<std::vector<unsigned char>> & levelData,
+		const std::vector<std::pair<std::string, std::string>> & keyValues)
+	{
+		uint32_t levelCount = (uint32_t)levelData.size();
+		std::vector<unsigned char> descriptor = dataFormatDescriptor(format, srgb);
+
+		std::vector<unsigned char> keyValueData;
+		for (const std::pair<std::string, std::string> & entry : keyValues)
+		{
+			uint32_t length = (uint32_t)(entry.first.size() + 1 + entry.second.size() + 1);
+			append(keyValueData, length);
+			keyValueData.insert(keyValueData.end(), entry.first.begin(), entry.first.end());
+			keyValueData.push_back(0);
+			keyValueData.insert(keyValueData.end(), entry.second.begin(), entry.second.end());
+			keyValueData.push_back(0);
+			keyValueData.resize((keyValueData.size() + 3) & ~(size_t)3, 0);
+		}
+
+		uint32_t descriptorOffset = HEADER_BYTES + levelCount * LEVEL_INDEX_BYTES;
+		uint32_t keyValueOffset = descriptorOffset + (uint32_t)descriptor.size();
+
+		// levels are stored smallest first, each aligned to its block size
+		size_t alignment = BlockCompression::blockBytes(format);
+		std::vector<uint64_t> offsets(levelCount);
+		size_t end = keyValueOffset + keyValueData.size();
+		for (uint32_t i = levelCount; i-- > 0;)
+		{
+			end = (end + alignment - 1) / alignment * alignment;
+			offsets[i] = end;
+			end += levelData[i].size();
+		}
+
+		std::vector<unsigned char> out;
+		out.reserve(end);
+		out.insert(out.end(), identifier(), identifier() + IDENTIFIER_BYTES);
+		append(out, vkFormat(format, srgb));
+		append(out, (uint32_t)1); // typeSize
+		append(out, (uint32_t)width);
+		append(out, (uint32_t)height);
+		append(out, (uint32_t)0); // pixelDepth
+		append(out, (uint32_t)0); // layerCount
+		append(out, (uint32_t)1); // faceCount
+		append(out, levelCount);
+		append(out, (uint32_t)0); // supercompressionScheme
+		append(out, descriptorOffset);
+		append(out, (uint32_t)descriptor.size());
+		append(out, keyValueData.empty() ? (uint32_t)0 : keyValueOffset);
+		append(out, (uint32_t)keyValueData.size());
+		append(out, (uint64_t)0); // supercompression global data
+		append(out, (uint64_t)0);
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			append(out, offsets[i]);
+			append(out, (uint64_t)levelData[i].size());
+			append(out, (uint64_t)levelData[i].size());
+		}
+		out.insert(out.end(), descriptor.begin(), descriptor.end());
+		out.insert(out.end(), keyValueData.begin(), keyValueData.end());
+		for (uint32_t i = levelCount; i-- > 0;)
+		{
+			out.resize((size_t)offsets[i], 0);
+			out.insert(out.end(), levelData[i].begin(), levelData[i].end());
+		}
+		return out;
+	}
+
+	// Writes the bytes next to path and renames them over it, so a loader on another thread never
+	// maps a half written file.
+	static bool write(const std::string & path, const std::vector<unsigned char> & data)
+	{
+		static std::atomic<unsigned int> writes(0);
+		std::string temporary = path + "." + std::to_string(writes++) + ".tmp";
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			std::cout << "ERROR::KTX::CANNOT_WRITE " << path << std::endl;
+			return false;
+		}
+		file.write((const char*)data.data(), data.size());
+		file.close();
+		if (!file)
+		{
+			std::remove(temporary.c_str());
+			return false;
+		}
+		std::remove(path.c_str());
+		if (std::rename(temporary.c_str(), path.c_str()) != 0)
+		{
+			std::remove(temporary.c_str());
+			return false;
+		}
+		return true;
+	}
+
+private:
+	static const uint32_t HEADER_BYTES = 80;
+	static const uint32_t LEVEL_INDEX_BYTES = 24;
+	static const size_t IDENTIFIER_BYTES = 12;
+
+	std::unique_ptr<MappedFile> file;
+	std::vector<unsigned char> bytes;
+	bool ok;
+	BlockFormat blockFormat;
+	bool srgbFormat;
+	std::vector<Level> levels;
+	std::vector<std::pair<std::string, std::string>> keyValues;
+
+	// the KTX 2.0 file identifier
+	static const unsigned char* identifier()
+	{
+		static const unsigned char bytes[IDENTIFIER_BYTES] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+		return bytes;
+	}
+
+	// VkFormat of each block format, the sRGB variant is one higher except for BC4 and BC5.
+	static uint32_t vkFormat(BlockFormat format, bool srgb)
+	{
+		switch (format)
+		{
+		case BlockFormat::BC1:
+			return srgb ? 132 : 131;
+		case BlockFormat::BC3:
+			return srgb ? 138 : 137;
+		case BlockFormat::BC4:
+			return 139;
+		case BlockFormat::BC5:
+			return 141;
+		default:
+			return srgb ? 146 : 145;
+		}
+	}
+
+	static bool blockFormatOf(uint32_t vkFormat, BlockFormat & format, bool & srgb)
+	{
+		const BlockFormat formats[5] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7 };
+		for (BlockFormat candidate : formats)
+		{
+			for (int s = 0; s < 2; s++)
+			{
+				if (KtxTexture::vkFormat(candidate, s != 0) == vkFormat)
+				{
+					format = candidate;
+					srgb = s != 0;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	// The basic data format descriptor block of the Khronos Data Format spec for a BC format: color
+	// model, transfer function, 4x4 blocks and one sample per 64-bit half of the block.
+	static std::vector<unsigned char> dataFormatDescriptor(BlockFormat format, bool srgb)
+	{
+		uint32_t colorModel = 128; // KHR_DF_MODEL_BC1A
+		std::vector<uint32_t> channels(1, 0);
+		switch (format)
+		{
+		case BlockFormat::BC3:
+			colorModel = 130;
+			channels = { 15, 0 }; // alpha, then color
+			break;
+		case BlockFormat::BC4:
+			colorModel = 131;
+			break;
+		case BlockFormat::BC5:
+			colorModel = 132;
+			channels = { 0, 1 }; // red, then green
+			break;
+		case BlockFormat::BC7:
+			colorModel = 134;
+			break;
+		default:
+			break;
+		}
+		uint32_t blockBits = BlockCompression::blockBytes(format) * 8;
+		uint32_t sampleBits = blockBits / (uint32_t)channels.size();
+
+		std::vector<unsigned char> out;
+		uint32_t blockSize = 24 + 16 * (uint32_t)channels.size();
+		append(out, 4 + blockSize); // dfdTotalSize
+		append(out, (uint32_t)0); // vendor and descriptor type
+		append(out, (uint32_t)(2 | (blockSize << 16))); // version 2
+		append(out, colorModel | (1u << 8) | ((srgb ? 2u : 1u) << 16)); // BT.709 primaries, sRGB or linear
+		append(out, (uint32_t)(3 | (3 << 8))); // 4x4 texel blocks
+		append(out, BlockCompression::blockBytes(format));
+		append(out, (uint32_t)0);
+		for (size_t i = 0; i < channels.size(); i++)
+		{
+			append(out, (uint32_t)((i * sampleBits) | ((sampleBits - 1) << 16) | (channels[i] << 24)));
+			append(out, (uint32_t)0);
+			append(out, (uint32_t)0);
+			append(out, (uint32_t)0xFFFFFFFF);
+		}
+		return out;
+	}
+
+	template <typename T>
+	static void append(std::vector<unsigned char> & out, T value)
+	{
+		const unsigned char* data = (const unsigned char*)&value;
+		out.insert(out.end(), data, data + sizeof(T));
+	}
+
+	template <typename T>
+	static T read(const unsigned char* data, size_t offset)
+	{
+		T value;
+		memcpy(&value, data + offset, sizeof(T));
+		return value;
+	}
+
+	void parse(const unsigned char* data, size_t size)
+	{
+		if (size < HEADER_BYTES || memcmp(data, identifier(), IDENTIFIER_BYTES) != 0)
+		{
+			return;
+		}
+		uint32_t width = read<uint32_t>(data, 20);
+		uint32_t height = read<uint32_t>(data, 24);
+		uint32_t levelCount = read<uint32_t>(data, 40);
+		if (!blockFormatOf(read<uint32_t>(data, 12), blockFormat, srgbFormat) || width == 0 || height == 0 || read<uint32_t>(data, 28) > 1
+			|| read<uint32_t>(data, 32) > 1 || read<uint32_t>(data, 36) != 1 || levelCount == 0 || read<uint32_t>(data, 44) != 0
+			|| HEADER_BYTES + (uint64_t)levelCount * LEVEL_INDEX_BYTES > size)
+		{
+			return;
+		}
+
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			uint64_t offset = read<uint64_t>(data, HEADER_BYTES + i * LEVEL_INDEX_BYTES);
+			uint64_t length = read<uint64_t>(data, HEADER_BYTES + i * LEVEL_INDEX_BYTES + 8);
+			Level level;
+			level.width = std::max((int)(width >> i), 1);
+			level.height = std::max((int)(height >> i), 1);
+			level.data = data + offset;
+			level.size = (size_t)length;
+			if (offset + length > size || length != BlockCompression::imageBytes(blockFormat, level.width, level.height))
+			{
+				levels.clear();
+				return;
+			}
+			levels.push_back(level);
+		}
+
+		uint32_t keyValueOffset = read<uint32_t>(data, 56);
+		uint32_t keyValueLength = read<uint32_t>(data, 60);
+		if ((uint64_t)keyValueOffset + keyValueLength <= size)
+		{
+			size_t position = keyValueOffset;
+			size_t end = (size_t)keyValueOffset + keyValueLength;
+			while (position + 4 <= end)
+			{
+				uint32_t length = read<uint32_t>(data, position);
+				position += 4;
+				if (position + length > end)
+				{
+					break;
+				}
+				const char* text = (const char*)data + position;
+				size_t keyLength = strnlen(text, length);
+				if (keyLength < length)
+				{
+					std::string key(text, keyLength);
+					std::string value(text + keyLength + 1, length - keyLength - 1);
+					if (!value.empty() && value.back() == '\0')
+					{
+						value.pop_back();
+					}
+					keyValues.push_back(std::make_pair(key, value));
+				}
+				position = (position + length + 3) & ~(size_t)3;
+			}
+		}
+		ok = true;
+	}
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. Pages are faulted in by the OS on first touch, so
+// handing data() to glBufferData copies straight from the page cache without a read() buffer.
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string & path) : mappedData(nullptr), mappedSize(0)
+	{
+#ifdef _WIN32
+		fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		mappingHandle = NULL;
+		if (fileHandle == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart == 0)
+		{
+			return;
+		}
+		mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mappingHandle == NULL)
+		{
+			return;
+		}
+		mappedData = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		if (mappedData != nullptr)
+		{
+			mappedSize = (size_t)size.QuadPart;
+		}
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			return;
+		}
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0)
+		{
+			void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED)
+			{
+				mappedData = (const unsigned char*)data;
+				mappedSize = (size_t)info.st_size;
+			}
+		}
+		// the mapping keeps the file alive on its own
+		close(fd);
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (mappedData != nullptr)
+		{
+			UnmapViewOfFile(mappedData);
+		}
+		if (mappingHandle != NULL)
+		{
+			CloseHandle(mappingHandle);
+		}
+		if (fileHandle != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(fileHandle);
+		}
+#else
+		if (mappedData != nullptr)
+		{
+			munmap((void*)mappedData, mappedSize);
+		}
+#endif
+	}
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+
+	bool valid() const { return mappedData != nullptr; }
+	const unsigned char* data() const { return mappedData; }
+	size_t size() const { return mappedSize; }
+
+private:
+	const unsigned char* mappedData;
+	size_t mappedSize;
+#ifdef _WIN32
+	HANDLE fileHandle;
+	HANDLE mappingHandle;
+#endif
+};
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <algorithm>
+
+#include <stb_image.h>
+
+#include <TextureArray.h>
+#include <MaterialCooker.h>
+
+// Where a material lives in a MaterialAtlas: the batch whose arrays hold its maps and the layer
+// it has in all three of them.
+struct MaterialSlot
+{
+	int batch = -1;
+	int layer = -1;
+};
+
+// Stores cooked PBR materials as layers of texture arrays, so objects with different materials can
+// share one draw. A batch is an albedo, a normal and an ORM array with a common LayerAllocator, a
+// material takes the same layer in each; shaders with MATERIAL_ARRAYS sample them with the layer
+// as third coordinate. Every object of a batch draws in one instanced call.
+//
+// Each map of a material goes into the format, size and level count most of the added materials
+// share for that map. Larger textures with a full mip chain drop their top levels to fit it. Maps
+// that cannot fit, e.g. a different size that is not a power of two larger or another block
+// format, give their material a batch of its own, which still works but costs a draw of its own.
+// A missing map is a cleared layer and samples as zero.
+class MaterialAtlas
+{
+public:
+	static const int MAP_COUNT = 3;
+
+	struct Batch
+	{
+		// albedo, normal and ORM
+		std::unique_ptr<TextureArray> maps[MAP_COUNT];
+		LayerAllocator layers;
+
+		// Binds the three arrays to texture units from firstUnit on, in the order of PbrMaterial::bind().
+		void bind(unsigned int firstUnit) const
+		{
+			for (unsigned int i = 0; i < MAP_COUNT; i++)
+			{
+				glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, maps[i]->id());
+			}
+		}
+	};
+
+	MaterialAtlas() {}
+	MaterialAtlas(const MaterialAtlas &) = delete;
+	MaterialAtlas & operator=(const MaterialAtlas &) = delete;
+
+	// Gives every material a layer and uploads its maps, in the order of materials. Materials join a
+	// batch of the same formats while it has free layers, new batches are sized for all the
+	// materials that still need one. The images are released. Must be called on the thread that
+	// owns the GL context.
+	std::vector<MaterialSlot> add(std::vector<PbrMaterialImages> & materials)
+	{
+		std::vector<Placement> placements(materials.size());
+		for (int map = 0; map < MAP_COUNT; map++)
+		{
+			TextureArray::Format common = commonFormat(materials, map);
+			for (size_t i = 0; i < materials.size(); i++)
+			{
+				place(image(materials[i], map), common, placements[i].formats[map], placements[i].skipLevels[map]);
+			}
+		}
+
+		std::vector<MaterialSlot> slots(materials.size());
+		for (size_t i = 0; i < materials.size(); i++)
+		{
+			slots[i].batch = findBatch(placements[i]);
+			if (slots[i].batch < 0)
+			{
+				slots[i].batch = createBatch(placements, i);
+			}
+			Batch & batch = *batches[slots[i].batch];
+			slots[i].layer = batch.layers.allocate();
+			for (int map = 0; map < MAP_COUNT; map++)
+			{
+				TextureLoader::Image & source = image(materials[i], map);
+				if (source.compressed)
+				{
+					batch.maps[map]->upload(slots[i].layer, *source.compressed, placements[i].skipLevels[map]);
+				}
+				else
+				{
+					batch.maps[map]->clear(slots[i].layer);
+				}
+				release(source);
+			}
+		}
+		return slots;
+	}
+
+	// Frees the layer of a material for the next add(). The arrays keep their size.
+	void remove(const MaterialSlot & slot)
+	{
+		if (slot.batch >= 0 && slot.batch < (int)batches.size())
+		{
+			batches[slot.batch]->layers.release(slot.layer);
+		}
+	}
+
+	// Deletes every array, all slots become invalid.
+	void clear()
+	{
+		batches.clear();
+	}
+
+	size_t batchCount() const { return batches.size(); }
+	const Batch & batch(size_t i) const { return *batches[i]; }
+
+	// Bytes of all arrays, free layers included.
+	size_t memory() const
+	{
+		size_t bytes = 0;
+		for (const std::unique_ptr<Batch> & batch : batches)
+		{
+			for (int map = 0; map < MAP_COUNT; map++)
+			{
+				bytes += batch->maps[map]->memory();
+			}
+		}
+		return bytes;
+	}
+
+private:
+	struct Placement
+	{
+		TextureArray::Format formats[MAP_COUNT];
+		unsigned int skipLevels[MAP_COUNT] = { 0, 0, 0 };
+	};
+
+	std::vector<std::unique_ptr<Batch>> batches;
+
+	static TextureLoader::Image & image(PbrMaterialImages & material, int map)
+	{
+		return map == 0 ? material.albedo : map == 1 ? material.normal : material.orm;
+	}
+
+	// The format most cooked textures of a map have, a small cleared single level when none does.
+	static TextureArray::Format commonFormat(std::vector<PbrMaterialImages> & materials, int map)
+	{
+		std::vector<std::pair<TextureArray::Format, int>> counts;
+		for (PbrMaterialImages & material : materials)
+		{
+			TextureLoader::Image & source = image(material, map);
+			if (!source.compressed)
+			{
+				continue;
+			}
+			TextureArray::Format format = TextureArray::formatOf(*source.compressed);
+			auto found = std::find_if(counts.begin(), counts.end(), [&](const std::pair<TextureArray::Format, int> & count) { return count.first == format; });
+			if (found == counts.end())
+			{
+				counts.push_back(std::make_pair(format, 1));
+			}
+			else
+			{
+				found->second++;
+			}
+		}
+		if (counts.empty())
+		{
+			TextureArray::Format placeholder;
+			placeholder.blockFormat = BlockFormat::BC4;
+			placeholder.srgb = false;
+			placeholder.swizzle = "rrr1";
+			placeholder.width = placeholder.height = 4;
+			placeholder.levels = 1;
+			return placeholder;
+		}
+		return std::max_element(counts.begin(), counts.end(), [](const std::pair<TextureArray::Format, int> & a, const std::pair<TextureArray::Format, int> & b)
+		{
+			return a.second < b.second;
+		})->first;
+	}
+
+	static void place(const TextureLoader::Image & source, const TextureArray::Format & common, TextureArray::Format & format, unsigned int & skipLevels)
+	{
+		format = common;
+		skipLevels = 0;
+		if (source.data != nullptr)
+		{
+			std::cout << "ERROR::MATERIAL_ATLAS::TEXTURE_NOT_COMPRESSED" << std::endl;
+		}
+		if (!source.compressed)
+		{
+			return;
+		}
+		int skip = TextureArray::levelsToSkip(*source.compressed, common);
+		if (skip >= 0)
+		{
+			skipLevels = (unsigned int)skip;
+		}
+		else
+		{
+			format = TextureArray::formatOf(*source.compressed);
+		}
+	}
+
+	static void release(TextureLoader::Image & source)
+	{
+		source.compressed.reset();
+		stbi_image_free(source.data);
+		source.data = nullptr;
+	}
+
+	static bool matches(const Batch & batch, const Placement & placement)
+	{
+		for (int map = 0; map < MAP_COUNT; map++)
+		{
+			if (batch.maps[map]->format() != placement.formats[map])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	int findBatch(const Placement & placement) const
+	{
+		for (size_t i = 0; i < batches.size(); i++)
+		{
+			if (!batches[i]->layers.full() && matches(*batches[i], placement))
+			{
+				return (int)i;
+			}
+		}
+		return -1;
+	}
+
+	// A batch for placements[first] with a layer for every later placement of the same formats.
+	int createBatch(const std::vector<Placement> & placements, size_t first)
+	{
+		unsigned int count = 0;
+		for (size_t i = first; i < placements.size(); i++)
+		{
+			bool same = true;
+			for (int map = 0; map < MAP_COUNT; map++)
+			{
+				same = same && placements[i].formats[map] == placements[first].formats[map];
+			}
+			count += same ? 1 : 0;
+		}
+		unsigned int layers = std::min(count, TextureArray::maxLayers());
+
+		std::unique_ptr<Batch> batch(new Batch());
+		for (int map = 0; map < MAP_COUNT; map++)
+		{
+			batch->maps[map].reset(new TextureArray(placements[first].formats[map], layers));
+		}
+		batch->layers = LayerAllocator(layers);
+		batches.push_back(std::move(batch));
+		return (int)batches.size() - 1;
+	}
+};
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <string>
+#include <vector>
+#include <future>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include <stb_image.h>
+
+#include <TextureLoader.h>
+#include <TextureCache.h>
+
+// The textures of a PBR material as shaders with PACKED_MATERIAL_MAPS sample them: an sRGB albedo
+// that samples as linear color (SRGB_ALBEDO), a normal map read as x and y (NORMAL_MAP_RG), and
+// occlusion, roughness and metallic in the red, green and blue channels of one ORM texture.
+struct PbrMaterial
+{
+	TextureHandle albedo;
+	TextureHandle normal;
+	TextureHandle orm;
+
+	// Binds albedo, normal and ORM to three texture units from firstUnit on.
+	void bind(unsigned int firstUnit) const
+	{
+		const TextureHandle* textures[3] = { &albedo, &normal, &orm };
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+			glBindTexture(GL_TEXTURE_2D, textures[i]->id());
+		}
+	}
+};
+
+// The cooked textures of a material before upload, see MaterialCooker::decodeAll().
+struct PbrMaterialImages
+{
+	TextureLoader::Image albedo;
+	TextureLoader::Image normal;
+	TextureLoader::Image orm;
+};
+
+// Turns a directory with albedo.png, normal.png, ao.png, roughness.png and metallic.png into a
+// PbrMaterial. The three gray maps are packed into one image and cooked like TextureLoader cooks a
+// file, so the ORM texture is block compressed with its mips and cached in
+// TextureLoader::cacheDirectory() under a hash of all three sources. Gray maps of different sizes
+// are scaled to the largest, a missing one is replaced by full occlusion, full roughness and no
+// metal.
+class MaterialCooker
+{
+public:
+	static PbrMaterial load(const std::string & directory, unsigned int flags = TEXTURE_COMPRESSED)
+	{
+		return loadAll(std::vector<std::string>(1, directory), flags)[0];
+	}
+
+	// Loads every material. The ORM textures are cooked or read on threads of their own while the
+	// albedo and normal maps go through TextureCache::acquireAll with flags, plus TEXTURE_SRGB for
+	// albedo so its mips are filtered in linear space. ORM is BC7 where the context samples it, three
+	// unrelated channels lose more in BC1. Must be called on the thread that owns the GL context.
+	static std::vector<PbrMaterial> loadAll(const std::vector<std::string> & directories, unsigned int flags = TEXTURE_COMPRESSED)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		unsigned int packedFlags = contextOrmFlags(flags);
+
+		std::vector<std::future<TextureLoader::Image>> packed;
+		std::vector<std::string> albedoPaths, normalPaths;
+		for (const std::string & directory : directories)
+		{
+			packed.push_back(std::async(std::launch::async, cookOrm, directory, packedFlags));
+			albedoPaths.push_back(file(directory, "albedo.png"));
+			normalPaths.push_back(file(directory, "normal.png"));
+		}
+		std::vector<TextureHandle> albedo = TextureCache::acquireAll(albedoPaths, flags | TEXTURE_SRGB);
+		std::vector<TextureHandle> normal = TextureCache::acquireAll(normalPaths, flags | TEXTURE_NORMAL_MAP);
+
+		std::vector<PbrMaterial> materials(directories.size());
+		for (size_t i = 0; i < directories.size(); i++)
+		{
+			TextureLoader::Image orm = packed[i].get();
+			materials[i].albedo = albedo[i];
+			materials[i].normal = normal[i];
+			materials[i].orm = TextureCache::acquire(file(directories[i], "orm"), orm, packedFlags);
+		}
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << "loaded " << directories.size() << " materials in " << elapsed.count() << " ms" << std::endl;
+		return materials;
+	}
+
+	// Like loadAll(), but returns the textures without uploading them, for callers that place them
+	// themselves such as MaterialAtlas. With TEXTURE_COMPRESSED every image holds its cooked texture.
+	// Must be called on the thread that owns the GL context, which decides the ORM format.
+	static std::vector<PbrMaterialImages> decodeAll(const std::vector<std::string> & directories, unsigned int flags = TEXTURE_COMPRESSED)
+	{
+		unsigned int packedFlags = contextOrmFlags(flags);
+
+		std::vector<std::future<TextureLoader::Image>> packed;
+		std::vector<std::string> paths;
+		std::vector<unsigned int> pathFlags;
+		for (const std::string & directory : directories)
+		{
+			packed.push_back(std::async(std::launch::async, cookOrm, directory, packedFlags));
+			paths.push_back(file(directory, "albedo.png"));
+			pathFlags.push_back(flags | TEXTURE_SRGB);
+			paths.push_back(file(directory, "normal.png"));
+			pathFlags.push_back(flags | TEXTURE_NORMAL_MAP);
+		}
+		std::vector<TextureLoader::Image> decoded = TextureLoader::decodeAll(paths, pathFlags);
+
+		std::vector<PbrMaterialImages> materials(directories.size());
+		for (size_t i = 0; i < directories.size(); i++)
+		{
+			materials[i].albedo = decoded[2 * i];
+			materials[i].normal = decoded[2 * i + 1];
+			materials[i].orm = packed[i].get();
+		}
+		return materials;
+	}
+
+	// The packed ORM texture of a directory, read from the cache or cooked, in BC7 with TEXTURE_BC7 and
+	// BC1 otherwise. Needs no GL context. The image is empty when none of the three maps could be read.
+	static TextureLoader::Image cookOrm(const std::string & directory, unsigned int flags)
+	{
+		const char* maps[3] = { "ao.png", "roughness.png", "metallic.png" };
+		const unsigned char defaults[3] = { 255, 255, 0 };
+
+		TextureLoader::Image image;
+		image.width = image.height = 0;
+		image.components = 3;
+		image.data = nullptr;
+
+		// the sources are hashed with their lengths, so moving bytes from one map to the next is a change
+		std::string sources[3];
+		std::string combined;
+		bool any = false;
+		for (int i = 0; i < 3; i++)
+		{
+			sources[i] = TextureLoader::readFile(file(directory, maps[i]));
+			combined += std::to_string(sources[i].size()) + ":" + sources[i];
+			any = any || !sources[i].empty();
+		}
+		if (!any)
+		{
+			return image;
+		}
+		unsigned int cookFlags = ormFlags(flags);
+		std::string hash = TextureLoader::sourceHash(combined, cookFlags);
+		std::string cookedPath = TextureLoader::cachePath(file(directory, "orm"), cookFlags);
+		image.compressed = TextureLoader::findCooked(cookedPath, hash);
+		if (!image.compressed)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::vector<unsigned char> rgba = pack(sources, defaults, image.width, image.height);
+			std::vector<unsigned char> bytes = TextureLoader::cook(rgba.data(), image.width, image.height, 3, cookFlags, hash);
+			image.compressed = TextureLoader::storeCooked(cookedPath, std::move(bytes));
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			std::cout << "cooked " << file(directory, "orm") << " in " << elapsed.count() << " ms" << std::endl;
+		}
+		if (image.compressed)
+		{
+			image.width = image.compressed->width();
+			image.height = image.compressed->height();
+		}
+		return image;
+	}
+
+private:
+	static std::string file(const std::string & directory, const std::string & name)
+	{
+		return directory.empty() ? name : directory + "/" + name;
+	}
+
+	// ORM is always cooked, its channels are data and never sRGB.
+	static unsigned int ormFlags(unsigned int flags)
+	{
+		return TEXTURE_COMPRESSED | (flags & TEXTURE_BC7);
+	}
+
+	static unsigned int contextOrmFlags(unsigned int flags)
+	{
+		return ormFlags(KtxTexture::supported(BlockFormat::BC7) ? flags | TEXTURE_BC7 : flags);
+	}
+
+	// Decodes the first channel of every source and interleaves them into RGBA8 at the size of the
+	// largest one. Writes that size.
+	static std::vector<unsigned char> pack(const std::string sources[3], const unsigned char defaults[3], int & width, int & height)
+	{
+		unsigned char* channels[3] = { nullptr, nullptr, nullptr };
+		int widths[3] = { 0, 0, 0 };
+		int heights[3] = { 0, 0, 0 };
+		int components[3] = { 0, 0, 0 };
+		width = height = 1;
+		for (int i = 0; i < 3; i++)
+		{
+			if (!sources[i].empty())
+			{
+				channels[i] = stbi_load_from_memory((const stbi_uc*)sources[i].data(), (int)sources[i].size(), &widths[i], &heights[i], &components[i], 0);
+			}
+			if (channels[i] != nullptr)
+			{
+				width = std::max(width, widths[i]);
+				height = std::max(height, heights[i]);
+			}
+		}
+
+		std::vector<unsigned char> rgba((size_t)width * height * 4, 255);
+		for (int i = 0; i < 3; i++)
+		{
+			for (int y = 0; y < height; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					unsigned char value = defaults[i];
+					if (channels[i] != nullptr)
+					{
+						value = sample(channels[i], widths[i], heights[i], components[i], (x + 0.5f) * widths[i] / width - 0.5f, (y + 0.5f) * heights[i] / height - 0.5f);
+					}
+					rgba[((size_t)y * width + x) * 4 + i] = value;
+				}
+			}
+			stbi_image_free(channels[i]);
+		}
+		return rgba;
+	}
+
+	// Bilinear sample of the first channel at a texel position, clamped to the edge.
+	static unsigned char sample(const unsigned char* pixels, int width, int height, int components, float x, float y)
+	{
+		x = std::min(std::max(x, 0.0f), (float)(width - 1));
+		y = std::min(std::max(y, 0.0f), (float)(height - 1));
+		int x0 = (int)x;
+		int y0 = (int)y;
+		int x1 = std::min(x0 + 1, width - 1);
+		int y1 = std::min(y0 + 1, height - 1);
+		float fx = x - (float)x0;
+		float fy = y - (float)y0;
+		auto at = [&](int px, int py) { return (float)pixels[((size_t)py * width + px) * components]; };
+		float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+		float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+		return (unsigned char)(top + (bottom - top) * fy + 0.5f);
+	}
+};
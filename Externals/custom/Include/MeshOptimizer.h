@@ -0,0 +1,391 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+#include <glm.hpp>
+
+// Import-time reordering of triangle lists. optimize() runs the three passes in order:
+// optimizeVertexCache() orders triangles for the post-transform cache (Forsyth's linear-speed
+// algorithm), optimizeOverdraw() moves outward facing clusters of them to the front without breaking
+// that order up, optimizeVertexFetch() renumbers vertices in first-use order. analyzeVertexCache()
+// simulates a FIFO cache, so the gain can be measured on the CPU.
+class MeshOptimizer
+{
+public:
+	struct VertexCacheStatistics
+	{
+		unsigned long long triangles;
+		unsigned long long vertices;
+		unsigned long long transformed;
+
+		// average cache miss ratio: transformed vertices per triangle, 0.5 is the best a regular grid gets
+		float acmr() const { return triangles > 0 ? (float)transformed / triangles : 0.0f; }
+		// average transform to vertex ratio: 1 means every vertex is transformed exactly once
+		float atvr() const { return vertices > 0 ? (float)transformed / vertices : 0.0f; }
+
+		void add(const VertexCacheStatistics & other)
+		{
+			triangles += other.triangles;
+			vertices += other.vertices;
+			transformed += other.transformed;
+		}
+	};
+
+	// Totals of every optimize() call since the last resetReport(), before and after.
+	struct Report
+	{
+		VertexCacheStatistics before;
+		VertexCacheStatistics after;
+	};
+
+	// Cache size analyzeVertexCache() simulates when the caller gives none.
+	static const unsigned int SIMULATED_CACHE_SIZE = 16;
+
+	// Loaders only run the passes when this is set. Off by default.
+	static bool & enabled()
+	{
+		static bool optimize = false;
+		return optimize;
+	}
+
+	// One per thread, so models imported on worker threads at the same time do not mix their numbers.
+	static Report & report()
+	{
+		static thread_local Report totals = { { 0, 0, 0 }, { 0, 0, 0 } };
+		return totals;
+	}
+
+	static void resetReport()
+	{
+		Report none = { { 0, 0, 0 }, { 0, 0, 0 } };
+		report() = none;
+	}
+
+	static void printReport(const std::string & name)
+	{
+		const Report & totals = report();
+		std::cout << "vertex cache " << name << ": ACMR " << totals.before.acmr() << " -> " << totals.after.acmr()
+			<< ", ATVR " << totals.before.atvr() << " -> " << totals.after.atvr()
+			<< " (" << SIMULATED_CACHE_SIZE << " entry FIFO)" << std::endl;
+	}
+
+	// Runs all passes on one mesh and adds its statistics to report(). positions points at the first
+	// position, stride is the distance between two in bytes. Returns the vertex remap for
+	// remapVertices(), which the caller applies to every vertex stream.
+	static std::vector<unsigned int> optimize(unsigned int* indices, size_t indexCount, unsigned int vertexCount, const float* positions, size_t stride)
+	{
+		report().before.add(analyzeVertexCache(indices, indexCount, vertexCount));
+
+		optimizeVertexCache(indices, indexCount, vertexCount);
+		optimizeOverdraw(indices, indexCount, vertexCount, positions, stride);
+		std::vector<unsigned int> remap = optimizeVertexFetch(indices, indexCount, vertexCount);
+
+		report().after.add(analyzeVertexCache(indices, indexCount, vertexCount));
+		return remap;
+	}
+
+	static VertexCacheStatistics analyzeVertexCache(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int cacheSize = SIMULATED_CACHE_SIZE)
+	{
+		VertexCacheStatistics statistics = { indexCount / 3, vertexCount, 0 };
+
+		// timestamps instead of a queue: a vertex is cached while it entered less than cacheSize misses ago
+		std::vector<unsigned long long> entered(vertexCount, 0);
+		unsigned long long time = cacheSize + 1;
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			unsigned int vertex = indices[i];
+			if (time - entered[vertex] > cacheSize)
+			{
+				entered[vertex] = time++;
+				statistics.transformed++;
+			}
+		}
+		return statistics;
+	}
+
+	// Forsyth, "Linear-Speed Vertex Cache Optimisation", with a 32 entry LRU cache model.
+	static void optimizeVertexCache(unsigned int* indices, size_t indexCount, unsigned int vertexCount)
+	{
+		const int CACHE_SIZE = 32;
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		// triangles of every vertex, as offsets into one array
+		std::vector<unsigned int> valence(vertexCount, 0);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+		{
+			valence[indices[i]]++;
+		}
+		std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			firstTriangle[v + 1] = firstTriangle[v] + valence[v];
+		}
+		std::vector<unsigned int> adjacency(triangleCount * 3);
+		std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int v = indices[t * 3 + corner];
+				adjacency[filled[v]++] = (unsigned int)t;
+			}
+		}
+
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			vertexScore[v] = score(-1, valence[v]);
+		}
+
+		std::vector<char> emitted(triangleCount, 0);
+		std::vector<float> triangleScore(triangleCount);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		}
+
+		std::vector<unsigned int> result;
+		result.reserve(triangleCount * 3);
+		std::vector<unsigned int> cache;
+		std::vector<unsigned int> nextCache;
+		size_t scanStart = 0;
+		size_t best = 0;
+		float bestScore = -1.0f;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			if (triangleScore[t] > bestScore)
+			{
+				bestScore = triangleScore[t];
+				best = t;
+			}
+		}
+
+		for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+		{
+			if (bestScore < 0.0f)
+			{
+				// nothing in the cache leads anywhere, continue with the next triangle in input order
+				while (emitted[scanStart])
+				{
+					scanStart++;
+				}
+				best = scanStart;
+			}
+
+			emitted[best] = 1;
+			const unsigned int* triangle = indices + best * 3;
+			result.insert(result.end(), triangle, triangle + 3);
+
+			// the triangle's vertices move to the front, everything else shifts back
+			nextCache.assign(triangle, triangle + 3);
+			for (unsigned int v : cache)
+			{
+				if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				{
+					nextCache.push_back(v);
+				}
+			}
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int v = triangle[corner];
+				valence[v]--;
+				// drop the triangle from the vertex's list
+				for (unsigned int a = firstTriangle[v]; a < firstTriangle[v] + valence[v] + 1; a++)
+				{
+					if (adjacency[a] == best)
+					{
+						std::swap(adjacency[a], adjacency[firstTriangle[v] + valence[v]]);
+						break;
+					}
+				}
+			}
+
+			for (size_t i = 0; i < nextCache.size(); i++)
+			{
+				unsigned int v = nextCache[i];
+				cachePosition[v] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+				vertexScore[v] = score(cachePosition[v], valence[v]);
+			}
+
+			// only triangles touching the cache changed their score
+			bestScore = -1.0f;
+			for (unsigned int v : nextCache)
+			{
+				for (unsigned int a = firstTriangle[v]; a < firstTriangle[v] + valence[v]; a++)
+				{
+					unsigned int t = adjacency[a];
+					triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+					if (triangleScore[t] > bestScore)
+					{
+						bestScore = triangleScore[t];
+						best = t;
+					}
+				}
+			}
+
+			if (nextCache.size() > (size_t)CACHE_SIZE)
+			{
+				nextCache.resize(CACHE_SIZE);
+			}
+			cache.swap(nextCache);
+		}
+
+		std::copy(result.begin(), result.end(), indices);
+	}
+
+	// Splits the cache-ordered triangles into clusters at every triangle that misses the simulated
+	// cache with all three vertices, then draws clusters that face away from the mesh center first.
+	// Those tend to occlude the rest, and since the clusters start cold anyway the cache order holds.
+	static void optimizeOverdraw(unsigned int* indices, size_t indexCount, unsigned int vertexCount, const float* positions, size_t stride)
+	{
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		std::vector<size_t> clusterStart;
+		std::vector<unsigned long long> entered(vertexCount, 0);
+		unsigned long long time = SIMULATED_CACHE_SIZE + 1;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			int misses = 0;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int v = indices[t * 3 + corner];
+				if (time - entered[v] > SIMULATED_CACHE_SIZE)
+				{
+					entered[v] = time++;
+					misses++;
+				}
+			}
+			if (t == 0 || misses == 3)
+			{
+				clusterStart.push_back(t);
+			}
+		}
+		clusterStart.push_back(triangleCount);
+
+		size_t clusterCount = clusterStart.size() - 1;
+		std::vector<glm::vec3> clusterCenter(clusterCount, glm::vec3(0.0f));
+		std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+		glm::vec3 meshCenter(0.0f);
+		float meshArea = 0.0f;
+		for (size_t c = 0; c < clusterCount; c++)
+		{
+			float clusterArea = 0.0f;
+			for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+			{
+				glm::vec3 a = position(positions, stride, indices[t * 3]);
+				glm::vec3 b = position(positions, stride, indices[t * 3 + 1]);
+				glm::vec3 d = position(positions, stride, indices[t * 3 + 2]);
+				glm::vec3 normal = glm::cross(b - a, d - a);
+				float area = glm::length(normal);
+
+				clusterCenter[c] += (a + b + d) * (area / 3.0f);
+				clusterNormal[c] += normal;
+				clusterArea += area;
+			}
+			meshCenter += clusterCenter[c];
+			meshArea += clusterArea;
+			clusterCenter[c] = clusterArea > 0.0f ? clusterCenter[c] / clusterArea : glm::vec3(0.0f);
+		}
+		meshCenter = meshArea > 0.0f ? meshCenter / meshArea : glm::vec3(0.0f);
+
+		std::vector<float> sortKey(clusterCount);
+		std::vector<size_t> order(clusterCount);
+		for (size_t c = 0; c < clusterCount; c++)
+		{
+			float length = glm::length(clusterNormal[c]);
+			sortKey[c] = length > 0.0f ? glm::dot(clusterCenter[c] - meshCenter, clusterNormal[c] / length) : 0.0f;
+			order[c] = c;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+		std::vector<unsigned int> result;
+		result.reserve(triangleCount * 3);
+		for (size_t c : order)
+		{
+			result.insert(result.end(), indices + clusterStart[c] * 3, indices + clusterStart[c + 1] * 3);
+		}
+		std::copy(result.begin(), result.end(), indices);
+	}
+
+	// Renumbers vertices in the order the triangles first use them, so vertex fetches walk the buffer
+	// forward. Unused vertices go to the end. Rewrites indices and returns the new number of every
+	// old vertex.
+	static std::vector<unsigned int> optimizeVertexFetch(unsigned int* indices, size_t indexCount, unsigned int vertexCount)
+	{
+		const unsigned int UNUSED = ~0u;
+		std::vector<unsigned int> remap(vertexCount, UNUSED);
+		unsigned int next = 0;
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			unsigned int & target = remap[indices[i]];
+			if (target == UNUSED)
+			{
+				target = next++;
+			}
+			indices[i] = target;
+		}
+		for (unsigned int & target : remap)
+		{
+			if (target == UNUSED)
+			{
+				target = next++;
+			}
+		}
+		return remap;
+	}
+
+	// Moves every vertex of one stream to the slot remap gives it.
+	template <typename T>
+	static void remapVertices(T* vertices, unsigned int vertexCount, const std::vector<unsigned int> & remap)
+	{
+		std::vector<T> original(vertices, vertices + vertexCount);
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			vertices[remap[v]] = original[v];
+		}
+	}
+
+private:
+	static float score(int cachePosition, unsigned int valence)
+	{
+		if (valence == 0)
+		{
+			// no triangles left, never worth picking
+			return -1.0f;
+		}
+
+		float result = 0.0f;
+		if (cachePosition >= 0 && cachePosition < 3)
+		{
+			// the last triangle's vertices score a fixed value so the strip does not just continue
+			result = 0.75f;
+		}
+		else if (cachePosition >= 3)
+		{
+			float scaler = 1.0f / (32 - 3);
+			result = std::pow(1.0f - (cachePosition - 3) * scaler, 1.5f);
+		}
+		// favour vertices with few triangles left to finish them off
+		return result + 2.0f * std::pow((float)valence, -0.5f);
+	}
+
+	static glm::vec3 position(const float* positions, size_t stride, unsigned int vertex)
+	{
+		const float* p = (const float*)((const char*)positions + stride * vertex);
+		return glm::vec3(p[0], p[1], p[2]);
+	}
+};
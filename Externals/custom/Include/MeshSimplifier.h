@@ -0,0 +1,429 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm.hpp>
+
+// Quadric error edge collapse (Garland and Heckbert) on an indexed triangle list. Vertices are only
+// ever merged into other existing vertices, so every level of detail indexes the same vertex buffer
+// and a LOD costs nothing but its indices.
+//
+// Vertices that share a position but differ in normal or texture coordinates form a seam. A seam
+// vertex only moves along the seam together with its twin, vertices on an open border only along
+// the border, and anything more complex is locked, so simplification never tears the mesh open.
+class MeshSimplifier
+{
+public:
+	// Fractions of the full triangle count loaders build a LOD chain for, e.g. { 0.5, 0.25, 0.125 }.
+	// Empty by default, which builds no LODs.
+	static std::vector<float> & lodRatios()
+	{
+		static std::vector<float> ratios;
+		return ratios;
+	}
+
+	// Collapses edges until at most targetIndexCount indices are left or no collapse is allowed any
+	// more. error receives the largest distance a collapse moved the surface, in model units.
+	static std::vector<unsigned int> simplify(const unsigned int* indices, size_t indexCount, unsigned int vertexCount,
+		const float* positions, size_t stride, size_t targetIndexCount, float & error)
+	{
+		std::vector<unsigned int> result(indices, indices + indexCount);
+		error = 0.0f;
+		if (vertexCount == 0)
+		{
+			return result;
+		}
+
+		std::vector<unsigned int> canonical;
+		std::vector<unsigned int> wedgeNext;
+		buildWedges(vertexCount, positions, stride, canonical, wedgeNext);
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t t = 0; t + 2 < indexCount; t += 3)
+		{
+			Quadric plane = Quadric::fromTriangle(position(positions, stride, indices[t]), position(positions, stride, indices[t + 1]),
+				position(positions, stride, indices[t + 2]));
+			for (int corner = 0; corner < 3; corner++)
+			{
+				quadrics[canonical[indices[t + corner]]].add(plane);
+			}
+		}
+
+		std::vector<unsigned int> remap(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			remap[v] = v;
+		}
+
+		double maxCost = 0.0;
+		while (result.size() > targetIndexCount)
+		{
+			Topology topology(result, vertexCount, wedgeNext);
+
+			std::vector<Collapse> candidates;
+			for (size_t t = 0; t < result.size(); t += 3)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					unsigned int a = result[t + corner];
+					unsigned int b = result[t + (corner + 1) % 3];
+					addCandidate(topology, canonical, quadrics, positions, stride, a, b, candidates);
+					addCandidate(topology, canonical, quadrics, positions, stride, b, a, candidates);
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), [](const Collapse & a, const Collapse & b) { return a.cost < b.cost; });
+
+			// a collapse removes about two triangles
+			size_t goal = std::max<size_t>((result.size() - targetIndexCount) / 3 / 2, 1);
+			size_t collapsed = 0;
+			std::vector<char> touched(vertexCount, 0);
+			for (const Collapse & collapse : candidates)
+			{
+				if (collapsed >= goal)
+				{
+					break;
+				}
+				unsigned int u = collapse.from;
+				unsigned int v = collapse.to;
+				if (touched[u] || touched[v])
+				{
+					continue;
+				}
+
+				// a seam vertex takes its twin along to the matching wedge of the target
+				unsigned int twinFrom = u;
+				unsigned int twinTo = v;
+				if (topology.kind[u] == Seam)
+				{
+					twinFrom = wedgeNext[u];
+					twinTo = topology.borderNeighbourAt(twinFrom, v, wedgeNext);
+					if (twinTo == INVALID || touched[twinFrom] || touched[twinTo])
+					{
+						continue;
+					}
+				}
+
+				if (flips(topology, result, positions, stride, u, v) || (twinFrom != u && flips(topology, result, positions, stride, twinFrom, twinTo)))
+				{
+					continue;
+				}
+
+				remap[u] = v;
+				remap[twinFrom] = twinTo;
+				touch(topology, result, u, touched);
+				touch(topology, result, twinFrom, touched);
+				touched[v] = touched[twinTo] = 1;
+
+				if (canonical[u] != canonical[v])
+				{
+					quadrics[canonical[v]].add(quadrics[canonical[u]]);
+				}
+				maxCost = std::max(maxCost, collapse.cost);
+				collapsed++;
+			}
+			if (collapsed == 0)
+			{
+				break;
+			}
+
+			size_t kept = 0;
+			for (size_t t = 0; t < result.size(); t += 3)
+			{
+				unsigned int a = remap[result[t]];
+				unsigned int b = remap[result[t + 1]];
+				unsigned int c = remap[result[t + 2]];
+				if (a != b && b != c && c != a)
+				{
+					result[kept++] = a;
+					result[kept++] = b;
+					result[kept++] = c;
+				}
+			}
+			result.resize(kept);
+			for (unsigned int v = 0; v < vertexCount; v++)
+			{
+				remap[v] = v;
+			}
+		}
+
+		error = (float)std::sqrt(maxCost);
+		return result;
+	}
+
+private:
+	static const unsigned int INVALID = ~0u;
+
+	enum VertexKind
+	{
+		Manifold,
+		Border,
+		Seam,
+		Locked
+	};
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double cost;
+	};
+
+	// Symmetric 4x4 matrix of the summed squared distances to a set of planes.
+	struct Quadric
+	{
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+		Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0) {}
+
+		// plane of the triangle weighted by its area
+		static Quadric fromTriangle(const glm::vec3 & p0, const glm::vec3 & p1, const glm::vec3 & p2)
+		{
+			Quadric q;
+			glm::dvec3 normal = glm::cross(glm::dvec3(p1 - p0), glm::dvec3(p2 - p0));
+			double length = glm::length(normal);
+			if (length == 0.0)
+			{
+				return q;
+			}
+			normal /= length;
+			double weight = length * 0.5;
+			double a = normal.x, b = normal.y, c = normal.z;
+			double d = -glm::dot(normal, glm::dvec3(p0));
+			q.a2 = a * a * weight; q.ab = a * b * weight; q.ac = a * c * weight; q.ad = a * d * weight;
+			q.b2 = b * b * weight; q.bc = b * c * weight; q.bd = b * d * weight;
+			q.c2 = c * c * weight; q.cd = c * d * weight;
+			q.d2 = d * d * weight;
+			return q;
+		}
+
+		void add(const Quadric & q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+		}
+
+		// area weighted squared distance, divided by the area again so the cost is a squared length
+		double error(const glm::vec3 & p, double area) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double result = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+				+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+				+ c2 * z * z + 2 * cd * z
+				+ d2;
+			return area > 0.0 ? std::fabs(result) / area : 0.0;
+		}
+
+		// a2 + b2 + c2 sums the weights, i.e. the area of the planes
+		double area() const
+		{
+			return a2 + b2 + c2;
+		}
+	};
+
+	// Open edges and triangle lists of the current triangles.
+	struct Topology
+	{
+		std::vector<VertexKind> kind;
+		std::vector<unsigned int> openNext;
+		std::vector<unsigned int> openPrevious;
+		std::vector<unsigned int> firstTriangle;
+		std::vector<unsigned int> triangles;
+
+		Topology(const std::vector<unsigned int> & indices, unsigned int vertexCount, const std::vector<unsigned int> & wedgeNext)
+			: kind(vertexCount, Manifold), openNext(vertexCount, INVALID), openPrevious(vertexCount, INVALID), firstTriangle(vertexCount + 1, 0)
+		{
+			std::unordered_set<uint64_t> halfEdges;
+			halfEdges.reserve(indices.size());
+			for (size_t t = 0; t < indices.size(); t += 3)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					halfEdges.insert(edgeKey(indices[t + corner], indices[t + (corner + 1) % 3]));
+					firstTriangle[indices[t + corner] + 1]++;
+				}
+			}
+
+			std::vector<unsigned int> openOut(vertexCount, 0);
+			std::vector<unsigned int> openIn(vertexCount, 0);
+			for (size_t t = 0; t < indices.size(); t += 3)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					unsigned int a = indices[t + corner];
+					unsigned int b = indices[t + (corner + 1) % 3];
+					if (halfEdges.count(edgeKey(b, a)) == 0)
+					{
+						openOut[a]++;
+						openIn[b]++;
+						openNext[a] = b;
+						openPrevious[b] = a;
+					}
+				}
+			}
+
+			for (unsigned int v = 0; v < vertexCount; v++)
+			{
+				bool simpleBorder = openOut[v] == 1 && openIn[v] == 1;
+				bool open = openOut[v] != 0 || openIn[v] != 0;
+				unsigned int twin = wedgeNext[v];
+				if (twin == v)
+				{
+					kind[v] = !open ? Manifold : (simpleBorder ? Border : Locked);
+				}
+				else if (wedgeNext[twin] == v && simpleBorder && openOut[twin] == 1 && openIn[twin] == 1)
+				{
+					kind[v] = Seam;
+				}
+				else
+				{
+					kind[v] = Locked;
+				}
+			}
+
+			for (unsigned int v = 0; v < vertexCount; v++)
+			{
+				firstTriangle[v + 1] += firstTriangle[v];
+			}
+			triangles.resize(indices.size());
+			std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+			for (size_t t = 0; t < indices.size(); t += 3)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					triangles[filled[indices[t + corner]]++] = (unsigned int)t;
+				}
+			}
+		}
+
+		// The wedge of target's position that v borders on, or INVALID.
+		unsigned int borderNeighbourAt(unsigned int v, unsigned int target, const std::vector<unsigned int> & wedgeNext) const
+		{
+			unsigned int wedge = target;
+			do
+			{
+				if (openNext[v] == wedge || openPrevious[v] == wedge)
+				{
+					return wedge;
+				}
+				wedge = wedgeNext[wedge];
+			} while (wedge != target);
+			return INVALID;
+		}
+
+		static uint64_t edgeKey(unsigned int a, unsigned int b)
+		{
+			return ((uint64_t)a << 32) | b;
+		}
+	};
+
+	static void addCandidate(const Topology & topology, const std::vector<unsigned int> & canonical, const std::vector<Quadric> & quadrics,
+		const float* positions, size_t stride, unsigned int from, unsigned int to, std::vector<Collapse> & candidates)
+	{
+		VertexKind kind = topology.kind[from];
+		if (kind == Locked || canonical[from] == canonical[to])
+		{
+			return;
+		}
+		if ((kind == Border || kind == Seam) && topology.openNext[from] != to && topology.openPrevious[from] != to)
+		{
+			return;
+		}
+
+		const Quadric & quadric = quadrics[canonical[from]];
+		Collapse collapse;
+		collapse.from = from;
+		collapse.to = to;
+		collapse.cost = quadric.error(position(positions, stride, to), quadric.area());
+		candidates.push_back(collapse);
+	}
+
+	// True when moving from onto to would turn one of from's triangles over by more than about 75 degrees.
+	static bool flips(const Topology & topology, const std::vector<unsigned int> & indices, const float* positions, size_t stride,
+		unsigned int from, unsigned int to)
+	{
+		glm::vec3 target = position(positions, stride, to);
+		for (unsigned int a = topology.firstTriangle[from]; a < topology.firstTriangle[from + 1]; a++)
+		{
+			unsigned int t = topology.triangles[a];
+			if (indices[t] == to || indices[t + 1] == to || indices[t + 2] == to)
+			{
+				continue;
+			}
+
+			glm::vec3 corners[3];
+			glm::vec3 moved[3];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				corners[corner] = position(positions, stride, indices[t + corner]);
+				moved[corner] = indices[t + corner] == from ? target : corners[corner];
+			}
+			glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+			glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+			if (glm::dot(before, after) < 0.25f * glm::length(before) * glm::length(after))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Locks the vertex and its one-ring for the rest of the pass, so later flip checks see final positions.
+	static void touch(const Topology & topology, const std::vector<unsigned int> & indices, unsigned int v, std::vector<char> & touched)
+	{
+		touched[v] = 1;
+		for (unsigned int a = topology.firstTriangle[v]; a < topology.firstTriangle[v + 1]; a++)
+		{
+			unsigned int t = topology.triangles[a];
+			touched[indices[t]] = touched[indices[t + 1]] = touched[indices[t + 2]] = 1;
+		}
+	}
+
+	// canonical is the first vertex with the same position, wedgeNext links all of them in a ring.
+	static void buildWedges(unsigned int vertexCount, const float* positions, size_t stride,
+		std::vector<unsigned int> & canonical, std::vector<unsigned int> & wedgeNext)
+	{
+		struct PositionHash
+		{
+			size_t operator()(const glm::vec3 & p) const
+			{
+				uint32_t bits[3];
+				std::memcpy(bits, &p[0], sizeof(bits));
+				return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+			}
+		};
+
+		canonical.resize(vertexCount);
+		wedgeNext.resize(vertexCount);
+		std::unordered_map<glm::vec3, unsigned int, PositionHash> first;
+		first.reserve(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			std::pair<std::unordered_map<glm::vec3, unsigned int, PositionHash>::iterator, bool> inserted = first.insert(std::make_pair(position(positions, stride, v), v));
+			unsigned int head = inserted.first->second;
+			canonical[v] = head;
+			if (head == v)
+			{
+				wedgeNext[v] = v;
+			}
+			else
+			{
+				wedgeNext[v] = wedgeNext[head];
+				wedgeNext[head] = v;
+			}
+		}
+	}
+
+	static glm::vec3 position(const float* positions, size_t stride, unsigned int vertex)
+	{
+		const float* p = (const float*)((const char*)positions + stride * vertex);
+		return glm::vec3(p[0], p[1], p[2]);
+	}
+};
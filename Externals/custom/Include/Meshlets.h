@@ -0,0 +1,325 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstddef>
+
+#include <glm.hpp>
+
+#include <Frustum.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MESHLET_CULLING_SSE 1
+#endif
+
+// A cluster of at most MeshletBuilder::MAX_VERTICES vertices and MAX_TRIANGLES triangles. Its
+// triangles are a contiguous range of the mesh's indices, firstIndex counts from the mesh's first index.
+struct Meshlet
+{
+	unsigned int firstIndex;
+	unsigned int triangleCount;
+};
+
+// Bounding sphere and normal cone of a meshlet. The cluster faces away from every camera position
+// with dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius. A meshlet
+// whose normals spread too far gets a zero axis and a cutoff of 1 and is never cone culled.
+struct MeshletBounds
+{
+	glm::vec3 center;
+	float radius;
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+// Splits a triangle list into meshlets. A meshlet grows by the neighbouring triangle that adds the
+// fewest new vertices, so clusters stay compact and their normal cones narrow.
+class MeshletBuilder
+{
+public:
+	static const unsigned int MAX_VERTICES = 64;
+	static const unsigned int MAX_TRIANGLES = 124;
+
+	// Loaders only build meshlets when this is set. Off by default.
+	static bool & enabled()
+	{
+		static bool build = false;
+		return build;
+	}
+
+	// Reorders the triangles so every meshlet is one range of indices and returns the meshlets.
+	static std::vector<Meshlet> build(unsigned int* indices, size_t indexCount, unsigned int vertexCount)
+	{
+		std::vector<Meshlet> meshlets;
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+		{
+			return meshlets;
+		}
+
+		std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+		{
+			firstTriangle[indices[i] + 1]++;
+		}
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			firstTriangle[v + 1] += firstTriangle[v];
+		}
+		std::vector<unsigned int> adjacency(triangleCount * 3);
+		std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+		{
+			adjacency[filled[indices[i]]++] = (unsigned int)(i / 3);
+		}
+
+		std::vector<unsigned int> ordered;
+		ordered.reserve(triangleCount * 3);
+		std::vector<char> emitted(triangleCount, 0);
+		// the meshlet a vertex was last added to, plus one
+		std::vector<unsigned int> stamp(vertexCount, 0);
+		std::vector<unsigned int> meshletVertices;
+		meshletVertices.reserve(MAX_VERTICES);
+		size_t seed = 0;
+		size_t done = 0;
+
+		while (done < triangleCount)
+		{
+			Meshlet meshlet;
+			meshlet.firstIndex = (unsigned int)ordered.size();
+			meshlet.triangleCount = 0;
+			unsigned int id = (unsigned int)meshlets.size() + 1;
+			meshletVertices.clear();
+
+			while (meshlet.triangleCount < MAX_TRIANGLES)
+			{
+				size_t best = triangleCount;
+				unsigned int bestNew = 4;
+				for (unsigned int v : meshletVertices)
+				{
+					for (unsigned int a = firstTriangle[v]; a < firstTriangle[v + 1] && bestNew > 0; a++)
+					{
+						unsigned int t = adjacency[a];
+						unsigned int added = newVertices(indices, t, stamp, id);
+						if (!emitted[t] && added < bestNew && meshletVertices.size() + added <= MAX_VERTICES)
+						{
+							best = t;
+							bestNew = added;
+						}
+					}
+				}
+				if (best == triangleCount)
+				{
+					if (!meshletVertices.empty())
+					{
+						break;
+					}
+					while (emitted[seed])
+					{
+						seed++;
+					}
+					best = seed;
+				}
+
+				for (int corner = 0; corner < 3; corner++)
+				{
+					unsigned int v = indices[best * 3 + corner];
+					if (stamp[v] != id)
+					{
+						stamp[v] = id;
+						meshletVertices.push_back(v);
+					}
+					ordered.push_back(v);
+				}
+				emitted[best] = 1;
+				meshlet.triangleCount++;
+				done++;
+				if (done == triangleCount)
+				{
+					break;
+				}
+			}
+			meshlets.push_back(meshlet);
+		}
+
+		std::copy(ordered.begin(), ordered.end(), indices);
+		return meshlets;
+	}
+
+	static MeshletBounds computeBounds(const unsigned int* indices, unsigned int triangleCount, const float* positions, size_t stride)
+	{
+		MeshletBounds bounds;
+		glm::vec3 boundsMin(FLT_MAX);
+		glm::vec3 boundsMax(-FLT_MAX);
+		glm::vec3 normalSum(0.0f);
+		std::vector<glm::vec3> normals;
+		normals.reserve(triangleCount);
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			glm::vec3 p0 = position(positions, stride, indices[t * 3]);
+			glm::vec3 p1 = position(positions, stride, indices[t * 3 + 1]);
+			glm::vec3 p2 = position(positions, stride, indices[t * 3 + 2]);
+			boundsMin = glm::min(boundsMin, glm::min(p0, glm::min(p1, p2)));
+			boundsMax = glm::max(boundsMax, glm::max(p0, glm::max(p1, p2)));
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(normal);
+			if (length > 0.0f)
+			{
+				normals.push_back(normal / length);
+				normalSum += normals.back();
+			}
+		}
+
+		bounds.center = (boundsMin + boundsMax) * 0.5f;
+		bounds.radius = 0.0f;
+		for (unsigned int i = 0; i < triangleCount * 3; i++)
+		{
+			bounds.radius = std::max(bounds.radius, glm::length(position(positions, stride, indices[i]) - bounds.center));
+		}
+
+		bounds.coneAxis = glm::vec3(0.0f);
+		bounds.coneCutoff = 1.0f;
+		float axisLength = glm::length(normalSum);
+		if (axisLength == 0.0f)
+		{
+			return bounds;
+		}
+		glm::vec3 axis = normalSum / axisLength;
+		float minDot = 1.0f;
+		for (const glm::vec3 & normal : normals)
+		{
+			minDot = std::min(minDot, glm::dot(normal, axis));
+		}
+		// past about 84 degrees the cone would hardly ever cull
+		if (minDot > 0.1f)
+		{
+			bounds.coneAxis = axis;
+			bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+		return bounds;
+	}
+
+private:
+	static unsigned int newVertices(const unsigned int* indices, unsigned int triangle, const std::vector<unsigned int> & stamp, unsigned int id)
+	{
+		return (stamp[indices[triangle * 3]] != id) + (stamp[indices[triangle * 3 + 1]] != id) + (stamp[indices[triangle * 3 + 2]] != id);
+	}
+
+	static glm::vec3 position(const float* positions, size_t stride, unsigned int vertex)
+	{
+		const float* p = (const float*)((const char*)positions + stride * vertex);
+		return glm::vec3(p[0], p[1], p[2]);
+	}
+};
+
+// Meshlet bounds in structure-of-arrays form, padded to a multiple of four. cull() tests four
+// meshlets per step with SSE, cullScalar() is the reference it must agree with.
+class MeshletCuller
+{
+public:
+	void reset(const std::vector<MeshletBounds> & bounds)
+	{
+		count = bounds.size();
+		size_t padded = (count + 3) & ~(size_t)3;
+		for (std::vector<float>* column : { &centerX, &centerY, &centerZ, &radius, &axisX, &axisY, &axisZ, &cutoff })
+		{
+			column->assign(padded, 0.0f);
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			centerX[i] = bounds[i].center.x;
+			centerY[i] = bounds[i].center.y;
+			centerZ[i] = bounds[i].center.z;
+			radius[i] = bounds[i].radius;
+			axisX[i] = bounds[i].coneAxis.x;
+			axisY[i] = bounds[i].coneAxis.y;
+			axisZ[i] = bounds[i].coneAxis.z;
+			cutoff[i] = bounds[i].coneCutoff;
+		}
+		// padding never passes the frustum test
+		for (size_t i = count; i < padded; i++)
+		{
+			radius[i] = -FLT_MAX;
+		}
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	// Writes 1 for every meshlet that intersects the frustum and faces the camera, 0 otherwise, into
+	// visible and returns how many are visible. planes and camera are in the meshlets' space, the
+	// planes as in Frustum. visible needs room for size() rounded up to four.
+	size_t cull(const glm::vec4 planes[6], const glm::vec3 & camera, unsigned char* visible) const
+	{
+#ifdef MESHLET_CULLING_SSE
+		size_t visibleCount = 0;
+		__m128 cameraX = _mm_set1_ps(camera.x);
+		__m128 cameraY = _mm_set1_ps(camera.y);
+		__m128 cameraZ = _mm_set1_ps(camera.z);
+		for (size_t i = 0; i < centerX.size(); i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&centerX[i]);
+			__m128 y = _mm_loadu_ps(&centerY[i]);
+			__m128 z = _mm_loadu_ps(&centerZ[i]);
+			__m128 r = _mm_loadu_ps(&radius[i]);
+			__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), r);
+
+			__m128 inside = _mm_cmpeq_ps(r, r);
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p].x)), _mm_mul_ps(y, _mm_set1_ps(planes[p].y))),
+					_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(planes[p].z)), _mm_set1_ps(planes[p].w)));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+
+			__m128 dx = _mm_sub_ps(x, cameraX);
+			__m128 dy = _mm_sub_ps(y, cameraY);
+			__m128 dz = _mm_sub_ps(z, cameraZ);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			__m128 facing = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&axisX[i])), _mm_mul_ps(dy, _mm_loadu_ps(&axisY[i]))),
+				_mm_mul_ps(dz, _mm_loadu_ps(&axisZ[i])));
+			__m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&cutoff[i]), length), r);
+			__m128 frontFacing = _mm_cmplt_ps(facing, limit);
+
+			int mask = _mm_movemask_ps(_mm_and_ps(inside, frontFacing));
+			for (int lane = 0; lane < 4; lane++)
+			{
+				visible[i + lane] = (unsigned char)((mask >> lane) & 1);
+			}
+			visibleCount += (size_t)((mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1));
+		}
+		return visibleCount;
+#else
+		return cullScalar(planes, camera, visible);
+#endif
+	}
+
+	size_t cullScalar(const glm::vec4 planes[6], const glm::vec3 & camera, unsigned char* visible) const
+	{
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < centerX.size(); i++)
+		{
+			glm::vec3 center(centerX[i], centerY[i], centerZ[i]);
+			bool inside = true;
+			for (int p = 0; p < 6; p++)
+			{
+				inside = inside && glm::dot(glm::vec3(planes[p]), center) + planes[p].w >= -radius[i];
+			}
+			glm::vec3 toCenter = center - camera;
+			bool frontFacing = glm::dot(toCenter, glm::vec3(axisX[i], axisY[i], axisZ[i])) < cutoff[i] * glm::length(toCenter) + radius[i];
+			visible[i] = (unsigned char)(inside && frontFacing);
+			visibleCount += visible[i];
+		}
+		return visibleCount;
+	}
+
+private:
+	size_t count = 0;
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> axisX, axisY, axisZ, cutoff;
+};
@@ -0,0 +1,698 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MIP_GENERATION_AVX2 1
+#endif
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define MIP_GENERATION_F16C 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_GENERATION_SSE2 1
+#endif
+
+// Halves images with a 2x2 box filter to build mip chains on the CPU, e.g. while a loader thread
+// cooks a texture, instead of leaving the filter to glGenerateMipmap.
+//   RGBA8        averaged as stored, or for sRGB textures in linear space with alpha kept linear
+//   RG8 normals  z is reconstructed, the four vectors are summed and renormalized
+//   RGB16F/32F   HDR texels averaged per channel
+// A side of 1 stays 1 and an odd last row or column is dropped.
+//
+// Whole rows go through AVX2 or SSE2 kernels where the build enables them; image edges and builds
+// without them take the scalar per-texel path. Kernels add the four texels in the same order as
+// the scalar path, (top left + bottom left) + (top right + bottom right), and sRGB is encoded
+// through tables derived from the exact curve, so they match the *Reference functions, which are
+// plain scalar loops with the sRGB curve evaluated by pow. RGB16F uses F16C when it is enabled.
+class MipGenerator
+{
+public:
+	static int mipSize(int size)
+	{
+		return std::max(size / 2, 1);
+	}
+
+	static unsigned int levelCount(int width, int height)
+	{
+		unsigned int levels = 1;
+		while (width > 1 || height > 1)
+		{
+			width = mipSize(width);
+			height = mipSize(height);
+			levels++;
+		}
+		return levels;
+	}
+
+	// Name of the kernels the downsample functions use, for the RGB16F ones see halfKernel().
+	static const char* kernel()
+	{
+#if defined(MIP_GENERATION_AVX2)
+		return "AVX2";
+#elif defined(MIP_GENERATION_SSE2)
+		return "SSE2";
+#else
+		return "scalar";
+#endif
+	}
+
+	static const char* halfKernel()
+	{
+#if defined(MIP_GENERATION_F16C)
+		return "F16C";
+#else
+		return "scalar";
+#endif
+	}
+
+	// target holds mipSize(width) x mipSize(height) texels, here and below.
+	static void downsampleRGBA8(const unsigned char* source, int width, int height, bool srgb, unsigned char* target)
+	{
+		int targetWidth = mipSize(width);
+		forEachRow(width, height, [&](int y)
+		{
+			const unsigned char* top = source + (size_t)y * 2 * width * 4;
+			unsigned char* out = target + (size_t)y * targetWidth * 4;
+			return srgb ? srgbRowRGBA8(top, top + (size_t)width * 4, targetWidth, out) : rowRGBA8(top, top + (size_t)width * 4, targetWidth, out);
+		}, [&](int x, int y)
+		{
+			texelRGBA8(source, width, height, x, y, srgb, false, target + ((size_t)y * targetWidth + x) * 4);
+		});
+	}
+
+	static void downsampleRGBA8Reference(const unsigned char* source, int width, int height, bool srgb, unsigned char* target)
+	{
+		int targetWidth = mipSize(width);
+		forEachTexel(width, height, [&](int x, int y)
+		{
+			texelRGBA8(source, width, height, x, y, srgb, true, target + ((size_t)y * targetWidth + x) * 4);
+		});
+	}
+
+	// Two channels per texel, x and y of a unit normal mapped to 0..255.
+	static void downsampleRG8Normal(const unsigned char* source, int width, int height, unsigned char* target)
+	{
+		int targetWidth = mipSize(width);
+		forEachRow(width, height, [&](int y)
+		{
+			const unsigned char* top = source + (size_t)y * 2 * width * 2;
+			return normalRowRG8(top, top + (size_t)width * 2, targetWidth, target + (size_t)y * targetWidth * 2);
+		}, [&](int x, int y)
+		{
+			texelRG8Normal(source, width, height, x, y, target + ((size_t)y * targetWidth + x) * 2);
+		});
+	}
+
+	static void downsampleRG8NormalReference(const unsigned char* source, int width, int height, unsigned char* target)
+	{
+		int targetWidth = mipSize(width);
+		forEachTexel(width, height, [&](int x, int y)
+		{
+			texelRG8Normal(source, width, height, x, y, target + ((size_t)y * targetWidth + x) * 2);
+		});
+	}
+
+	static void downsampleRGB32F(const float* source, int width, int height, float* target)
+	{
+		int targetWidth = mipSize(width);
+		forEachRow(width, height, [&](int y)
+		{
+			const float* top = source + (size_t)y * 2 * width * 3;
+			return rowRGB32F(top, top + (size_t)width * 3, targetWidth, target + (size_t)y * targetWidth * 3);
+		}, [&](int x, int y)
+		{
+			texelRGB(source, width, height, x, y, target + ((size_t)y * targetWidth + x) * 3, [](float value) { return value; }, [](float value) { return value; });
+		});
+	}
+
+	static void downsampleRGB32FReference(const float* source, int width, int height, float* target)
+	{
+		int targetWidth = mipSize(width);
+		forEachTexel(width, height, [&](int x, int y)
+		{
+			texelRGB(source, width, height, x, y, target + ((size_t)y * targetWidth + x) * 3, [](float value) { return value; }, [](float value) { return value; });
+		});
+	}
+
+	// Half floats as GL_HALF_FLOAT stores them.
+	static void downsampleRGB16F(const uint16_t* source, int width, int height, uint16_t* target)
+	{
+		int targetWidth = mipSize(width);
+		forEachRow(width, height, [&](int y)
+		{
+			const uint16_t* top = source + (size_t)y * 2 * width * 3;
+			return rowRGB16F(top, top + (size_t)width * 3, targetWidth, target + (size_t)y * targetWidth * 3);
+		}, [&](int x, int y)
+		{
+			texelRGB(source, width, height, x, y, target + ((size_t)y * targetWidth + x) * 3, halfToFloat, floatToHalf);
+		});
+	}
+
+	static void downsampleRGB16FReference(const uint16_t* source, int width, int height, uint16_t* target)
+	{
+		int targetWidth = mipSize(width);
+		forEachTexel(width, height, [&](int x, int y)
+		{
+			texelRGB(source, width, height, x, y, target + ((size_t)y * targetWidth + x) * 3, halfToFloat, floatToHalf);
+		});
+	}
+
+	// Converts count floats, e.g. a decoded HDR image, for downsampleRGB16F() and GL_HALF_FLOAT.
+	static void floatsToHalf(const float* source, size_t count, uint16_t* target)
+	{
+		size_t i = 0;
+#if defined(MIP_GENERATION_F16C)
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storel_epi64((__m128i*)(target + i), _mm_cvtps_ph(_mm_loadu_ps(source + i), 0));
+		}
+#endif
+		for (; i < count; i++)
+		{
+			target[i] = floatToHalf(source[i]);
+		}
+	}
+
+	// Rounds to the nearest half, ties to even, like F16C.
+	static uint16_t floatToHalf(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		uint32_t sign = (bits >> 16) & 0x8000;
+		uint32_t magnitude = bits & 0x7FFFFFFF;
+		if (magnitude >= 0x7F800000)
+		{
+			return (uint16_t)(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+		}
+		if (magnitude >= 0x47800000)
+		{
+			return (uint16_t)(sign | 0x7C00);
+		}
+		if (magnitude < 0x38800000)
+		{
+			// below the smallest normal half, shift the mantissa with its implicit bit into place
+			int shift = 126 - (int)(magnitude >> 23);
+			if (shift > 24)
+			{
+				return (uint16_t)sign;
+			}
+			uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+			uint32_t half = mantissa >> shift;
+			uint32_t remainder = mantissa & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			half += remainder > halfway || (remainder == halfway && (half & 1) != 0) ? 1 : 0;
+			return (uint16_t)(sign | half);
+		}
+		// a carry out of the mantissa correctly bumps the exponent, up to infinity
+		uint32_t half = (magnitude - 0x38000000) >> 13;
+		uint32_t remainder = magnitude & 0x1FFF;
+		half += remainder > 0x1000 || (remainder == 0x1000 && (half & 1) != 0) ? 1 : 0;
+		return (uint16_t)(sign | half);
+	}
+
+	static float halfToFloat(uint16_t half)
+	{
+		uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+		uint32_t exponent = (half >> 10) & 0x1F;
+		uint32_t mantissa = half & 0x3FF;
+		uint32_t bits;
+		if (exponent == 0)
+		{
+			float value = (float)mantissa * (1.0f / 16777216.0f);
+			return sign != 0 ? -value : value;
+		}
+		else if (exponent == 31)
+		{
+			bits = sign | 0x7F800000 | (mantissa << 13);
+		}
+		else
+		{
+			bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		}
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+private:
+	static const int SRGB_BUCKETS = 4096;
+
+	// Linear values of the 256 sRGB bytes, and the way back: a linear value v in bucket
+	// floor(v * SRGB_BUCKETS) encodes to bucketBase, plus one when it reaches thresholds[bucketBase
+	// + 1]. thresholds[k] is the smallest value the pow curve rounds to k, found by bisection, so the
+	// result is the same as from the curve. Buckets are narrower than the steepest step of the curve,
+	// 1 / (255 * 12.92), so no bucket holds two thresholds.
+	struct SrgbTables
+	{
+		float toLinear[256];
+		int bucketBase[SRGB_BUCKETS];
+		float thresholds[257];
+
+		SrgbTables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float c = (float)i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+
+			thresholds[0] = 0.0f;
+			thresholds[256] = FLT_MAX;
+			for (int k = 1; k < 256; k++)
+			{
+				// positive floats order like their bit patterns
+				uint32_t low = 0;
+				uint32_t high = 0x3F800000;
+				while (low < high)
+				{
+					uint32_t middle = low + (high - low) / 2;
+					if (linearToSrgbReference(fromBits(middle)) >= k)
+					{
+						high = middle;
+					}
+					else
+					{
+						low = middle + 1;
+					}
+				}
+				thresholds[k] = fromBits(low);
+			}
+
+			int base = 0;
+			for (int bucket = 0; bucket < SRGB_BUCKETS; bucket++)
+			{
+				float start = (float)bucket / (float)SRGB_BUCKETS;
+				while (base < 255 && thresholds[base + 1] <= start)
+				{
+					base++;
+				}
+				bucketBase[bucket] = base;
+			}
+		}
+
+		static float fromBits(uint32_t bits)
+		{
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+	};
+
+	// built once, by whichever thread gets here first
+	static const SrgbTables & srgbTables()
+	{
+		static SrgbTables tables;
+		return tables;
+	}
+
+	static unsigned char linearToSrgbReference(float value)
+	{
+		float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+		return (unsigned char)std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f);
+	}
+
+	static unsigned char linearToSrgb(float value)
+	{
+		const SrgbTables & tables = srgbTables();
+		value = std::min(std::max(value, 0.0f), 1.0f);
+		int base = tables.bucketBase[std::min((int)(value * (float)SRGB_BUCKETS), SRGB_BUCKETS - 1)];
+		return (unsigned char)(base + (value >= tables.thresholds[base + 1] ? 1 : 0));
+	}
+
+	// Calls row(y) for every target row of an image at least 2 x 2, which returns how many texels it
+	// filtered, and texel(x, y) for the rest.
+	template <typename Row, typename Texel>
+	static void forEachRow(int width, int height, Row row, Texel texel)
+	{
+		int targetWidth = mipSize(width);
+		int targetHeight = mipSize(height);
+		for (int y = 0; y < targetHeight; y++)
+		{
+			int x = width > 1 && height > 1 ? row(y) : 0;
+			for (; x < targetWidth; x++)
+			{
+				texel(x, y);
+			}
+		}
+	}
+
+	template <typename Texel>
+	static void forEachTexel(int width, int height, Texel texel)
+	{
+		forEachRow(width, height, [](int) { return 0; }, texel);
+	}
+
+	// Indices of the source texels of target texel (x, y): top left, top right, bottom left, bottom right.
+	static void footprint(int width, int height, int x, int y, size_t texels[4])
+	{
+		int left = std::min(x * 2, width - 1);
+		int right = std::min(x * 2 + 1, width - 1);
+		int top = std::min(y * 2, height - 1);
+		int bottom = std::min(y * 2 + 1, height - 1);
+		texels[0] = (size_t)top * width + left;
+		texels[1] = (size_t)top * width + right;
+		texels[2] = (size_t)bottom * width + left;
+		texels[3] = (size_t)bottom * width + right;
+	}
+
+	static void texelRGBA8(const unsigned char* source, int width, int height, int x, int y, bool srgb, bool reference, unsigned char* out)
+	{
+		size_t texels[4];
+		footprint(width, height, x, y, texels);
+		const unsigned char* t[4] = { source + texels[0] * 4, source + texels[1] * 4, source + texels[2] * 4, source + texels[3] * 4 };
+		for (int c = 0; c < 4; c++)
+		{
+			if (srgb && c < 3)
+			{
+				const float* toLinear = srgbTables().toLinear;
+				float linear = ((toLinear[t[0][c]] + toLinear[t[2][c]]) + (toLinear[t[1][c]] + toLinear[t[3][c]])) * 0.25f;
+				out[c] = reference ? linearToSrgbReference(linear) : linearToSrgb(linear);
+			}
+			else
+			{
+				out[c] = (unsigned char)((t[0][c] + t[1][c] + t[2][c] + t[3][c] + 2) / 4);
+			}
+		}
+	}
+
+	static void texelRG8Normal(const unsigned char* source, int width, int height, int x, int y, unsigned char* out)
+	{
+		size_t texels[4];
+		footprint(width, height, x, y, texels);
+		float normals[4][3];
+		for (int i = 0; i < 4; i++)
+		{
+			const unsigned char* texel = source + texels[i] * 2;
+			normals[i][0] = (float)texel[0] * (2.0f / 255.0f) - 1.0f;
+			normals[i][1] = (float)texel[1] * (2.0f / 255.0f) - 1.0f;
+			normals[i][2] = std::sqrt(std::max(1.0f - normals[i][0] * normals[i][0] - normals[i][1] * normals[i][1], 0.0f));
+		}
+		float normal[3];
+		for (int c = 0; c < 3; c++)
+		{
+			normal[c] = (normals[0][c] + normals[2][c]) + (normals[1][c] + normals[3][c]);
+		}
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		for (int c = 0; c < 2; c++)
+		{
+			float unit = length > 1e-6f ? normal[c] / length : 0.0f;
+			out[c] = (unsigned char)std::min(std::max((unit + 1.0f) * 127.5f + 0.5f, 0.0f), 255.0f);
+		}
+	}
+
+	template <typename T, typename Decode, typename Encode>
+	static void texelRGB(const T* source, int width, int height, int x, int y, T* out, Decode decode, Encode encode)
+	{
+		size_t texels[4];
+		footprint(width, height, x, y, texels);
+		for (int c = 0; c < 3; c++)
+		{
+			float sum = (decode(source[texels[0] * 3 + c]) + decode(source[texels[2] * 3 + c])) + (decode(source[texels[1] * 3 + c]) + decode(source[texels[3] * 3 + c]));
+			out[c] = encode(sum * 0.25f);
+		}
+	}
+
+	// The row kernels filter target texels 0 to the returned count from the source rows top and
+	// bottom, the caller does the rest.
+	static int rowRGBA8(const unsigned char* top, const unsigned char* bottom, int count, unsigned char* out)
+	{
+		int x = 0;
+#if defined(MIP_GENERATION_AVX2)
+		const __m256i two = _mm256_set1_epi16(2);
+		const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+		for (; x + 8 <= count; x += 8)
+		{
+			// column sums of 16 source texels as 16-bit channels, four per register
+			__m256i columns[4];
+			for (int i = 0; i < 4; i++)
+			{
+				size_t offset = (size_t)x * 8 + i * 16;
+				columns[i] = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(top + offset))),
+					_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(bottom + offset))));
+			}
+			// neighbouring columns are added within 128-bit lanes, which leaves the texels in the
+			// order 0 2 4 6 | 1 3 5 7 for the permute to undo
+			__m256i first = _mm256_add_epi16(_mm256_unpacklo_epi64(columns[0], columns[1]), _mm256_unpackhi_epi64(columns[0], columns[1]));
+			__m256i second = _mm256_add_epi16(_mm256_unpacklo_epi64(columns[2], columns[3]), _mm256_unpackhi_epi64(columns[2], columns[3]));
+			first = _mm256_srli_epi16(_mm256_add_epi16(first, two), 2);
+			second = _mm256_srli_epi16(_mm256_add_epi16(second, two), 2);
+			_mm256_storeu_si256((__m256i*)(out + (size_t)x * 4), _mm256_permutevar8x32_epi32(_mm256_packus_epi16(first, second), order));
+		}
+#endif
+#if defined(MIP_GENERATION_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i two16 = _mm_set1_epi16(2);
+		for (; x + 4 <= count; x += 4)
+		{
+			__m128i halves[2];
+			for (int i = 0; i < 2; i++)
+			{
+				size_t offset = (size_t)x * 8 + i * 16;
+				__m128i upper = _mm_loadu_si128((const __m128i*)(top + offset));
+				__m128i lower = _mm_loadu_si128((const __m128i*)(bottom + offset));
+				__m128i left = _mm_add_epi16(_mm_unpacklo_epi8(upper, zero), _mm_unpacklo_epi8(lower, zero));
+				__m128i right = _mm_add_epi16(_mm_unpackhi_epi8(upper, zero), _mm_unpackhi_epi8(lower, zero));
+				__m128i pairs = _mm_add_epi16(_mm_unpacklo_epi64(left, right), _mm_unpackhi_epi64(left, right));
+				halves[i] = _mm_srli_epi16(_mm_add_epi16(pairs, two16), 2);
+			}
+			_mm_storeu_si128((__m128i*)(out + (size_t)x * 4), _mm_packus_epi16(halves[0], halves[1]));
+		}
+#endif
+		return x;
+	}
+
+	// Two target texels per iteration. The tables are read with scalar loads, which were faster than
+	// AVX2 gathers here, and an SSE2 version of this gained too little over the scalar path to keep.
+	static int srgbRowRGBA8(const unsigned char* top, const unsigned char* bottom, int count, unsigned char* out)
+	{
+		int x = 0;
+#if defined(MIP_GENERATION_AVX2)
+		const SrgbTables & tables = srgbTables();
+		const __m256 quarter = _mm256_set1_ps(0.25f);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 buckets = _mm256_set1_ps((float)SRGB_BUCKETS);
+		const __m256i lastBucket = _mm256_set1_epi32(SRGB_BUCKETS - 1);
+		const __m256i two = _mm256_set1_epi32(2);
+		const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+		for (; x + 2 <= count; x += 2)
+		{
+			// four source texels per row, the left and right ones of both targets in separate registers
+			size_t offset = (size_t)x * 8;
+			__m256 left = _mm256_add_ps(decodeSrgb(tables, top + offset), decodeSrgb(tables, bottom + offset));
+			__m256 right = _mm256_add_ps(decodeSrgb(tables, top + offset + 8), decodeSrgb(tables, bottom + offset + 8));
+			__m256 linear = _mm256_mul_ps(_mm256_add_ps(_mm256_permute2f128_ps(left, right, 0x20), _mm256_permute2f128_ps(left, right, 0x31)), quarter);
+			linear = _mm256_min_ps(_mm256_max_ps(linear, zero), one);
+
+			alignas(32) int bucket[8];
+			_mm256_store_si256((__m256i*)bucket, _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(linear, buckets)), lastBucket));
+			int base[8];
+			for (int i = 0; i < 8; i++)
+			{
+				base[i] = tables.bucketBase[bucket[i]];
+			}
+			__m256 threshold = _mm256_setr_ps(tables.thresholds[base[0] + 1], tables.thresholds[base[1] + 1], tables.thresholds[base[2] + 1], tables.thresholds[base[3] + 1],
+				tables.thresholds[base[4] + 1], tables.thresholds[base[5] + 1], tables.thresholds[base[6] + 1], tables.thresholds[base[7] + 1]);
+			__m256i color = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)base), _mm256_castps_si256(_mm256_cmp_ps(linear, threshold, _CMP_GE_OQ)));
+
+			__m128i upper = _mm_loadu_si128((const __m128i*)(top + offset));
+			__m128i lower = _mm_loadu_si128((const __m128i*)(bottom + offset));
+			__m256i leftSum = _mm256_add_epi32(_mm256_cvtepu8_epi32(upper), _mm256_cvtepu8_epi32(lower));
+			__m256i rightSum = _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(upper, 8)), _mm256_cvtepu8_epi32(_mm_srli_si128(lower, 8)));
+			__m256i sum = _mm256_add_epi32(_mm256_permute2x128_si256(leftSum, rightSum, 0x20), _mm256_permute2x128_si256(leftSum, rightSum, 0x31));
+			__m256i alpha = _mm256_srli_epi32(_mm256_add_epi32(sum, two), 2);
+
+			__m256i texels = _mm256_blend_epi32(color, alpha, 0x88);
+			__m256i words = _mm256_packus_epi32(texels, texels);
+			__m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(words, words), order);
+			_mm_storel_epi64((__m128i*)(out + (size_t)x * 4), _mm256_castsi256_si128(bytes));
+		}
+#else
+		(void)top;
+		(void)bottom;
+		(void)count;
+		(void)out;
+#endif
+		return x;
+	}
+
+#if defined(MIP_GENERATION_AVX2)
+	// Two RGBA8 texels as linear floats, alpha included.
+	static __m256 decodeSrgb(const SrgbTables & tables, const unsigned char* texels)
+	{
+		const float* toLinear = tables.toLinear;
+		return _mm256_setr_ps(toLinear[texels[0]], toLinear[texels[1]], toLinear[texels[2]], toLinear[texels[3]],
+			toLinear[texels[4]], toLinear[texels[5]], toLinear[texels[6]], toLinear[texels[7]]);
+	}
+#endif
+
+	static int normalRowRG8(const unsigned char* top, const unsigned char* bottom, int count, unsigned char* out)
+	{
+		int x = 0;
+#if defined(MIP_GENERATION_AVX2)
+		{
+			const __m256i lowByte = _mm256_set1_epi16(0x00FF);
+			const __m256i lowWord = _mm256_set1_epi32(0xFFFF);
+			const __m256 scale = _mm256_set1_ps(2.0f / 255.0f);
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 one = _mm256_set1_ps(1.0f);
+			const __m256 minimum = _mm256_set1_ps(1e-6f);
+			const __m256 halfRange = _mm256_set1_ps(127.5f);
+			const __m256 rounding = _mm256_set1_ps(0.5f);
+			const __m256 maximum = _mm256_set1_ps(255.0f);
+			for (; x + 8 <= count; x += 8)
+			{
+				// 16 source texels per row, 0..7 in the lower 128-bit lane and 8..15 in the upper one
+				__m256 sum[3] = { zero, zero, zero };
+				__m256 column[2][3];
+				for (int row = 0; row < 2; row++)
+				{
+					__m256i texels = _mm256_loadu_si256((const __m256i*)((row == 0 ? top : bottom) + (size_t)x * 4));
+					__m256i xs = _mm256_and_si256(texels, lowByte);
+					__m256i ys = _mm256_srli_epi16(texels, 8);
+					__m256i channels[2][2] = { { _mm256_and_si256(xs, lowWord), _mm256_srli_epi32(xs, 16) }, { _mm256_and_si256(ys, lowWord), _mm256_srli_epi32(ys, 16) } };
+					for (int side = 0; side < 2; side++)
+					{
+						__m256 nx = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(channels[0][side]), scale), one);
+						__m256 ny = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(channels[1][side]), scale), one);
+						__m256 nz = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_sub_ps(one, _mm256_mul_ps(nx, nx)), _mm256_mul_ps(ny, ny)), zero));
+						if (row == 0)
+						{
+							column[side][0] = nx;
+							column[side][1] = ny;
+							column[side][2] = nz;
+						}
+						else
+						{
+							column[side][0] = _mm256_add_ps(column[side][0], nx);
+							column[side][1] = _mm256_add_ps(column[side][1], ny);
+							column[side][2] = _mm256_add_ps(column[side][2], nz);
+						}
+					}
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					sum[c] = _mm256_add_ps(column[0][c], column[1][c]);
+				}
+				__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sum[0], sum[0]), _mm256_mul_ps(sum[1], sum[1])), _mm256_mul_ps(sum[2], sum[2])));
+				__m256 valid = _mm256_cmp_ps(length, minimum, _CMP_GT_OQ);
+				__m256i encoded[2];
+				for (int c = 0; c < 2; c++)
+				{
+					__m256 unit = _mm256_and_ps(_mm256_div_ps(sum[c], length), valid);
+					__m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(unit, one), halfRange), rounding);
+					encoded[c] = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(value, zero), maximum));
+				}
+				// x0..x3 y0..y3 per lane, interleaved to x0 y0 .. x3 y3 and the lanes joined
+				__m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(encoded[0], encoded[1]), _mm256_setzero_si256());
+				__m256i interleaved = _mm256_unpacklo_epi8(bytes, _mm256_srli_si256(bytes, 4));
+				_mm_storeu_si128((__m128i*)(out + (size_t)x * 2), _mm256_castsi256_si128(_mm256_permute4x64_epi64(interleaved, 0x08)));
+			}
+		}
+#endif
+#if defined(MIP_GENERATION_SSE2)
+		const __m128i lowByte = _mm_set1_epi16(0x00FF);
+		const __m128i lowWord = _mm_set1_epi32(0xFFFF);
+		const __m128 scale = _mm_set1_ps(2.0f / 255.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 minimum = _mm_set1_ps(1e-6f);
+		const __m128 halfRange = _mm_set1_ps(127.5f);
+		const __m128 rounding = _mm_set1_ps(0.5f);
+		const __m128 maximum = _mm_set1_ps(255.0f);
+		for (; x + 4 <= count; x += 4)
+		{
+			__m128 column[2][3];
+			for (int row = 0; row < 2; row++)
+			{
+				__m128i texels = _mm_loadu_si128((const __m128i*)((row == 0 ? top : bottom) + (size_t)x * 4));
+				__m128i xs = _mm_and_si128(texels, lowByte);
+				__m128i ys = _mm_srli_epi16(texels, 8);
+				__m128i channels[2][2] = { { _mm_and_si128(xs, lowWord), _mm_srli_epi32(xs, 16) }, { _mm_and_si128(ys, lowWord), _mm_srli_epi32(ys, 16) } };
+				for (int side = 0; side < 2; side++)
+				{
+					__m128 nx = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(channels[0][side]), scale), one);
+					__m128 ny = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(channels[1][side]), scale), one);
+					__m128 nz = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_sub_ps(one, _mm_mul_ps(nx, nx)), _mm_mul_ps(ny, ny)), zero));
+					if (row == 0)
+					{
+						column[side][0] = nx;
+						column[side][1] = ny;
+						column[side][2] = nz;
+					}
+					else
+					{
+						column[side][0] = _mm_add_ps(column[side][0], nx);
+						column[side][1] = _mm_add_ps(column[side][1], ny);
+						column[side][2] = _mm_add_ps(column[side][2], nz);
+					}
+				}
+			}
+			__m128 sum[3];
+			for (int c = 0; c < 3; c++)
+			{
+				sum[c] = _mm_add_ps(column[0][c], column[1][c]);
+			}
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sum[0], sum[0]), _mm_mul_ps(sum[1], sum[1])), _mm_mul_ps(sum[2], sum[2])));
+			__m128 valid = _mm_cmpgt_ps(length, minimum);
+			__m128i encoded[2];
+			for (int c = 0; c < 2; c++)
+			{
+				__m128 unit = _mm_and_ps(_mm_div_ps(sum[c], length), valid);
+				__m128 value = _mm_add_ps(_mm_mul_ps(_mm_add_ps(unit, one), halfRange), rounding);
+				encoded[c] = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(value, zero), maximum));
+			}
+			__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(encoded[0], encoded[1]), _mm_setzero_si128());
+			_mm_storel_epi64((__m128i*)(out + (size_t)x * 2), _mm_unpacklo_epi8(bytes, _mm_srli_si128(bytes, 4)));
+		}
+#endif
+		return x;
+	}
+
+	// One RGB texel per register. Each load reaches one float into the next texel and each store one
+	// float into the next target texel, so the last texel of a row is left to the scalar path.
+	static int rowRGB32F(const float* top, const float* bottom, int count, float* out)
+	{
+		int x = 0;
+#if defined(MIP_GENERATION_SSE2)
+		const __m128 quarter = _mm_set1_ps(0.25f);
+		for (; x + 1 < count; x++)
+		{
+			size_t offset = (size_t)x * 6;
+			__m128 left = _mm_add_ps(_mm_loadu_ps(top + offset), _mm_loadu_ps(bottom + offset));
+			__m128 right = _mm_add_ps(_mm_loadu_ps(top + offset + 3), _mm_loadu_ps(bottom + offset + 3));
+			_mm_storeu_ps(out + (size_t)x * 3, _mm_mul_ps(_mm_add_ps(left, right), quarter));
+		}
+#endif
+		return x;
+	}
+
+	static int rowRGB16F(const uint16_t* top, const uint16_t* bottom, int count, uint16_t* out)
+	{
+		int x = 0;
+#if defined(MIP_GENERATION_F16C)
+		const __m128 quarter = _mm_set1_ps(0.25f);
+		for (; x + 1 < count; x++)
+		{
+			size_t offset = (size_t)x * 6;
+			__m128 left = _mm_add_ps(_mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(top + offset))), _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(bottom + offset))));
+			__m128 right = _mm_add_ps(_mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(top + offset + 3))), _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(bottom + offset + 3))));
+			_mm_storel_epi64((__m128i*)(out + (size_t)x * 3), _mm_cvtps_ph(_mm_mul_ps(_mm_add_ps(left, right), quarter), 0));
+		}
+#else
+		(void)top;
+		(void)bottom;
+		(void)count;
+		(void)out;
+#endif
+		return x;
+	}
+};
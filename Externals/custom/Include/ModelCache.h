@@ -0,0 +1,369 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+
+#include <MappedFile.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Cooked model file, written after the first Assimp import and memory-mapped on later starts.
+// Layout: header | meshes | textures | meshlets | string table | vertices | indices. Vertices are stored in the
+// exact layout the VBO wants, compact ones with the quantization box in the header, so a warm load
+// hands the mapped bytes to glBufferData unchanged.
+struct CookedModelHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t vertexSize;
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint32_t stringBytes;
+	uint64_t vertexOffset;
+	uint64_t vertexCount;
+	uint64_t indexOffset;
+	uint64_t indexCount;
+	uint32_t meshletCount;
+	// quantization box of compact vertices, offset 0 and scale 1 for full ones
+	float positionOffset[3];
+	float positionScale[3];
+	uint32_t reserved;
+};
+
+// Most LODs a cooked mesh stores, level 0 included.
+const uint32_t COOKED_MAX_LODS = 4;
+
+// A range of the mesh's indices, firstIndex counts from the mesh's first index.
+struct CookedLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+};
+
+// indexCount covers the indices of every LOD.
+struct CookedMesh
+{
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t firstTexture;
+	uint32_t textureCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	float sphereCenter[3];
+	float sphereRadius;
+	uint32_t lodCount;
+	CookedLod lods[COOKED_MAX_LODS];
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+};
+
+// A meshlet of the full level and its culling bounds, firstIndex counts from the mesh's first index.
+struct CookedMeshlet
+{
+	uint32_t firstIndex;
+	uint32_t triangleCount;
+	float center[3];
+	float radius;
+	float coneAxis[3];
+	float coneCutoff;
+};
+
+// type and path are offsets into the string table
+struct CookedTexture
+{
+	uint32_t type;
+	uint32_t path;
+};
+
+class ModelCache
+{
+public:
+	static const uint32_t MAGIC = 0x4c444d43; // "CMDL"
+	static const uint32_t VERSION = 6;
+
+	// Directory the cooked models are written to. Set it to an empty string to disable the cache.
+	static std::string & directory()
+	{
+		static std::string dir = "model_cache";
+		return dir;
+	}
+
+	// Hash of the model file, the .mtl files an .obj pulls in and the import settings. Any edit
+	// produces a different hash and the cooked file is rebuilt. options describes loader settings
+	// beyond the Assimp flags, e.g. whether MeshOptimizer ran and which LODs were built.
+	static uint64_t sourceHash(const std::string & path, unsigned int importFlags, const std::string & options = std::string())
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		hash = fnv1a(hash, (const char*)&importFlags, sizeof(importFlags));
+		hash = fnv1a(hash, options.data(), options.size());
+
+		std::string source = readFile(path);
+		hash = fnv1a(hash, source.data(), source.size());
+
+		if (path.size() > 4 && path.compare(path.size() - 4, 4, ".obj") == 0)
+		{
+			size_t slash = path.find_last_of("/\\");
+			std::string folder = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+
+			std::istringstream lines(source);
+			std::string line;
+			while (std::getline(lines, line))
+			{
+				if (line.compare(0, 7, "mtllib ") == 0)
+				{
+					std::string library = line.substr(7);
+					library.erase(library.find_last_not_of(" \t\r") + 1);
+					std::string material = readFile(folder + library);
+					hash = fnv1a(hash, material.data(), material.size());
+				}
+			}
+		}
+		return hash;
+	}
+
+	static std::string path(const std::string & sourcePath)
+	{
+		size_t slash = sourcePath.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? sourcePath : sourcePath.substr(slash + 1);
+
+		char text[17];
+		std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)fnv1a(14695981039346656037ULL, sourcePath.data(), sourcePath.size()));
+		return directory() + "/" + name + "." + text + ".mesh";
+	}
+
+	static void makeDirectory()
+	{
+#ifdef _WIN32
+		_mkdir(directory().c_str());
+#else
+		mkdir(directory().c_str(), 0755);
+#endif
+	}
+
+private:
+	static std::string readFile(const std::string & path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream stream;
+		stream << file.rdbuf();
+		return stream.str();
+	}
+
+	static uint64_t fnv1a(uint64_t hash, const char* data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= (unsigned char)data[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+};
+
+// A mapped cooked model. valid() is false when the file is missing, truncated, from another format
+// version or cooked from different sources, and the caller falls back to Assimp.
+class CookedModel
+{
+public:
+	CookedModel(const std::string & path, uint64_t sourceHash, uint32_t vertexSize) : file(path), ok(false)
+	{
+		if (!file.valid() || file.size() < sizeof(CookedModelHeader))
+		{
+			return;
+		}
+		const CookedModelHeader & h = header();
+		if (h.magic != ModelCache::MAGIC || h.version != ModelCache::VERSION || h.sourceHash != sourceHash || h.vertexSize != vertexSize)
+		{
+			return;
+		}
+		uint64_t tablesEnd = sizeof(CookedModelHeader) + (uint64_t)h.meshCount * sizeof(CookedMesh)
+			+ (uint64_t)h.textureCount * sizeof(CookedTexture) + (uint64_t)h.meshletCount * sizeof(CookedMeshlet) + h.stringBytes;
+		ok = tablesEnd <= h.vertexOffset
+			&& h.vertexOffset + h.vertexCount * vertexSize <= h.indexOffset
+			&& h.indexOffset + h.indexCount * sizeof(uint32_t) <= file.size();
+	}
+
+	bool valid() const { return ok; }
+
+	const CookedModelHeader & header() const { return *(const CookedModelHeader*)file.data(); }
+
+	const CookedMesh* meshes() const
+	{
+		return (const CookedMesh*)(file.data() + sizeof(CookedModelHeader));
+	}
+
+	const CookedTexture* textures() const
+	{
+		return (const CookedTexture*)(meshes() + header().meshCount);
+	}
+
+	const CookedMeshlet* meshlets() const
+	{
+		return (const CookedMeshlet*)(textures() + header().textureCount);
+	}
+
+	const char* text(uint32_t offset) const
+	{
+		return (const char*)(meshlets() + header().meshletCount) + offset;
+	}
+
+	const void* vertices() const { return file.data() + header().vertexOffset; }
+
+	const uint32_t* indices() const { return (const uint32_t*)(file.data() + header().indexOffset); }
+
+private:
+	MappedFile file;
+	bool ok;
+};
+
+// Collects meshes in their GPU layout and writes them as one cooked model file.
+class CookedModelWriter
+{
+public:
+	// vertexSize is the size of one vertex in the GPU layout, positionOffset and positionScale the
+	// quantization box compact vertices were encoded in.
+	CookedModelWriter(uint32_t vertexSize, const float positionOffset[3], const float positionScale[3]) : vertexSize(vertexSize)
+	{
+		std::copy(positionOffset, positionOffset + 3, this->positionOffset);
+		std::copy(positionScale, positionScale + 3, this->positionScale);
+	}
+
+	// lods are ranges of indexData, at most COOKED_MAX_LODS of them, and so are the meshlets.
+	void addMesh(const void* vertexData, uint32_t vertexCount, const uint32_t* indexData, uint32_t indexCount,
+		const std::vector<std::pair<std::string, std::string>> & typedTexturePaths, const float boundsMin[3], const float boundsMax[3],
+		const float sphereCenter[3], float sphereRadius, const CookedLod* lods, uint32_t lodCount, const CookedMeshlet* meshletData, uint32_t meshletCount)
+	{
+		CookedMesh mesh;
+		mesh.firstVertex = (uint32_t)(vertices.size() / vertexSize);
+		mesh.vertexCount = vertexCount;
+		mesh.firstIndex = (uint32_t)indices.size();
+		mesh.indexCount = indexCount;
+		mesh.firstTexture = (uint32_t)textures.size();
+		mesh.textureCount = (uint32_t)typedTexturePaths.size();
+		for (int axis = 0; axis < 3; axis++)
+		{
+			mesh.boundsMin[axis] = boundsMin[axis];
+			mesh.boundsMax[axis] = boundsMax[axis];
+			mesh.sphereCenter[axis] = sphereCenter[axis];
+		}
+		mesh.sphereRadius = sphereRadius;
+		std::memset(mesh.lods, 0, sizeof(mesh.lods));
+		mesh.lodCount = std::min(lodCount, COOKED_MAX_LODS);
+		std::copy(lods, lods + mesh.lodCount, mesh.lods);
+		mesh.firstMeshlet = (uint32_t)meshlets.size();
+		mesh.meshletCount = meshletCount;
+		meshes.push_back(mesh);
+		meshlets.insert(meshlets.end(), meshletData, meshletData + meshletCount);
+
+		for (const std::pair<std::string, std::string> & texture : typedTexturePaths)
+		{
+			CookedTexture cooked;
+			cooked.type = addString(texture.first);
+			cooked.path = addString(texture.second);
+			textures.push_back(cooked);
+		}
+
+		const char* bytes = (const char*)vertexData;
+		vertices.insert(vertices.end(), bytes, bytes + (size_t)vertexCount * vertexSize);
+		indices.insert(indices.end(), indexData, indexData + indexCount);
+	}
+
+	bool write(const std::string & path, uint64_t sourceHash) const
+	{
+		CookedModelHeader header;
+		std::memset(&header, 0, sizeof(header));
+		header.magic = ModelCache::MAGIC;
+		header.version = ModelCache::VERSION;
+		header.sourceHash = sourceHash;
+		header.vertexSize = vertexSize;
+		header.meshCount = (uint32_t)meshes.size();
+		header.textureCount = (uint32_t)textures.size();
+		header.stringBytes = (uint32_t)strings.size();
+		header.meshletCount = (uint32_t)meshlets.size();
+		std::copy(positionOffset, positionOffset + 3, header.positionOffset);
+		std::copy(positionScale, positionScale + 3, header.positionScale);
+		uint64_t tablesEnd = sizeof(header) + meshes.size() * sizeof(CookedMesh) + textures.size() * sizeof(CookedTexture)
+			+ meshlets.size() * sizeof(CookedMeshlet) + strings.size();
+		header.vertexOffset = align(tablesEnd);
+		header.vertexCount = vertices.size() / vertexSize;
+		header.indexOffset = align(header.vertexOffset + vertices.size());
+		header.indexCount = indices.size();
+
+		// written next to the target and renamed over it, so a loader on another thread never maps a
+		// half written file
+		static std::atomic<unsigned int> writes(0);
+		std::string temporary = path + "." + std::to_string(writes++) + ".tmp";
+		ModelCache::makeDirectory();
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			std::cout << "ERROR::MODEL_CACHE::CANNOT_WRITE " << path << std::endl;
+			return false;
+		}
+		const char padding[16] = { 0 };
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)meshes.data(), meshes.size() * sizeof(CookedMesh));
+		file.write((const char*)textures.data(), textures.size() * sizeof(CookedTexture));
+		file.write((const char*)meshlets.data(), meshlets.size() * sizeof(CookedMeshlet));
+		file.write(strings.data(), strings.size());
+		file.write(padding, header.vertexOffset - tablesEnd);
+		file.write(vertices.data(), vertices.size());
+		file.write(padding, header.indexOffset - (header.vertexOffset + vertices.size()));
+		file.write((const char*)indices.data(), indices.size() * sizeof(uint32_t));
+		file.close();
+		if (!file)
+		{
+			std::remove(temporary.c_str());
+			return false;
+		}
+		// rename does not replace an existing file on Windows, and fails there while the old one is
+		// mapped, the next start cooks again then
+		std::remove(path.c_str());
+		if (std::rename(temporary.c_str(), path.c_str()) != 0)
+		{
+			std::remove(temporary.c_str());
+			return false;
+		}
+		return true;
+	}
+
+private:
+	uint32_t vertexSize;
+	float positionOffset[3];
+	float positionScale[3];
+	std::vector<CookedMesh> meshes;
+	std::vector<CookedTexture> textures;
+	std::vector<CookedMeshlet> meshlets;
+	std::vector<char> strings;
+	std::vector<char> vertices;
+	std::vector<uint32_t> indices;
+
+	uint32_t addString(const std::string & text)
+	{
+		uint32_t offset = (uint32_t)strings.size();
+		strings.insert(strings.end(), text.begin(), text.end());
+		strings.push_back('\0');
+		return offset;
+	}
+
+	static uint64_t align(uint64_t offset)
+	{
+		return (offset + 15) & ~(uint64_t)15;
+	}
+};
@@ -0,0 +1,347 @@
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <chrono>
+#include <iostream>
+
+#include <model.h>
+
+// A box drawn in place of a model that is still loading, in the vertex format of the model so the
+// same shader draws both.
+class PlaceholderBox
+{
+public:
+	PlaceholderBox() : VAO(0), VBO(0) {}
+
+	~PlaceholderBox()
+	{
+		release();
+	}
+
+	PlaceholderBox(const PlaceholderBox &) = delete;
+	PlaceholderBox & operator=(const PlaceholderBox &) = delete;
+
+	bool valid() const
+	{
+		return VAO != 0;
+	}
+
+	// Builds the 12 triangles of the box from boundsMin to boundsMax with outward normals.
+	void create(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax, VertexFormat format)
+	{
+		const glm::vec3 normals[6] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+		std::vector<Vertex> vertices;
+		for (const glm::vec3 & normal : normals)
+		{
+			// two axes spanning the face, ordered so the triangles wind counter-clockwise from outside
+			glm::vec3 u(normal.y, normal.z, normal.x);
+			glm::vec3 v = glm::cross(normal, u);
+			const glm::vec2 corners[6] = { glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, -1), glm::vec2(1, 1), glm::vec2(-1, 1) };
+			for (const glm::vec2 & corner : corners)
+			{
+				glm::vec3 unit = (normal + corner.x * u + corner.y * v) * 0.5f + 0.5f;
+				Vertex vertex;
+				vertex.Position = boundsMin + unit * (boundsMax - boundsMin);
+				vertex.Normal = normal;
+				vertex.TexCoords = corner * 0.5f + 0.5f;
+				vertex.Tangent = u;
+				vertex.Bitangent = v;
+				vertices.push_back(vertex);
+			}
+		}
+
+		layout = format == VertexFormat::Compact ? VertexLayout::compact(boundsMin, boundsMax) : VertexLayout();
+		std::vector<unsigned char> encoded;
+		encodeVertices(vertices.data(), (unsigned int)vertices.size(), layout, encoded);
+
+		release();
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, encoded.size(), encoded.data(), GL_STATIC_DRAW);
+		setupVertexAttributes(format);
+		glBindVertexArray(0);
+	}
+
+	// Draws the box with no textures bound, instanceCount times like Model::Draw.
+	void Draw(Shader & shader, unsigned int instanceCount = 1)
+	{
+		if (layout.format == VertexFormat::Compact)
+		{
+			glUniform3fv(shader.location("positionOffset"), 1, &layout.positionOffset[0]);
+			glUniform3fv(shader.location("positionScale"), 1, &layout.positionScale[0]);
+		}
+		GLStateCache::bindTexture(0, GL_TEXTURE_2D, 0);
+		GLStateCache::bindVertexArray(VAO);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instanceCount);
+	}
+
+	void release()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		VAO = VBO = 0;
+	}
+
+private:
+	unsigned int VAO, VBO;
+	VertexLayout layout;
+};
+
+// The half of a ModelLoader load that runs on a worker thread: Model::import of the file, textures
+// decoded, with the bounds reported as soon as the file is read. Nothing here touches GL, so it can
+// run before any context exists.
+class ModelImport
+{
+public:
+	ModelImport() : hasBounds(false) {}
+
+	ModelImport(const ModelImport &) = delete;
+	ModelImport & operator=(const ModelImport &) = delete;
+
+	// Same arguments as Model::import. Call it once.
+	void start(const std::string & path, VertexFormat format, bool decodeTextures = true)
+	{
+		data.reset(new ModelData());
+		worker = std::async(std::launch::async, [this, path, format, decodeTextures]()
+		{
+			Model::import(path, format, decodeTextures, *data, [this](const glm::vec3 & min, const glm::vec3 & max)
+			{
+				std::lock_guard<std::mutex> lock(boundsMutex);
+				boundsMin = min;
+				boundsMax = max;
+				hasBounds = true;
+			});
+		});
+	}
+
+	// False until the worker has read the file and knows the bounds of the model.
+	bool bounds(glm::vec3 & min, glm::vec3 & max)
+	{
+		std::lock_guard<std::mutex> lock(boundsMutex);
+		min = boundsMin;
+		max = boundsMax;
+		return hasBounds;
+	}
+
+	bool ready() const
+	{
+		return worker.valid() && worker.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	void wait() const
+	{
+		if (worker.valid())
+		{
+			worker.wait();
+		}
+	}
+
+	// Waits for the import and hands over its data, ModelData::valid tells whether the file was read.
+	std::unique_ptr<ModelData> take()
+	{
+		worker.get();
+		return std::move(data);
+	}
+
+private:
+	std::unique_ptr<ModelData> data;
+	std::mutex boundsMutex;
+	bool hasBounds;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+
+	// last, so it is destroyed first and waits for the worker before the members it writes go
+	std::future<void> worker;
+};
+
+// A model ModelLoader loads in the background. Draw() draws its bounding box until the model is
+// ready, and nothing before the box is known. Copies share the same model.
+class ModelHandle
+{
+public:
+	ModelHandle() {}
+
+	bool ready() const
+	{
+		return load && load->done;
+	}
+
+	// The loaded model, nullptr until ready().
+	Model* model() const
+	{
+		return ready() ? load->model.get() : nullptr;
+	}
+
+	void Draw(Shader & shader, unsigned int instanceCount = 1, unsigned int lod = 0)
+	{
+		if (ready())
+		{
+			load->model->Draw(shader, instanceCount, lod);
+		}
+		else if (load && load->placeholder.valid())
+		{
+			load->placeholder.Draw(shader, instanceCount);
+		}
+	}
+
+	void Draw(Shader & shader, const LodCamera & camera, const glm::mat4 & transform)
+	{
+		if (ready())
+		{
+			load->model->Draw(shader, camera, transform);
+		}
+		else
+		{
+			Draw(shader);
+		}
+	}
+
+private:
+	friend class ModelLoader;
+
+	struct Load
+	{
+		std::string path;
+		bool gamma;
+		bool packed;
+		VertexFormat format;
+		bool keepCpuCopy;
+		std::chrono::steady_clock::time_point start;
+
+		// taken from import once it is ready and dropped after the upload
+		std::unique_ptr<ModelData> data;
+
+		PlaceholderBox placeholder;
+		std::unique_ptr<Model> model;
+		bool done;
+
+		// last, so it is destroyed first and waits for the worker before the load goes
+		ModelImport import;
+	};
+
+	std::shared_ptr<Load> load;
+};
+
+// Loads models without blocking the render loop. load() starts a ModelImport of the file: Assimp or
+// the cooked cache, mesh processing and texture decoding. update(), called once per frame on the
+// GL thread, then uploads the imported models a texture or mesh at a time within a time budget, so
+// the first frame does not wait for any model whatever its size.
+class ModelLoader
+{
+public:
+	// Same arguments as the Model constructor.
+	static ModelHandle load(const std::string & path, bool gamma = false, bool packed = false, VertexFormat format = VertexFormat::Full,
+		bool keepCpuCopy = false)
+	{
+		ModelHandle handle;
+		handle.load = std::make_shared<ModelHandle::Load>();
+		ModelHandle::Load* load = handle.load.get();
+		load->path = path;
+		load->gamma = gamma;
+		load->packed = packed;
+		load->format = format;
+		load->keepCpuCopy = keepCpuCopy;
+		load->start = std::chrono::steady_clock::now();
+		load->done = false;
+		load->import.start(path, format);
+		pending().push_back(handle.load);
+		return handle;
+	}
+
+	// Creates the placeholders of models whose bounds became known and uploads imported models, in the
+	// order they were requested, until budgetMs have passed. A model that is only partly uploaded
+	// continues on the next call before the next one starts. Call it on the GL thread.
+	static void update(double budgetMs = 2.0)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		updateUntil(now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(budgetMs)));
+	}
+
+	// Blocks until every pending model is ready, e.g. before a benchmark.
+	static void finish()
+	{
+		while (!pending().empty())
+		{
+			pending().front()->import.wait();
+			updateUntil(std::chrono::steady_clock::time_point::max());
+		}
+	}
+
+	// Models requested and not ready yet.
+	static size_t pendingCount()
+	{
+		return pending().size();
+	}
+
+private:
+	static std::vector<std::shared_ptr<ModelHandle::Load>> & pending()
+	{
+		static std::vector<std::shared_ptr<ModelHandle::Load>> loads;
+		return loads;
+	}
+
+	static void updateUntil(std::chrono::steady_clock::time_point deadline)
+	{
+		std::vector<std::shared_ptr<ModelHandle::Load>> & loads = pending();
+		for (const std::shared_ptr<ModelHandle::Load> & load : loads)
+		{
+			glm::vec3 boundsMin, boundsMax;
+			if (!load->placeholder.valid() && load->import.bounds(boundsMin, boundsMax))
+			{
+				load->placeholder.create(boundsMin, boundsMax, load->format);
+			}
+		}
+
+		// a model that is partly uploaded goes first, so the uploads of two models never interleave
+		ModelHandle::Load* uploading = nullptr;
+		for (const std::shared_ptr<ModelHandle::Load> & load : loads)
+		{
+			if (load->model)
+			{
+				uploading = load.get();
+			}
+		}
+
+		bool budgetLeft = true;
+		for (const std::shared_ptr<ModelHandle::Load> & load : loads)
+		{
+			if (!budgetLeft)
+			{
+				break;
+			}
+			if (uploading != nullptr && load.get() != uploading)
+			{
+				continue;
+			}
+			if (!load->model)
+			{
+				if (!load->import.ready())
+				{
+					continue;
+				}
+				load->data = load->import.take();
+				load->model.reset(new Model(load->gamma, load->packed, load->format, load->keepCpuCopy));
+			}
+
+			load->done = load->model->upload(*load->data, deadline);
+			budgetLeft = load->done && std::chrono::steady_clock::now() < deadline;
+			if (load->done)
+			{
+				uploading = nullptr;
+				load->data.reset();
+				load->placeholder.release();
+				std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - load->start;
+				std::cout << "model " << load->path << " ready after " << elapsed.count() << " ms" << std::endl;
+			}
+		}
+
+		loads.erase(std::remove_if(loads.begin(), loads.end(), [](const std::shared_ptr<ModelHandle::Load> & load) { return load->done; }), loads.end());
+	}
+};
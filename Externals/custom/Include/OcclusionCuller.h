@@ -0,0 +1,661 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstddef>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+#include <glm.hpp>
+
+#include <Bounds.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_CULLING_SSE 1
+#endif
+
+// Occlusion culling on the CPU. A few occluder meshes, e.g. walls, are rasterized into a small depth
+// buffer, then the screen rectangle of each object's box is tested against a max-depth pyramid of it:
+// an object whose nearest point lies behind the farthest occluder depth under its rectangle is hidden.
+// Depths are window depths in [0, 1] as in OpenGL. Occluders cover the pixels whose centers they
+// cover, and their depth is pushed to the far end of each pixel, so a visible object is only reported
+// hidden when it shows through less than a pixel. Rasterization runs on worker threads, one band of
+// rows each, four pixels at a time with SSE. The threads live as long as the culler, a frame only
+// wakes them. Nothing here touches GL.
+class OcclusionCuller
+{
+public:
+	// width and height are rounded up to powers of two, at least 4.
+	OcclusionCuller(unsigned int width = 256, unsigned int height = 128)
+		: batchInvoke(nullptr), batchWork(nullptr), batchCount(0), batchNext(0), batchPending(0), jobQueued(false), jobRunning(false), stopping(false)
+	{
+		this->width = 4;
+		while (this->width < width)
+		{
+			this->width *= 2;
+		}
+		this->height = 4;
+		while (this->height < height)
+		{
+			this->height *= 2;
+		}
+
+		unsigned int levelWidth = this->width;
+		unsigned int levelHeight = this->height;
+		while (true)
+		{
+			Level level = { levelWidth, levelHeight, std::vector<float>(levelWidth * levelHeight, 1.0f) };
+			levels.push_back(level);
+			if (levelWidth == 1 && levelHeight == 1)
+			{
+				break;
+			}
+			levelWidth = std::max(levelWidth / 2, 1u);
+			levelHeight = std::max(levelHeight / 2, 1u);
+		}
+
+		workers = std::thread::hardware_concurrency();
+		workers = std::min(std::max(workers, 1u), 8u);
+		startThreads();
+	}
+
+	~OcclusionCuller()
+	{
+		finish();
+		stopThreads();
+	}
+
+	OcclusionCuller(const OcclusionCuller &) = delete;
+	OcclusionCuller & operator=(const OcclusionCuller &) = delete;
+
+	unsigned int bufferWidth() const { return width; }
+	unsigned int bufferHeight() const { return height; }
+
+	// Threads render() and test() use, 1 runs everything on the calling thread. Restarts the pool,
+	// so call it at setup, not per frame.
+	void setWorkers(unsigned int count)
+	{
+		finish();
+		stopThreads();
+		workers = std::max(count, 1u);
+		startThreads();
+	}
+
+	void clearOccluders()
+	{
+		occluderPositions.clear();
+		occluderIndices.clear();
+	}
+
+	// Adds the triangles of a mesh at transform as occluders. They should lie inside what they stand
+	// for, a simplified mesh that sticks out hides objects that are visible.
+	void addOccluder(const glm::vec3* positions, size_t vertexCount, const unsigned int* indices, size_t indexCount, const glm::mat4 & transform)
+	{
+		unsigned int first = (unsigned int)occluderPositions.size();
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			occluderPositions.push_back(glm::vec3(transform * glm::vec4(positions[i], 1.0f)));
+		}
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			occluderIndices.push_back(first + indices[i]);
+		}
+	}
+
+	// Adds a solid world-space box as an occluder.
+	void addOccluder(const BoundingBox & box)
+	{
+		glm::vec3 corners[8];
+		for (int i = 0; i < 8; i++)
+		{
+			corners[i] = glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+		}
+		const unsigned int faces[36] = { 0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+		addOccluder(corners, 8, faces, 36, glm::mat4(1.0f));
+	}
+
+	size_t occluderTriangles() const
+	{
+		return occluderIndices.size() / 3;
+	}
+
+	// Rasterizes the occluders as seen through viewProjection and builds the depth pyramid.
+	void render(const glm::mat4 & viewProjection)
+	{
+		this->viewProjection = viewProjection;
+		setupTriangles();
+
+		unsigned int bands = std::min(workers, height);
+		unsigned int bandHeight = (height + bands - 1) / bands;
+		runParallel(bands, [&](unsigned int band)
+		{
+			unsigned int firstRow = band * bandHeight;
+			unsigned int endRow = std::min(firstRow + bandHeight, height);
+			std::fill(levels[0].depth.begin() + firstRow * width, levels[0].depth.begin() + endRow * width, 1.0f);
+			for (const Triangle & triangle : triangles)
+			{
+				rasterize(triangle, (int)firstRow, (int)endRow);
+			}
+		});
+
+		for (size_t l = 1; l < levels.size(); l++)
+		{
+			const Level & fine = levels[l - 1];
+			Level & coarse = levels[l];
+			for (unsigned int y = 0; y < coarse.height; y++)
+			{
+				unsigned int y0 = std::min(y * 2, fine.height - 1);
+				unsigned int y1 = std::min(y * 2 + 1, fine.height - 1);
+				for (unsigned int x = 0; x < coarse.width; x++)
+				{
+					unsigned int x0 = std::min(x * 2, fine.width - 1);
+					unsigned int x1 = std::min(x * 2 + 1, fine.width - 1);
+					coarse.depth[y * coarse.width + x] = std::max(std::max(fine.depth[y0 * fine.width + x0], fine.depth[y0 * fine.width + x1]),
+						std::max(fine.depth[y1 * fine.width + x0], fine.depth[y1 * fine.width + x1]));
+				}
+			}
+		}
+	}
+
+	// False when box is hidden behind the occluders of the last render(). Boxes that cross the near
+	// plane or leave the screen count as visible, the frustum test decides about those. Reads at most
+	// 3x3 texels of the pyramid level that fits the box's rectangle.
+	bool visible(const BoundingBox & box) const
+	{
+		return testBox(box, false);
+	}
+
+	// Like visible(), but compares against every pixel under the rectangle. Slower, for checking how
+	// much the pyramid loses.
+	bool visibleAtFullResolution(const BoundingBox & box) const
+	{
+		return testBox(box, true);
+	}
+
+	// Writes visible(boxes[i]) to result[i] for count boxes, spread over the workers, and returns how
+	// many are visible.
+	size_t test(const BoundingBox* boxes, size_t count, unsigned char* result) const
+	{
+		const size_t minimumPerWorker = 2048;
+		unsigned int chunks = (unsigned int)std::min<size_t>(workers, std::max<size_t>(count / minimumPerWorker, 1));
+		size_t chunkSize = (count + chunks - 1) / chunks;
+		std::vector<size_t> visibleCounts(chunks, 0);
+		runParallel(chunks, [&](unsigned int chunk)
+		{
+			size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < end; i++)
+			{
+				result[i] = (unsigned char)visible(boxes[i]);
+				visibleCounts[chunk] += result[i];
+			}
+		});
+
+		size_t visibleCount = 0;
+		for (size_t counted : visibleCounts)
+		{
+			visibleCount += counted;
+		}
+		return visibleCount;
+	}
+
+	// Runs render() and test() for a copy of boxes on a worker thread and returns at once, so the
+	// caller can record the rest of the frame meanwhile. finish() returns the result.
+	void start(const glm::mat4 & viewProjection, const BoundingBox* boxes, size_t count)
+	{
+		finish();
+		pendingBoxes.assign(boxes, boxes + count);
+		results.resize(count);
+		std::lock_guard<std::mutex> lock(poolMutex);
+		jobViewProjection = viewProjection;
+		jobQueued = true;
+		wake.notify_all();
+	}
+
+	// Waits for the job of start() and returns one byte per box, 1 when visible.
+	const std::vector<unsigned char> & finish()
+	{
+		std::unique_lock<std::mutex> lock(poolMutex);
+		done.wait(lock, [this]() { return !jobQueued && !jobRunning; });
+		return results;
+	}
+
+	// Window depth of the occluders at a pixel of the full resolution buffer, 1 where there are none.
+	float depthAt(unsigned int x, unsigned int y) const
+	{
+		return levels[0].depth[std::min(y, height - 1) * width + std::min(x, width - 1)];
+	}
+
+private:
+	struct Level
+	{
+		unsigned int width;
+		unsigned int height;
+		std::vector<float> depth;
+	};
+
+	// A screen-space triangle ready to rasterize: three edge functions a * x + b * y + c that are
+	// >= 0 inside, the depth plane and the pixel rectangle it covers.
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depth0, depthX, depthY, depthMax;
+		int minX, maxX, minY, maxY;
+	};
+
+	unsigned int width, height;
+	unsigned int workers;
+	std::vector<Level> levels;
+	glm::mat4 viewProjection;
+
+	std::vector<glm::vec3> occluderPositions;
+	std::vector<unsigned int> occluderIndices;
+	std::vector<glm::vec4> clipPositions;
+	std::vector<Triangle> triangles;
+
+	std::vector<BoundingBox> pendingBoxes;
+	std::vector<unsigned char> results;
+
+	// The pool: workers - 1 threads, at least one for start(). A batch is the work of one
+	// runParallel(), its indices are handed out one at a time under poolMutex. test() is const but
+	// still uses the pool, hence mutable.
+	std::vector<std::thread> threads;
+	mutable std::mutex poolMutex;
+	mutable std::condition_variable wake;
+	mutable std::condition_variable done;
+	mutable void (*batchInvoke)(const void*, unsigned int);
+	mutable const void* batchWork;
+	mutable unsigned int batchCount, batchNext, batchPending;
+	glm::mat4 jobViewProjection;
+	bool jobQueued, jobRunning, stopping;
+
+	void startThreads()
+	{
+		stopping = false;
+		for (unsigned int i = 0; i < std::max(workers, 2u) - 1; i++)
+		{
+			threads.push_back(std::thread(&OcclusionCuller::workerLoop, this));
+		}
+	}
+
+	void stopThreads()
+	{
+		{
+			std::lock_guard<std::mutex> lock(poolMutex);
+			stopping = true;
+			wake.notify_all();
+		}
+		for (std::thread & thread : threads)
+		{
+			thread.join();
+		}
+		threads.clear();
+	}
+
+	void workerLoop()
+	{
+		std::unique_lock<std::mutex> lock(poolMutex);
+		while (true)
+		{
+			wake.wait(lock, [this]() { return stopping || jobQueued || batchNext < batchCount; });
+			if (stopping)
+			{
+				return;
+			}
+			if (jobQueued)
+			{
+				jobQueued = false;
+				jobRunning = true;
+				lock.unlock();
+				render(jobViewProjection);
+				test(pendingBoxes.data(), pendingBoxes.size(), results.data());
+				lock.lock();
+				jobRunning = false;
+				done.notify_all();
+				continue;
+			}
+			runBatch(lock);
+		}
+	}
+
+	// Takes indices of the current batch until none are left. Called with poolMutex locked.
+	void runBatch(std::unique_lock<std::mutex> & lock) const
+	{
+		while (batchNext < batchCount)
+		{
+			unsigned int index = batchNext++;
+			lock.unlock();
+			batchInvoke(batchWork, index);
+			lock.lock();
+			if (--batchPending == 0)
+			{
+				done.notify_all();
+			}
+		}
+	}
+
+	// Runs work(0) .. work(count - 1) on the pool and the calling thread, which takes indices too, so
+	// a batch started from the thread running start()'s job cannot wait on itself.
+	template <typename Work>
+	void runParallel(unsigned int count, const Work & work) const
+	{
+		if (count <= 1)
+		{
+			for (unsigned int i = 0; i < count; i++)
+			{
+				work(i);
+			}
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(poolMutex);
+		// one batch at a time, e.g. test() from another thread while start()'s job renders
+		done.wait(lock, [this]() { return batchPending == 0; });
+		batchInvoke = [](const void* batch, unsigned int index) { (*(const Work*)batch)(index); };
+		batchWork = &work;
+		batchCount = count;
+		batchNext = 0;
+		batchPending = count;
+		wake.notify_all();
+		runBatch(lock);
+		done.wait(lock, [this]() { return batchPending == 0; });
+	}
+
+	void setupTriangles()
+	{
+		clipPositions.resize(occluderPositions.size());
+		for (size_t i = 0; i < occluderPositions.size(); i++)
+		{
+			clipPositions[i] = viewProjection * glm::vec4(occluderPositions[i], 1.0f);
+		}
+
+		triangles.clear();
+		for (size_t i = 0; i + 2 < occluderIndices.size(); i += 3)
+		{
+			glm::vec4 polygon[4];
+			int corners = clipNear(clipPositions[occluderIndices[i]], clipPositions[occluderIndices[i + 1]], clipPositions[occluderIndices[i + 2]], polygon);
+			for (int c = 2; c < corners; c++)
+			{
+				addTriangle(polygon[0], polygon[c - 1], polygon[c]);
+			}
+		}
+	}
+
+	// Cuts the triangle at the near plane, z >= -w in clip space. Returns the corners left, 0, 3 or 4.
+	static int clipNear(const glm::vec4 & a, const glm::vec4 & b, const glm::vec4 & c, glm::vec4 polygon[4])
+	{
+		const glm::vec4 input[3] = { a, b, c };
+		int count = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			const glm::vec4 & from = input[i];
+			const glm::vec4 & to = input[(i + 1) % 3];
+			float fromDistance = from.z + from.w;
+			float toDistance = to.z + to.w;
+			if (fromDistance >= 0.0f)
+			{
+				polygon[count++] = from;
+			}
+			if ((fromDistance >= 0.0f) != (toDistance >= 0.0f) && count < 4)
+			{
+				polygon[count++] = from + (to - from) * (fromDistance / (fromDistance - toDistance));
+			}
+		}
+		return count;
+	}
+
+	void addTriangle(const glm::vec4 & a, const glm::vec4 & b, const glm::vec4 & c)
+	{
+		glm::vec3 screen[3];
+		const glm::vec4* corners[3] = { &a, &b, &c };
+		for (int i = 0; i < 3; i++)
+		{
+			float w = std::max(corners[i]->w, 1e-6f);
+			screen[i] = glm::vec3((corners[i]->x / w * 0.5f + 0.5f) * width, (corners[i]->y / w * 0.5f + 0.5f) * height, corners[i]->z / w * 0.5f + 0.5f);
+		}
+
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+		if (std::abs(area) < 1e-8f)
+		{
+			return;
+		}
+		// occluders are drawn from both sides, a clockwise triangle is turned around
+		if (area < 0.0f)
+		{
+			std::swap(screen[1], screen[2]);
+			area = -area;
+		}
+
+		Triangle triangle;
+		for (int i = 0; i < 3; i++)
+		{
+			const glm::vec3 & from = screen[i];
+			const glm::vec3 & to = screen[(i + 1) % 3];
+			triangle.edgeA[i] = from.y - to.y;
+			triangle.edgeB[i] = to.x - from.x;
+			triangle.edgeC[i] = -(triangle.edgeA[i] * from.x + triangle.edgeB[i] * from.y);
+		}
+
+		triangle.depthX = ((screen[1].z - screen[0].z) * (screen[2].y - screen[0].y) - (screen[2].z - screen[0].z) * (screen[1].y - screen[0].y)) / area;
+		triangle.depthY = ((screen[2].z - screen[0].z) * (screen[1].x - screen[0].x) - (screen[1].z - screen[0].z) * (screen[2].x - screen[0].x)) / area;
+		triangle.depth0 = screen[0].z - triangle.depthX * screen[0].x - triangle.depthY * screen[0].y;
+		triangle.depthMax = std::max(screen[0].z, std::max(screen[1].z, screen[2].z));
+
+		float minX = std::min(screen[0].x, std::min(screen[1].x, screen[2].x));
+		float maxX = std::max(screen[0].x, std::max(screen[1].x, screen[2].x));
+		float minY = std::min(screen[0].y, std::min(screen[1].y, screen[2].y));
+		float maxY = std::max(screen[0].y, std::max(screen[1].y, screen[2].y));
+		if (maxX < 0.0f || maxY < 0.0f || minX > (float)width || minY > (float)height)
+		{
+			return;
+		}
+		// whole groups of four pixels, the edge functions mask the ones outside
+		triangle.minX = std::max((int)std::floor(minX), 0) & ~3;
+		triangle.maxX = std::min((int)std::ceil(maxX), (int)width - 1);
+		triangle.minY = std::max((int)std::floor(minY), 0);
+		triangle.maxY = std::min((int)std::ceil(maxY), (int)height - 1);
+		triangles.push_back(triangle);
+	}
+
+	// Rasterizes the rows of triangle from firstRow up to endRow.
+	void rasterize(const Triangle & triangle, int firstRow, int endRow)
+	{
+		int minY = std::max(triangle.minY, firstRow);
+		int maxY = std::min(triangle.maxY, endRow - 1);
+		// the farthest depth within a pixel, from its center half a pixel along both axes
+		float bias = 0.5f * (std::abs(triangle.depthX) + std::abs(triangle.depthY));
+		float* depth = levels[0].depth.data();
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			float py = y + 0.5f;
+			float px = triangle.minX + 0.5f;
+			float* row = depth + y * width;
+#ifdef OCCLUSION_CULLING_SSE
+			__m128 offsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+			__m128 edge[3], edgeStep[3];
+			for (int e = 0; e < 3; e++)
+			{
+				float start = triangle.edgeA[e] * px + triangle.edgeB[e] * py + triangle.edgeC[e];
+				edge[e] = _mm_add_ps(_mm_set1_ps(start), _mm_mul_ps(_mm_set1_ps(triangle.edgeA[e]), offsets));
+				edgeStep[e] = _mm_set1_ps(triangle.edgeA[e] * 4.0f);
+			}
+			__m128 z = _mm_add_ps(_mm_set1_ps(triangle.depth0 + triangle.depthX * px + triangle.depthY * py + bias), _mm_mul_ps(_mm_set1_ps(triangle.depthX), offsets));
+			__m128 zStep = _mm_set1_ps(triangle.depthX * 4.0f);
+			__m128 zMax = _mm_set1_ps(triangle.depthMax);
+			__m128 zero = _mm_setzero_ps();
+			for (int x = triangle.minX; x <= triangle.maxX; x += 4)
+			{
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge[0], zero), _mm_cmpge_ps(edge[1], zero)), _mm_cmpge_ps(edge[2], zero));
+				if (_mm_movemask_ps(inside) != 0)
+				{
+					__m128 old = _mm_loadu_ps(row + x);
+					__m128 nearest = _mm_min_ps(old, _mm_min_ps(z, zMax));
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+				}
+				for (int e = 0; e < 3; e++)
+				{
+					edge[e] = _mm_add_ps(edge[e], edgeStep[e]);
+				}
+				z = _mm_add_ps(z, zStep);
+			}
+#else
+			for (int x = triangle.minX; x <= triangle.maxX; x++)
+			{
+				float cx = x + 0.5f;
+				bool inside = true;
+				for (int e = 0; e < 3; e++)
+				{
+					inside = inside && triangle.edgeA[e] * cx + triangle.edgeB[e] * py + triangle.edgeC[e] >= 0.0f;
+				}
+				if (inside)
+				{
+					float z = std::min(triangle.depth0 + triangle.depthX * cx + triangle.depthY * py + bias, triangle.depthMax);
+					row[x] = std::min(row[x], z);
+				}
+			}
+#endif
+		}
+	}
+
+	// Projects the corners of box and returns false when one lies before the near plane. Otherwise
+	// bounds is the rectangle in normalized device coordinates, min x, min y, max x, max y, and nearest
+	// the smallest normalized depth.
+	bool projectBox(const BoundingBox & box, float bounds[4], float & nearest) const
+	{
+		// the corners are the transformed min corner plus the transformed edges, no matrix product each
+		glm::vec4 origin = viewProjection * glm::vec4(box.min, 1.0f);
+		glm::vec4 edgeX = viewProjection[0] * (box.max.x - box.min.x);
+		glm::vec4 edgeY = viewProjection[1] * (box.max.y - box.min.y);
+		glm::vec4 edgeZ = viewProjection[2] * (box.max.z - box.min.z);
+#ifdef OCCLUSION_CULLING_SSE
+		// corners 0-3 in low, 4-7 in high, one register per component
+		__m128 low[4], high[4];
+		for (int c = 0; c < 4; c++)
+		{
+			low[c] = _mm_add_ps(_mm_set1_ps(origin[c]), _mm_set_ps(edgeX[c] + edgeY[c], edgeY[c], edgeX[c], 0.0f));
+			high[c] = _mm_add_ps(low[c], _mm_set1_ps(edgeZ[c]));
+		}
+		__m128 zero = _mm_setzero_ps();
+		__m128 behind = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(_mm_add_ps(low[2], low[3]), zero), _mm_cmple_ps(low[3], zero)),
+			_mm_or_ps(_mm_cmplt_ps(_mm_add_ps(high[2], high[3]), zero), _mm_cmple_ps(high[3], zero)));
+		if (_mm_movemask_ps(behind) != 0)
+		{
+			return false;
+		}
+
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 lowInverse = _mm_div_ps(one, low[3]);
+		__m128 highInverse = _mm_div_ps(one, high[3]);
+		__m128 lowX = _mm_mul_ps(low[0], lowInverse), highX = _mm_mul_ps(high[0], highInverse);
+		__m128 lowY = _mm_mul_ps(low[1], lowInverse), highY = _mm_mul_ps(high[1], highInverse);
+		__m128 lowZ = _mm_mul_ps(low[2], lowInverse), highZ = _mm_mul_ps(high[2], highInverse);
+		// min x, min y, min z and max x in one register, max y in another
+		__m128 minimum = horizontalMin(_mm_min_ps(lowX, highX), _mm_min_ps(lowY, highY), _mm_min_ps(lowZ, highZ),
+			_mm_sub_ps(zero, _mm_max_ps(lowX, highX)));
+		float minimums[4];
+		_mm_storeu_ps(minimums, minimum);
+		__m128 maxY = _mm_max_ps(lowY, highY);
+		maxY = _mm_max_ps(maxY, _mm_shuffle_ps(maxY, maxY, _MM_SHUFFLE(1, 0, 3, 2)));
+		maxY = _mm_max_ps(maxY, _mm_shuffle_ps(maxY, maxY, _MM_SHUFFLE(2, 3, 0, 1)));
+		bounds[0] = minimums[0];
+		bounds[1] = minimums[1];
+		bounds[2] = -minimums[3];
+		bounds[3] = _mm_cvtss_f32(maxY);
+		nearest = minimums[2];
+		return true;
+#else
+		bounds[0] = bounds[1] = FLT_MAX;
+		bounds[2] = bounds[3] = -FLT_MAX;
+		nearest = FLT_MAX;
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec4 clip = origin;
+			if (i & 1)
+			{
+				clip += edgeX;
+			}
+			if (i & 2)
+			{
+				clip += edgeY;
+			}
+			if (i & 4)
+			{
+				clip += edgeZ;
+			}
+			if (clip.z < -clip.w || clip.w <= 0.0f)
+			{
+				return false;
+			}
+			float inverseW = 1.0f / clip.w;
+			bounds[0] = std::min(bounds[0], clip.x * inverseW);
+			bounds[1] = std::min(bounds[1], clip.y * inverseW);
+			bounds[2] = std::max(bounds[2], clip.x * inverseW);
+			bounds[3] = std::max(bounds[3], clip.y * inverseW);
+			nearest = std::min(nearest, clip.z * inverseW);
+		}
+		return true;
+#endif
+	}
+
+#ifdef OCCLUSION_CULLING_SSE
+	// The minimum of each of a, b, c and d, in that order.
+	static __m128 horizontalMin(__m128 a, __m128 b, __m128 c, __m128 d)
+	{
+		// transpose so each register holds one lane of all four, then reduce across registers
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+		return _mm_min_ps(_mm_min_ps(a, b), _mm_min_ps(c, d));
+	}
+#endif
+
+	bool testBox(const BoundingBox & box, bool fullResolution) const
+	{
+		float bounds[4];
+		float nearest;
+		if (!projectBox(box, bounds, nearest))
+		{
+			return true;
+		}
+		float minX = bounds[0], minY = bounds[1], maxX = bounds[2], maxY = bounds[3];
+		// from normalized device coordinates to pixels and window depth, once for the rectangle
+		minX = (minX * 0.5f + 0.5f) * width;
+		maxX = (maxX * 0.5f + 0.5f) * width;
+		minY = (minY * 0.5f + 0.5f) * height;
+		maxY = (maxY * 0.5f + 0.5f) * height;
+		nearest = nearest * 0.5f + 0.5f;
+		if (maxX < 0.0f || maxY < 0.0f || minX >= (float)width || minY >= (float)height)
+		{
+			return true;
+		}
+
+		int x0 = std::max((int)std::floor(minX), 0);
+		int x1 = std::min((int)std::floor(maxX), (int)width - 1);
+		int y0 = std::max((int)std::floor(minY), 0);
+		int y1 = std::min((int)std::floor(maxY), (int)height - 1);
+
+		// the finest level where the rectangle spans at most three texels each way
+		unsigned int level = 0;
+		while (!fullResolution && level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 2 || (y1 >> level) - (y0 >> level) > 2))
+		{
+			level++;
+		}
+
+		const Level & hiZ = levels[level];
+		for (int y = y0 >> level; y <= (y1 >> level); y++)
+		{
+			for (int x = x0 >> level; x <= (x1 >> level); x++)
+			{
+				unsigned int texel = std::min((unsigned int)y, hiZ.height - 1) * hiZ.width + std::min((unsigned int)x, hiZ.width - 1);
+				if (hiZ.depth[texel] >= nearest)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#endif
+
+// Resident memory of the process, e.g. to see what a loader leaves behind and how high it peaked.
+class ProcessMemory
+{
+public:
+	struct Usage
+	{
+		// bytes in RAM now and the most there ever were
+		unsigned long long resident;
+		unsigned long long peakResident;
+	};
+
+	// Zeros where the platform does not tell.
+	static Usage current()
+	{
+		Usage usage = { 0, 0 };
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		{
+			usage.resident = counters.WorkingSetSize;
+			usage.peakResident = counters.PeakWorkingSetSize;
+		}
+#else
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, 6, "VmRSS:") == 0)
+			{
+				usage.resident = std::stoull(line.substr(6)) * 1024;
+			}
+			else if (line.compare(0, 6, "VmHWM:") == 0)
+			{
+				usage.peakResident = std::stoull(line.substr(6)) * 1024;
+			}
+		}
+#endif
+		return usage;
+	}
+
+	static void print(const std::string & what)
+	{
+		Usage usage = current();
+		std::cout << "memory " << what << ": " << usage.resident / (1024.0 * 1024.0) << " MB resident, peak "
+			<< usage.peakResident / (1024.0 * 1024.0) << " MB" << std::endl;
+	}
+};
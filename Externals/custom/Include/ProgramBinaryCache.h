@@ -0,0 +1,156 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Persists linked programs with glGetProgramBinary so the next start can skip compiling and linking.
+// Entries are keyed by a hash of the final shader sources plus the GL vendor/renderer/version strings,
+// so a driver update or an edited shader simply misses instead of feeding a stale binary to the driver.
+class ProgramBinaryCache
+{
+public:
+	// Directory the binaries are written to, relative to the working directory, which Visual Studio
+	// sets to the project directory. Set it to an empty string to disable the cache.
+	static std::string & directory()
+	{
+		static std::string dir = "shader_cache";
+		return dir;
+	}
+
+	static bool supported()
+	{
+		if (directory().empty() || glGetProgramBinary == NULL || glProgramBinary == NULL)
+		{
+			return false;
+		}
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}
+
+	static std::string key(const std::vector<std::string> & sources)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		for (const std::string & source : sources)
+		{
+			hash = fnv1a(hash, source.data(), source.size());
+			hash = fnv1a(hash, "\0", 1);
+		}
+		const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (GLenum name : driverStrings)
+		{
+			const char* value = (const char*)glGetString(name);
+			if (value != NULL)
+			{
+				hash = fnv1a(hash, value, std::char_traits<char>::length(value));
+			}
+		}
+
+		char text[17];
+		std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+		return std::string(text);
+	}
+
+	// Loads the cached binary for key into program. Returns false when there is no entry or when the
+	// driver rejects it; the caller then compiles from source and calls store().
+	static bool load(GLuint program, const std::string & key)
+	{
+		std::ifstream file(path(key), std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+
+		uint32_t header[2] = { 0, 0 };
+		file.read((char*)header, sizeof(header));
+		if (!file || header[0] != MAGIC)
+		{
+			return false;
+		}
+
+		std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (binary.empty())
+		{
+			return false;
+		}
+
+		glProgramBinary(program, (GLenum)header[1], binary.data(), (GLsizei)binary.size());
+
+		GLint success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			std::cout << "program binary " << key << " was rejected by the driver, recompiling" << std::endl;
+			std::remove(path(key).c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// Writes the binary of a successfully linked program. The program must have been linked with
+	// GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+	static void store(GLuint program, const std::string & key)
+	{
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+		{
+			return;
+		}
+
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, NULL, &format, binary.data());
+
+		makeDirectory(directory());
+		std::ofstream file(path(key), std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			std::cout << "ERROR::PROGRAM_BINARY_CACHE::CANNOT_WRITE " << path(key) << std::endl;
+			return;
+		}
+		uint32_t header[2] = { MAGIC, (uint32_t)format };
+		file.write((const char*)header, sizeof(header));
+		file.write(binary.data(), binary.size());
+	}
+
+	// The file the binary for key is stored in.
+	static std::string path(const std::string & key)
+	{
+		return directory() + "/" + key + ".bin";
+	}
+
+private:
+	static const uint32_t MAGIC = 0x42504c47; // "GLPB"
+
+	static uint64_t fnv1a(uint64_t hash, const char* data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= (unsigned char)data[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	static void makeDirectory(const std::string & dir)
+	{
+#ifdef _WIN32
+		_mkdir(dir.c_str());
+#else
+		mkdir(dir.c_str(), 0755);
+#endif
+	}
+};
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <glm.hpp>
+
+#include <Shader.h>
+#include <mesh.h>
+#include <Frustum.h>
+#include <GLStateCache.h>
+
+// One draw in a RenderQueue. mesh provides the material and the VAO and, unless arena is set, the
+// indices of level lod. A packed model draws commandCount commands of arena from firstCommand
+// instead. With clusterView >= 0 the mesh is drawn meshlet by meshlet, culled against that view.
+// The transforms are uploaded to transformUniform as one array, instanceCount copies are drawn.
+struct DrawPacket
+{
+	Shader* shader;
+	Mesh* mesh;
+	MeshArena* arena;
+	unsigned int firstCommand;
+	unsigned int commandCount;
+	unsigned int lod;
+	int clusterView;
+	Uniform<glm::mat4> transformUniform;
+	unsigned int firstTransform;
+	unsigned int instanceCount;
+};
+
+// Collects the draws of a frame, sorts them by a 64-bit key and submits them with as few state
+// changes as the order allows. From the top, an opaque key holds the pass (4 bits), the shader
+// (8 bits), the material (16 bits), the depth bucket (16 bits) and the VAO (20 bits), so draws
+// group by shader and material and run front to back within one. Passes marked blended move the
+// depth up behind the pass, inverted, so they run back to front whatever their state. The key
+// only orders the draws, submit() still compares the real program, material and VAO before
+// binding. Everything is reused from frame to frame, a steady frame does not allocate.
+class RenderQueue
+{
+public:
+	// Per-frame counts of what submit() did.
+	struct Stats
+	{
+		unsigned int packets;
+		unsigned int drawCalls;
+		unsigned int shaderChanges;
+		unsigned int materialChanges;
+		unsigned int vertexArrayChanges;
+		unsigned int transformUploads;
+		unsigned long long triangles;
+
+		unsigned int stateChanges() const
+		{
+			return shaderChanges + materialChanges + vertexArrayChanges;
+		}
+	};
+
+	static const unsigned int MAX_PASSES = 16;
+
+	RenderQueue() : nearDepth(0.1f), farDepth(100.0f), blendedPasses(0)
+	{
+		resetStats();
+	}
+
+	// The view distances the depth buckets span, closer and farther draws share the first and last bucket.
+	void setDepthRange(float nearPlane, float farPlane)
+	{
+		nearDepth = nearPlane;
+		farDepth = std::max(farPlane, nearPlane + 1e-4f);
+	}
+
+	// Draws of a blended pass are sorted back to front instead of by state.
+	void setBlended(unsigned int pass, bool blended)
+	{
+		if (blended)
+		{
+			blendedPasses |= 1u << pass;
+		}
+		else
+		{
+			blendedPasses &= ~(1u << pass);
+		}
+	}
+
+	// Starts a new frame. The storage of the last one is kept.
+	void clear()
+	{
+		packets.clear();
+		entries.clear();
+		transforms.clear();
+		clusterViews.clear();
+	}
+
+	// Copies count transforms into the frame and returns the index of the first, for DrawPacket::firstTransform.
+	unsigned int addTransforms(const glm::mat4* values, unsigned int count)
+	{
+		unsigned int first = (unsigned int)transforms.size();
+		transforms.insert(transforms.end(), values, values + count);
+		return first;
+	}
+
+	// Stores a frustum and camera position, both in model space, for DrawPacket::clusterView.
+	int addClusterView(const Frustum & frustum, const glm::vec3 & camera)
+	{
+		ClusterView view = { frustum, camera };
+		clusterViews.push_back(view);
+		return (int)clusterViews.size() - 1;
+	}
+
+	// Queues packet in pass. depth is its distance from the camera, e.g. of its nearest instance.
+	void add(const DrawPacket & packet, unsigned int pass, float depth)
+	{
+		SortEntry entry;
+		entry.key = key(pass, packet.shader->ID, materialKey(*packet.mesh), depth, packet.mesh->VAO);
+		entry.packet = (uint32_t)packets.size();
+		entries.push_back(entry);
+		packets.push_back(packet);
+	}
+
+	uint64_t key(unsigned int pass, unsigned int program, unsigned int material, float depth, unsigned int vertexArray) const
+	{
+		float unit = glm::clamp((depth - nearDepth) / (farDepth - nearDepth), 0.0f, 1.0f);
+		uint64_t bucket = (uint64_t)(unit * 65535.0f);
+		uint64_t passBits = (uint64_t)(pass & (MAX_PASSES - 1)) << 60;
+		uint64_t stateBits = ((uint64_t)(program & 0xFF) << 16) | (material & 0xFFFF);
+		uint64_t vertexArrayBits = vertexArray & 0xFFFFF;
+		if (blendedPasses & (1u << pass))
+		{
+			return passBits | ((65535 - bucket) << 44) | (stateBits << 20) | vertexArrayBits;
+		}
+		return passBits | (stateBits << 36) | (bucket << 20) | vertexArrayBits;
+	}
+
+	// Orders the queued packets by key with an LSD radix sort, one byte per pass. Bytes that are the
+	// same in every key are skipped, and equal keys keep the order they were added in.
+	void sort()
+	{
+		size_t count = entries.size();
+		if (count < 2)
+		{
+			return;
+		}
+		scratch.resize(count);
+
+		memset(histograms, 0, sizeof(histograms));
+		for (const SortEntry & entry : entries)
+		{
+			for (unsigned int digit = 0; digit < 8; digit++)
+			{
+				histograms[digit][(entry.key >> (digit * 8)) & 0xFF]++;
+			}
+		}
+
+		SortEntry* from = entries.data();
+		SortEntry* to = scratch.data();
+		for (unsigned int digit = 0; digit < 8; digit++)
+		{
+			uint32_t* histogram = histograms[digit];
+			if (histogram[(from[0].key >> (digit * 8)) & 0xFF] == count)
+			{
+				continue;
+			}
+
+			uint32_t offset = 0;
+			for (unsigned int value = 0; value < 256; value++)
+			{
+				uint32_t size = histogram[value];
+				histogram[value] = offset;
+				offset += size;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				to[histogram[(from[i].key >> (digit * 8)) & 0xFF]++] = from[i];
+			}
+			std::swap(from, to);
+		}
+		if (from != entries.data())
+		{
+			entries.swap(scratch);
+		}
+	}
+
+	// Draws the packets in key order. The program, the material and the transforms are only set when
+	// they differ from the previous packet's. Fills stats().
+	void submit()
+	{
+		resetStats();
+		frameStats.packets = (unsigned int)entries.size();
+
+		unsigned int program = 0;
+		unsigned int vertexArray = 0;
+		Mesh* material = nullptr;
+		GLint transformLocation = -1;
+		unsigned int firstTransform = 0;
+		unsigned int transformCount = 0;
+		for (const SortEntry & entry : entries)
+		{
+			DrawPacket & packet = packets[entry.packet];
+			Mesh & mesh = *packet.mesh;
+
+			// culled first, so a mesh with no visible meshlet changes no state
+			unsigned long long triangles = 0;
+			if (packet.clusterView >= 0)
+			{
+				const ClusterView & view = clusterViews[packet.clusterView];
+				triangles = mesh.cullClusters(view.frustum, view.camera);
+				if (triangles == 0)
+				{
+					continue;
+				}
+			}
+
+			if (packet.shader->ID != program)
+			{
+				packet.shader->use();
+				program = packet.shader->ID;
+				// samplers and uniforms are per program
+				material = nullptr;
+				transformLocation = -1;
+				frameStats.shaderChanges++;
+			}
+			if (material == nullptr || (material != &mesh && !material->sameMaterial(mesh)))
+			{
+				mesh.bindMaterial(*packet.shader);
+				material = &mesh;
+				frameStats.materialChanges++;
+			}
+			if (mesh.VAO != vertexArray)
+			{
+				vertexArray = mesh.VAO;
+				frameStats.vertexArrayChanges++;
+			}
+			if (packet.transformUniform.location != transformLocation || packet.firstTransform != firstTransform || packet.instanceCount != transformCount)
+			{
+				packet.transformUniform.set(transforms.data() + packet.firstTransform, (GLsizei)packet.instanceCount);
+				transformLocation = packet.transformUniform.location;
+				firstTransform = packet.firstTransform;
+				transformCount = packet.instanceCount;
+				frameStats.transformUploads++;
+			}
+
+			if (packet.clusterView >= 0)
+			{
+				mesh.drawClusters();
+				frameStats.drawCalls++;
+			}
+			else if (packet.arena != nullptr)
+			{
+				packet.arena->draw(packet.firstCommand, packet.commandCount, packet.instanceCount);
+				triangles = packet.arena->indexCount(packet.firstCommand, packet.commandCount) / 3 * packet.instanceCount;
+				frameStats.drawCalls += packet.arena->drawCalls(packet.commandCount);
+			}
+			else
+			{
+				mesh.drawGeometry(packet.instanceCount, packet.lod);
+				triangles = mesh.lod(packet.lod).indexCount / 3 * packet.instanceCount;
+				frameStats.drawCalls++;
+			}
+			frameStats.triangles += triangles;
+		}
+		GLStateCache::activeTexture(GL_TEXTURE0);
+	}
+
+	// What the last submit() did.
+	const Stats & stats() const
+	{
+		return frameStats;
+	}
+
+private:
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t packet;
+	};
+
+	struct ClusterView
+	{
+		Frustum frustum;
+		glm::vec3 camera;
+	};
+
+	float nearDepth;
+	float farDepth;
+	unsigned int blendedPasses;
+
+	std::vector<DrawPacket> packets;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+	std::vector<glm::mat4> transforms;
+	std::vector<ClusterView> clusterViews;
+	uint32_t histograms[8][256];
+	Stats frameStats;
+
+	void resetStats()
+	{
+		memset(&frameStats, 0, sizeof(frameStats));
+	}
+
+	// 16 bits that are equal for meshes with the same material and usually differ otherwise.
+	static unsigned int materialKey(const Mesh & mesh)
+	{
+		uint32_t hash = 2166136261u;
+		for (const Texture & texture : mesh.textures)
+		{
+			hash = (hash ^ texture.id) * 16777619u;
+		}
+		const float parts[6] = { mesh.layout.positionOffset.x, mesh.layout.positionOffset.y, mesh.layout.positionOffset.z,
+			mesh.layout.positionScale.x, mesh.layout.positionScale.y, mesh.layout.positionScale.z };
+		for (float part : parts)
+		{
+			uint32_t bits;
+			memcpy(&bits, &part, sizeof(bits));
+			hash = (hash ^ bits) * 16777619u;
+		}
+		return (hash ^ (hash >> 16)) & 0xFFFF;
+	}
+};
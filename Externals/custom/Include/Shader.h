@@ -6,145 +6,662 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <future>
+
+#include <ProgramBinaryCache.h>
+#include <ShaderPreprocessor.h>
+#include <GLExtensions.h>
+#include <FileWatcher.h>
 
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 #include <gtc/type_ptr.hpp>
 
+// Uploads used by Uniform<T>. They act on the currently bound program, like the Shader::set* helpers.
+inline void uploadUniform(GLint location, bool value) { glUniform1i(location, (int)value); }
+inline void uploadUniform(GLint location, int value) { glUniform1i(location, value); }
+inline void uploadUniform(GLint location, float value) { glUniform1f(location, value); }
+inline void uploadUniform(GLint location, const glm::vec2 & value) { glUniform2fv(location, 1, &value[0]); }
+inline void uploadUniform(GLint location, const glm::vec3 & value) { glUniform3fv(location, 1, &value[0]); }
+inline void uploadUniform(GLint location, const glm::vec4 & value) { glUniform4fv(location, 1, &value[0]); }
+inline void uploadUniform(GLint location, const glm::mat3 & value) { glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+inline void uploadUniform(GLint location, const glm::mat4 & value) { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+
+inline void uploadUniform(GLint location, const int* values, GLsizei count) { glUniform1iv(location, count, values); }
+inline void uploadUniform(GLint location, const float* values, GLsizei count) { glUniform1fv(location, count, values); }
+inline void uploadUniform(GLint location, const glm::vec3* values, GLsizei count) { glUniform3fv(location, count, glm::value_ptr(values[0])); }
+inline void uploadUniform(GLint location, const glm::vec4* values, GLsizei count) { glUniform4fv(location, count, glm::value_ptr(values[0])); }
+inline void uploadUniform(GLint location, const glm::mat4* values, GLsizei count) { glUniformMatrix4fv(location, count, GL_FALSE, glm::value_ptr(values[0])); }
+
+// A uniform location resolved once through Shader::uniform(). Keep it next to the shader and
+// set it every frame without any string building or glGetUniformLocation call.
+template <typename T>
+class Uniform {
+public:
+	GLint location;
+
+	Uniform(GLint location = -1) : location(location) {}
+
+	bool valid() const { return location >= 0; }
+
+	void set(const T & value) const
+	{
+		uploadUniform(location, value);
+	}
+
+	// Uploads count consecutive elements of a uniform array starting at this element.
+	void set(const T* values, GLsizei count) const
+	{
+		uploadUniform(location, values, count);
+	}
+};
+
+// How a Shader is built. Immediate compiles and links inside the constructor. Async reads and
+// preprocesses the source files on a worker thread right away, issues the compile and link calls on
+// submit() and only asks the driver for the result the first time the program is used.
+enum class ShaderBuild
+{
+	Immediate,
+	Async
+};
+
+struct ShaderSources
+{
+	std::string vertex;
+	std::string fragment;
+	std::string geometry;
+	// every file that was read, includes too, for hot reload
+	std::vector<std::string> files;
+};
+
+// A program built from GLSL files, with a uniform location table, the program binary cache and hot
+// reload. Hot reload never waits on the disk, and with GL_KHR_parallel_shader_compile never on the
+// driver either. Without the extension the link cannot be polled: its status is queried a few frames
+// after the link was issued, which stalls the frame thread for whatever is left of the link. Hiding
+// that too would take a second context shared with the window's on a worker thread, which the samples
+// do not create, so on such drivers an edit costs one hitch of about the link time.
 class Shader {
 public:
 	unsigned int ID;
 
-	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const GLchar* geometryPath = nullptr)
+	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const GLchar* geometryPath = nullptr, const ShaderDefines & defines = ShaderDefines(), ShaderBuild build = ShaderBuild::Immediate)
+		: state(State::Loading), vertexShader(0), fragmentShader(0), geometryShader(0), storeBinary(false),
+		vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath != nullptr ? geometryPath : ""), defines(defines),
+		reloadState(ReloadState::Idle), reloadProgram(0), reloadFrames(0), programGeneration(0)
 	{
         // debug info
         std::cout << vertexPath << std::endl;
         std::cout << fragmentPath << std::endl;
         // debug info end
 
-		std::string vertexCode;
-		std::string fragmentCode;
-        std::string geometryCode;
+		buildStart = std::chrono::steady_clock::now();
+		ID = glCreateProgram();
+
+		std::launch policy = build == ShaderBuild::Async ? std::launch::async : std::launch::deferred;
+		pendingSources = std::async(policy, loadSources, this->vertexPath, this->fragmentPath, this->geometryPath, defines);
+
+		if (build == ShaderBuild::Immediate)
+		{
+			finish();
+		}
+	}
 
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
+	~Shader()
+	{
+		if (sourcesChanged)
+		{
+			FileWatcher::instance().unwatch(sourcesChanged);
+		}
+	}
 
-		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	// Issues the compile and link calls. Waits for the source files if the worker thread is still
+	// reading them, but never for the driver. Call it on every async shader right after creating them
+	// so the driver can work on all programs at once. Does nothing once the program was submitted.
+	void submit()
+	{
+		if (state != State::Loading)
+		{
+			return;
+		}
 
+		ShaderSources sources;
 		try {
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
+			sources = pendingSources.get();
+		}
+		catch (const std::ifstream::failure & e)
+		{
+            std::cout << "SYSTEM IO OUT: " << e.code() << std::endl;
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULL_READ" << std::endl;
+		}
+		sourceFiles = sources.files;
+		submitProgram(sources);
+	}
 
-			std::stringstream vShaderSteam, fShaderSteam;
-			
-			vShaderSteam << vShaderFile.rdbuf();
-			fShaderSteam << fShaderFile.rdbuf();
+	// True when finish() will not have to wait for the driver. Only drivers exposing
+	// GL_KHR_parallel_shader_compile can answer this before the program is finished.
+	bool ready() const
+	{
+		if (state == State::Ready)
+		{
+			return true;
+		}
+		if (state == State::Loading || !parallelCompileSupported())
+		{
+			return false;
+		}
+		GLint completed = GL_FALSE;
+		glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+		return completed == GL_TRUE;
+	}
 
-			vShaderFile.close();
-			fShaderFile.close();
+	// Waits for the program to be linked, reports errors and builds the uniform table. Called on the
+	// first use() or uniform lookup, so async shaders never have to call it explicitly.
+	void finish() const
+	{
+		if (state == State::Ready)
+		{
+			return;
+		}
+		const_cast<Shader*>(this)->submit();
+		if (state != State::Ready)
+		{
+			finishProgram();
+		}
+	}
 
-			vertexCode = vShaderSteam.str();
-			fragmentCode = fShaderSteam.str();
+	void use() {
+		finish();
+		glUseProgram(ID);
+	}
 
-            if (geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
+	// Location of an active uniform, taken from the table built at link time. Returns -1 for
+	// unknown names, which glUniform* silently ignores just like a failed glGetUniformLocation.
+	GLint location(const std::string & name) const
+	{
+		finish();
+		std::unordered_map<std::string, GLint>::const_iterator it = uniformLocations.find(name);
+		return it != uniformLocations.end() ? it->second : -1;
+	}
 
+	// Starts watching the source files, includes too. Edits are then picked up by updateHotReload().
+	// Only submits the program, so async shaders still do not wait for the driver here.
+	void enableHotReload()
+	{
+		submit();
+		if (!sourcesChanged)
+		{
+			sourcesChanged = std::make_shared<std::atomic<bool>>(false);
 		}
-		catch (std::ifstream::failure e)
+		FileWatcher::instance().watch(sourceFiles, sourcesChanged);
+	}
+
+	// Call once per frame, before use(). After a watched file changed it rebuilds the program in steps
+	// that never wait on the disk and, with GL_KHR_parallel_shader_compile, never on the driver either.
+	// Without the extension the driver cannot be asked whether the link is done: the status is then
+	// queried a few frames after the link was issued, which only hides the wait when the driver links
+	// on its own thread and otherwise stalls that frame. ID only changes after the new program linked
+	// successfully; on errors the log is printed and the old program keeps running. Uniform values are
+	// carried over, so samplers set once at startup survive. Returns true when the program was
+	// replaced: locations may have moved, so re-resolve any Uniform handles then.
+	bool updateHotReload()
+	{
+		if (!sourcesChanged)
 		{
-            std::cout << "SYSTEM IO OUT: " << e.code() << std::endl;
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULL_READ" << std::endl;
+			return false;
 		}
 
-		const char* vShaderCode = vertexCode.c_str();
-		const char* fShaderCode = fragmentCode.c_str();
+		if (reloadState == ReloadState::Idle)
+		{
+			if (!sourcesChanged->exchange(false))
+			{
+				return false;
+			}
+			reloadSources = std::async(std::launch::async, loadSources, vertexPath, fragmentPath, geometryPath, defines);
+			reloadState = ReloadState::Loading;
+			return false;
+		}
 
-		unsigned int vertex, fragment;
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
-		checkCompileErrors(vertex, "VERTEX");
+		if (reloadState == ReloadState::Loading)
+		{
+			if (reloadSources.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				return false;
+			}
+			ShaderSources sources;
+			try {
+				sources = reloadSources.get();
+			}
+			catch (const std::ifstream::failure &)
+			{
+				// editors may still be writing the file, the next change event retries
+				std::cout << "ERROR::SHADER::HOT_RELOAD_READ_FAILED " << vertexPath << ", keeping program " << ID << std::endl;
+				reloadState = ReloadState::Idle;
+				return false;
+			}
+			sourceFiles = sources.files;
+			FileWatcher::instance().watch(sourceFiles, sourcesChanged);
 
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
-		checkCompileErrors(fragment, "FRAGMENT");
+			reloadStart = std::chrono::steady_clock::now();
+			reloadProgram = glCreateProgram();
+			reloadShaders[0] = compileShader(GL_VERTEX_SHADER, sources.vertex);
+			reloadShaders[1] = compileShader(GL_FRAGMENT_SHADER, sources.fragment);
+			reloadShaders[2] = sources.geometry.empty() ? 0 : compileShader(GL_GEOMETRY_SHADER, sources.geometry);
+			for (unsigned int shader : reloadShaders)
+			{
+				if (shader != 0)
+				{
+					glAttachShader(reloadProgram, shader);
+				}
+			}
+			glLinkProgram(reloadProgram);
+			reloadState = ReloadState::Linking;
+			reloadFrames = 0;
+			if (!parallelCompileSupported())
+			{
+				static bool reported = false;
+				if (!reported)
+				{
+					std::cout << "GL_KHR_parallel_shader_compile is not supported, hot reload waits for the driver on the frame thread" << std::endl;
+					reported = true;
+				}
+			}
+			return false;
+		}
 
-        unsigned int geometry;
-        if (geometryPath != nullptr)
-        {
-            const char* gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
+		if (parallelCompileSupported())
+		{
+			GLint completed = GL_FALSE;
+			glGetProgramiv(reloadProgram, GL_COMPLETION_STATUS_KHR, &completed);
+			if (completed != GL_TRUE)
+			{
+				return false;
+			}
+		}
+		else if (++reloadFrames < RELOAD_STATUS_DELAY)
+		{
+			return false;
+		}
 
-		ID = glCreateProgram();
-		glAttachShader(ID, vertex);
-		glAttachShader(ID, fragment);
-        if (geometryPath != nullptr)
-        {
-            glAttachShader(ID, geometry);
-        }
-		glLinkProgram(ID);
-		checkCompileErrors(ID, "PROGRAM");
+		const char* stageNames[] = { "VERTEX", "FRAGMENT", "GEOMETRY" };
+		for (int stage = 0; stage < 3; stage++)
+		{
+			if (reloadShaders[stage] != 0)
+			{
+				checkCompileErrors(reloadShaders[stage], stageNames[stage]);
+				glDeleteShader(reloadShaders[stage]);
+			}
+		}
+		reloadState = ReloadState::Idle;
 
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
-        if (geometryPath != NULL)
-        {
-            glDeleteShader(geometry);
-        }
-		
+		if (!checkCompileErrors(reloadProgram, "PROGRAM"))
+		{
+			std::cout << "hot reload of " << fragmentPath << " failed, keeping program " << ID << std::endl;
+			glDeleteProgram(reloadProgram);
+			reloadProgram = 0;
+			return false;
+		}
+
+		copyUniformValues(ID, reloadProgram);
+		// the old program may still be bound, GL then deletes it once it is unbound
+		glDeleteProgram(ID);
+		ID = reloadProgram;
+		reloadProgram = 0;
+		reflectUniforms();
+		programGeneration++;
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - reloadStart;
+		std::cout << "program " << ID << " reloaded from " << fragmentPath << " in " << elapsed.count() << " ms" << std::endl;
+		return true;
 	}
 
-	void use() {
-		glUseProgram(ID);
+	// Incremented every time hot reload replaces the program.
+	unsigned int generation() const
+	{
+		return programGeneration;
+	}
+
+	template <typename T>
+	Uniform<T> uniform(const std::string & name) const
+	{
+		return Uniform<T>(location(name));
+	}
+
+	// Resolves name[0] .. name[count - 1], or name[i].member when member is given, e.g.
+	// uniformArray<glm::vec3>("lights", NR_LIGHTS, "Position").
+	template <typename T>
+	std::vector<Uniform<T>> uniformArray(const std::string & name, unsigned int count, const std::string & member = "") const
+	{
+		std::vector<Uniform<T>> handles;
+		handles.reserve(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			std::string element = name + "[" + std::to_string(i) + "]";
+			if (!member.empty())
+			{
+				element += "." + member;
+			}
+			handles.push_back(Uniform<T>(location(element)));
+		}
+		return handles;
 	}
 
 	void setBool(const std::string &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(location(name), (int)value);
 	}
 	void setInt(const std::string &name, int value) const 
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(location(name), value);
 	}
 	void setFloat(const std::string &name, float value) const 
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(location(name), value);
 	}
 	void setVector(const std::string &name, float r, float g, float b, float a) const 
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), r, g, b, a);
+		glUniform4f(location(name), r, g, b, a);
 	}
-	void setVec3(const std::string &name, glm::vec3 & value) const
+	void setVec3(const std::string &name, const glm::vec3 & value) const
 	{
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(location(name), 1, &value[0]);
 	}
 	void setMat4(const std::string &name, glm::mat4 value) const {
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+		glUniformMatrix4fv(location(name), 1, GL_FALSE, glm::value_ptr(value));
 	}
 
 private:
-	void checkCompileErrors(GLuint shader, std::string type)
+	enum class State
+	{
+		Loading,
+		Linking,
+		Ready
+	};
+
+	mutable State state;
+	std::future<ShaderSources> pendingSources;
+	mutable unsigned int vertexShader;
+	mutable unsigned int fragmentShader;
+	mutable unsigned int geometryShader;
+	mutable bool storeBinary;
+	std::string cacheKey;
+	std::chrono::steady_clock::time_point buildStart;
+
+	mutable std::unordered_map<std::string, GLint> uniformLocations;
+
+	enum class ReloadState
+	{
+		Idle,
+		Loading,
+		Linking
+	};
+
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::string geometryPath;
+	ShaderDefines defines;
+	std::vector<std::string> sourceFiles;
+	std::shared_ptr<std::atomic<bool>> sourcesChanged;
+	ReloadState reloadState;
+	std::future<ShaderSources> reloadSources;
+	unsigned int reloadProgram;
+	unsigned int reloadShaders[3];
+	unsigned int reloadFrames;
+	unsigned int programGeneration;
+	std::chrono::steady_clock::time_point reloadStart;
+
+	// frames between a reload's link and its status query without GL_KHR_parallel_shader_compile
+	static const unsigned int RELOAD_STATUS_DELAY = 3;
+
+	static ShaderSources loadSources(std::string vertexPath, std::string fragmentPath, std::string geometryPath, ShaderDefines defines)
+	{
+		ShaderSources sources;
+		std::vector<std::string> files;
+		sources.vertex = ShaderPreprocessor::load(vertexPath, defines, &files);
+		sources.files.insert(sources.files.end(), files.begin(), files.end());
+		sources.fragment = ShaderPreprocessor::load(fragmentPath, defines, &files);
+		sources.files.insert(sources.files.end(), files.begin(), files.end());
+		if (!geometryPath.empty())
+		{
+			sources.geometry = ShaderPreprocessor::load(geometryPath, defines, &files);
+			sources.files.insert(sources.files.end(), files.begin(), files.end());
+		}
+		return sources;
+	}
+
+	static bool parallelCompileSupported()
+	{
+		static bool supported = hasGLExtension("GL_KHR_parallel_shader_compile") || hasGLExtension("GL_ARB_parallel_shader_compile");
+		return supported;
+	}
+
+	// Fills the location table from the linked program. Array uniforms are also registered
+	// without the "[0]" suffix and once per element, so "gBones" and "gBones[7]" both resolve.
+	void reflectUniforms() const
+	{
+		uniformLocations.clear();
+
+		GLint count = 0;
+		GLint maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+		std::vector<GLchar> nameBuffer(maxLength > 0 ? maxLength : 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+
+			std::string name(nameBuffer.data(), length);
+			GLint location = glGetUniformLocation(ID, name.c_str());
+			if (location < 0)
+			{
+				// members of uniform blocks have no location
+				continue;
+			}
+			uniformLocations[name] = location;
+
+			if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+			{
+				std::string base = name.substr(0, name.size() - 3);
+				uniformLocations[base] = location;
+				for (GLint element = 1; element < size; element++)
+				{
+					std::string elementName = base + "[" + std::to_string(element) + "]";
+					uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+				}
+			}
+		}
+	}
+
+	// Restores the program from the program binary cache when the same sources were linked by the
+	// same driver before, otherwise compiles and links it without querying any status.
+	void submitProgram(const ShaderSources & sources)
+	{
+		bool useBinaryCache = ProgramBinaryCache::supported();
+		if (useBinaryCache)
+		{
+			cacheKey = ProgramBinaryCache::key({ sources.vertex, sources.fragment, sources.geometry });
+			if (ProgramBinaryCache::load(ID, cacheKey))
+			{
+				reflectUniforms();
+				state = State::Ready;
+				printBuildTime("loaded from program binary cache");
+				return;
+			}
+			// glProgramBinary may have left the program in a failed state, start over with a fresh object
+			glDeleteProgram(ID);
+			ID = glCreateProgram();
+		}
+
+		vertexShader = compileShader(GL_VERTEX_SHADER, sources.vertex);
+		fragmentShader = compileShader(GL_FRAGMENT_SHADER, sources.fragment);
+		if (!sources.geometry.empty())
+		{
+			geometryShader = compileShader(GL_GEOMETRY_SHADER, sources.geometry);
+		}
+
+		glAttachShader(ID, vertexShader);
+		glAttachShader(ID, fragmentShader);
+		if (geometryShader != 0)
+		{
+			glAttachShader(ID, geometryShader);
+		}
+		if (useBinaryCache)
+		{
+			glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+		glLinkProgram(ID);
+
+		storeBinary = useBinaryCache;
+		state = State::Linking;
+	}
+
+	static unsigned int compileShader(GLenum type, const std::string & code)
+	{
+		const char* shaderCode = code.c_str();
+		unsigned int shader = glCreateShader(type);
+		glShaderSource(shader, 1, &shaderCode, NULL);
+		glCompileShader(shader);
+		return shader;
+	}
+
+	void finishProgram() const
+	{
+		checkCompileErrors(vertexShader, "VERTEX");
+		checkCompileErrors(fragmentShader, "FRAGMENT");
+		if (geometryShader != 0)
+		{
+			checkCompileErrors(geometryShader, "GEOMETRY");
+		}
+		bool linked = checkCompileErrors(ID, "PROGRAM");
+		reflectUniforms();
+
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		if (geometryShader != 0)
+		{
+			glDeleteShader(geometryShader);
+		}
+		vertexShader = fragmentShader = geometryShader = 0;
+
+		if (linked && storeBinary)
+		{
+			ProgramBinaryCache::store(ID, cacheKey);
+		}
+		state = State::Ready;
+		printBuildTime("compiled");
+	}
+
+	// Copies the current value of every uniform the two programs share, so a reloaded program starts
+	// out with the sampler units and constants the old one was given. Uniforms whose type changed keep
+	// their defaults.
+	static void copyUniformValues(GLuint from, GLuint to)
+	{
+		std::unordered_map<std::string, GLenum> targetTypes;
+		GLint count = 0;
+		GLint maxLength = 0;
+		glGetProgramiv(to, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(to, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<GLchar> nameBuffer(maxLength > 0 ? maxLength : 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(to, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+			targetTypes[std::string(nameBuffer.data(), length)] = type;
+		}
+
+		GLint previous = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+		glUseProgram(to);
+
+		glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(from, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		nameBuffer.resize(maxLength > 0 ? maxLength : 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(from, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+			std::string name(nameBuffer.data(), length);
+
+			std::unordered_map<std::string, GLenum>::const_iterator target = targetTypes.find(name);
+			if (target == targetTypes.end() || target->second != type)
+			{
+				continue;
+			}
+
+			bool isArray = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0;
+			std::string base = isArray ? name.substr(0, name.size() - 3) : name;
+			for (GLint element = 0; element < size; element++)
+			{
+				std::string elementName = isArray ? base + "[" + std::to_string(element) + "]" : name;
+				GLint source = glGetUniformLocation(from, elementName.c_str());
+				GLint destination = glGetUniformLocation(to, elementName.c_str());
+				if (source >= 0 && destination >= 0)
+				{
+					copyUniformValue(from, source, destination, type);
+				}
+			}
+		}
+
+		glUseProgram((GLuint)previous);
+	}
+
+	static void copyUniformValue(GLuint from, GLint source, GLint destination, GLenum type)
+	{
+		GLfloat floats[16];
+		GLint ints[4];
+		switch (type)
+		{
+		case GL_FLOAT: glGetUniformfv(from, source, floats); glUniform1fv(destination, 1, floats); break;
+		case GL_FLOAT_VEC2: glGetUniformfv(from, source, floats); glUniform2fv(destination, 1, floats); break;
+		case GL_FLOAT_VEC3: glGetUniformfv(from, source, floats); glUniform3fv(destination, 1, floats); break;
+		case GL_FLOAT_VEC4: glGetUniformfv(from, source, floats); glUniform4fv(destination, 1, floats); break;
+		case GL_FLOAT_MAT2: glGetUniformfv(from, source, floats); glUniformMatrix2fv(destination, 1, GL_FALSE, floats); break;
+		case GL_FLOAT_MAT3: glGetUniformfv(from, source, floats); glUniformMatrix3fv(destination, 1, GL_FALSE, floats); break;
+		case GL_FLOAT_MAT4: glGetUniformfv(from, source, floats); glUniformMatrix4fv(destination, 1, GL_FALSE, floats); break;
+		case GL_INT_VEC2: glGetUniformiv(from, source, ints); glUniform2iv(destination, 1, ints); break;
+		case GL_INT_VEC3: glGetUniformiv(from, source, ints); glUniform3iv(destination, 1, ints); break;
+		case GL_INT_VEC4: glGetUniformiv(from, source, ints); glUniform4iv(destination, 1, ints); break;
+		case GL_INT:
+		case GL_BOOL:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_2D_MULTISAMPLE:
+		case GL_SAMPLER_CUBE_SHADOW:
+			glGetUniformiv(from, source, ints);
+			glUniform1iv(destination, 1, ints);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void printBuildTime(const char* how) const
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - buildStart;
+		std::cout << "program " << ID << " " << how << " in " << elapsed.count() << " ms" << std::endl;
+	}
+
+	bool checkCompileErrors(GLuint shader, std::string type) const
 	{
 		GLint success;
 		GLchar infoLog[1024];
 
 		if (type == "VERTEX" || type == "FRAGMENT"  || type == "GEOMETRY")
 		{
-			glGetProgramiv(shader, GL_COMPILE_STATUS, &success);
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 			if (!success)
 			{
 				glGetShaderInfoLog(shader, 1024, NULL, infoLog);
@@ -162,6 +679,8 @@ private:
 		}
 		else {
 			std::cout << "ERROR:PARAM_HAS_ERROR" << type << std::endl;
+			return false;
 		}
+		return success != 0;
 	}
 };
@@ -0,0 +1,476 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+
+// A compile-time define injected right after the #version line, e.g. { "HAS_NORMAL_MAP" } or { "NR_LIGHTS", "4" }.
+struct ShaderDefine
+{
+	std::string name;
+	std::string value;
+
+	ShaderDefine(const std::string & name, const std::string & value = "1") : name(name), value(value) {}
+	ShaderDefine(const char* name, const std::string & value = "1") : name(name), value(value) {}
+	ShaderDefine(const std::string & name, int value) : name(name), value(std::to_string(value)) {}
+	ShaderDefine(const char* name, int value) : name(name), value(std::to_string(value)) {}
+};
+
+typedef std::vector<ShaderDefine> ShaderDefines;
+
+// Loads GLSL sources, expands #include "file" directives and injects defines, so shared code lives in
+// one file and each permutation only pays for the branches it was compiled with.
+class ShaderPreprocessor
+{
+public:
+	// Extra directories searched for #include after the directory of the including file.
+	static std::vector<std::string> & includeDirectories()
+	{
+		static std::vector<std::string> directories;
+		return directories;
+	}
+
+	// Canonical text of a define set, independent of the order the defines were given in.
+	static std::string key(const ShaderDefines & defines)
+	{
+		std::vector<std::string> entries;
+		for (const ShaderDefine & define : defines)
+		{
+			entries.push_back(define.name + "=" + define.value);
+		}
+		std::sort(entries.begin(), entries.end());
+
+		std::string result;
+		for (const std::string & entry : entries)
+		{
+			result += entry + ";";
+		}
+		return result;
+	}
+
+	// Returns the expanded source of path. Every file in files is opened once, later #includes of the
+	// same file are dropped, which makes every included file behave as if it had #pragma once.
+	// #includes inside #if/#ifdef branches the given defines and the files' own #defines rule out are
+	// dropped too, so a variant never reads, or watches, files it does not compile. Conditions using
+	// more than defined(), !, &&, || and integer macros are left to the compiler and their includes kept.
+	// Throws std::ifstream::failure when path or one of its includes cannot be read.
+	static std::string load(const std::string & path, const ShaderDefines & defines, std::vector<std::string> * files = nullptr)
+	{
+		std::set<std::string> included;
+		std::vector<std::string> loadedFiles;
+		Conditions conditions;
+		for (const ShaderDefine & define : defines)
+		{
+			conditions.macros[define.name] = define.value;
+		}
+		std::string body = expand(path, included, loadedFiles, conditions);
+		if (files != nullptr)
+		{
+			*files = loadedFiles;
+		}
+		return injectDefines(body, defines);
+	}
+
+private:
+	enum class Truth
+	{
+		False,
+		True,
+		Unknown
+	};
+
+	// The preprocessor state of one expansion, shared by a file and its includes.
+	struct Conditions
+	{
+		// defined macros and their values
+		std::map<std::string, std::string> macros;
+		// macros #defined or #undefined in branches whose condition could not be decided
+		std::set<std::string> unknown;
+		// for every open #if, whether its current branch is taken and whether any branch so far was
+		std::vector<std::pair<Truth, Truth>> levels;
+	};
+
+	static std::string readFile(const std::string & path)
+	{
+		std::ifstream file;
+		file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		file.open(path);
+		std::stringstream stream;
+		stream << file.rdbuf();
+		return stream.str();
+	}
+
+	static bool exists(const std::string & path)
+	{
+		std::ifstream file(path);
+		return file.good();
+	}
+
+	static std::string directoryOf(const std::string & path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	static std::string resolve(const std::string & name, const std::string & includingPath)
+	{
+		std::string local = directoryOf(includingPath) + name;
+		if (exists(local))
+		{
+			return local;
+		}
+		for (const std::string & directory : includeDirectories())
+		{
+			std::string candidate = directory + "/" + name;
+			if (exists(candidate))
+			{
+				return candidate;
+			}
+		}
+		// let readFile report the failure on the path relative to the including file
+		return local;
+	}
+
+	static std::string expand(const std::string & path, std::set<std::string> & included, std::vector<std::string> & files, Conditions & conditions)
+	{
+		if (!included.insert(path).second)
+		{
+			return std::string();
+		}
+		files.push_back(path);
+
+		std::istringstream source(readFile(path));
+		std::string result;
+		std::string line;
+		bool topLevel = files.size() == 1;
+		while (std::getline(source, line))
+		{
+			size_t first = line.find_first_not_of(" \t");
+			if (first != std::string::npos && line.compare(first, 8, "#include") == 0)
+			{
+				if (active(conditions) == Truth::False)
+				{
+					continue;
+				}
+				size_t open = line.find_first_of("\"<", first + 8);
+				size_t close = open == std::string::npos ? std::string::npos : line.find_first_of("\">", open + 1);
+				if (close == std::string::npos)
+				{
+					std::cout << "ERROR::SHADER::MALFORMED_INCLUDE in " << path << ": " << line << std::endl;
+					continue;
+				}
+				result += expand(resolve(line.substr(open + 1, close - open - 1), path), included, files, conditions);
+				continue;
+			}
+			if (first != std::string::npos && line[first] == '#')
+			{
+				track(line.substr(first + 1), conditions);
+			}
+			if (!topLevel && first != std::string::npos && line.compare(first, 8, "#version") == 0)
+			{
+				// only the top level file decides the version
+				continue;
+			}
+			result += line;
+			result += '\n';
+		}
+		return result;
+	}
+
+	// Follows the conditional and #define directives, given without the leading #.
+	static void track(const std::string & directive, Conditions & conditions)
+	{
+		size_t nameStart = directive.find_first_not_of(" \t");
+		if (nameStart == std::string::npos)
+		{
+			return;
+		}
+		size_t nameEnd = directive.find_first_of(" \t(", nameStart);
+		std::string name = directive.substr(nameStart, nameEnd == std::string::npos ? std::string::npos : nameEnd - nameStart);
+		std::string rest = nameEnd == std::string::npos ? std::string() : directive.substr(nameEnd);
+		size_t comment = rest.find("//");
+		if (comment != std::string::npos)
+		{
+			rest.erase(comment);
+		}
+
+		if (name == "if" || name == "ifdef" || name == "ifndef")
+		{
+			Truth truth = name == "if" ? evaluate(rest, conditions) : isDefined(word(rest), conditions);
+			if (name == "ifndef")
+			{
+				truth = negate(truth);
+			}
+			conditions.levels.push_back(std::make_pair(truth, truth));
+		}
+		else if (name == "elif" && !conditions.levels.empty())
+		{
+			std::pair<Truth, Truth> & level = conditions.levels.back();
+			Truth truth = evaluate(rest, conditions);
+			level.first = both(negate(level.second), truth);
+			level.second = either(level.second, truth);
+		}
+		else if (name == "else" && !conditions.levels.empty())
+		{
+			std::pair<Truth, Truth> & level = conditions.levels.back();
+			level.first = negate(level.second);
+			level.second = Truth::True;
+		}
+		else if (name == "endif" && !conditions.levels.empty())
+		{
+			conditions.levels.pop_back();
+		}
+		else if (name == "define" || name == "undef")
+		{
+			Truth truth = active(conditions);
+			std::string macro = word(rest);
+			if (truth == Truth::False || macro.empty())
+			{
+				return;
+			}
+			conditions.macros.erase(macro);
+			conditions.unknown.erase(macro);
+			if (truth == Truth::Unknown)
+			{
+				conditions.unknown.insert(macro);
+			}
+			else if (name == "define")
+			{
+				// the value of a function-like macro is never used, it only has to be defined
+				size_t valueStart = rest.find(macro) + macro.size();
+				size_t first = rest.find_first_not_of(" \t", valueStart);
+				size_t last = rest.find_last_not_of(" \t\r");
+				conditions.macros[macro] = first == std::string::npos || rest[valueStart] == '(' ? std::string() : rest.substr(first, last - first + 1);
+			}
+		}
+	}
+
+	static Truth active(const Conditions & conditions)
+	{
+		Truth result = Truth::True;
+		for (const std::pair<Truth, Truth> & level : conditions.levels)
+		{
+			result = both(result, level.first);
+		}
+		return result;
+	}
+
+	static Truth negate(Truth truth)
+	{
+		return truth == Truth::Unknown ? Truth::Unknown : truth == Truth::True ? Truth::False : Truth::True;
+	}
+
+	static Truth both(Truth a, Truth b)
+	{
+		if (a == Truth::False || b == Truth::False)
+		{
+			return Truth::False;
+		}
+		return a == Truth::True && b == Truth::True ? Truth::True : Truth::Unknown;
+	}
+
+	static Truth either(Truth a, Truth b)
+	{
+		if (a == Truth::True || b == Truth::True)
+		{
+			return Truth::True;
+		}
+		return a == Truth::False && b == Truth::False ? Truth::False : Truth::Unknown;
+	}
+
+	// The first identifier in text.
+	static std::string word(const std::string & text)
+	{
+		size_t start = text.find_first_not_of(" \t");
+		if (start == std::string::npos)
+		{
+			return std::string();
+		}
+		size_t end = start;
+		while (end < text.size() && (isalnum((unsigned char)text[end]) || text[end] == '_'))
+		{
+			end++;
+		}
+		return text.substr(start, end - start);
+	}
+
+	// Macros of the driver and of extensions are never known here.
+	static bool builtin(const std::string & name)
+	{
+		return name.compare(0, 3, "GL_") == 0 || name.compare(0, 2, "__") == 0;
+	}
+
+	static Truth isDefined(const std::string & name, const Conditions & conditions)
+	{
+		if (name.empty() || builtin(name) || conditions.unknown.count(name) != 0)
+		{
+			return Truth::Unknown;
+		}
+		return conditions.macros.count(name) != 0 ? Truth::True : Truth::False;
+	}
+
+	// Value of a macro or literal in an #if, undefined macros count as 0 like in C.
+	static Truth value(const std::string & token, const Conditions & conditions)
+	{
+		std::string text = token;
+		if (isalpha((unsigned char)token[0]) || token[0] == '_')
+		{
+			Truth defined = isDefined(token, conditions);
+			if (defined != Truth::True)
+			{
+				return defined;
+			}
+			text = conditions.macros.find(token)->second;
+		}
+		char* end = nullptr;
+		long number = text.empty() ? 0 : strtol(text.c_str(), &end, 0);
+		if (text.empty() || (*end != '\0' && *end != 'u' && *end != 'U'))
+		{
+			return Truth::Unknown;
+		}
+		return number != 0 ? Truth::True : Truth::False;
+	}
+
+	// Evaluates an #if or #elif condition built from defined(), !, &&, ||, parentheses, integer
+	// literals and macros. Anything else makes the whole condition Unknown.
+	static Truth evaluate(const std::string & expression, const Conditions & conditions)
+	{
+		std::vector<std::string> tokens;
+		for (size_t i = 0; i < expression.size();)
+		{
+			char c = expression[i];
+			if (c == ' ' || c == '\t' || c == '\r')
+			{
+				i++;
+			}
+			else if (isalnum((unsigned char)c) || c == '_')
+			{
+				size_t start = i;
+				while (i < expression.size() && (isalnum((unsigned char)expression[i]) || expression[i] == '_'))
+				{
+					i++;
+				}
+				tokens.push_back(expression.substr(start, i - start));
+			}
+			else if ((c == '&' || c == '|') && i + 1 < expression.size() && expression[i + 1] == c)
+			{
+				tokens.push_back(expression.substr(i, 2));
+				i += 2;
+			}
+			else if (c == '!' && i + 1 < expression.size() && expression[i + 1] == '=')
+			{
+				return Truth::Unknown;
+			}
+			else
+			{
+				tokens.push_back(std::string(1, c));
+				i++;
+			}
+		}
+
+		size_t position = 0;
+		bool supported = true;
+		Truth result = parseOr(tokens, position, supported, conditions);
+		return supported && position == tokens.size() ? result : Truth::Unknown;
+	}
+
+	static Truth parseOr(const std::vector<std::string> & tokens, size_t & position, bool & supported, const Conditions & conditions)
+	{
+		Truth result = parseAnd(tokens, position, supported, conditions);
+		while (position < tokens.size() && tokens[position] == "||")
+		{
+			position++;
+			result = either(result, parseAnd(tokens, position, supported, conditions));
+		}
+		return result;
+	}
+
+	static Truth parseAnd(const std::vector<std::string> & tokens, size_t & position, bool & supported, const Conditions & conditions)
+	{
+		Truth result = parseUnary(tokens, position, supported, conditions);
+		while (position < tokens.size() && tokens[position] == "&&")
+		{
+			position++;
+			result = both(result, parseUnary(tokens, position, supported, conditions));
+		}
+		return result;
+	}
+
+	static Truth parseUnary(const std::vector<std::string> & tokens, size_t & position, bool & supported, const Conditions & conditions)
+	{
+		if (position >= tokens.size())
+		{
+			supported = false;
+			return Truth::Unknown;
+		}
+		const std::string & token = tokens[position++];
+		if (token == "!")
+		{
+			return negate(parseUnary(tokens, position, supported, conditions));
+		}
+		if (token == "(")
+		{
+			Truth result = parseOr(tokens, position, supported, conditions);
+			if (position >= tokens.size() || tokens[position++] != ")")
+			{
+				supported = false;
+			}
+			return result;
+		}
+		if (token == "defined")
+		{
+			bool parenthesized = position < tokens.size() && tokens[position] == "(";
+			position += parenthesized ? 1 : 0;
+			if (position >= tokens.size())
+			{
+				supported = false;
+				return Truth::Unknown;
+			}
+			Truth result = isDefined(tokens[position++], conditions);
+			if (parenthesized && (position >= tokens.size() || tokens[position++] != ")"))
+			{
+				supported = false;
+			}
+			return result;
+		}
+		if (isalnum((unsigned char)token[0]) || token[0] == '_')
+		{
+			return value(token, conditions);
+		}
+		supported = false;
+		return Truth::Unknown;
+	}
+
+	static std::string injectDefines(const std::string & source, const ShaderDefines & defines)
+	{
+		if (defines.empty())
+		{
+			return source;
+		}
+
+		std::string block;
+		for (const ShaderDefine & define : defines)
+		{
+			block += "#define " + define.name + " " + define.value + "\n";
+		}
+
+		size_t version = source.find("#version");
+		if (version == std::string::npos)
+		{
+			return block + source;
+		}
+		size_t lineEnd = source.find('\n', version);
+		if (lineEnd == std::string::npos)
+		{
+			return source + "\n" + block;
+		}
+		return source.substr(0, lineEnd + 1) + block + source.substr(lineEnd + 1);
+	}
+};
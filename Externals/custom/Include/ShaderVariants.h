@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+
+#include <Shader.h>
+
+// A family of programs built from the same vertex/fragment/geometry files with different defines.
+// A variant is compiled the first time it is requested and cached under the canonical key of its
+// defines, so only the permutations that are actually drawn are ever built.
+class ShaderVariants
+{
+public:
+	ShaderVariants(const std::string & vertexPath, const std::string & fragmentPath, const std::string & geometryPath = "", ShaderBuild build = ShaderBuild::Immediate)
+		: vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath), build(build)
+	{
+	}
+
+	// Sets uniforms that stay the same for the whole run, e.g. sampler units, on every variant built so
+	// far and on each new one right after it is built. Running it waits for async variants to link.
+	void setup(const std::function<void(Shader &)> & function)
+	{
+		prepare = function;
+		for (std::pair<const std::string, std::unique_ptr<Shader>> & variant : variants)
+		{
+			variant.second->use();
+			prepare(*variant.second);
+		}
+	}
+
+	Shader & get(const ShaderDefines & defines = ShaderDefines())
+	{
+		std::string key = ShaderPreprocessor::key(defines);
+		std::unordered_map<std::string, std::unique_ptr<Shader>>::iterator it = variants.find(key);
+		if (it != variants.end())
+		{
+			return *it->second;
+		}
+
+		Shader* shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(), geometryPath.empty() ? nullptr : geometryPath.c_str(), defines, build);
+		variants[key] = std::unique_ptr<Shader>(shader);
+		if (prepare)
+		{
+			shader->use();
+			prepare(*shader);
+		}
+		return *shader;
+	}
+
+	size_t size() const
+	{
+		return variants.size();
+	}
+
+private:
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::string geometryPath;
+	ShaderBuild build;
+	std::function<void(Shader &)> prepare;
+	std::unordered_map<std::string, std::unique_ptr<Shader>> variants;
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include <BlockCompression.h>
+#include <KtxTexture.h>
+
+// Hands out the layers of a texture array. Released layers are reused before untouched ones, so
+// the array stays densely filled.
+class LayerAllocator
+{
+public:
+	explicit LayerAllocator(unsigned int capacity = 0) : layers(capacity), next(0) {}
+
+	// The allocated layer, -1 when every layer is in use.
+	int allocate()
+	{
+		if (!released.empty())
+		{
+			int layer = released.back();
+			released.pop_back();
+			return layer;
+		}
+		return next < layers ? (int)next++ : -1;
+	}
+
+	void release(int layer)
+	{
+		released.push_back(layer);
+	}
+
+	unsigned int capacity() const { return layers; }
+	unsigned int used() const { return next - (unsigned int)released.size(); }
+	bool full() const { return released.empty() && next == layers; }
+
+private:
+	unsigned int layers;
+	unsigned int next;
+	std::vector<int> released;
+};
+
+// A GL_TEXTURE_2D_ARRAY whose layers hold cooked textures of one format, size and level count.
+// Storage for every layer is allocated up front, layers are filled with upload() and the
+// LayerAllocator of the owner decides which ones are in use. A context that cannot sample the
+// block format gets RGBA8 layers and the levels are decoded on upload, like KtxTexture::upload().
+class TextureArray
+{
+public:
+	// What a KtxTexture must match to become a layer.
+	struct Format
+	{
+		BlockFormat blockFormat;
+		bool srgb;
+		std::string swizzle;
+		int width;
+		int height;
+		unsigned int levels;
+
+		bool operator==(const Format & other) const
+		{
+			return blockFormat == other.blockFormat && srgb == other.srgb && swizzle == other.swizzle
+				&& width == other.width && height == other.height && levels == other.levels;
+		}
+		bool operator!=(const Format & other) const { return !(*this == other); }
+	};
+
+	static Format formatOf(const KtxTexture & texture, unsigned int skipLevels = 0)
+	{
+		Format format;
+		format.blockFormat = texture.format();
+		format.srgb = texture.srgb();
+		format.swizzle = texture.value("KTXswizzle");
+		format.width = std::max(texture.width() >> skipLevels, 1);
+		format.height = std::max(texture.height() >> skipLevels, 1);
+		format.levels = texture.levelCount() - skipLevels;
+		return format;
+	}
+
+	// How many top levels texture has to drop to match format, -1 when it never does. Lets a larger
+	// texture with a full mip chain share the array of smaller ones.
+	static int levelsToSkip(const KtxTexture & texture, const Format & format)
+	{
+		for (unsigned int skip = 0; skip < texture.levelCount(); skip++)
+		{
+			if (formatOf(texture, skip) == format)
+			{
+				return (int)skip;
+			}
+		}
+		return -1;
+	}
+
+	// Largest layer count the context allows.
+	static unsigned int maxLayers()
+	{
+		GLint layers = 0;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &layers);
+		return (unsigned int)layers;
+	}
+
+	TextureArray(const Format & format, unsigned int layers) : arrayFormat(format), layerCount(layers)
+	{
+		native = KtxTexture::supported(format.blockFormat);
+		glGenTextures(1, &textureID);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+		for (unsigned int level = 0; level < format.levels; level++)
+		{
+			int width = std::max(format.width >> level, 1);
+			int height = std::max(format.height >> level, 1);
+			if (native)
+			{
+				glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, KtxTexture::glInternalFormat(format.blockFormat, format.srgb), width, height, layers, 0,
+					(GLsizei)(BlockCompression::imageBytes(format.blockFormat, width, height) * layers), nullptr);
+			}
+			else
+			{
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			}
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)format.levels - 1);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, format.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		KtxTexture::setSwizzle(GL_TEXTURE_2D_ARRAY, format.swizzle);
+	}
+
+	~TextureArray()
+	{
+		glDeleteTextures(1, &textureID);
+	}
+
+	TextureArray(const TextureArray &) = delete;
+	TextureArray & operator=(const TextureArray &) = delete;
+
+	unsigned int id() const { return textureID; }
+	const Format & format() const { return arrayFormat; }
+	unsigned int layers() const { return layerCount; }
+
+	// Copies the levels of texture from skipLevels on into layer. Fails when they do not match the
+	// format of the array.
+	bool upload(unsigned int layer, const KtxTexture & texture, unsigned int skipLevels = 0)
+	{
+		if (layer >= layerCount || formatOf(texture, skipLevels) != arrayFormat)
+		{
+			std::cout << "ERROR::TEXTURE_ARRAY::FORMAT_MISMATCH" << std::endl;
+			return false;
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+		std::vector<unsigned char> decoded;
+		for (unsigned int level = 0; level < arrayFormat.levels; level++)
+		{
+			const KtxTexture::Level & source = texture.level(level + skipLevels);
+			if (native)
+			{
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, source.width, source.height, 1,
+					KtxTexture::glInternalFormat(arrayFormat.blockFormat, arrayFormat.srgb), (GLsizei)source.size, source.data);
+			}
+			else
+			{
+				decoded.resize((size_t)source.width * source.height * 4);
+				BlockCompression::decompress(arrayFormat.blockFormat, source.data, source.width, source.height, decoded.data());
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, source.width, source.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, decoded.data());
+			}
+		}
+		return true;
+	}
+
+	// Fills layer with zeros, black for color and zero for data, which is what a missing texture
+	// sampled as before.
+	void clear(unsigned int layer)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+		std::vector<unsigned char> zeros;
+		for (unsigned int level = 0; level < arrayFormat.levels; level++)
+		{
+			int width = std::max(arrayFormat.width >> level, 1);
+			int height = std::max(arrayFormat.height >> level, 1);
+			if (native)
+			{
+				zeros.assign(BlockCompression::imageBytes(arrayFormat.blockFormat, width, height), 0);
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1,
+					KtxTexture::glInternalFormat(arrayFormat.blockFormat, arrayFormat.srgb), (GLsizei)zeros.size(), zeros.data());
+			}
+			else
+			{
+				zeros.assign((size_t)width * height * 4, 0);
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, zeros.data());
+			}
+		}
+	}
+
+	// Bytes of every level of every layer, used or not.
+	size_t memory() const
+	{
+		size_t bytes = 0;
+		for (unsigned int level = 0; level < arrayFormat.levels; level++)
+		{
+			int width = std::max(arrayFormat.width >> level, 1);
+			int height = std::max(arrayFormat.height >> level, 1);
+			bytes += native ? BlockCompression::imageBytes(arrayFormat.blockFormat, width, height) : (size_t)width * height * 4;
+		}
+		return bytes * layerCount;
+	}
+
+private:
+	Format arrayFormat;
+	unsigned int layerCount;
+	bool native;
+	unsigned int textureID;
+};
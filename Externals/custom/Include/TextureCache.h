@@ -0,0 +1,226 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+
+#include <TextureLoader.h>
+
+// A reference to a texture owned by TextureCache. Copies share the texture and the GL texture is
+// deleted when the last handle is gone.
+class TextureHandle
+{
+public:
+	TextureHandle() {}
+
+	unsigned int id() const { return entry ? entry->id : 0; }
+	bool valid() const { return entry != nullptr; }
+	long useCount() const { return entry.use_count(); }
+
+private:
+	friend class TextureCache;
+
+	struct Entry
+	{
+		unsigned int id;
+		std::string key;
+
+		Entry(unsigned int id, const std::string & key) : id(id), key(key) {}
+		~Entry();
+	};
+
+	std::shared_ptr<Entry> entry;
+
+	explicit TextureHandle(const std::shared_ptr<Entry> & entry) : entry(entry) {}
+};
+
+// Process-wide texture cache keyed by canonical path and TextureFlags, so every model and sample
+// that asks for the same file with the same flags shares one GL texture. Lookups are a hash probe.
+// Only use it from the thread that owns the GL context.
+class TextureCache
+{
+public:
+	static TextureHandle acquire(const std::string & path, unsigned int flags = TEXTURE_DEFAULT)
+	{
+		std::vector<TextureHandle> handles = acquireAll(std::vector<std::string>(1, path), flags);
+		return handles[0];
+	}
+
+	// Like acquire() for every path, but all files that are not cached yet are decoded in parallel.
+	static std::vector<TextureHandle> acquireAll(const std::vector<std::string> & paths, unsigned int flags = TEXTURE_DEFAULT)
+	{
+		return acquireAll(paths, std::vector<unsigned int>(paths.size(), flags));
+	}
+
+	// Like acquireAll() above with the TextureFlags of each path, e.g. sRGB for the color maps only.
+	static std::vector<TextureHandle> acquireAll(const std::vector<std::string> & paths, const std::vector<unsigned int> & flags)
+	{
+		std::vector<TextureHandle> handles(paths.size());
+		std::vector<std::string> keys(paths.size());
+		std::vector<std::string> missingFiles;
+		std::vector<unsigned int> missingFlags;
+		std::vector<size_t> missing;
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			keys[i] = key(paths[i], flags[i]);
+			std::unordered_map<std::string, std::weak_ptr<TextureHandle::Entry>>::iterator it = entries().find(keys[i]);
+			if (it != entries().end())
+			{
+				handles[i].entry = it->second.lock();
+			}
+			if (handles[i].valid())
+			{
+				continue;
+			}
+
+			// the same file may be requested twice in one batch
+			bool queued = false;
+			for (size_t j : missing)
+			{
+				queued = queued || keys[j] == keys[i];
+			}
+			if (!queued)
+			{
+				missingFiles.push_back(paths[i]);
+				missingFlags.push_back(flags[i]);
+			}
+			missing.push_back(i);
+		}
+
+		std::vector<unsigned int> ids = TextureLoader::loadAll(missingFiles, missingFlags);
+		size_t next = 0;
+		for (size_t i : missing)
+		{
+			std::weak_ptr<TextureHandle::Entry> & cached = entries()[keys[i]];
+			handles[i].entry = cached.lock();
+			if (!handles[i].valid())
+			{
+				handles[i].entry = std::make_shared<TextureHandle::Entry>(ids[next++], keys[i]);
+				cached = handles[i].entry;
+			}
+		}
+		return handles;
+	}
+
+	// Like acquire() for an image the caller already decoded, e.g. on a worker thread. The pixels are
+	// freed either way, unused when the file is cached already.
+	static TextureHandle acquire(const std::string & path, TextureLoader::Image & image, unsigned int flags = TEXTURE_DEFAULT)
+	{
+		std::string textureKey = key(path, flags);
+		std::weak_ptr<TextureHandle::Entry> & cached = entries()[textureKey];
+		TextureHandle handle(cached.lock());
+		if (handle.valid())
+		{
+			stbi_image_free(image.data);
+			image.data = nullptr;
+			image.compressed.reset();
+			return handle;
+		}
+
+		handle.entry = std::make_shared<TextureHandle::Entry>(TextureLoader::upload(image, path, flags), textureKey);
+		cached = handle.entry;
+		return handle;
+	}
+
+	// For samples that keep their textures until exit: returns the GL name and holds a reference
+	// for the rest of the process.
+	static unsigned int load(const std::string & path, unsigned int flags = TEXTURE_DEFAULT)
+	{
+		TextureHandle handle = acquire(path, flags);
+		pinned().push_back(handle);
+		return handle.id();
+	}
+
+	// Drops the references load() holds. Call it before the context goes away.
+	static void releasePinned()
+	{
+		pinned().clear();
+	}
+
+	// Number of live textures.
+	static size_t size()
+	{
+		return entries().size();
+	}
+
+	// Resolves "." and ".." segments and unifies separators, so "model/../model/a.png" and
+	// "model\\a.png" share one entry. Paths are case-insensitive on Windows.
+	static std::string canonicalPath(const std::string & path)
+	{
+		std::string unified = path;
+		std::replace(unified.begin(), unified.end(), '\\', '/');
+#ifdef _WIN32
+		std::transform(unified.begin(), unified.end(), unified.begin(), [](char c) { return (char)::tolower((unsigned char)c); });
+#endif
+
+		std::vector<std::string> segments;
+		size_t start = 0;
+		while (start <= unified.size())
+		{
+			size_t slash = unified.find('/', start);
+			if (slash == std::string::npos)
+			{
+				slash = unified.size();
+			}
+			std::string segment = unified.substr(start, slash - start);
+			if (segment == "..")
+			{
+				if (!segments.empty() && segments.back() != "..")
+				{
+					segments.pop_back();
+				}
+				else
+				{
+					segments.push_back(segment);
+				}
+			}
+			else if (!segment.empty() && segment != ".")
+			{
+				segments.push_back(segment);
+			}
+			start = slash + 1;
+		}
+
+		std::string result = !unified.empty() && unified[0] == '/' ? "/" : "";
+		for (size_t i = 0; i < segments.size(); i++)
+		{
+			result += (i > 0 ? "/" : "") + segments[i];
+		}
+		return result;
+	}
+
+private:
+	friend struct TextureHandle::Entry;
+
+	static std::unordered_map<std::string, std::weak_ptr<TextureHandle::Entry>> & entries()
+	{
+		static std::unordered_map<std::string, std::weak_ptr<TextureHandle::Entry>> cache;
+		return cache;
+	}
+
+	static std::vector<TextureHandle> & pinned()
+	{
+		static std::vector<TextureHandle> handles;
+		return handles;
+	}
+
+	static std::string key(const std::string & path, unsigned int flags)
+	{
+		return canonicalPath(path) + "|" + std::to_string(flags);
+	}
+};
+
+inline TextureHandle::Entry::~Entry()
+{
+	glDeleteTextures(1, &id);
+
+	std::unordered_map<std::string, std::weak_ptr<Entry>>::iterator it = TextureCache::entries().find(key);
+	if (it != TextureCache::entries().end() && it->second.expired())
+	{
+		TextureCache::entries().erase(it);
+	}
+}
@@ -0,0 +1,481 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+
+#include <stb_image.h>
+
+#include <BlockCompression.h>
+#include <KtxTexture.h>
+#include <MipGenerator.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// How a texture is created. SRGB stores color maps as sRGB so sampling returns linear values;
+// CLAMP_ALPHA clamps textures with an alpha channel to the edge to avoid semi-transparent borders.
+// COMPRESSED cooks the file into a block-compressed KTX2 file with every mip on first load and
+// reads that file afterwards. NORMAL_MAP keeps only x and y of a tangent-space normal map in BC5,
+// the shader reconstructs z. BC7 compresses color maps to BC7 instead of BC1 or BC3.
+enum TextureFlags
+{
+	TEXTURE_DEFAULT = 0,
+	TEXTURE_SRGB = 1,
+	TEXTURE_CLAMP_ALPHA = 2,
+	TEXTURE_COMPRESSED = 4,
+	TEXTURE_NORMAL_MAP = 8,
+	TEXTURE_BC7 = 16
+};
+
+// Splits texture loading into the part that can run anywhere, decoding with stb_image, and the part
+// that needs the GL context, the upload. loadAll() decodes on a pool of worker threads while the
+// calling thread uploads every image as soon as it is ready. Compressed textures are cooked or mapped
+// in the decoding part, so the upload copies the stored mips and builds none.
+class TextureLoader
+{
+public:
+	struct Image
+	{
+		int width;
+		int height;
+		int components;
+		unsigned char* data;
+		// the cooked texture when TEXTURE_COMPRESSED was asked for, data is null then
+		std::shared_ptr<KtxTexture> compressed;
+	};
+
+	// Directory the cooked .ktx2 files are written to. Set it to an empty string to cook in memory on
+	// every load instead.
+	static std::string & cacheDirectory()
+	{
+		static std::string dir = "texture_cache";
+		return dir;
+	}
+
+	// Worker threads used by loadAll() and decodeAll(). 0 picks one per hardware thread.
+	static unsigned int & threadCount()
+	{
+		static unsigned int count = 0;
+		return count;
+	}
+
+	static Image decode(const std::string & path, unsigned int flags = TEXTURE_DEFAULT)
+	{
+		Image image;
+		image.data = nullptr;
+		if ((flags & TEXTURE_COMPRESSED) != 0)
+		{
+			image.compressed = loadCompressed(path, flags);
+			if (image.compressed)
+			{
+				image.width = image.compressed->width();
+				image.height = image.compressed->height();
+				image.components = std::atoi(image.compressed->value("components").c_str());
+				return image;
+			}
+		}
+		image.data = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+		return image;
+	}
+
+	// The cooked texture of a file, read from the cache directory when it was cooked from the same
+	// bytes with the same flags, cooked and written there otherwise. nullptr when the file cannot be
+	// decoded.
+	static std::shared_ptr<KtxTexture> loadCompressed(const std::string & path, unsigned int flags)
+	{
+		std::string source = readFile(path);
+		if (source.empty())
+		{
+			return nullptr;
+		}
+		std::string hash = sourceHash(source, flags);
+		std::string cookedPath = cachePath(path, flags);
+		std::shared_ptr<KtxTexture> cooked = findCooked(cookedPath, hash);
+		if (cooked)
+		{
+			return cooked;
+		}
+
+		int width, height, components;
+		unsigned char* pixels = stbi_load_from_memory((const stbi_uc*)source.data(), (int)source.size(), &width, &height, &components, 4);
+		if (pixels == nullptr)
+		{
+			return nullptr;
+		}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<unsigned char> bytes = cook(pixels, width, height, components, flags, hash);
+		stbi_image_free(pixels);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << "cooked " << path << " in " << elapsed.count() << " ms" << std::endl;
+		return storeCooked(cookedPath, std::move(bytes));
+	}
+
+	// What a cooked file is checked against: the source bytes, the flags and the cooker version.
+	static std::string sourceHash(const std::string & source, unsigned int flags)
+	{
+		uint32_t version = COOK_VERSION;
+		uint64_t hash = fnv1a(14695981039346656037ULL, (const char*)&version, sizeof(version));
+		hash = fnv1a(hash, (const char*)&flags, sizeof(flags));
+		hash = fnv1a(hash, source.data(), source.size());
+		return hexadecimal(hash);
+	}
+
+	// The file in the cache directory for a source path and flags, one per combination.
+	static std::string cachePath(const std::string & path, unsigned int flags)
+	{
+		size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+		std::string key = path + "|" + std::to_string(flags);
+		return cacheDirectory() + "/" + name + "." + hexadecimal(fnv1a(14695981039346656037ULL, key.data(), key.size())) + ".ktx2";
+	}
+
+	// The cooked file at cookedPath if it was cooked from sourceHash, nullptr otherwise.
+	static std::shared_ptr<KtxTexture> findCooked(const std::string & cookedPath, const std::string & sourceHash)
+	{
+		if (cacheDirectory().empty())
+		{
+			return nullptr;
+		}
+		std::shared_ptr<KtxTexture> cooked = std::make_shared<KtxTexture>(cookedPath);
+		return cooked->valid() && cooked->value("sourceHash") == sourceHash ? cooked : nullptr;
+	}
+
+	// Writes freshly cooked bytes to cookedPath, unless the cache is disabled, and keeps them in memory.
+	static std::shared_ptr<KtxTexture> storeCooked(const std::string & cookedPath, std::vector<unsigned char> && bytes)
+	{
+		if (!cacheDirectory().empty())
+		{
+#ifdef _WIN32
+			_mkdir(cacheDirectory().c_str());
+#else
+			mkdir(cacheDirectory().c_str(), 0755);
+#endif
+			KtxTexture::write(cookedPath, bytes);
+		}
+		std::shared_ptr<KtxTexture> cooked = std::make_shared<KtxTexture>(std::move(bytes));
+		return cooked->valid() ? cooked : nullptr;
+	}
+
+	static std::string readFile(const std::string & path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream stream;
+		stream << file.rdbuf();
+		return stream.str();
+	}
+
+	// The block format a texture is cooked to: BC5 for normal maps, BC4 for gray maps such as
+	// roughness, BC3 when any pixel is not opaque and BC1 otherwise, or BC7 for both with TEXTURE_BC7.
+	static BlockFormat compressedFormat(const unsigned char* rgba, int width, int height, int components, unsigned int flags)
+	{
+		if ((flags & TEXTURE_NORMAL_MAP) != 0)
+		{
+			return BlockFormat::BC5;
+		}
+		bool gray = (flags & TEXTURE_SRGB) == 0 && components != 2;
+		bool opaque = true;
+		for (size_t i = 0; i < (size_t)width * height; i++)
+		{
+			const unsigned char* pixel = rgba + i * 4;
+			gray = gray && pixel[0] == pixel[1] && pixel[0] == pixel[2];
+			opaque = opaque && pixel[3] == 255;
+		}
+		if (gray && opaque)
+		{
+			return BlockFormat::BC4;
+		}
+		if ((flags & TEXTURE_BC7) != 0)
+		{
+			return BlockFormat::BC7;
+		}
+		return opaque ? BlockFormat::BC1 : BlockFormat::BC3;
+	}
+
+	// Compresses width x height RGBA8 pixels and the mips below them into a KTX2 file. The mips are
+	// built by MipGenerator: sRGB textures are filtered in linear space and normal maps as x and y
+	// with renormalized vectors. components is the channel count of the source file and is kept with
+	// the texture.
+	static std::vector<unsigned char> cook(const unsigned char* rgba, int width, int height, int components, unsigned int flags, const std::string & sourceHash)
+	{
+		BlockFormat format = compressedFormat(rgba, width, height, components, flags);
+		bool srgb = (flags & TEXTURE_SRGB) != 0 && format != BlockFormat::BC4 && format != BlockFormat::BC5;
+
+		// BC5 keeps only x and y of a normal map, so its chain is built from those
+		bool normalMap = (flags & TEXTURE_NORMAL_MAP) != 0;
+		int channels = normalMap ? 2 : 4;
+		std::vector<unsigned char> level((size_t)width * height * channels);
+		for (size_t i = 0; i < (size_t)width * height; i++)
+		{
+			std::copy(rgba + i * 4, rgba + i * 4 + channels, level.begin() + i * channels);
+		}
+
+		std::vector<std::vector<unsigned char>> levels;
+		std::vector<unsigned char> next;
+		std::vector<unsigned char> expanded;
+		int levelWidth = width;
+		int levelHeight = height;
+		while (true)
+		{
+			const unsigned char* pixels = level.data();
+			if (normalMap)
+			{
+				expanded.resize((size_t)levelWidth * levelHeight * 4);
+				for (size_t i = 0; i < (size_t)levelWidth * levelHeight; i++)
+				{
+					expanded[i * 4] = level[i * 2];
+					expanded[i * 4 + 1] = level[i * 2 + 1];
+					expanded[i * 4 + 2] = 0;
+					expanded[i * 4 + 3] = 255;
+				}
+				pixels = expanded.data();
+			}
+			levels.push_back(std::vector<unsigned char>(BlockCompression::imageBytes(format, levelWidth, levelHeight)));
+			BlockCompression::compress(format, pixels, levelWidth, levelHeight, levels.back().data());
+			if (levelWidth == 1 && levelHeight == 1)
+			{
+				break;
+			}
+			next.resize((size_t)MipGenerator::mipSize(levelWidth) * MipGenerator::mipSize(levelHeight) * channels);
+			if (normalMap)
+			{
+				MipGenerator::downsampleRG8Normal(level.data(), levelWidth, levelHeight, next.data());
+			}
+			else
+			{
+				MipGenerator::downsampleRGBA8(level.data(), levelWidth, levelHeight, (flags & TEXTURE_SRGB) != 0, next.data());
+			}
+			level.swap(next);
+			levelWidth = MipGenerator::mipSize(levelWidth);
+			levelHeight = MipGenerator::mipSize(levelHeight);
+		}
+
+		// sorted by key, as KTX2 wants them
+		std::vector<std::pair<std::string, std::string>> keyValues;
+		if (format == BlockFormat::BC4)
+		{
+			keyValues.push_back(std::make_pair("KTXswizzle", "rrr1"));
+		}
+		keyValues.push_back(std::make_pair("components", std::to_string(components)));
+		keyValues.push_back(std::make_pair("sourceHash", sourceHash));
+		return KtxTexture::serialize(format, srgb, width, height, levels, keyValues);
+	}
+
+	// Creates a mipmapped, repeating GL texture from a decoded image and frees the pixels. Returns a
+	// texture name even when decoding failed, like TextureFromFile always did.
+	static unsigned int upload(Image & image, const std::string & path, unsigned int flags = TEXTURE_DEFAULT)
+	{
+		if (image.compressed)
+		{
+			GLint wrap = (flags & TEXTURE_CLAMP_ALPHA) != 0 && image.components == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+			unsigned int textureID = image.compressed->upload(wrap);
+			image.compressed.reset();
+			return textureID;
+		}
+
+		unsigned int textureID;
+		glGenTextures(1, &textureID);
+
+		if (image.data)
+		{
+			bool srgb = (flags & TEXTURE_SRGB) != 0;
+			GLenum format = GL_RGB;
+			GLenum internalFormat = GL_RGB;
+			if (image.components == 1)
+			{
+				internalFormat = format = GL_RED;
+			}
+			else if (image.components == 3)
+			{
+				format = GL_RGB;
+				internalFormat = srgb ? GL_SRGB : GL_RGB;
+			}
+			else if (image.components == 4)
+			{
+				format = GL_RGBA;
+				internalFormat = srgb ? GL_SRGB_ALPHA : GL_RGBA;
+			}
+			GLint wrap = (flags & TEXTURE_CLAMP_ALPHA) != 0 && format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+
+			glBindTexture(GL_TEXTURE_2D, textureID);
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+			glGenerateMipmap(GL_TEXTURE_2D);
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			stbi_image_free(image.data);
+			image.data = nullptr;
+		}
+		else
+		{
+			std::cout << "texture failed to load at path:" << path << std::endl;
+		}
+
+		return textureID;
+	}
+
+	// Bytes of every level of a 2D texture as the driver reports them, for comparing texture memory.
+	static size_t memory(unsigned int texture)
+	{
+		glBindTexture(GL_TEXTURE_2D, texture);
+		size_t bytes = 0;
+		for (GLint level = 0; level < 16; level++)
+		{
+			GLint width = 0, height = 0, compressed = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+			if (width == 0 || height == 0)
+			{
+				break;
+			}
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+			if (compressed)
+			{
+				GLint size = 0;
+				glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+				bytes += (size_t)size;
+				continue;
+			}
+			GLint bits = 0;
+			for (GLenum channel : { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE })
+			{
+				GLint channelBits = 0;
+				glGetTexLevelParameteriv(GL_TEXTURE_2D, level, channel, &channelBits);
+				bits += channelBits;
+			}
+			bytes += (size_t)width * height * bits / 8;
+		}
+		return bytes;
+	}
+
+	// Loads every file and returns the texture names in the same order. flags is either empty or holds
+	// the TextureFlags of each file. Must be called on the thread that owns the GL context.
+	static std::vector<unsigned int> loadAll(const std::vector<std::string> & paths, const std::vector<unsigned int> & flags = std::vector<unsigned int>())
+	{
+		if (paths.empty())
+		{
+			return std::vector<unsigned int>();
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		unsigned int workers = workerCount(paths.size());
+
+		std::vector<std::promise<Image>> decoded(paths.size());
+		std::vector<std::future<Image>> ready;
+		ready.reserve(paths.size());
+		for (std::promise<Image> & image : decoded)
+		{
+			ready.push_back(image.get_future());
+		}
+
+		// workers take the next path in order, so the uploads below rarely wait
+		std::atomic<size_t> next(0);
+		std::vector<std::thread> pool;
+		for (unsigned int i = 0; i < workers; i++)
+		{
+			pool.push_back(std::thread([&]()
+			{
+				for (size_t index = next++; index < paths.size(); index = next++)
+				{
+					decoded[index].set_value(decode(paths[index], flags.empty() ? (unsigned int)TEXTURE_DEFAULT : flags[index]));
+				}
+			}));
+		}
+
+		std::vector<unsigned int> textures;
+		textures.reserve(paths.size());
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			Image image = ready[i].get();
+			textures.push_back(upload(image, paths[i], flags.empty() ? (unsigned int)TEXTURE_DEFAULT : flags[i]));
+		}
+
+		for (std::thread & worker : pool)
+		{
+			worker.join();
+		}
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << "loaded " << paths.size() << " textures on " << workers << " threads in " << elapsed.count() << " ms" << std::endl;
+		return textures;
+	}
+
+	// Decodes every file on the worker pool and returns the images in the same order, for callers that
+	// upload them later. Needs no GL context, so it can run on a thread of its own. flags is empty or
+	// holds the TextureFlags of each file, like for loadAll().
+	static std::vector<Image> decodeAll(const std::vector<std::string> & paths, const std::vector<unsigned int> & flags = std::vector<unsigned int>())
+	{
+		std::vector<Image> images(paths.size());
+		std::atomic<size_t> next(0);
+		std::vector<std::thread> pool;
+		for (unsigned int i = 0; i < workerCount(paths.size()); i++)
+		{
+			pool.push_back(std::thread([&]()
+			{
+				for (size_t index = next++; index < paths.size(); index = next++)
+				{
+					images[index] = decode(paths[index], flags.empty() ? (unsigned int)TEXTURE_DEFAULT : flags[index]);
+				}
+			}));
+		}
+		for (std::thread & worker : pool)
+		{
+			worker.join();
+		}
+		return images;
+	}
+
+private:
+	// part of every source hash, bump it when cooking changes so old files are cooked again
+	static const uint32_t COOK_VERSION = 2;
+
+	static uint64_t fnv1a(uint64_t hash, const char* data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= (unsigned char)data[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	static std::string hexadecimal(uint64_t value)
+	{
+		char text[17];
+		std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)value);
+		return text;
+	}
+
+	static unsigned int workerCount(size_t jobs)
+	{
+		unsigned int workers = threadCount() != 0 ? threadCount() : std::thread::hardware_concurrency();
+		if (workers == 0)
+		{
+			workers = 1;
+		}
+		if (workers > jobs)
+		{
+			workers = (unsigned int)jobs;
+		}
+		return workers;
+	}
+};
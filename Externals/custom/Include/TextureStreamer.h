@@ -0,0 +1,547 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <BlockCompression.h>
+#include <KtxTexture.h>
+
+// Decides which mip levels of streamed textures are in GPU memory, under a byte budget. It knows
+// nothing of GL: TextureStreamer applies its decisions to real textures, checks drive it with
+// synthetic ones.
+//
+// The levels of at most residentSize texels a side, the tail, are resident from add() on and never
+// leave. Every frame the caller requests the finest level each visible texture needs; update()
+// then picks one finer level per texture that is short of it, those furthest from their level
+// first, and as many as fit the bytes a frame may upload. A load that does not fit the budget
+// evicts levels no request needs, least recently used texture first: everything above the tail of
+// a texture that was not requested this frame, and levels finer than requested of one that was.
+// Loads count against the budget from update() on and become resident with loaded().
+class TextureResidency
+{
+public:
+	struct Load
+	{
+		int texture;
+		unsigned int level;
+		size_t bytes;
+	};
+
+	struct Eviction
+	{
+		int texture;
+		unsigned int level;
+	};
+
+	// Levels from residentLevel to the last are resident, those from tailLevel on always.
+	struct TextureStats
+	{
+		unsigned int levels;
+		unsigned int tailLevel;
+		unsigned int residentLevel;
+		// the finest level requested in the last frame the texture was used
+		unsigned int wantedLevel;
+		bool loading;
+		size_t residentBytes;
+		size_t fullBytes;
+		unsigned int loads;
+		unsigned int evictions;
+		uint64_t lastUsed;
+	};
+
+	struct Stats
+	{
+		size_t budget;
+		// resident levels and the loads under way
+		size_t residentBytes;
+		size_t peakBytes;
+		size_t tailBytes;
+		// every level of every texture
+		size_t fullBytes;
+		size_t loadedBytes;
+		unsigned long long loads;
+		unsigned long long evictions;
+		uint64_t frame;
+		// textures requested in the last frame, and those of them short of their level because
+		// nothing else could be evicted
+		unsigned int requested;
+		unsigned int starved;
+	};
+
+	explicit TextureResidency(size_t budget, int residentSize = 64) : residentSize(std::max(residentSize, 1))
+	{
+		totals = Stats();
+		totals.budget = budget;
+	}
+
+	// The level whose size a side covers about pixels on screen, 0 when it covers more than size.
+	static unsigned int levelForSize(int size, float pixels)
+	{
+		if (pixels >= (float)size)
+		{
+			return 0;
+		}
+		if (pixels <= 1.0f)
+		{
+			return 31;
+		}
+		return (unsigned int)std::floor(std::log2((float)size / pixels));
+	}
+
+	// Adds a texture with the byte size of each of its levels, the full size first, and makes its
+	// tail resident. The tail counts against the budget even when it does not fit.
+	int add(int width, int height, const std::vector<size_t> & levelBytes)
+	{
+		Entry entry;
+		entry.levelBytes = levelBytes;
+		TextureStats & stats = entry.stats;
+		stats = TextureStats();
+		stats.levels = (unsigned int)levelBytes.size();
+		stats.tailLevel = stats.levels > 0 ? stats.levels - 1 : 0;
+		for (unsigned int level = 0; level < stats.levels; level++)
+		{
+			stats.fullBytes += levelBytes[level];
+			if (level < stats.tailLevel && std::max(width >> level, height >> level) <= residentSize)
+			{
+				stats.tailLevel = level;
+			}
+		}
+		stats.residentLevel = stats.wantedLevel = stats.tailLevel;
+		for (unsigned int level = stats.tailLevel; level < stats.levels; level++)
+		{
+			stats.residentBytes += levelBytes[level];
+		}
+		entries.push_back(entry);
+
+		totals.residentBytes += stats.residentBytes;
+		totals.peakBytes = std::max(totals.peakBytes, totals.residentBytes);
+		totals.tailBytes += stats.residentBytes;
+		totals.fullBytes += stats.fullBytes;
+		return (int)entries.size() - 1;
+	}
+
+	// Asks for level or finer of texture this frame, several requests keep the finest.
+	void request(int texture, unsigned int level)
+	{
+		Entry & entry = entries[texture];
+		TextureStats & stats = entry.stats;
+		if (!entry.requested)
+		{
+			stats.lastUsed = totals.frame;
+			stats.wantedLevel = stats.tailLevel;
+			entry.requested = true;
+			requested.push_back(texture);
+			if (entry.inLru)
+			{
+				lru.splice(lru.end(), lru, entry.lruPosition);
+			}
+		}
+		stats.wantedLevel = std::min(stats.wantedLevel, std::min(level, stats.tailLevel));
+	}
+
+	// Ends the frame: fills evictions with the levels to drop and loads with the levels to upload,
+	// at most frameBytes of them unless a single level is larger. Evictions take effect at once,
+	// every load must be followed by loaded().
+	void update(size_t frameBytes, std::vector<Load> & loads, std::vector<Eviction> & evictions)
+	{
+		loads.clear();
+		evictions.clear();
+		std::stable_sort(requested.begin(), requested.end(), [&](int a, int b) { return shortfall(entries[a]) > shortfall(entries[b]); });
+
+		size_t scheduled = 0;
+		totals.starved = 0;
+		for (int texture : requested)
+		{
+			Entry & entry = entries[texture];
+			TextureStats & stats = entry.stats;
+			if (stats.loading || shortfall(entry) == 0)
+			{
+				continue;
+			}
+			unsigned int level = stats.residentLevel - 1;
+			size_t bytes = entry.levelBytes[level];
+			if (!loads.empty() && scheduled + bytes > frameBytes)
+			{
+				continue;
+			}
+			if (!makeRoom(bytes, evictions))
+			{
+				totals.starved++;
+				continue;
+			}
+			stats.loading = true;
+			totals.residentBytes += bytes;
+			totals.peakBytes = std::max(totals.peakBytes, totals.residentBytes);
+			scheduled += bytes;
+			Load load = { texture, level, bytes };
+			loads.push_back(load);
+		}
+
+		for (int texture : requested)
+		{
+			entries[texture].requested = false;
+		}
+		totals.requested = (unsigned int)requested.size();
+		requested.clear();
+		totals.frame++;
+	}
+
+	// The level of a load from update() is resident now.
+	void loaded(const Load & load)
+	{
+		Entry & entry = entries[load.texture];
+		TextureStats & stats = entry.stats;
+		stats.loading = false;
+		stats.residentLevel = load.level;
+		stats.residentBytes += load.bytes;
+		stats.loads++;
+		totals.loads++;
+		totals.loadedBytes += load.bytes;
+		if (!entry.inLru)
+		{
+			entry.lruPosition = lru.insert(lru.end(), load.texture);
+			entry.inLru = true;
+		}
+	}
+
+	size_t textureCount() const { return entries.size(); }
+	const TextureStats & textureStats(int texture) const { return entries[texture].stats; }
+	const Stats & stats() const { return totals; }
+
+private:
+	struct Entry
+	{
+		std::vector<size_t> levelBytes;
+		TextureStats stats;
+		// requested this frame
+		bool requested = false;
+		// in the list of textures with levels above their tail, least recently requested first
+		bool inLru = false;
+		std::list<int>::iterator lruPosition;
+	};
+
+	int residentSize;
+	std::vector<Entry> entries;
+	std::vector<int> requested;
+	std::list<int> lru;
+	Stats totals;
+
+	static unsigned int shortfall(const Entry & entry)
+	{
+		return entry.stats.residentLevel > entry.stats.wantedLevel ? entry.stats.residentLevel - entry.stats.wantedLevel : 0;
+	}
+
+	// Evicts levels no request of this frame needs until bytes more fit the budget. Returns whether they do.
+	bool makeRoom(size_t bytes, std::vector<Eviction> & evictions)
+	{
+		std::list<int>::iterator it = lru.begin();
+		while (totals.residentBytes + bytes > totals.budget && it != lru.end())
+		{
+			Entry & victim = entries[*it];
+			TextureStats & stats = victim.stats;
+			unsigned int needed = victim.requested ? stats.wantedLevel : stats.tailLevel;
+			if (stats.loading || stats.residentLevel >= needed)
+			{
+				++it;
+				continue;
+			}
+			Eviction eviction = { *it, stats.residentLevel };
+			evictions.push_back(eviction);
+			size_t freed = victim.levelBytes[stats.residentLevel];
+			stats.residentBytes -= freed;
+			stats.residentLevel++;
+			stats.evictions++;
+			totals.residentBytes -= freed;
+			totals.evictions++;
+			if (stats.residentLevel == stats.tailLevel)
+			{
+				victim.inLru = false;
+				it = lru.erase(it);
+			}
+		}
+		return totals.residentBytes + bytes <= totals.budget;
+	}
+};
+
+// Streams the mips of cooked KTX2 textures under a GPU memory budget, see TextureResidency. A texture
+// starts with its tail levels; request() says how large it appears this frame and update(), once a
+// frame on the thread that owns the GL context, evicts and uploads levels. Evicted levels are
+// redefined with size zero so the driver can free them and GL_TEXTURE_BASE_LEVEL keeps the texture
+// complete. Uploads are copied into one of stagingFrames pixel buffers of stagingBytes each and
+// read by GL from there, each buffer is reused once a fence says GL is done with it. A level larger
+// than a buffer is uploaded straight from the KtxTexture. The KtxTextures stay alive as the source
+// of evicted levels.
+class TextureStreamer
+{
+public:
+	struct UploadStats
+	{
+		unsigned long long staged;
+		unsigned long long direct;
+		// waits for a staging buffer GL was still reading
+		unsigned long long stalls;
+	};
+
+	TextureStreamer(size_t budget, size_t stagingBytes = 8 << 20, unsigned int stagingFrames = 3, int residentSize = 64)
+		: state(budget, residentSize), stagingBytes(stagingBytes), nextStaging(0)
+	{
+		uploads = UploadStats();
+		staging.resize(std::max(stagingFrames, 1u));
+		for (Staging & buffer : staging)
+		{
+			glGenBuffers(1, &buffer.buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.buffer);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)stagingBytes, nullptr, GL_STREAM_DRAW);
+			buffer.fence = nullptr;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	~TextureStreamer()
+	{
+		clear();
+	}
+
+	TextureStreamer(const TextureStreamer &) = delete;
+	TextureStreamer & operator=(const TextureStreamer &) = delete;
+
+	// Creates the GL texture of a cooked texture with its tail levels. Returns the index for the other
+	// calls, -1 for an invalid texture.
+	int add(const std::shared_ptr<KtxTexture> & texture, GLint wrap = GL_REPEAT)
+	{
+		if (!texture || !texture->valid())
+		{
+			std::cout << "ERROR::TEXTURE_STREAMER::INVALID_TEXTURE" << std::endl;
+			return -1;
+		}
+		Streamed streamed;
+		streamed.texture = texture;
+		streamed.native = KtxTexture::supported(texture->format());
+		std::vector<size_t> levelBytes;
+		for (unsigned int level = 0; level < texture->levelCount(); level++)
+		{
+			const KtxTexture::Level & source = texture->level(level);
+			levelBytes.push_back(streamed.native ? source.size : (size_t)source.width * source.height * 4);
+		}
+		int index = state.add(texture->width(), texture->height(), levelBytes);
+		unsigned int tailLevel = state.textureStats(index).tailLevel;
+
+		glGenTextures(1, &streamed.id);
+		glBindTexture(GL_TEXTURE_2D, streamed.id);
+		std::vector<unsigned char> decoded;
+		for (unsigned int level = tailLevel; level < texture->levelCount(); level++)
+		{
+			define(streamed, level, direct(streamed, level, decoded));
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)tailLevel);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture->levelCount() - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture->levelCount() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		KtxTexture::setSwizzle(GL_TEXTURE_2D, texture->value("KTXswizzle"));
+		textures.push_back(streamed);
+		return index;
+	}
+
+	unsigned int id(int texture) const
+	{
+		return texture >= 0 ? textures[texture].id : 0;
+	}
+
+	// How many pixels the full width of texture covers on screen where it is closest this frame,
+	// see projectedSize(). Textures without a request this frame may lose everything but their tail.
+	void request(int texture, float pixels)
+	{
+		if (texture >= 0)
+		{
+			state.request(texture, TextureResidency::levelForSize(textures[texture].texture->width(), pixels));
+		}
+	}
+
+	// Pixels that worldSize covers at distance from the eye in a perspective projection.
+	static float projectedSize(float worldSize, float distance, float fovY, int viewportHeight)
+	{
+		return worldSize / (2.0f * std::max(distance, 1e-4f) * std::tan(fovY * 0.5f)) * (float)viewportHeight;
+	}
+
+	// Once a frame after the requests: drops the levels the residency evicts and uploads the ones it
+	// loads, at most one staging buffer of them.
+	void update()
+	{
+		state.update(stagingBytes, loads, evictions);
+		for (const TextureResidency::Eviction & eviction : evictions)
+		{
+			const Streamed & streamed = textures[eviction.texture];
+			glBindTexture(GL_TEXTURE_2D, streamed.id);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)eviction.level + 1);
+			define(streamed, eviction.level, nullptr, true);
+		}
+		if (loads.empty())
+		{
+			return;
+		}
+
+		Staging & buffer = staging[nextStaging];
+		nextStaging = (nextStaging + 1) % staging.size();
+		if (buffer.fence != nullptr)
+		{
+			if (glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				uploads.stalls++;
+				glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			}
+			glDeleteSync(buffer.fence);
+			buffer.fence = nullptr;
+		}
+
+		// levels that fit are copied into the staging buffer, the rest is uploaded from client memory
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.buffer);
+		unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)stagingBytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		std::vector<size_t> offsets(loads.size(), SIZE_MAX);
+		size_t used = 0;
+		for (size_t i = 0; i < loads.size(); i++)
+		{
+			if (mapped != nullptr && used + loads[i].bytes <= stagingBytes)
+			{
+				copy(textures[loads[i].texture], loads[i].level, mapped + used);
+				offsets[i] = used;
+				// keeps every level aligned for its blocks
+				used += (loads[i].bytes + 15) & ~(size_t)15;
+			}
+		}
+		if (mapped != nullptr)
+		{
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		for (size_t i = 0; i < loads.size(); i++)
+		{
+			if (offsets[i] != SIZE_MAX)
+			{
+				apply(loads[i], (const unsigned char*)offsets[i]);
+				uploads.staged++;
+			}
+		}
+		buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		std::vector<unsigned char> decoded;
+		for (size_t i = 0; i < loads.size(); i++)
+		{
+			if (offsets[i] == SIZE_MAX)
+			{
+				apply(loads[i], direct(textures[loads[i].texture], loads[i].level, decoded));
+				uploads.direct++;
+			}
+		}
+	}
+
+	const TextureResidency & residency() const { return state; }
+	const UploadStats & uploadStats() const { return uploads; }
+
+	// Deletes every texture and staging buffer, all indices become invalid.
+	void clear()
+	{
+		for (const Streamed & streamed : textures)
+		{
+			glDeleteTextures(1, &streamed.id);
+		}
+		textures.clear();
+		for (Staging & buffer : staging)
+		{
+			if (buffer.fence != nullptr)
+			{
+				glDeleteSync(buffer.fence);
+			}
+			glDeleteBuffers(1, &buffer.buffer);
+		}
+		staging.clear();
+	}
+
+private:
+	struct Streamed
+	{
+		std::shared_ptr<KtxTexture> texture;
+		bool native;
+		unsigned int id;
+	};
+
+	struct Staging
+	{
+		unsigned int buffer;
+		GLsync fence;
+	};
+
+	TextureResidency state;
+	std::vector<Streamed> textures;
+	std::vector<Staging> staging;
+	size_t stagingBytes;
+	size_t nextStaging;
+	UploadStats uploads;
+	std::vector<TextureResidency::Load> loads;
+	std::vector<TextureResidency::Eviction> evictions;
+
+	// Writes a level as GL takes it, decoded to RGBA8 when the context cannot sample the format.
+	static void copy(const Streamed & streamed, unsigned int level, unsigned char* target)
+	{
+		const KtxTexture::Level & source = streamed.texture->level(level);
+		if (streamed.native)
+		{
+			std::memcpy(target, source.data, source.size);
+		}
+		else
+		{
+			BlockCompression::decompress(streamed.texture->format(), source.data, source.width, source.height, target);
+		}
+	}
+
+	// Level data in client memory, decoded into scratch when needed.
+	static const unsigned char* direct(const Streamed & streamed, unsigned int level, std::vector<unsigned char> & scratch)
+	{
+		if (streamed.native)
+		{
+			return streamed.texture->level(level).data;
+		}
+		const KtxTexture::Level & source = streamed.texture->level(level);
+		scratch.resize((size_t)source.width * source.height * 4);
+		copy(streamed, level, scratch.data());
+		return scratch.data();
+	}
+
+	// Defines level of the bound texture from pixels, a pointer or an offset into the bound unpack
+	// buffer, or with size zero to free it.
+	static void define(const Streamed & streamed, unsigned int level, const unsigned char* pixels, bool empty = false)
+	{
+		const KtxTexture::Level & source = streamed.texture->level(level);
+		int width = empty ? 0 : source.width;
+		int height = empty ? 0 : source.height;
+		bool srgb = streamed.texture->srgb();
+		if (streamed.native)
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, KtxTexture::glInternalFormat(streamed.texture->format(), srgb), width, height, 0,
+				empty ? 0 : (GLsizei)source.size, pixels);
+		}
+		else
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		}
+	}
+
+	void apply(const TextureResidency::Load & load, const unsigned char* pixels)
+	{
+		const Streamed & streamed = textures[load.texture];
+		glBindTexture(GL_TEXTURE_2D, streamed.id);
+		define(streamed, load.level, pixels);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)load.level);
+		state.loaded(load);
+	}
+};
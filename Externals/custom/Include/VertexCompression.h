@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <glm.hpp>
+
+// Encoders for compact vertex attributes: unorm16 positions inside a quantization box, octahedral
+// snorm16 directions, half float texture coordinates and unorm8 bone weights. Every encoder decodes
+// its result again and keeps the largest error in error(), so a loader can check that the compact
+// layout stays within tolerance. The GLSL decoders live in Shaders/vertex_compression.glsl.
+class VertexCompression
+{
+public:
+	// Largest decode error since the last resetError().
+	struct Error
+	{
+		// in quantization steps, rounding keeps it at half a step
+		float position;
+		// angle between the original and the decoded direction, in degrees
+		float normal;
+		float tangent;
+		// relative to max(1, |uv|)
+		float texCoord;
+		unsigned long long vertices;
+
+		bool withinTolerance() const
+		{
+			return position <= 0.51f && normal <= 0.05f && tangent <= 0.05f && texCoord <= 1.01f / 2048.0f;
+		}
+	};
+
+	static Error & error()
+	{
+		static Error maximum = { 0.0f, 0.0f, 0.0f, 0.0f, 0 };
+		return maximum;
+	}
+
+	static void resetError()
+	{
+		Error none = { 0.0f, 0.0f, 0.0f, 0.0f, 0 };
+		error() = none;
+	}
+
+	// Quantizes position to offset + q / 65535 * scale. An axis with scale 0 is stored as 0.
+	static void encodePosition(const glm::vec3 & position, const glm::vec3 & offset, const glm::vec3 & scale, uint16_t encoded[3])
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float normalized = scale[axis] > 0.0f ? (position[axis] - offset[axis]) / scale[axis] : 0.0f;
+			encoded[axis] = toUnorm16(normalized);
+			if (scale[axis] > 0.0f)
+			{
+				float decoded = offset[axis] + fromUnorm16(encoded[axis]) * scale[axis];
+				float steps = std::fabs(decoded - position[axis]) / scale[axis] * 65535.0f;
+				error().position = std::max(error().position, steps);
+			}
+		}
+		error().vertices++;
+	}
+
+	static void encodeNormal(const glm::vec3 & normal, int16_t encoded[2])
+	{
+		encodeOctahedral(normal, encoded, error().normal);
+	}
+
+	static void encodeTangent(const glm::vec3 & tangent, int16_t encoded[2])
+	{
+		encodeOctahedral(tangent, encoded, error().tangent);
+	}
+
+	static void encodeTexCoords(const glm::vec2 & texCoords, uint16_t encoded[2])
+	{
+		for (int axis = 0; axis < 2; axis++)
+		{
+			encoded[axis] = toHalf(texCoords[axis]);
+			float relative = std::fabs(fromHalf(encoded[axis]) - texCoords[axis]) / std::max(1.0f, std::fabs(texCoords[axis]));
+			error().texCoord = std::max(error().texCoord, relative);
+		}
+	}
+
+	// Four weights summing to 1 as unorm8 values summing to exactly 255, the rounding rest goes to
+	// the largest weight.
+	static void encodeWeights(const float weights[4], uint8_t encoded[4])
+	{
+		int sum = 0;
+		int largest = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			encoded[i] = (uint8_t)(std::min(std::max(weights[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+			sum += encoded[i];
+			largest = weights[i] > weights[largest] ? i : largest;
+		}
+		if (sum > 0)
+		{
+			encoded[largest] = (uint8_t)std::min(std::max(encoded[largest] + 255 - sum, 0), 255);
+		}
+	}
+
+	static glm::vec3 decodeOctahedral(const int16_t encoded[2])
+	{
+		glm::vec3 n(fromSnorm16(encoded[0]), fromSnorm16(encoded[1]), 0.0f);
+		n.z = 1.0f - std::fabs(n.x) - std::fabs(n.y);
+		float t = std::max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+		return glm::normalize(n);
+	}
+
+	static uint16_t toUnorm16(float value)
+	{
+		return (uint16_t)(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f + 0.5f);
+	}
+
+	static float fromUnorm16(uint16_t value)
+	{
+		return value / 65535.0f;
+	}
+
+	static int16_t toSnorm16(float value)
+	{
+		return (int16_t)std::floor(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f + 0.5f);
+	}
+
+	static float fromSnorm16(int16_t value)
+	{
+		return std::max(value / 32767.0f, -1.0f);
+	}
+
+	// IEEE 754 half float, rounded to nearest even.
+	static uint16_t toHalf(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		uint32_t sign = (bits >> 16) & 0x8000;
+		uint32_t exponentBits = (bits >> 23) & 0xff;
+		uint32_t mantissa = bits & 0x7fffff;
+		if (exponentBits == 0xff)
+		{
+			return (uint16_t)(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+		}
+
+		int exponent = (int)exponentBits - 127 + 15;
+		if (exponent >= 31)
+		{
+			return (uint16_t)(sign | 0x7c00);
+		}
+		if (exponent <= 0)
+		{
+			// subnormal half
+			if (exponent < -10)
+			{
+				return (uint16_t)sign;
+			}
+			mantissa |= 0x800000;
+			uint32_t shift = (uint32_t)(14 - exponent);
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			if (rest > halfway || (rest == halfway && (half & 1) != 0))
+			{
+				half++;
+			}
+			return (uint16_t)(sign | half);
+		}
+
+		// a carry out of the mantissa correctly bumps the exponent
+		uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+		uint32_t rest = mantissa & 0x1fff;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1) != 0))
+		{
+			half++;
+		}
+		return (uint16_t)(sign | half);
+	}
+
+	static float fromHalf(uint16_t half)
+	{
+		uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+		uint32_t exponent = (half >> 10) & 0x1f;
+		uint32_t mantissa = half & 0x3ff;
+		if (exponent == 0)
+		{
+			float value = std::ldexp((float)mantissa, -24);
+			return sign != 0 ? -value : value;
+		}
+
+		uint32_t bits = exponent == 31 ? (sign | 0x7f800000 | (mantissa << 13)) : (sign | ((exponent + 112) << 23) | (mantissa << 13));
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+private:
+	// Projects the direction onto an octahedron and unfolds it into a square. A zero vector, e.g. the
+	// tangent of a mesh without texture coordinates, is stored as +Z and not counted in the error.
+	static void encodeOctahedral(const glm::vec3 & direction, int16_t encoded[2], float & maximumError)
+	{
+		float length = std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z);
+		if (length == 0.0f)
+		{
+			encoded[0] = encoded[1] = 0;
+			return;
+		}
+
+		glm::vec3 n = direction / length;
+		glm::vec2 folded(n.x, n.y);
+		if (n.z < 0.0f)
+		{
+			folded.x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+			folded.y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		encoded[0] = toSnorm16(folded.x);
+		encoded[1] = toSnorm16(folded.y);
+
+		float cosine = glm::dot(glm::normalize(direction), decodeOctahedral(encoded));
+		float degrees = std::acos(std::min(std::max(cosine, -1.0f), 1.0f)) * 57.2957795f;
+		maximumError = std::max(maximumError, degrees);
+	}
+};
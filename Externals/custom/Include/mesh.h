@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cfloat>
+#include <iostream>
 
 using namespace std;
 
@@ -11,14 +13,19 @@ using namespace std;
 #include <gtc/type_ptr.hpp>
 
 #include <Shader.h>
+#include <GLStateCache.h>
+#include <TextureCache.h>
+#include <VertexCompression.h>
+#include <Meshlets.h>
+#include <Bounds.h>
 
 struct Vertex
 {
 	glm::vec3 Position;
 	glm::vec3 Normal;
 	glm::vec2 TexCoords;
-	glm::vec2 Tangent;
-	glm::vec2 Bitangent;
+	glm::vec3 Tangent;
+	glm::vec3 Bitangent;
 };
 
 struct Texture
@@ -26,6 +33,327 @@ struct Texture
 	unsigned int id;
 	std::string type;
 	std::string path;
+	// keeps the shared texture alive as long as a mesh uses it
+	TextureHandle handle;
+};
+
+// How vertices are stored on the GPU. Full uploads Vertex as it is, Compact uploads CompactVertex.
+enum class VertexFormat
+{
+	Full,
+	Compact
+};
+
+// 20 bytes instead of the 56 of Vertex: unorm16 position inside the quantization box with the sign
+// of the bitangent in w, octahedral snorm16 normal and tangent and half float texture coordinates.
+// The bitangent is rebuilt in the shader as cross(normal, tangent) * sign.
+struct CompactVertex
+{
+	uint16_t Position[4];
+	int16_t Normal[2];
+	int16_t Tangent[2];
+	uint16_t TexCoords[2];
+};
+
+// The vertex format of a mesh and, for Compact, the box its positions are quantized in. The vertex
+// shader undoes the quantization with the positionOffset and positionScale uniforms.
+struct VertexLayout
+{
+	VertexFormat format;
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
+
+	VertexLayout() : format(VertexFormat::Full), positionOffset(0.0f), positionScale(1.0f) {}
+
+	static VertexLayout compact(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax)
+	{
+		VertexLayout layout;
+		layout.format = VertexFormat::Compact;
+		layout.positionOffset = boundsMin;
+		layout.positionScale = boundsMax - boundsMin;
+		return layout;
+	}
+
+	size_t vertexSize() const
+	{
+		return format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+	}
+};
+
+// Appends the vertices to encoded in the GPU layout of layout.
+inline void encodeVertices(const Vertex* vertices, unsigned int vertexCount, const VertexLayout & layout, std::vector<unsigned char> & encoded)
+{
+	size_t start = encoded.size();
+	encoded.resize(start + vertexCount * layout.vertexSize());
+	if (layout.format == VertexFormat::Full)
+	{
+		std::copy((const unsigned char*)vertices, (const unsigned char*)(vertices + vertexCount), encoded.begin() + start);
+		return;
+	}
+
+	CompactVertex* compact = (CompactVertex*)(encoded.data() + start);
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const Vertex & vertex = vertices[i];
+		VertexCompression::encodePosition(vertex.Position, layout.positionOffset, layout.positionScale, compact[i].Position);
+		VertexCompression::encodeNormal(vertex.Normal, compact[i].Normal);
+		VertexCompression::encodeTangent(vertex.Tangent, compact[i].Tangent);
+		VertexCompression::encodeTexCoords(vertex.TexCoords, compact[i].TexCoords);
+		bool flipped = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f;
+		compact[i].Position[3] = flipped ? 0 : 65535;
+	}
+}
+
+// Rebuilds Vertex from vertices in the GPU layout of layout, e.g. for a CPU copy of a cooked compact
+// mesh. Compact vertices come back with the precision they have on the GPU.
+inline void decodeVertices(const void* encoded, unsigned int vertexCount, const VertexLayout & layout, std::vector<Vertex> & vertices)
+{
+	if (layout.format == VertexFormat::Full)
+	{
+		vertices.assign((const Vertex*)encoded, (const Vertex*)encoded + vertexCount);
+		return;
+	}
+
+	const CompactVertex* compact = (const CompactVertex*)encoded;
+	vertices.resize(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		Vertex & vertex = vertices[i];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			vertex.Position[axis] = layout.positionOffset[axis] + VertexCompression::fromUnorm16(compact[i].Position[axis]) * layout.positionScale[axis];
+		}
+		vertex.Normal = VertexCompression::decodeOctahedral(compact[i].Normal);
+		vertex.Tangent = VertexCompression::decodeOctahedral(compact[i].Tangent);
+		vertex.TexCoords = glm::vec2(VertexCompression::fromHalf(compact[i].TexCoords[0]), VertexCompression::fromHalf(compact[i].TexCoords[1]));
+		vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent) * (compact[i].Position[3] == 0 ? -1.0f : 1.0f);
+	}
+}
+
+// Points the attributes of the bound VAO at the bound VBO, which holds vertices of the given format.
+// Both formats use the same locations: position, normal, texture coordinates, tangent, bitangent.
+inline void setupVertexAttributes(VertexFormat format)
+{
+	if (format == VertexFormat::Compact)
+	{
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Position));
+
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Normal));
+
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, TexCoords));
+
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Tangent));
+		return;
+	}
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+}
+
+// Draw arguments of one packed mesh, in the layout glMultiDrawElementsIndirect reads.
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// One VAO with a single vertex and index buffer that many meshes are packed into. Meshes only keep
+// their first index and base vertex, so drawing one after another needs no VAO switch, and a list
+// of meshes can go out as one glMultiDrawElementsIndirect.
+class MeshArena
+{
+public:
+	struct Range
+	{
+		unsigned int firstIndex;
+		unsigned int indexCount;
+		int baseVertex;
+	};
+
+	explicit MeshArena(VertexFormat format = VertexFormat::Full) : format(format), VAO(0), VBO(0), EBO(0), indirectBuffer(0), indirectInstances(0) {}
+
+	~MeshArena()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		glDeleteBuffers(1, &indirectBuffer);
+	}
+
+	MeshArena(const MeshArena &) = delete;
+	MeshArena & operator=(const MeshArena &) = delete;
+
+	// The VAO every packed mesh draws with. It exists before upload(), so meshes can store it.
+	unsigned int vertexArray()
+	{
+		if (VAO == 0)
+		{
+			glGenVertexArrays(1, &VAO);
+		}
+		return VAO;
+	}
+
+	// Stages a mesh, its vertices already in the GPU layout of layout, for upload() and returns where
+	// it will live in the shared buffers. All meshes of an arena share its vertex format.
+	Range append(const void* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount, const VertexLayout & layout)
+	{
+		if (VBO != 0)
+		{
+			std::cout << "ERROR::MESH_ARENA::APPEND_AFTER_UPLOAD" << std::endl;
+		}
+		if (layout.format != format)
+		{
+			std::cout << "ERROR::MESH_ARENA::VERTEX_FORMAT_MISMATCH" << std::endl;
+		}
+
+		Range range;
+		range.firstIndex = (unsigned int)indices.size();
+		range.indexCount = indexCount;
+		range.baseVertex = (int)(vertices.size() / layout.vertexSize());
+		const unsigned char* bytes = (const unsigned char*)vertexData;
+		vertices.insert(vertices.end(), bytes, bytes + vertexCount * layout.vertexSize());
+		indices.insert(indices.end(), indexData, indexData + indexCount);
+		return range;
+	}
+
+	// Creates the shared buffers from everything appended and frees the staged copies.
+	void upload()
+	{
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+
+		glBindVertexArray(vertexArray());
+
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+		setupVertexAttributes(format);
+
+		glBindVertexArray(0);
+
+		std::vector<unsigned char>().swap(vertices);
+		std::vector<unsigned int>().swap(indices);
+	}
+
+	// Sets the commands draw() picks from. The instance counts are filled in by draw().
+	void setCommands(const std::vector<DrawElementsIndirectCommand> & drawCommands)
+	{
+		commands = drawCommands;
+		indirectInstances = 0;
+		if (multiDrawIndirectSupported())
+		{
+			if (indirectBuffer == 0)
+			{
+				glGenBuffers(1, &indirectBuffer);
+			}
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+		}
+	}
+
+	// Draws count commands starting at first, each with instanceCount instances. Uses one
+	// glMultiDrawElementsIndirect on GL 4.3 contexts and a glDrawElementsInstancedBaseVertex loop on 3.3.
+	void draw(unsigned int first, unsigned int count, unsigned int instanceCount)
+	{
+		GLStateCache::bindVertexArray(VAO);
+
+		if (indirectBuffer == 0)
+		{
+			for (unsigned int i = first; i < first + count; i++)
+			{
+				const DrawElementsIndirectCommand & command = commands[i];
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+					(void*)(command.firstIndex * sizeof(unsigned int)), instanceCount, command.baseVertex);
+			}
+			return;
+		}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		if (instanceCount != indirectInstances)
+		{
+			// the instance count is part of every command, rewrite them when a caller asks for another one
+			for (DrawElementsIndirectCommand & command : commands)
+			{
+				command.instanceCount = instanceCount;
+			}
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+			indirectInstances = instanceCount;
+		}
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(first * sizeof(DrawElementsIndirectCommand)), count, 0);
+	}
+
+	// Indices draw() covers with count commands starting at first, one instance each.
+	unsigned long long indexCount(unsigned int first, unsigned int count) const
+	{
+		unsigned long long indices = 0;
+		for (unsigned int i = first; i < first + count; i++)
+		{
+			indices += commands[i].count;
+		}
+		return indices;
+	}
+
+	// GL draw calls draw() issues for count commands.
+	unsigned int drawCalls(unsigned int count) const
+	{
+		return indirectBuffer != 0 ? 1 : count;
+	}
+
+	// glad only loads glMultiDrawElementsIndirect when the context is GL 4.3 or newer.
+	static bool multiDrawIndirectSupported()
+	{
+		return glMultiDrawElementsIndirect != NULL;
+	}
+
+private:
+	VertexFormat format;
+	unsigned int VAO, VBO, EBO;
+	unsigned int indirectBuffer;
+	unsigned int indirectInstances;
+	// staged vertices in the GPU layout
+	std::vector<unsigned char> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<DrawElementsIndirectCommand> commands;
+};
+
+// One level of detail of a mesh: a range of its indices, counted from the mesh's first index, and
+// the largest distance simplification moved the surface from the full mesh, in model units.
+struct MeshLod
+{
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	float error;
+};
+
+// One texture of a mesh's material, resolved against a shader: the sampler location, the texture
+// unit it reads from and the GL texture bound there.
+struct MaterialBinding
+{
+	GLint location;
+	unsigned int unit;
+	unsigned int texture;
 };
 
 class Mesh {
@@ -34,27 +362,277 @@ public:
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
 	unsigned int VAO;
+	// all indices, every LOD included
+	unsigned int indexCount;
+	// where the indices start in the index buffer and the vertex they count from, both 0 unless the
+	// mesh is packed into a MeshArena
+	unsigned int firstIndex;
+	int baseVertex;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	// around the vertices, centered on the box and usually tighter than its corners
+	BoundingSphere boundingSphere;
+	VertexLayout layout;
+	// level 0 is the full mesh, the others index the same vertices
+	std::vector<MeshLod> lods;
+	// clusters of level 0 for DrawClusters, empty unless the loader built them
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshletBounds> meshletBounds;
+
+	// With an arena the geometry is staged into it instead of getting its own buffers, and the mesh
+	// can be drawn once the arena was uploaded. layout selects the format of the GPU copy, the CPU
+	// copy in vertices always stays in Vertex layout until releaseCpuGeometry(). lods are ranges of
+	// indices, without them the whole index list is the only level. Pass the vectors with std::move
+	// to hand them over without a copy.
+	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, MeshArena* arena = nullptr,
+		const VertexLayout & layout = VertexLayout(), vector<MeshLod> lods = vector<MeshLod>())
+		: vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), layout(layout), lods(std::move(lods))
+	{
+		boundsMin = glm::vec3(this->vertices.empty() ? 0.0f : FLT_MAX);
+		boundsMax = glm::vec3(this->vertices.empty() ? 0.0f : -FLT_MAX);
+		for (const Vertex & vertex : this->vertices)
+		{
+			boundsMin = glm::min(boundsMin, vertex.Position);
+			boundsMax = glm::max(boundsMax, vertex.Position);
+		}
+		boundingSphere = BoundingSphere::around(bounds().center(), this->vertices.empty() ? nullptr : &this->vertices[0].Position.x,
+			this->vertices.size(), sizeof(Vertex));
+
+		std::vector<unsigned char> encoded;
+		const void* vertexData = this->vertices.data();
+		if (layout.format == VertexFormat::Compact)
+		{
+			encodeVertices(this->vertices.data(), (unsigned int)this->vertices.size(), layout, encoded);
+			vertexData = encoded.data();
+		}
+		setupMesh(vertexData, (unsigned int)this->vertices.size(), this->indices.data(), (unsigned int)this->indices.size(), arena);
+	}
+
+	// Uploads vertices that are already in the GPU layout of layout, e.g. straight from a mapped
+	// cooked model, without touching them. No CPU copy is kept, so vertices and indices stay empty.
+	// The bounds come from the import, so nothing here reads the vertices.
+	Mesh(const void* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount,
+		vector<Texture> textures, const glm::vec3 & boundsMin, const glm::vec3 & boundsMax, const BoundingSphere & boundingSphere,
+		MeshArena* arena = nullptr, const VertexLayout & layout = VertexLayout(), vector<MeshLod> lods = vector<MeshLod>())
+		: textures(std::move(textures)), boundsMin(boundsMin), boundsMax(boundsMax), boundingSphere(boundingSphere), layout(layout), lods(std::move(lods))
+	{
+		setupMesh(vertexData, vertexCount, indexData, indexCount, arena);
+	}
+
+	// Frees the CPU copy of the geometry once the GPU has its own. Bounds, LODs and meshlets stay.
+	void releaseCpuGeometry()
+	{
+		vector<Vertex>().swap(vertices);
+		vector<unsigned int>().swap(indices);
+	}
+
+	// lod is clamped to the coarsest level the mesh has.
+	void Draw(Shader & shader, unsigned int instanceCount = 1, unsigned int lod = 0)
+	{
+		bindMaterial(shader);
+		drawGeometry(instanceCount, lod);
+		GLStateCache::activeTexture(GL_TEXTURE0);
+	}
+
+	// Draw() without binding the material, for callers that bound it already, e.g. RenderQueue.
+	void drawGeometry(unsigned int instanceCount = 1, unsigned int lod = 0)
+	{
+		// the VAO stays bound, the next mesh binds its own and the state cache drops repeats
+		const MeshLod & level = this->lod(lod);
+		GLStateCache::bindVertexArray(VAO);
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, (void*)((firstIndex + level.firstIndex) * sizeof(unsigned int)),
+			instanceCount, baseVertex);
+	}
+
+	BoundingBox bounds() const
+	{
+		return BoundingBox(boundsMin, boundsMax);
+	}
+
+	const MeshLod & lod(unsigned int level) const
+	{
+		return lods[std::min<size_t>(level, lods.size() - 1)];
+	}
+
+	// Sets the meshlets and sizes everything DrawClusters needs, so drawing them does not allocate.
+	void setMeshlets(const vector<Meshlet> & clusters, const vector<MeshletBounds> & bounds)
+	{
+		meshlets = clusters;
+		meshletBounds = bounds;
+		meshletCuller.reset(bounds);
+		meshletVisible.assign((bounds.size() + 3) & ~(size_t)3, 0);
+		clusterCounts.reserve(meshlets.size());
+		clusterOffsets.reserve(meshlets.size());
+		clusterBaseVertices.reserve(meshlets.size());
+	}
+
+	// Culls the meshlets against frustum and camera, both in model space, and draws the visible ones
+	// with one glMultiDrawElementsBaseVertex. Meshlets are consecutive in the index buffer, so a run of
+	// visible ones becomes one range. Cone culling drops clusters that face away, which assumes a
+	// closed mesh or back-face culling. Returns the triangles drawn. Without meshlets the full level
+	// is drawn.
+	unsigned int DrawClusters(Shader & shader, const Frustum & frustum, const glm::vec3 & camera)
+	{
+		unsigned int triangles = cullClusters(frustum, camera);
+		if (triangles == 0)
+		{
+			return 0;
+		}
+
+		bindMaterial(shader);
+		drawClusters();
+		GLStateCache::activeTexture(GL_TEXTURE0);
+		return triangles;
+	}
+
+	// The culling half of DrawClusters: finds the visible ranges and returns their triangles, all of
+	// level 0 without meshlets. drawClusters() then draws them without touching the material.
+	unsigned int cullClusters(const Frustum & frustum, const glm::vec3 & camera)
+	{
+		clusterCounts.clear();
+		clusterOffsets.clear();
+		clusterBaseVertices.clear();
+		if (meshlets.empty())
+		{
+			return lods[0].indexCount / 3;
+		}
+
+		meshletCuller.cull(frustum.planes, camera, meshletVisible.data());
+		unsigned int triangles = 0;
+		for (size_t i = 0; i < meshlets.size(); i++)
+		{
+			if (!meshletVisible[i])
+			{
+				continue;
+			}
+			if (i > 0 && meshletVisible[i - 1])
+			{
+				clusterCounts.back() += meshlets[i].triangleCount * 3;
+			}
+			else
+			{
+				clusterCounts.push_back(meshlets[i].triangleCount * 3);
+				clusterOffsets.push_back((const void*)((firstIndex + meshlets[i].firstIndex) * sizeof(unsigned int)));
+				clusterBaseVertices.push_back(baseVertex);
+			}
+			triangles += meshlets[i].triangleCount;
+		}
+		return triangles;
+	}
+
+	void drawClusters()
+	{
+		if (meshlets.empty())
+		{
+			drawGeometry();
+			return;
+		}
+		if (clusterCounts.empty())
+		{
+			return;
+		}
+		GLStateCache::bindVertexArray(VAO);
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, clusterCounts.data(), GL_UNSIGNED_INT, clusterOffsets.data(), (GLsizei)clusterCounts.size(),
+			clusterBaseVertices.data());
+	}
 
-	Mesh(vector<Vertex> & vertices, vector<unsigned int> & indices, vector<Texture> & textures)
+	// Points the samplers of the shader at this mesh's textures and, for compact vertices, passes the
+	// quantization box.
+	void bindMaterial(Shader & shader)
 	{
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
+		const MaterialBindingTable & table = materialBindings(shader);
+		for (const MaterialBinding & binding : table.bindings)
+		{
+			glUniform1i(binding.location, binding.unit);
+			GLStateCache::bindTexture(binding.unit, GL_TEXTURE_2D, binding.texture);
+		}
+		if (layout.format == VertexFormat::Compact)
+		{
+			glUniform3fv(table.positionOffset, 1, &layout.positionOffset[0]);
+			glUniform3fv(table.positionScale, 1, &layout.positionScale[0]);
+		}
+	}
+
+	// True when both meshes bind the same textures to the same samplers and decode positions the same way.
+	bool sameMaterial(const Mesh & other) const
+	{
+		if (textures.size() != other.textures.size() || layout.positionOffset != other.layout.positionOffset || layout.positionScale != other.layout.positionScale)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			if (textures[i].id != other.textures[i].id || textures[i].type != other.textures[i].type)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
 
-		setupMesh();
+	// Drops the resolved bindings. Call it after changing textures so the next Draw resolves them again.
+	void invalidateMaterialBindings()
+	{
+		bindingTables.clear();
 	}
 
-	void Draw(Shader & shader)
+private:
+	unsigned int VBO, EBO;
+
+	MeshletCuller meshletCuller;
+	std::vector<unsigned char> meshletVisible;
+	std::vector<GLsizei> clusterCounts;
+	std::vector<const void*> clusterOffsets;
+	std::vector<GLint> clusterBaseVertices;
+
+	// The samplers of this mesh resolved against one shader program. Built on the first Draw with a
+	// shader and again after a hot reload replaced its program, so a steady-state Draw does no string
+	// work, no glGetUniformLocation and no heap allocation.
+	struct MaterialBindingTable
 	{
+		const Shader* shader;
+		unsigned int program;
+		unsigned int generation;
+		std::vector<MaterialBinding> bindings;
+		GLint positionOffset;
+		GLint positionScale;
+	};
+	std::vector<MaterialBindingTable> bindingTables;
+
+	const MaterialBindingTable & materialBindings(const Shader & shader)
+	{
+		MaterialBindingTable* table = nullptr;
+		for (MaterialBindingTable & candidate : bindingTables)
+		{
+			if (candidate.shader == &shader)
+			{
+				table = &candidate;
+				break;
+			}
+		}
+		if (table != nullptr && table->program == shader.ID && table->generation == shader.generation())
+		{
+			return *table;
+		}
+		if (table == nullptr)
+		{
+			bindingTables.push_back(MaterialBindingTable());
+			table = &bindingTables.back();
+			table->shader = &shader;
+		}
+		table->program = shader.ID;
+		table->generation = shader.generation();
+		table->bindings.clear();
+		table->positionOffset = shader.location("positionOffset");
+		table->positionScale = shader.location("positionScale");
+
+		// samplers are numbered per type in texture order: texture_diffuse1, texture_diffuse2, ...
 		unsigned int diffuseNr = 1;
 		unsigned int specularNr = 1;
 		unsigned int normalNr = 1;
 		unsigned int heightNr = 1;
-
 		for (unsigned int i = 0; i < textures.size(); ++i)
 		{
-			glActiveTexture(GL_TEXTURE0 + i);
-
 			string number;
 			string name = textures[i].type;
 			if (name == "texture_diffuse")
@@ -74,25 +652,40 @@ public:
 				number = std::to_string(heightNr++);
 			}
 
-			glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-
-            //std::cout << "bind the id: " << (name + number).c_str() << "to the mesh." << std::endl;
-
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+			// samplers the shader does not use are left out, the unit stays the texture's index
+			MaterialBinding binding;
+			binding.location = shader.location(name + number);
+			binding.unit = i;
+			binding.texture = textures[i].id;
+			if (binding.location >= 0)
+			{
+				table->bindings.push_back(binding);
+			}
 		}
-
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-
-		glActiveTexture(GL_TEXTURE0);
+		return *table;
 	}
 
-private:
-	unsigned int VBO, EBO;
-
-	void setupMesh()
+	void setupMesh(const void* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount, MeshArena* arena)
 	{
+		this->indexCount = indexCount;
+		if (lods.empty())
+		{
+			MeshLod full = { 0, indexCount, 0.0f };
+			lods.push_back(full);
+		}
+
+		if (arena != nullptr)
+		{
+			MeshArena::Range range = arena->append(vertexData, vertexCount, indexData, indexCount, layout);
+			VAO = arena->vertexArray();
+			VBO = EBO = 0;
+			firstIndex = range.firstIndex;
+			baseVertex = range.baseVertex;
+			return;
+		}
+		firstIndex = 0;
+		baseVertex = 0;
+
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
 		glGenBuffers(1, &EBO);
@@ -100,25 +693,12 @@ private:
 		glBindVertexArray(VAO);
 
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertexCount * layout.vertexSize(), vertexData, GL_STATIC_DRAW);
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-		
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
 
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+		setupVertexAttributes(layout.format);
 
 		glBindVertexArray(0);
 	}
@@ -3,10 +3,22 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <unordered_set>
 #include <iostream>
+#include <chrono>
+#include <memory>
+#include <functional>
 
 #include <Shader.h>
 #include <mesh.h>
+#include <ModelCache.h>
+#include <TextureLoader.h>
+#include <MeshOptimizer.h>
+#include <MeshSimplifier.h>
+#include <Meshlets.h>
+#include <Frustum.h>
+#include <RenderQueue.h>
+#include <ProcessMemory.h>
 
 #include <stb_image.h>
 
@@ -18,67 +30,813 @@ using namespace std;
 
 unsigned int TextureFromFile(const char* path, const string & directory, bool gamma = false);
 
+// What Model::selectLod needs to know about the camera: where it is, how many pixels one world unit
+// covers at distance 1, and how far in pixels a LOD may move the surface.
+struct LodCamera
+{
+	glm::vec3 position;
+	float pixelsPerUnit;
+	float maxPixelError;
+
+	LodCamera(const glm::vec3 & position, float fovY, float viewportHeight, float maxPixelError = 1.0f)
+		: position(position), pixelsPerUnit(viewportHeight / (2.0f * std::tan(fovY * 0.5f))), maxPixelError(maxPixelError) {}
+
+	// The coarsest of the levels with lodErrors, in model units, whose error projected to the screen at
+	// the distance of sphere moved by transform stays within maxPixelError. Level 0 when the camera is
+	// inside the sphere.
+	unsigned int select(const BoundingSphere & sphere, const vector<float> & lodErrors, const glm::mat4 & transform) const
+	{
+		BoundingSphere bounds = sphere.transformed(transform);
+		float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+		float distance = glm::length(bounds.center - position) - bounds.radius;
+		if (distance <= 0.0f)
+		{
+			return 0;
+		}
+		for (unsigned int lod = (unsigned int)lodErrors.size() - 1; lod > 0; lod--)
+		{
+			if (lodErrors[lod] * scale / distance * pixelsPerUnit <= maxPixelError)
+			{
+				return lod;
+			}
+		}
+		return 0;
+	}
+};
+
+// Everything Model::import reads from a file without touching GL, so it can run on a worker thread:
+// the geometry, LODs and meshlets of every mesh and the textures they use. A Model is then built
+// from it on the GL thread, at once or a few steps per frame.
+struct ModelData
+{
+	struct MeshData
+	{
+		// the imported geometry, empty when it comes from the cooked file
+		vector<Vertex> vertices;
+		vector<unsigned int> indices;
+		// the imported vertices in the compact GPU layout, empty for full vertices and cooked models
+		vector<unsigned char> encoded;
+		// what gets uploaded, in the GPU layout of ModelData::layout: the vectors above or the mapped cooked file
+		const void* vertexData;
+		unsigned int vertexCount;
+		const unsigned int* indexData;
+		unsigned int indexCount;
+		// type and path of every texture of the material
+		vector<pair<string, string>> textures;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		// computed once at import and cooked with the mesh, so a warm load never reads the vertices
+		BoundingSphere sphere;
+		vector<MeshLod> lods;
+		vector<Meshlet> meshlets;
+		vector<MeshletBounds> meshletBounds;
+	};
+
+	string path;
+	string directory;
+	// false when the file could not be read, the model stays empty
+	bool valid;
+	VertexLayout layout;
+	vector<MeshData> meshes;
+	// type and path of every texture file once, in the order the materials use them
+	vector<pair<string, string>> textures;
+	// the pixels of textures in the same order, empty unless the import decoded them
+	vector<TextureLoader::Image> images;
+	// the mapping the meshes of a cooked model point into
+	std::unique_ptr<CookedModel> cooked;
+
+	// how far Model::upload got
+	bool uploadStarted;
+	size_t uploadedTextures;
+	size_t uploadedMeshes;
+	bool uploaded;
+
+	ModelData() : valid(false), uploadStarted(false), uploadedTextures(0), uploadedMeshes(0), uploaded(false) {}
+
+	ModelData(const ModelData &) = delete;
+	ModelData & operator=(const ModelData &) = delete;
+
+	~ModelData()
+	{
+		for (TextureLoader::Image & image : images)
+		{
+			stbi_image_free(image.data);
+		}
+	}
+};
+
 class Model 
 {
 public:
+	// every texture this model uses once, in load order
 	vector<Texture> texture_loads;
 	vector<Mesh> meshes;
 	string directory;
 	bool gammaCorrection;
 
 
-	Model(const char* path, bool gamma = false) : gammaCorrection(gamma)
+	// packed puts all meshes into one MeshArena. Draw then binds a single VAO and issues one draw per
+	// material instead of one per mesh. VertexFormat::Compact quantizes every mesh against the box of
+	// the whole model, the shader decodes it as in Shaders/vertex_compression.glsl. The CPU copy of
+	// the geometry is freed once it is on the GPU, keepCpuCopy keeps it in Mesh::vertices and
+	// Mesh::indices, e.g. for picking or physics. ModelLoader loads the same model in the background.
+	Model(const char* path, bool gamma = false, bool packed = false, VertexFormat format = VertexFormat::Full, bool keepCpuCopy = false)
+		: Model(gamma, packed, format, keepCpuCopy)
 	{
-		loadModel(path);
+		ModelData data;
+		import(path, format, false, data);
+		upload(data, std::chrono::steady_clock::time_point::max());
 	}
 
-	void Draw(Shader & shader)
+	// Reads the model at path into data without touching GL: from the cooked cache when it was cooked
+	// from the same sources, otherwise with Assimp, and cooks it for the next start. decodeTextures
+	// also decodes the texture files, otherwise the upload has TextureCache decode them. onBounds, when
+	// set, gets the box around all meshes as soon as it is known, before the meshes are processed.
+	static void import(const string & path, VertexFormat format, bool decodeTextures, ModelData & data,
+		const std::function<void(const glm::vec3 &, const glm::vec3 &)> & onBounds = nullptr)
 	{
-		for (unsigned int i = 0; i < meshes.size(); i++)
+		// the simplifier needs triangles to share vertices, .obj files come with three per face
+		const unsigned int importFlags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		data.path = path;
+		data.layout.format = format;
+		size_t slash = path.find_last_of("/\\");
+		data.directory = slash == string::npos ? string(".") : path.substr(0, slash);
+
+		string options = string("optimize=") + (MeshOptimizer::enabled() ? "1" : "0") + ";meshlets=" + (MeshletBuilder::enabled() ? "1" : "0") + ";lods=";
+		for (float ratio : MeshSimplifier::lodRatios())
 		{
-			meshes[i].Draw(shader);
+			options += std::to_string(ratio) + ",";
+		}
+		options += format == VertexFormat::Compact ? ";format=compact" : ";format=full";
+		bool useCache = !ModelCache::directory().empty();
+		uint64_t sourceHash = useCache ? ModelCache::sourceHash(path, importFlags, options) : 0;
+		if (useCache && loadCooked(path, sourceHash, data, onBounds))
+		{
+			decodeTexturesIf(decodeTextures, data);
+			printLoadTime(path, "loaded from cooked cache", start);
+			return;
 		}
-	}
 
-private:
-	void loadModel(string const & path)
-	{
 		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+		const aiScene* scene = importer.ReadFile(path, importFlags);
 		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 		{
 			cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
 			return;
 		}
 
-		directory = path.substr(0, path.find_last_not_of('/'));
+		glm::vec3 boundsMin(scene->mNumMeshes == 0 ? 0.0f : FLT_MAX);
+		glm::vec3 boundsMax(scene->mNumMeshes == 0 ? 0.0f : -FLT_MAX);
+		for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+		{
+			for (unsigned int i = 0; i < scene->mMeshes[m]->mNumVertices; i++)
+			{
+				const aiVector3D & position = scene->mMeshes[m]->mVertices[i];
+				boundsMin = glm::min(boundsMin, glm::vec3(position.x, position.y, position.z));
+				boundsMax = glm::max(boundsMax, glm::vec3(position.x, position.y, position.z));
+			}
+		}
+		if (format == VertexFormat::Compact)
+		{
+			data.layout = VertexLayout::compact(boundsMin, boundsMax);
+		}
+		if (onBounds)
+		{
+			onBounds(boundsMin, boundsMax);
+		}
+
+		cout << "directory: " << data.directory << endl;
+
+		const aiTextureType types[] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_NORMALS, aiTextureType_HEIGHT };
+		const char* typeNames[] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+		for (unsigned int m = 0; m < scene->mNumMaterials; m++)
+		{
+			for (int t = 0; t < 4; t++)
+			{
+				for (unsigned int i = 0; i < scene->mMaterials[m]->GetTextureCount(types[t]); i++)
+				{
+					aiString str;
+					scene->mMaterials[m]->GetTexture(types[t], i, &str);
+					addTexturePath(data, typeNames[t], str.C_Str());
+				}
+			}
+		}
+		decodeTexturesIf(decodeTextures, data);
+
+		MeshOptimizer::resetReport();
+		data.meshes.reserve(scene->mNumMeshes);
+		processNode(scene->mRootNode, scene, data);
+		if (MeshOptimizer::enabled())
+		{
+			MeshOptimizer::printReport(path);
+		}
+		if (format == VertexFormat::Compact)
+		{
+			encodeMeshes(data);
+		}
+		data.valid = true;
+		printLoadTime(path, "imported with assimp", start);
+
+		if (useCache)
+		{
+			cook(path, sourceHash, data);
+		}
+	}
+
+	// instanceCount > 1 draws every mesh that many times, the shader tells the copies apart by gl_InstanceID.
+	// lod 0 is the full model, higher levels are clamped to the coarsest one.
+	void Draw(Shader & shader, unsigned int instanceCount = 1, unsigned int lod = 0)
+	{
+		if (!arena)
+		{
+			// consecutive meshes with the same material bind it once
+			const Mesh* bound = nullptr;
+			for (Mesh & mesh : meshes)
+			{
+				if (bound == nullptr || !bound->sameMaterial(mesh))
+				{
+					mesh.bindMaterial(shader);
+					bound = &mesh;
+				}
+				mesh.drawGeometry(instanceCount, lod);
+			}
+			GLStateCache::activeTexture(GL_TEXTURE0);
+			return;
+		}
+
+		unsigned int level = std::min(lod, lodCount() - 1);
+		for (const DrawGroup & group : drawGroups)
+		{
+			meshes[group.mesh].bindMaterial(shader);
+			arena->draw(level * (unsigned int)meshes.size() + group.firstCommand, group.commandCount, instanceCount);
+		}
+		GLStateCache::activeTexture(GL_TEXTURE0);
+	}
+
+	// Draws the LOD selectLod picks for one copy of the model at transform. The caller still sets the
+	// model matrix of the shader.
+	void Draw(Shader & shader, const LodCamera & camera, const glm::mat4 & transform)
+	{
+		Draw(shader, 1, selectLod(camera, transform));
+	}
+
+	// The coarsest LOD whose simplification error, projected to the screen at the distance of the
+	// model's bounding sphere, stays within camera.maxPixelError. A copy covering many pixels keeps
+	// the full mesh, a copy far away drops to the coarsest level.
+	unsigned int selectLod(const LodCamera & camera, const glm::mat4 & transform) const
+	{
+		return camera.select(sphere, lodErrors, transform);
+	}
+
+	// Draws the full level of one copy at transform, meshlet by meshlet, skipping the meshlets outside
+	// frustum or facing away from camera, both in world space. The caller sets the model matrix of the
+	// shader. Returns the triangles drawn.
+	unsigned long long DrawClusters(Shader & shader, const Frustum & frustum, const glm::vec3 & camera, const glm::mat4 & transform)
+	{
+		Frustum local = frustum.transformed(transform);
+		glm::vec3 localCamera = glm::vec3(glm::inverse(transform) * glm::vec4(camera, 1.0f));
+		unsigned long long triangles = 0;
+		for (Mesh & mesh : meshes)
+		{
+			triangles += mesh.DrawClusters(shader, local, localCamera);
+		}
+		return triangles;
+	}
+
+	// Queues what Draw(shader, instanceCount, lod) would draw: one packet per mesh or, when packed,
+	// per group of meshes sharing a material. The instanceCount transforms go to transformUniform.
+	// depth is the view distance the packets sort by, e.g. of the nearest copy.
+	void Submit(RenderQueue & queue, unsigned int pass, Shader & shader, Uniform<glm::mat4> transformUniform,
+		const glm::mat4* transforms, unsigned int instanceCount, unsigned int lod, float depth)
+	{
+		DrawPacket packet = { &shader, nullptr, arena.get(), 0, 0, lod, -1, transformUniform, queue.addTransforms(transforms, instanceCount), instanceCount };
+		if (!arena)
+		{
+			for (Mesh & mesh : meshes)
+			{
+				packet.mesh = &mesh;
+				queue.add(packet, pass, depth);
+			}
+			return;
+		}
+
+		unsigned int level = std::min(lod, lodCount() - 1);
+		for (const DrawGroup & group : drawGroups)
+		{
+			packet.mesh = &meshes[group.mesh];
+			packet.firstCommand = level * (unsigned int)meshes.size() + group.firstCommand;
+			packet.commandCount = group.commandCount;
+			queue.add(packet, pass, depth);
+		}
+	}
+
+	// Queues what DrawClusters would draw, one packet per mesh. The queue culls the meshlets when it
+	// submits them and leaves out meshes with none visible.
+	void SubmitClusters(RenderQueue & queue, unsigned int pass, Shader & shader, Uniform<glm::mat4> transformUniform,
+		const Frustum & frustum, const glm::vec3 & camera, const glm::mat4 & transform, float depth)
+	{
+		Frustum local = frustum.transformed(transform);
+		glm::vec3 localCamera = glm::vec3(glm::inverse(transform) * glm::vec4(camera, 1.0f));
+		DrawPacket packet = { &shader, nullptr, nullptr, 0, 0, 0, queue.addClusterView(local, localCamera), transformUniform,
+			queue.addTransforms(&transform, 1), 1 };
+		for (Mesh & mesh : meshes)
+		{
+			packet.mesh = &mesh;
+			queue.add(packet, pass, depth);
+		}
+	}
+
+	size_t meshletCount() const
+	{
+		size_t count = 0;
+		for (const Mesh & mesh : meshes)
+		{
+			count += mesh.meshlets.size();
+		}
+		return count;
+	}
+
+	// Radius of the bounding sphere in pixels, for callers that pick LODs by coverage instead.
+	float projectedSize(const LodCamera & camera, const glm::mat4 & transform) const
+	{
+		BoundingSphere bounds = sphere.transformed(transform);
+		float distance = std::max(glm::length(bounds.center - camera.position), 1e-4f);
+		return bounds.radius / distance * camera.pixelsPerUnit;
+	}
+
+	// Model-space box and sphere around every mesh, known once the model is loaded.
+	const BoundingBox & bounds() const
+	{
+		return box;
+	}
+
+	const BoundingSphere & boundingSphere() const
+	{
+		return sphere;
+	}
+
+	unsigned int lodCount() const
+	{
+		return (unsigned int)lodErrors.size();
+	}
+
+	unsigned long long triangleCount(unsigned int lod = 0) const
+	{
+		unsigned long long triangles = 0;
+		for (const Mesh & mesh : meshes)
+		{
+			triangles += mesh.lod(lod).indexCount / 3;
+		}
+		return triangles;
+	}
+
+private:
+	friend class ModelLoader;
 
-		directory = "model";
+	unordered_set<string> loadedPaths;
+	bool keepCpuCopy;
 
-		cout << "directory: " << directory << endl;
+	// Meshes of a packed model that share a material, drawn with one call. mesh is the first of them
+	// and provides the texture bindings.
+	struct DrawGroup
+	{
+		unsigned int mesh;
+		unsigned int firstCommand;
+		unsigned int commandCount;
+	};
+	std::unique_ptr<MeshArena> arena;
+	vector<DrawGroup> drawGroups;
+	VertexLayout layout;
+	// bounds of all meshes and, per LOD, the largest error of any mesh
+	BoundingBox box;
+	BoundingSphere sphere;
+	vector<float> lodErrors;
 
-		processNode(scene->mRootNode, scene);
+	// An empty model for upload() to fill.
+	Model(bool gamma, bool packed, VertexFormat format, bool keepCpuCopy) : gammaCorrection(gamma), keepCpuCopy(keepCpuCopy)
+	{
+		layout.format = format;
+		if (packed)
+		{
+			arena.reset(new MeshArena(format));
+		}
 	}
 
-	void processNode(aiNode* node, const aiScene* scene)
+	// Builds the model from data one step at a time, a step being one texture, one mesh or the packing
+	// and reports at the end, until it is done or deadline has passed. At least one step runs per call.
+	// Returns true once the model is complete, data can be dropped then.
+	bool upload(ModelData & data, std::chrono::steady_clock::time_point deadline)
+	{
+		if (!data.uploadStarted)
+		{
+			data.uploadStarted = true;
+			directory = data.directory;
+			layout = data.layout;
+			meshes.reserve(data.meshes.size());
+		}
+
+		do
+		{
+			if (data.uploadedTextures < data.textures.size())
+			{
+				uploadTextures(data);
+			}
+			else if (data.uploadedMeshes < data.meshes.size())
+			{
+				uploadMesh(data.meshes[data.uploadedMeshes++]);
+			}
+			else
+			{
+				finishUpload(data);
+			}
+		}
+		while (!data.uploaded && std::chrono::steady_clock::now() < deadline);
+		return data.uploaded;
+	}
+
+	// Decoded textures go up one per step. Without decoded images TextureCache decodes them all in
+	// parallel within one step.
+	void uploadTextures(ModelData & data)
+	{
+		if (data.images.empty())
+		{
+			preloadTextures(data.textures);
+			data.uploadedTextures = data.textures.size();
+			return;
+		}
+
+		size_t t = data.uploadedTextures++;
+		addTexture(data.textures[t].second, data.textures[t].first,
+			TextureCache::acquire(directory + '/' + data.textures[t].second, data.images[t], textureFlags(data.textures[t].first)));
+	}
+
+	void uploadMesh(ModelData::MeshData & mesh)
+	{
+		vector<Texture> textures;
+		textures.reserve(mesh.textures.size());
+		for (const pair<string, string> & texture : mesh.textures)
+		{
+			textures.push_back(loadTexture(texture.second.c_str(), texture.first));
+		}
+
+		meshes.emplace_back(mesh.vertexData, mesh.vertexCount, mesh.indexData, mesh.indexCount, std::move(textures),
+			mesh.boundsMin, mesh.boundsMax, mesh.sphere, arena.get(), layout, std::move(mesh.lods));
+		if (!mesh.meshlets.empty())
+		{
+			meshes.back().setMeshlets(mesh.meshlets, mesh.meshletBounds);
+		}
+
+		if (keepCpuCopy && mesh.vertices.empty())
+		{
+			decodeVertices(mesh.vertexData, mesh.vertexCount, layout, meshes.back().vertices);
+			meshes.back().indices.assign(mesh.indexData, mesh.indexData + mesh.indexCount);
+		}
+		else if (keepCpuCopy)
+		{
+			meshes.back().vertices = std::move(mesh.vertices);
+			meshes.back().indices = std::move(mesh.indices);
+		}
+		else
+		{
+			vector<Vertex>().swap(mesh.vertices);
+			vector<unsigned int>().swap(mesh.indices);
+		}
+		vector<unsigned char>().swap(mesh.encoded);
+	}
+
+	void finishUpload(ModelData & data)
+	{
+		computeLods();
+		if (arena)
+		{
+			packMeshes();
+		}
+		if (lodErrors.size() > 1)
+		{
+			printLods(data.path);
+		}
+		if (meshletCount() > 0)
+		{
+			printMeshlets(data.path);
+		}
+		ProcessMemory::print("after loading " + data.path + (keepCpuCopy ? " (CPU copy kept)" : ""));
+		data.uploaded = true;
+	}
+
+	static bool loadCooked(const string & path, uint64_t sourceHash, ModelData & data,
+		const std::function<void(const glm::vec3 &, const glm::vec3 &)> & onBounds)
+	{
+		data.cooked.reset(new CookedModel(ModelCache::path(path), sourceHash, (uint32_t)data.layout.vertexSize()));
+		const CookedModel & cooked = *data.cooked;
+		if (!cooked.valid())
+		{
+			data.cooked.reset();
+			return false;
+		}
+
+		const CookedModelHeader & header = cooked.header();
+		for (uint32_t t = 0; t < header.textureCount; t++)
+		{
+			addTexturePath(data, cooked.text(cooked.textures()[t].type), cooked.text(cooked.textures()[t].path));
+		}
+
+		glm::vec3 boundsMin(header.meshCount == 0 ? 0.0f : FLT_MAX);
+		glm::vec3 boundsMax(header.meshCount == 0 ? 0.0f : -FLT_MAX);
+		for (uint32_t i = 0; i < header.meshCount; i++)
+		{
+			const CookedMesh & mesh = cooked.meshes()[i];
+			boundsMin = glm::min(boundsMin, glm::vec3(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]));
+			boundsMax = glm::max(boundsMax, glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]));
+		}
+		if (data.layout.format == VertexFormat::Compact)
+		{
+			// the box the vertices were encoded in when they were cooked
+			data.layout.positionOffset = glm::make_vec3(header.positionOffset);
+			data.layout.positionScale = glm::make_vec3(header.positionScale);
+		}
+		if (onBounds)
+		{
+			onBounds(boundsMin, boundsMax);
+		}
+
+		const unsigned char* vertices = (const unsigned char*)cooked.vertices();
+		data.meshes.resize(header.meshCount);
+		for (uint32_t i = 0; i < header.meshCount; i++)
+		{
+			const CookedMesh & mesh = cooked.meshes()[i];
+			ModelData::MeshData & meshData = data.meshes[i];
+			meshData.vertexData = vertices + (size_t)mesh.firstVertex * data.layout.vertexSize();
+			meshData.vertexCount = mesh.vertexCount;
+			meshData.indexData = cooked.indices() + mesh.firstIndex;
+			meshData.indexCount = mesh.indexCount;
+			meshData.boundsMin = glm::vec3(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+			meshData.boundsMax = glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]);
+			meshData.sphere = BoundingSphere(glm::make_vec3(mesh.sphereCenter), mesh.sphereRadius);
+
+			for (uint32_t t = mesh.firstTexture; t < mesh.firstTexture + mesh.textureCount; t++)
+			{
+				const CookedTexture & texture = cooked.textures()[t];
+				meshData.textures.push_back(make_pair(string(cooked.text(texture.type)), string(cooked.text(texture.path))));
+			}
+
+			for (uint32_t l = 0; l < std::min(mesh.lodCount, COOKED_MAX_LODS); l++)
+			{
+				MeshLod lod = { mesh.lods[l].firstIndex, mesh.lods[l].indexCount, mesh.lods[l].error };
+				if (lod.firstIndex + lod.indexCount <= mesh.indexCount)
+				{
+					meshData.lods.push_back(lod);
+				}
+			}
+
+			// meshlets cover level 0, which is all indices when there are no LODs
+			unsigned int fullIndexCount = meshData.lods.empty() ? mesh.indexCount : meshData.lods[0].indexCount;
+			for (uint32_t m = mesh.firstMeshlet; m < mesh.firstMeshlet + mesh.meshletCount && m < header.meshletCount; m++)
+			{
+				const CookedMeshlet & cookedMeshlet = cooked.meshlets()[m];
+				Meshlet meshlet = { cookedMeshlet.firstIndex, cookedMeshlet.triangleCount };
+				MeshletBounds meshletBounds;
+				meshletBounds.center = glm::make_vec3(cookedMeshlet.center);
+				meshletBounds.radius = cookedMeshlet.radius;
+				meshletBounds.coneAxis = glm::make_vec3(cookedMeshlet.coneAxis);
+				meshletBounds.coneCutoff = cookedMeshlet.coneCutoff;
+				if (meshlet.firstIndex + meshlet.triangleCount * 3 <= fullIndexCount)
+				{
+					meshData.meshlets.push_back(meshlet);
+					meshData.meshletBounds.push_back(meshletBounds);
+				}
+			}
+		}
+		data.valid = true;
+		return true;
+	}
+
+	static void cook(const string & path, uint64_t sourceHash, const ModelData & data)
+	{
+		CookedModelWriter writer((uint32_t)data.layout.vertexSize(), glm::value_ptr(data.layout.positionOffset), glm::value_ptr(data.layout.positionScale));
+		for (const ModelData::MeshData & mesh : data.meshes)
+		{
+			vector<CookedLod> lods;
+			for (const MeshLod & lod : mesh.lods)
+			{
+				CookedLod cooked = { lod.firstIndex, lod.indexCount, lod.error };
+				lods.push_back(cooked);
+			}
+			vector<CookedMeshlet> meshlets;
+			for (size_t m = 0; m < mesh.meshlets.size(); m++)
+			{
+				const MeshletBounds & bounds = mesh.meshletBounds[m];
+				CookedMeshlet cooked = { mesh.meshlets[m].firstIndex, mesh.meshlets[m].triangleCount,
+					{ bounds.center.x, bounds.center.y, bounds.center.z }, bounds.radius,
+					{ bounds.coneAxis.x, bounds.coneAxis.y, bounds.coneAxis.z }, bounds.coneCutoff };
+				meshlets.push_back(cooked);
+			}
+			writer.addMesh(mesh.vertexData, mesh.vertexCount, mesh.indexData, mesh.indexCount,
+				mesh.textures, glm::value_ptr(mesh.boundsMin), glm::value_ptr(mesh.boundsMax), glm::value_ptr(mesh.sphere.center), mesh.sphere.radius,
+				lods.data(), (uint32_t)lods.size(),
+				meshlets.data(), (uint32_t)meshlets.size());
+		}
+		writer.write(ModelCache::path(path), sourceHash);
+	}
+
+	// Every file goes into data.textures once, with the type it is first used as.
+	static void addTexturePath(ModelData & data, const string & type, const string & path)
+	{
+		for (const pair<string, string> & texture : data.textures)
+		{
+			if (texture.second == path)
+			{
+				return;
+			}
+		}
+		data.textures.push_back(make_pair(type, path));
+	}
+
+	static void decodeTexturesIf(bool decodeTextures, ModelData & data)
+	{
+		if (!decodeTextures)
+		{
+			return;
+		}
+		vector<string> files;
+		for (const pair<string, string> & texture : data.textures)
+		{
+			files.push_back(data.directory + '/' + texture.second);
+		}
+		data.images = TextureLoader::decodeAll(files);
+	}
+
+	// Uploads the arena and orders the draw commands by material, so every run of meshes with the
+	// same textures becomes one range for MeshArena::draw. Every LOD gets its own copy of the
+	// commands, level l starts at command l * meshes.size().
+	void packMeshes()
+	{
+		arena->upload();
+
+		vector<vector<unsigned int>> groups;
+		for (unsigned int i = 0; i < meshes.size(); i++)
+		{
+			bool grouped = false;
+			for (vector<unsigned int> & group : groups)
+			{
+				if (meshes[group[0]].sameMaterial(meshes[i]))
+				{
+					group.push_back(i);
+					grouped = true;
+					break;
+				}
+			}
+			if (!grouped)
+			{
+				groups.push_back(vector<unsigned int>(1, i));
+			}
+		}
+
+		vector<DrawElementsIndirectCommand> commands;
+		for (unsigned int lod = 0; lod < lodCount(); lod++)
+		{
+			for (const vector<unsigned int> & group : groups)
+			{
+				if (lod == 0)
+				{
+					DrawGroup drawGroup;
+					drawGroup.mesh = group[0];
+					drawGroup.firstCommand = (unsigned int)commands.size();
+					drawGroup.commandCount = (unsigned int)group.size();
+					drawGroups.push_back(drawGroup);
+				}
+
+				for (unsigned int i : group)
+				{
+					DrawElementsIndirectCommand command;
+					command.count = meshes[i].lod(lod).indexCount;
+					command.instanceCount = 1;
+					command.firstIndex = meshes[i].firstIndex + meshes[i].lod(lod).firstIndex;
+					command.baseVertex = meshes[i].baseVertex;
+					command.baseInstance = 0;
+					commands.push_back(command);
+				}
+			}
+		}
+		arena->setCommands(commands);
+
+		cout << "packed " << meshes.size() << " meshes into " << drawGroups.size() << " draws ("
+			<< (MeshArena::multiDrawIndirectSupported() ? "multi-draw indirect" : "base vertex loop") << ")" << endl;
+	}
+
+	// Box and sphere around all meshes and the error of every LOD level over all meshes.
+	void computeLods()
+	{
+		glm::vec3 boundsMin(meshes.empty() ? 0.0f : FLT_MAX);
+		glm::vec3 boundsMax(meshes.empty() ? 0.0f : -FLT_MAX);
+		size_t levels = 1;
+		for (const Mesh & mesh : meshes)
+		{
+			boundsMin = glm::min(boundsMin, mesh.boundsMin);
+			boundsMax = glm::max(boundsMax, mesh.boundsMax);
+			levels = std::max(levels, mesh.lods.size());
+		}
+		box = BoundingBox(boundsMin, boundsMax);
+		sphere = BoundingSphere(box.center(), 0.0f);
+		for (const Mesh & mesh : meshes)
+		{
+			sphere.radius = std::max(sphere.radius, glm::length(mesh.boundingSphere.center - sphere.center) + mesh.boundingSphere.radius);
+		}
+		sphere.radius = std::min(sphere.radius, glm::length(box.extent()));
+
+		lodErrors.assign(levels, 0.0f);
+		for (const Mesh & mesh : meshes)
+		{
+			for (unsigned int lod = 0; lod < levels; lod++)
+			{
+				lodErrors[lod] = std::max(lodErrors[lod], mesh.lod(lod).error);
+			}
+		}
+	}
+
+	// Triangles and error of every LOD, the error also relative to the bounding sphere diameter.
+	void printLods(const string & path) const
+	{
+		for (unsigned int lod = 0; lod < lodCount(); lod++)
+		{
+			cout << "LOD " << lod << " of " << path << ": " << triangleCount(lod) << " triangles ("
+				<< 100.0f * triangleCount(lod) / std::max(triangleCount(0), 1ULL) << "%), error " << lodErrors[lod]
+				<< " (" << (sphere.radius > 0.0f ? 50.0f * lodErrors[lod] / sphere.radius : 0.0f) << "% of the model size)" << endl;
+		}
+	}
+
+	// Number of meshlets, their average size and how many have a normal cone narrow enough to be culled.
+	void printMeshlets(const string & path) const
+	{
+		size_t triangles = 0;
+		size_t cones = 0;
+		for (const Mesh & mesh : meshes)
+		{
+			for (size_t m = 0; m < mesh.meshlets.size(); m++)
+			{
+				triangles += mesh.meshlets[m].triangleCount;
+				cones += mesh.meshletBounds[m].coneCutoff < 1.0f ? 1 : 0;
+			}
+		}
+		cout << "meshlets of " << path << ": " << meshletCount() << ", " << (float)triangles / meshletCount() << " triangles each, "
+			<< 100.0f * cones / meshletCount() << "% with a normal cone" << endl;
+	}
+
+	// Encodes the imported vertices of every mesh in the compact layout once, so the upload and the
+	// cooked file both take the GPU bytes as they are.
+	static void encodeMeshes(ModelData & data)
+	{
+		VertexCompression::resetError();
+		for (ModelData::MeshData & mesh : data.meshes)
+		{
+			encodeVertices(mesh.vertices.data(), mesh.vertexCount, data.layout, mesh.encoded);
+			mesh.vertexData = mesh.encoded.data();
+		}
+		printCompression();
+	}
+
+	// Reports the size of the compact vertices and checks the largest decode error against the
+	// tolerances in VertexCompression::Error.
+	static void printCompression()
+	{
+		const VertexCompression::Error & error = VertexCompression::error();
+		cout << "compact vertices: " << error.vertices << " vertices, " << sizeof(CompactVertex) << " bytes each instead of " << sizeof(Vertex)
+			<< ", max error " << error.position << " steps, " << error.normal << " deg normal, " << error.tangent << " deg tangent, "
+			<< error.texCoord << " uv" << endl;
+		if (!error.withinTolerance())
+		{
+			cout << "ERROR::MODEL::VERTEX_COMPRESSION_ERROR_OUT_OF_TOLERANCE" << endl;
+		}
+	}
+
+	static void printLoadTime(const string & path, const char* how, std::chrono::steady_clock::time_point start)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		cout << "model " << path << " " << how << " in " << elapsed.count() << " ms" << endl;
+	}
+
+	static void processNode(aiNode* node, const aiScene* scene, ModelData & data)
 	{
 		for (unsigned int i = 0; i < node->mNumMeshes; i++)
 		{
 			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			meshes.push_back(processMesh(mesh, scene));
+			data.meshes.push_back(processMesh(mesh, scene));
 		}
 
 		for (unsigned int i = 0; i < node->mNumChildren; i++)
 		{
-			processNode(node->mChildren[i], scene);
+			processNode(node->mChildren[i], scene, data);
 		}
 	}
 
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+	static ModelData::MeshData processMesh(aiMesh* mesh, const aiScene* scene)
 	{
-		vector<Vertex> vertices;
-		vector<unsigned	int> indices;
-		vector<Texture> textures;
+		ModelData::MeshData result;
+		vector<Vertex> & vertices = result.vertices;
+		vector<unsigned	int> & indices = result.indices;
+		vertices.reserve(mesh->mNumVertices);
+		indices.reserve(mesh->mNumFaces * 3);
 
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 		{
@@ -131,96 +889,143 @@ private:
 			}
 		}
 
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-		vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-
-		vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal");
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+		if (MeshOptimizer::enabled() && !vertices.empty())
+		{
+			std::vector<unsigned int> remap = MeshOptimizer::optimize(indices.data(), indices.size(), (unsigned int)vertices.size(),
+				&vertices[0].Position.x, sizeof(Vertex));
+			MeshOptimizer::remapVertices(vertices.data(), (unsigned int)vertices.size(), remap);
+		}
+		if (MeshletBuilder::enabled() && !vertices.empty())
+		{
+			result.meshlets = MeshletBuilder::build(indices.data(), indices.size(), (unsigned int)vertices.size());
+			for (const Meshlet & meshlet : result.meshlets)
+			{
+				result.meshletBounds.push_back(MeshletBuilder::computeBounds(indices.data() + meshlet.firstIndex, meshlet.triangleCount,
+					&vertices[0].Position.x, sizeof(Vertex)));
+			}
+		}
+		result.lods = buildLods(vertices, indices);
 
-		vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_height");
-		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+		result.boundsMin = glm::vec3(vertices.empty() ? 0.0f : FLT_MAX);
+		result.boundsMax = glm::vec3(vertices.empty() ? 0.0f : -FLT_MAX);
+		for (const Vertex & vertex : vertices)
+		{
+			result.boundsMin = glm::min(result.boundsMin, vertex.Position);
+			result.boundsMax = glm::max(result.boundsMax, vertex.Position);
+		}
+		result.sphere = BoundingSphere::around((result.boundsMin + result.boundsMax) * 0.5f, vertices.empty() ? nullptr : &vertices[0].Position.x,
+			vertices.size(), sizeof(Vertex));
+		// moving the vectors keeps their buffers, so these stay valid when result is moved
+		result.vertexData = vertices.data();
+		result.vertexCount = (unsigned int)vertices.size();
+		result.indexData = indices.data();
+		result.indexCount = (unsigned int)indices.size();
 
-		return Mesh(vertices, indices, textures);
+		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+		addMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", result.textures);
+		addMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", result.textures);
+		addMaterialTextures(material, aiTextureType_NORMALS, "texture_normal", result.textures);
+		addMaterialTextures(material, aiTextureType_HEIGHT, "texture_height", result.textures);
+		return result;
 	}
 
-	vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName) 
+	// Simplifies each level from the one before it for every MeshSimplifier::lodRatios() entry and
+	// appends the LOD indices to indices. A level's error adds up the errors of the steps before it.
+	// The chain stops early when a level would barely be smaller than the last.
+	static vector<MeshLod> buildLods(const vector<Vertex> & vertices, vector<unsigned int> & indices)
 	{
-		vector<Texture> textures;
-		for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+		MeshLod full = { 0, (unsigned int)indices.size(), 0.0f };
+		vector<MeshLod> lods(1, full);
+		for (float ratio : MeshSimplifier::lodRatios())
 		{
-			aiString str;
-			mat->GetTexture(type, i, &str);
-			bool skip = false;
-			for (unsigned int j = 0; j < texture_loads.size(); j++)
+			if (lods.size() >= COOKED_MAX_LODS || vertices.empty())
 			{
-				if (std::strcmp(texture_loads[j].path.data(), str.C_Str()) == 0)
-				{
-					textures.push_back(texture_loads[j]);
-					skip = true;
-					break;
-				}
+				break;
 			}
-			if (!skip)
+			MeshLod previous = lods.back();
+			size_t target = (size_t)(full.indexCount / 3 * ratio) * 3;
+			float error = 0.0f;
+			vector<unsigned int> simplified = MeshSimplifier::simplify(indices.data() + previous.firstIndex, previous.indexCount,
+				(unsigned int)vertices.size(), &vertices[0].Position.x, sizeof(Vertex), target, error);
+			if (simplified.empty() || simplified.size() * 10 > (size_t)previous.indexCount * 9)
 			{
-				Texture texture;
-				texture.id = TextureFromFile(str.C_Str(), this->directory);
-				texture.type = typeName;
-				texture.path = str.C_Str();
-				textures.push_back(texture);
-				texture_loads.push_back(texture);
+				break;
+			}
+			if (MeshOptimizer::enabled())
+			{
+				MeshOptimizer::optimizeVertexCache(simplified.data(), simplified.size(), (unsigned int)vertices.size());
 			}
-		}
 
-		return textures;
+			MeshLod lod = { (unsigned int)indices.size(), (unsigned int)simplified.size(), previous.error + error };
+			indices.insert(indices.end(), simplified.begin(), simplified.end());
+			lods.push_back(lod);
+		}
+		return lods;
 	}
-};
-
-unsigned int TextureFromFile(const char* path, const string & directory, bool gamma)
-{
-	string filename = string(path);
-	filename = directory + '/' + filename;
-
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
 
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
+	static void addMaterialTextures(aiMaterial* mat, aiTextureType type, const string & typeName, vector<pair<string, string>> & textures)
 	{
-		GLenum format;
-		if (nrComponents == 1)
+		for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 		{
-			format = GL_RED;
+			aiString str;
+			mat->GetTexture(type, i, &str);
+			textures.push_back(make_pair(typeName, string(str.C_Str())));
 		}
-		else if (nrComponents == 3)
+	}
+
+	// Acquires every texture the model references from the TextureCache up front, so the files that
+	// are not cached yet are decoded in parallel. The loadTexture() calls while building the meshes
+	// then only hit the cache.
+	void preloadTextures(const vector<pair<string, string>> & typedTexturePaths)
+	{
+		vector<string> files;
+		vector<unsigned int> flags;
+		for (const pair<string, string> & typedPath : typedTexturePaths)
 		{
-			format = GL_RGB;
+			files.push_back(directory + '/' + typedPath.second);
+			flags.push_back(textureFlags(typedPath.first));
 		}
-		else if (nrComponents == 4)
+
+		vector<TextureHandle> handles = TextureCache::acquireAll(files, flags);
+		for (size_t i = 0; i < handles.size(); i++)
 		{
-			format = GL_RGBA;
+			addTexture(typedTexturePaths[i].second, typedTexturePaths[i].first, handles[i]);
 		}
+	}
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	Texture loadTexture(const char* path, const string & typeName)
+	{
+		return addTexture(path, typeName, TextureCache::acquire(directory + '/' + path, textureFlags(typeName)));
+	}
 
-		stbi_image_free(data);
+	// With gammaCorrection the diffuse maps are stored as sRGB, so sampling them returns linear color.
+	// The other maps hold data, not color, and stay linear.
+	unsigned int textureFlags(const string & typeName) const
+	{
+		return gammaCorrection && typeName == "texture_diffuse" ? TEXTURE_SRGB : TEXTURE_DEFAULT;
 	}
-	else 
+
+	Texture addTexture(const string & path, const string & typeName, const TextureHandle & handle)
 	{
-		std::cout << "texture failed to load at path:" << path << std::endl;
+		Texture texture;
+		texture.id = handle.id();
+		texture.type = typeName;
+		texture.path = path;
+		texture.handle = handle;
+		if (loadedPaths.insert(path).second)
+		{
+			texture_loads.push_back(texture);
+		}
+		return texture;
 	}
+};
+
+unsigned int TextureFromFile(const char* path, const string & directory, bool gamma)
+{
+	string filename = string(path);
+	filename = directory + '/' + filename;
 
-	return textureID;
+	unsigned int flags = gamma ? TEXTURE_SRGB : TEXTURE_DEFAULT;
+	TextureLoader::Image image = TextureLoader::decode(filename, flags);
+	return TextureLoader::upload(image, path, flags);
 }
@@ -0,0 +1,200 @@
+// Fragment stage shared by the PBR samples. Features are selected with defines injected by Shader:
+//   NR_LIGHTS             number of point lights, 4 when not given
+//   HAS_MATERIAL_MAPS     albedo/metallic/roughness/ao come from textures instead of uniforms
+//   PACKED_MATERIAL_MAPS  ao/roughness/metallic are the r/g/b channels of ormMap (MaterialCooker)
+//   SRGB_ALBEDO           albedoMap is an sRGB texture and samples as linear color
+//   MATERIAL_ARRAYS       the material maps are texture arrays indexed by the instance's Layer
+//                         (MaterialAtlas), implies PACKED_MATERIAL_MAPS
+//   HAS_NORMAL_MAP        perturb the normal with normalMap
+//   NORMAL_MAP_RG         normalMap holds only x and y (BC5), z is reconstructed
+//   IBL_DIFFUSE           diffuse ambient from irradianceMap
+//   IBL_SPECULAR          split-sum specular ambient from prefilterMap and brdfLUT, implies IBL_DIFFUSE
+
+#ifndef NR_LIGHTS
+#define NR_LIGHTS 4
+#endif
+
+#if defined(IBL_SPECULAR) && !defined(IBL_DIFFUSE)
+#define IBL_DIFFUSE 1
+#endif
+
+#if defined(MATERIAL_ARRAYS) && !defined(PACKED_MATERIAL_MAPS)
+#define PACKED_MATERIAL_MAPS 1
+#endif
+
+#ifdef MATERIAL_ARRAYS
+#define MATERIAL_SAMPLER sampler2DArray
+#define MATERIAL_TEXTURE(map) texture(map, vec3(TexCoords, Layer))
+#else
+#define MATERIAL_SAMPLER sampler2D
+#define MATERIAL_TEXTURE(map) texture(map, TexCoords)
+#endif
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec3 WorldPos;
+in vec3 Normal;
+#ifdef MATERIAL_ARRAYS
+flat in float Layer;
+#endif
+
+#ifdef HAS_MATERIAL_MAPS
+uniform MATERIAL_SAMPLER albedoMap;
+#ifdef PACKED_MATERIAL_MAPS
+uniform MATERIAL_SAMPLER ormMap;
+#else
+uniform sampler2D metallicMap;
+uniform sampler2D roughnessMap;
+uniform sampler2D aoMap;
+#endif
+#else
+uniform vec3 albedo;
+uniform float metallic;
+uniform float roughness;
+uniform float ao;
+#endif
+
+#ifdef HAS_NORMAL_MAP
+uniform MATERIAL_SAMPLER normalMap;
+#endif
+
+// IBL
+#ifdef IBL_DIFFUSE
+uniform samplerCube irradianceMap;
+#endif
+#ifdef IBL_SPECULAR
+uniform samplerCube prefilterMap;
+uniform sampler2D brdfLUT;
+#endif
+
+uniform vec3 lightPositions[NR_LIGHTS];
+uniform vec3 lightColors[NR_LIGHTS];
+
+uniform vec3 camPos;
+
+#include "pbr_brdf.glsl"
+
+#ifdef HAS_NORMAL_MAP
+vec3 getNormalFromMap()
+{
+#ifdef NORMAL_MAP_RG
+    vec3 tangentNormal;
+    tangentNormal.xy = MATERIAL_TEXTURE(normalMap).rg * 2.0 - 1.0;
+    tangentNormal.z = sqrt(max(1.0 - dot(tangentNormal.xy, tangentNormal.xy), 0.0));
+#else
+    vec3 tangentNormal = MATERIAL_TEXTURE(normalMap).xyz * 2.0 - 1.0;
+#endif
+
+    vec3 Q1  = dFdx(WorldPos);
+    vec3 Q2  = dFdy(WorldPos);
+    vec2 st1 = dFdx(TexCoords);
+    vec2 st2 = dFdy(TexCoords);
+
+    vec3 N   = normalize(Normal);
+    vec3 T  = normalize(Q1*st2.t - Q2*st1.t);
+    vec3 B  = -normalize(cross(N, T));
+    mat3 TBN = mat3(T, B, N);
+
+    return normalize(TBN * tangentNormal);
+}
+#endif
+
+void main()
+{
+#ifdef HAS_MATERIAL_MAPS
+#ifdef SRGB_ALBEDO
+	vec3 albedo = MATERIAL_TEXTURE(albedoMap).rgb;
+#else
+	vec3 albedo = pow(MATERIAL_TEXTURE(albedoMap).rgb, vec3(2.2));
+#endif
+#ifdef PACKED_MATERIAL_MAPS
+	vec3 orm = MATERIAL_TEXTURE(ormMap).rgb;
+	float ao = orm.r;
+	float roughness = orm.g;
+	float metallic = orm.b;
+#else
+	float metallic = texture(metallicMap, TexCoords).r;
+	float roughness = texture(roughnessMap, TexCoords).r;
+	float ao = texture(aoMap, TexCoords).r;
+#endif
+#endif
+
+#ifdef HAS_NORMAL_MAP
+	vec3 N = getNormalFromMap();
+#else
+	vec3 N = normalize(Normal);
+#endif
+	vec3 V = normalize(camPos - WorldPos);
+
+	vec3 F0 = vec3(0.04);
+
+	F0 = mix(F0, albedo, metallic);
+
+	vec3 Lo = vec3(0.0);
+	for(int i = 0; i < NR_LIGHTS; i++)
+	{
+		vec3 L = normalize(lightPositions[i] - WorldPos);
+		vec3 H = normalize(V + L);
+
+		float distance = length(lightPositions[i] - WorldPos);
+		float attenuation = 1.0 / (distance * distance);
+		vec3 radiance = lightColors[i] * attenuation;
+
+		float NDF = DistributionGGX(N, H, roughness);
+		float G = GeometrySmith(N, V, L, roughness);
+		vec3 F = fresnelSchlick(clamp(dot(H, V), 0.0, 1.0), F0);
+
+		vec3 nominator = NDF * G * F;
+		float denominator = 4 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0);
+		vec3 specular = nominator / max(denominator, 0.001);
+
+		vec3 kS = F;
+
+		vec3 kD = vec3(1.0) - kS;
+
+		kD *= 1.0 - metallic;
+
+		float NdotL = max(dot(N, L), 0.0);
+
+		Lo += (kD * albedo / PI + specular) * radiance * NdotL;
+	}
+
+#if defined(IBL_SPECULAR)
+	vec3 R = reflect(-V, N);
+	vec3 F = fresnelSchlickRoughness(max(dot(N, V), 0.0), F0, roughness);
+
+	vec3 kS = F;
+	vec3 kD = 1.0 - kS;
+	kD *= 1.0 - metallic;
+
+	vec3 irradiance = texture(irradianceMap, N).rgb;
+	vec3 diffuse = irradiance * albedo;
+
+	const float MAX_REFLECTION_LOD = 4.0;
+	vec3 prefilteredColor = textureLod(prefilterMap, R, roughness * MAX_REFLECTION_LOD).rgb;
+	vec2 brdf = texture(brdfLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
+	vec3 specular = prefilteredColor * (F * brdf.x + brdf.y);
+
+	vec3 ambient = (kD * diffuse + specular) * ao;
+#elif defined(IBL_DIFFUSE)
+	vec3 kS = fresnelSchlick(max(dot(N, V), 0.0), F0);
+	vec3 kD = 1.0 - kS;
+	kD *= 1.0 - metallic;
+
+	vec3 irradiance = texture(irradianceMap, N).rgb;
+	vec3 diffuse = irradiance * albedo;
+	vec3 ambient = (kD * diffuse) * ao;
+#else
+	vec3 ambient = vec3(0.03) * albedo * ao;
+#endif
+
+	vec3 color = ambient + Lo;
+
+    // HDR tonemapping
+    color = color / (color + vec3(1.0));
+    // gamma correct
+    color = pow(color, vec3(1.0/2.2)); 
+
+	FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,37 @@
+// Vertex stage shared by the PBR samples. With MATERIAL_ARRAYS the model matrix and the material
+// layer are per-instance attributes, so many objects draw in one instanced call.
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in vec3 aNormal;
+
+out vec2 TexCoords;
+out vec3 WorldPos;
+out vec3 Normal;
+
+#ifdef MATERIAL_ARRAYS
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in float aLayer;
+
+flat out float Layer;
+#endif
+
+uniform mat4 projection;
+uniform mat4 view;
+#ifndef MATERIAL_ARRAYS
+uniform mat4 model;
+#endif
+
+void main()
+{
+#ifdef MATERIAL_ARRAYS
+	mat4 model = aModel;
+	Layer = aLayer;
+#endif
+	TexCoords = aTexCoords;
+	WorldPos = vec3(model * vec4(aPos, 1.0));
+
+	Normal = mat3(model) * aNormal;
+
+	gl_Position = projection * view * vec4(WorldPos, 1.0);
+}
@@ -0,0 +1,27 @@
+// Decoders for Mesh's compact vertex format, see CompactVertex in mesh.h and VertexCompression.h.
+// Bind the attributes as: vec4 position, vec2 normal, vec2 texture coordinates, vec2 tangent.
+
+// box the positions are quantized in, set by Mesh::Draw
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+vec3 decodePosition(vec4 quantized)
+{
+	return positionOffset + quantized.xyz * positionScale;
+}
+
+// unfolds an octahedral direction
+vec3 decodeOctahedral(vec2 encoded)
+{
+	vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+// w of the quantized position holds the sign of the bitangent
+vec3 decodeBitangent(vec3 normal, vec3 tangent, vec4 quantized)
+{
+	return cross(normal, tangent) * (quantized.w * 2.0 - 1.0);
+}
@@ -30,12 +30,18 @@ void VertexBoneData::AddBoneData(uint BoneID, float Weight)
     assert(0);
 }
 
-SkinnedMesh::SkinnedMesh()
+SkinnedMesh::SkinnedMesh(bool compactVertices, bool keepCpuCopy)
 {
     m_VAO = 0;
+    m_CompactVertices = compactVertices;
+    m_KeepCpuCopy = keepCpuCopy;
+    m_PositionOffset = glm::vec3(0.0f);
+    m_PositionScale = glm::vec3(1.0f);
     memset(m_Buffers, 0, sizeof(m_Buffers));
     m_NumBones = 0;
-    m_pScene = NULL;
+    m_UniformShader = NULL;
+    m_UniformProgram = 0;
+    m_UniformGeneration = 0;
 }
 
 SkinnedMesh::~SkinnedMesh()
@@ -54,27 +60,33 @@ bool SkinnedMesh::LoadMesh(const string & fileName)
 
     bool Ret = false;
 
-    m_pScene = m_Importer.ReadFile(fileName.c_str(), aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
-
-    if (!m_pScene)
+    Assimp::Importer importer;
+    if (!importer.ReadFile(fileName.c_str(), aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices))
     {
         cout << "the model has problem . " << endl;
         return false;
     }
+    m_pScene.reset(importer.GetOrphanedScene());
 
     m_GlobalInverseTransform = make_glm_matrix4(m_pScene->mRootNode->mTransformation.Transpose());
     m_GlobalInverseTransform = glm::inverse(m_GlobalInverseTransform);
     
-    Ret = InitFromScene(m_pScene, fileName);
+    Ret = InitFromScene(m_pScene.get(), fileName);
 
     glBindVertexArray(0);
 
+    if (!m_KeepCpuCopy)
+    {
+        ReleaseSceneGeometry();
+    }
+    ProcessMemory::print("after loading " + fileName + (m_KeepCpuCopy ? " (CPU copy kept)" : ""));
+
     return Ret;
 }
 
 void SkinnedMesh::Render()
 {
-    glBindVertexArray(m_VAO);
+    GLStateCache::bindVertexArray(m_VAO);
 
     for (uint i = 0; i < m_Entries.size(); i++)
     {
@@ -93,13 +105,31 @@ void SkinnedMesh::Render()
             (void*)(sizeof(uint) * m_Entries[i].BaseIndex),
             m_Entries[i].BaseVertex);
     }
+}
 
-    glBindVertexArray(0);
+void SkinnedMesh::SetupUniforms(const Shader & shader)
+{
+    m_UniformShader = &shader;
+    m_UniformProgram = shader.ID;
+    m_UniformGeneration = shader.generation();
+    m_ColorMapUniform = shader.uniform<int>("gColorMap");
+    m_CompactVerticesUniform = shader.uniform<bool>("gCompactVertices");
+    m_PositionOffsetUniform = shader.uniform<glm::vec3>("gPositionOffset");
+    m_PositionScaleUniform = shader.uniform<glm::vec3>("gPositionScale");
 }
 
 void SkinnedMesh::Render(const Shader & shader)
 {
-    glBindVertexArray(m_VAO);
+    // another shader, or hot reload moved the locations
+    if (m_UniformShader != &shader || m_UniformProgram != shader.ID || m_UniformGeneration != shader.generation())
+    {
+        SetupUniforms(shader);
+    }
+    m_ColorMapUniform.set(0);
+    m_CompactVerticesUniform.set(m_CompactVertices);
+    m_PositionOffsetUniform.set(m_PositionOffset);
+    m_PositionScaleUniform.set(m_PositionScale);
+    GLStateCache::bindVertexArray(m_VAO);
 
     for (uint i = 0; i < m_Entries.size(); i++)
     {
@@ -112,16 +142,12 @@ void SkinnedMesh::Render(const Shader & shader)
             m_Textures[MaterialIndex]->Bind(GL_TEXTURE0);
         }
 
-        shader.setInt("gColorMap", 0);
-
         glDrawElementsBaseVertex(GL_TRIANGLES,
             m_Entries[i].NumIndices,
             GL_UNSIGNED_INT,
             (void*)(sizeof(uint) * m_Entries[i].BaseIndex),
             m_Entries[i].BaseVertex);
     }
-
-    glBindVertexArray(0);
 }
 
 void SkinnedMesh::BoneTransform(float timeInSeconds, vector<glm::mat4> & transforms)
@@ -391,54 +417,139 @@ bool SkinnedMesh::InitFromScene(const aiScene* pScene, const string FileName)
     Bones.resize(NumVertices);
     indices.reserve(NumIndices);
 
+    MeshOptimizer::resetReport();
     for (uint i = 0; i < m_Entries.size(); i++)
     {
         const aiMesh* paiMesh = pScene->mMeshes[i];
         InitMesh(i, paiMesh, Positions, Normals, TexCoords, Bones, indices);
     }
+    if (MeshOptimizer::enabled())
+    {
+        MeshOptimizer::printReport(FileName);
+    }
 
     if (!InitMaterials(pScene, FileName))
     {
         return false;
     }
 
-    // 
+    if (m_CompactVertices && m_NumBones > 256)
+    {
+        cout << "ERROR::SKINNED_MESH::TOO_MANY_BONES_FOR_COMPACT_VERTICES " << m_NumBones << endl;
+        m_CompactVertices = false;
+    }
+
+    if (m_CompactVertices)
+    {
+        InitCompactBuffers(Positions, Normals, TexCoords, Bones);
+    }
+    else
+    {
+        // 
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VB_TYPES::POS_VB]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(), &Positions[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(POSITION_LOCATION);
+        glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+        // uv
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VB_TYPES::TEXCOORD_VB]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(TexCoords[0]) * TexCoords.size(), &TexCoords[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(TEX_COORD_LOCATION);
+        glVertexAttribPointer(TEX_COORD_LOCATION, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+        // normal
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VB_TYPES::NORMAL_VB]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Normals[0]) * Normals.size(), &Normals[0], GL_STATIC_DRAW);
+        glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(NORMAL_LOCATION);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VB_TYPES::BONE_VB]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Bones[0]) * Bones.size(), &Bones[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(BONE_ID_LOCATION);
+        glVertexAttribIPointer(BONE_ID_LOCATION, 4, GL_INT, sizeof(VertexBoneData), (void*)0);
+
+        glEnableVertexAttribArray(BONE_WEIGHT_LOCATION);
+        glVertexAttribPointer(BONE_WEIGHT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData), (void*) (4 * sizeof(int)));
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[VB_TYPES::INDEX_BUFFER]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), &indices[0], GL_STATIC_DRAW);
+
+    GLenum error_code;
+    error_code = glad_glGetError();
+
+    if (error_code != GL_NO_ERROR) {
+        fprintf(stderr, "ERROR %d in %s\n", error_code, "init buffer");
+    }
+
+    return glad_glGetError() == 0;
+}
+
+// Uploads the vertex streams in the compact layout: 24 bytes per vertex instead of 64. Positions
+// are quantized inside the bounding box of the whole mesh, which Render passes to the shader.
+void SkinnedMesh::InitCompactBuffers(const vector<glm::vec3> & Positions, const vector<glm::vec3> & Normals, const vector<glm::vec2> & TexCoords,
+    const vector<VertexBoneData> & Bones)
+{
+    glm::vec3 boundsMin(FLT_MAX);
+    glm::vec3 boundsMax(-FLT_MAX);
+    for (const glm::vec3 & position : Positions)
+    {
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+    m_PositionOffset = boundsMin;
+    m_PositionScale = boundsMax - boundsMin;
+
+    // positions keep a 4th component so every vertex stays 4-byte aligned
+    vector<uint16_t> packedPositions(Positions.size() * 4, 0);
+    vector<uint16_t> packedTexCoords(TexCoords.size() * 2);
+    vector<int16_t> packedNormals(Normals.size() * 2);
+    vector<CompactBoneData> packedBones(Bones.size());
+
+    VertexCompression::resetError();
+    for (size_t i = 0; i < Positions.size(); i++)
+    {
+        VertexCompression::encodePosition(Positions[i], m_PositionOffset, m_PositionScale, &packedPositions[i * 4]);
+        VertexCompression::encodeTexCoords(TexCoords[i], &packedTexCoords[i * 2]);
+        VertexCompression::encodeNormal(Normals[i], &packedNormals[i * 2]);
+
+        for (uint j = 0; j < NUM_BONES_PER_VEREX; j++)
+        {
+            packedBones[i].IDs[j] = (uint8_t)Bones[i].IDs[j];
+        }
+        VertexCompression::encodeWeights(Bones[i].weights, packedBones[i].weights);
+    }
+
     glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VB_TYPES::POS_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(), &Positions[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(packedPositions[0]) * packedPositions.size(), packedPositions.data(), GL_STATIC_DRAW);
     glEnableVertexAttribArray(POSITION_LOCATION);
-    glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribPointer(POSITION_LOCATION, 4, GL_UNSIGNED_SHORT, GL_TRUE, 0, 0);
 
-    // uv
     glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VB_TYPES::TEXCOORD_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(TexCoords[0]) * TexCoords.size(), &TexCoords[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(packedTexCoords[0]) * packedTexCoords.size(), packedTexCoords.data(), GL_STATIC_DRAW);
     glEnableVertexAttribArray(TEX_COORD_LOCATION);
-    glVertexAttribPointer(TEX_COORD_LOCATION, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribPointer(TEX_COORD_LOCATION, 2, GL_HALF_FLOAT, GL_FALSE, 0, 0);
 
-    // normal
     glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VB_TYPES::NORMAL_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Normals[0]) * Normals.size(), &Normals[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(packedNormals[0]) * packedNormals.size(), packedNormals.data(), GL_STATIC_DRAW);
     glEnableVertexAttribArray(NORMAL_LOCATION);
+    glVertexAttribPointer(NORMAL_LOCATION, 2, GL_SHORT, GL_TRUE, 0, 0);
 
     glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VB_TYPES::BONE_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Bones[0]) * Bones.size(), &Bones[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(packedBones[0]) * packedBones.size(), packedBones.data(), GL_STATIC_DRAW);
     glEnableVertexAttribArray(BONE_ID_LOCATION);
-    glVertexAttribIPointer(BONE_ID_LOCATION, 4, GL_INT, sizeof(VertexBoneData), (void*)0);
+    glVertexAttribIPointer(BONE_ID_LOCATION, 4, GL_UNSIGNED_BYTE, sizeof(CompactBoneData), (void*)offsetof(CompactBoneData, IDs));
 
     glEnableVertexAttribArray(BONE_WEIGHT_LOCATION);
-    glVertexAttribPointer(BONE_WEIGHT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData), (void*) (4 * sizeof(int)));
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[VB_TYPES::INDEX_BUFFER]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), &indices[0], GL_STATIC_DRAW);
-
-    GLenum error_code;
-    error_code = glad_glGetError();
+    glVertexAttribPointer(BONE_WEIGHT_LOCATION, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactBoneData), (void*)offsetof(CompactBoneData, weights));
 
-    if (error_code != GL_NO_ERROR) {
-        fprintf(stderr, "ERROR %d in %s\n", error_code, "init buffer");
+    const VertexCompression::Error & error = VertexCompression::error();
+    cout << "compact skinned vertices: " << Positions.size() << " vertices, 24 bytes each instead of 64, max error "
+        << error.position << " steps, " << error.normal << " deg normal, " << error.texCoord << " uv" << endl;
+    if (!error.withinTolerance())
+    {
+        cout << "ERROR::SKINNED_MESH::VERTEX_COMPRESSION_ERROR_OUT_OF_TOLERANCE" << endl;
     }
-
-    return glad_glGetError() == 0;
 }
 
 void SkinnedMesh::InitMesh(uint MeshIndex, const aiMesh* paiMesh, vector<glm::vec3> & Positions, vector<glm::vec3> & Normals, vector<glm::vec2> & TexCoords, vector<VertexBoneData> & Bones, vector<unsigned int> & indices)
@@ -467,6 +578,18 @@ void SkinnedMesh::InitMesh(uint MeshIndex, const aiMesh* paiMesh, vector<glm::ve
         indices.push_back(Face.mIndices[1]);
         indices.push_back(Face.mIndices[2]);
     }
+
+    // indices are local to the mesh, so the passes run on its slice of every stream
+    if (MeshOptimizer::enabled() && paiMesh->mNumVertices > 0)
+    {
+        const MeshEntry & entry = m_Entries[MeshIndex];
+        vector<unsigned int> remap = MeshOptimizer::optimize(&indices[entry.BaseIndex], entry.NumIndices, paiMesh->mNumVertices,
+            &Positions[entry.BaseVertex].x, sizeof(glm::vec3));
+        MeshOptimizer::remapVertices(&Positions[entry.BaseVertex], paiMesh->mNumVertices, remap);
+        MeshOptimizer::remapVertices(&Normals[entry.BaseVertex], paiMesh->mNumVertices, remap);
+        MeshOptimizer::remapVertices(&TexCoords[entry.BaseVertex], paiMesh->mNumVertices, remap);
+        MeshOptimizer::remapVertices(&Bones[entry.BaseVertex], paiMesh->mNumVertices, remap);
+    }
 }
 
 void SkinnedMesh::LoadBones(uint MeshIndex, const aiMesh* paiMesh, vector<VertexBoneData> & Bones)
@@ -573,4 +696,35 @@ void SkinnedMesh::Clear()
         glDeleteVertexArrays(1, &m_VAO);
         m_VAO = 0;
     }
-}
\ No newline at end of file
+}
+
+// Frees what is on the GPU by now: the meshes, materials and embedded textures of the scene.
+// BoneTransform only walks the nodes and the animations.
+void SkinnedMesh::ReleaseSceneGeometry()
+{
+    if (!m_pScene)
+    {
+        return;
+    }
+
+    for (uint i = 0; i < m_pScene->mNumMeshes; i++) {
+        delete m_pScene->mMeshes[i];
+    }
+    delete[] m_pScene->mMeshes;
+    m_pScene->mMeshes = NULL;
+    m_pScene->mNumMeshes = 0;
+
+    for (uint i = 0; i < m_pScene->mNumMaterials; i++) {
+        delete m_pScene->mMaterials[i];
+    }
+    delete[] m_pScene->mMaterials;
+    m_pScene->mMaterials = NULL;
+    m_pScene->mNumMaterials = 0;
+
+    for (uint i = 0; i < m_pScene->mNumTextures; i++) {
+        delete m_pScene->mTextures[i];
+    }
+    delete[] m_pScene->mTextures;
+    m_pScene->mTextures = NULL;
+    m_pScene->mNumTextures = 0;
+}
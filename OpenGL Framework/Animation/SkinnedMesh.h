@@ -10,6 +10,12 @@
 
 #include <vector>
 #include <map>
+#include <memory>
+#include <cfloat>
+
+#include <VertexCompression.h>
+#include <MeshOptimizer.h>
+#include <ProcessMemory.h>
 
 #include "SkinnedTexture.h"
 #include "Shader.h"
@@ -61,6 +67,13 @@ struct VertexBoneData
     void AddBoneData(uint BoneID, float Weight);
 };
 
+// Bone stream of the compact layout: 8-bit bone indices and unorm8 weights, 8 bytes instead of 32.
+struct CompactBoneData
+{
+    uint8_t IDs[NUM_BONES_PER_VEREX];
+    uint8_t weights[NUM_BONES_PER_VEREX];
+};
+
 struct MeshEntry
 {
     unsigned int NumIndices{ 0 };
@@ -73,13 +86,20 @@ struct MeshEntry
 class SkinnedMesh
 {
 public:
-    SkinnedMesh();
+    // compactVertices stores the streams as unorm16 positions, octahedral normals, half float
+    // texture coordinates and 8-bit bone data, Vertex.vs decodes them. After the upload only the
+    // node hierarchy and the animations of the scene are kept, keepCpuCopy keeps its meshes and materials too.
+    explicit SkinnedMesh(bool compactVertices = false, bool keepCpuCopy = false);
     ~SkinnedMesh();
 
     bool LoadMesh(const string & fileName);
 
     void Render();
 
+    // Resolves the uniforms Render(shader) sets, so a frame neither looks them up nor builds their
+    // names. Render calls it itself for another shader or after hot reload replaced the program.
+    void SetupUniforms(const Shader & shader);
+
     void Render(const Shader & shader);
 
     inline uint NumBones() const
@@ -108,15 +128,24 @@ public:
 
     void LoadBones(uint MeshIndex, const aiMesh* paiMesh, vector<VertexBoneData> & Bones);
 
+    void InitCompactBuffers(const vector<glm::vec3> & Positions, const vector<glm::vec3> & Normals, const vector<glm::vec2> & TexCoords,
+        const vector<VertexBoneData> & Bones);
+
     bool InitMaterials(const aiScene* pScene, const string FileName);
 
     void Clear();
 
+    void ReleaseSceneGeometry();
+
 private:
 
     GLuint m_VAO;
     GLuint m_Buffers[NUM_VBs];
 
+    bool m_CompactVertices;
+    glm::vec3 m_PositionOffset;
+    glm::vec3 m_PositionScale;
+
     vector<MeshEntry> m_Entries;
     vector<SkinnedTexture*> m_Textures;
 
@@ -125,8 +154,19 @@ private:
     vector<BoneInfo> m_BoneInfo;
     glm::mat4 m_GlobalInverseTransform;
 
-    const aiScene* m_pScene;
-    Assimp::Importer m_Importer;
+    bool m_KeepCpuCopy;
+
+    // the uniforms of Render(shader) and the program they were resolved in
+    const Shader* m_UniformShader;
+    unsigned int m_UniformProgram;
+    unsigned int m_UniformGeneration;
+    Uniform<int> m_ColorMapUniform;
+    Uniform<bool> m_CompactVerticesUniform;
+    Uniform<glm::vec3> m_PositionOffsetUniform;
+    Uniform<glm::vec3> m_PositionScaleUniform;
+
+    // taken from the importer, so the importer itself does not outlive LoadMesh
+    std::unique_ptr<aiScene> m_pScene;
 };
 
 
@@ -6,6 +6,9 @@
 
 #include <stb_image.h>
 
+#include <GLStateCache.h>
+#include <TextureCache.h>
+
 #include <iostream>
 
 using namespace std;
@@ -21,59 +24,20 @@ public:
 
     bool Load()
     {
-        m_textureObj = SkinnedTexture_TextureFromFile(m_fileName.c_str(), true);
+        m_texture = TextureCache::acquire(m_fileName);
+        m_textureObj = m_texture.id();
 
         return true;
     }
 
     void Bind(GLenum TextureUnit)
     {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m_textureObj);
-    }
-
-    unsigned int SkinnedTexture_TextureFromFile(const char* path, bool gamma)
-    {
-        unsigned int textureID = 0;
-        glGenTextures(1, &textureID);
-
-        int width, height, nrComponents;
-        unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-        if (data)
-        {
-            GLenum format;
-            if (nrComponents == 1)
-            {
-                format = GL_RED;
-            }
-            else if (nrComponents == 3)
-            {
-                format = GL_RGB;
-            }
-            else if (nrComponents == 4)
-            {
-                format = GL_RGBA;
-            }
-
-            glBindTexture(m_textureTarget, textureID);
-            glTexImage2D(m_textureTarget, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glTexParameteri(m_textureTarget, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(m_textureTarget, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(m_textureTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(m_textureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "texture failed to load at path:" << path << std::endl;
-        }
-
-        return textureID;
+        GLStateCache::bindTexture(TextureUnit - GL_TEXTURE0, m_textureTarget, m_textureObj);
     }
 
 private:
     std::string m_fileName;
     GLenum m_textureTarget;
     GLuint m_textureObj;
+    TextureHandle m_texture;
 };
\ No newline at end of file
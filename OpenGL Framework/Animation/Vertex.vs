@@ -1,8 +1,9 @@
 #version 330 core
 
-layout (location = 0) in vec3 Position;
+// full vertices read as (x, y, z, 1), compact ones as quantized positions and octahedral normals
+layout (location = 0) in vec4 Position;
 layout (location = 1) in vec2 TexCoord;
-layout (location = 2) in vec3 Normal;
+layout (location = 2) in vec4 Normal;
 layout (location = 3) in ivec4 BoneIDs;
 layout (location = 4) in vec4 Weights;
 
@@ -13,10 +14,24 @@ uniform mat4 gWVP;
 uniform mat4 gWorld;
 uniform mat4 gBones[MAX_BONES];
 
+// set by SkinnedMesh::Render, offset 0 and scale 1 for full vertices
+uniform bool gCompactVertices;
+uniform vec3 gPositionOffset;
+uniform vec3 gPositionScale;
+
 out vec2 TexCoord0;
 out vec3 Normal0;
 out vec3 WorldPos0;
 
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
 	mat4 BoneTransform = gBones[BoneIDs[0]] * Weights[0];
@@ -24,10 +39,13 @@ void main()
     BoneTransform += gBones[BoneIDs[2]] * Weights[2];
     BoneTransform += gBones[BoneIDs[3]] * Weights[3];
 
-    vec4 PosL = BoneTransform * vec4(Position, 1.0);
+    vec3 LocalPos = gPositionOffset + Position.xyz * gPositionScale;
+    vec3 LocalNormal = gCompactVertices ? decodeOctahedral(Normal.xy) : Normal.xyz;
+
+    vec4 PosL = BoneTransform * vec4(LocalPos, 1.0);
 
     TexCoord0    = TexCoord;
-    vec4 NormalL = BoneTransform * vec4(Normal, 0.0);
+    vec4 NormalL = BoneTransform * vec4(LocalNormal, 0.0);
     Normal0      = (gWorld * NormalL).xyz;
     WorldPos0    = (gWorld * PosL).xyz;
 
@@ -15,6 +15,7 @@
 #include <model.h>
 
 #include <SkinnedMesh.h>
+#include <GLStateCache.h>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
@@ -79,16 +80,26 @@ int main()
 		return -1;
 	}
 
+	GLStateCache::install();
+
 	glEnable(GL_DEPTH_TEST);
 
 	Shader shader("Vertex.vs", "Fragment.fs");
     const char* animPath = "model/boblampclean.md5mesh";
 
-    SkinnedMesh skinnedMesh;
+    MeshOptimizer::enabled() = true;
+    SkinnedMesh skinnedMesh(true);
     if (!skinnedMesh.LoadMesh(animPath))
     {
         cout << "the model has problem";
     }
+    skinnedMesh.SetupUniforms(shader);
+
+    // resolved once, the bone palette is uploaded with a single call per frame
+    Uniform<glm::mat4> wvpUniform = shader.uniform<glm::mat4>("gWVP");
+    Uniform<glm::mat4> worldUniform = shader.uniform<glm::mat4>("gWorld");
+    Uniform<glm::mat4> bonesUniform = shader.uniform<glm::mat4>("gBones");
+    std::vector<glm::mat4> BoneTransforms;
 
 	// render loop
 	while (!glfwWindowShouldClose(window))
@@ -116,17 +127,14 @@ int main()
 
         glm::mat4 mvp = projection * view * model;
 
-        shader.SetMat4("gWVP", mvp);
-        shader.SetMat4("gWorld", model);
+        wvpUniform.set(mvp);
+        worldUniform.set(model);
 
-        std::vector<glm::mat4> BoneTransforms;
-        
         skinnedMesh.BoneTransform(currentFrame, BoneTransforms);
 
-        for (size_t i = 0; i < BoneTransforms.size(); i++)
+        if (!BoneTransforms.empty())
         {
-            std::string name = "gBones[" + std::to_string(i) + "]";
-            shader.SetMat4(name, BoneTransforms[i]);
+            bonesUniform.set(BoneTransforms.data(), (GLsizei)BoneTransforms.size());
         }
 
         skinnedMesh.Render(shader);
@@ -134,7 +142,7 @@ int main()
 		//glm::mat4 model = glm::mat4(1.0f);
 		//model = glm::translate(model, glm::vec3(0.0f, -1.75f, 0.0f)); // translate it down so it's at the center of the scene
 		//model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));	// it's a bit too big for our scene, so scale it down
-		//shader.SetMat4("model", model);
+		//shader.setMat4("model", model);
 		//oModel.Draw(shader);
 		
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
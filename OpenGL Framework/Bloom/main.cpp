@@ -11,6 +11,7 @@
 #include <gtc/type_ptr.hpp>
 
 #include <Camera.h>
+#include <TextureCache.h>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
@@ -73,6 +74,7 @@ int main()
 	Shader shaderLight("bloom.vs", "light_box.fs");
     Shader shaderBlur("blur.vs", "blur.fs");
     Shader shaderBloomFinal("bloom_final.vs", "bloom_final.fs");
+    shaderBloomFinal.enableHotReload();
 
 	unsigned int woodTexture = loadTexture("wood.png");
     unsigned int containerTexture = loadTexture("container2.png");
@@ -158,6 +160,8 @@ int main()
 		// -----
 		processInput(window);
 
+		shaderBloomFinal.updateHotReload();
+
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
@@ -445,37 +449,5 @@ void renderQuad()
 // ---------------------------------------------------
 unsigned int loadTexture(std::string path)
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
+	return TextureCache::load(path);
 }
\ No newline at end of file
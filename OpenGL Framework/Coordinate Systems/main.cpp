@@ -152,9 +152,9 @@ int main()
 		glActiveTexture(GL_TEXTURE0);
 
 		shader.setInt("texture1", 0);
-		shader.SetMat4("model", model);
-		shader.SetMat4("view", view);
-		shader.SetMat4("projection", projection);
+		shader.setMat4("model", model);
+		shader.setMat4("view", view);
+		shader.setMat4("projection", projection);
 
 		glBindVertexArray(VAO);
 		glPolygonMode(GL_FRONT, GL_LINE);
@@ -1,26 +1,41 @@
 #version 330 core
+#include "../../Externals/custom/Shaders/vertex_compression.glsl"
 
+#ifdef COMPACT_VERTICES
+layout (location = 0) in vec4 aPos;
+layout (location = 1) in vec2 aNormal;
+#else
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+#endif
 layout (location = 2) in vec2 aTexCoords;
 
 out vec3 FragPos;
 out vec2 TexCoords;
 out vec3 Normal;
 
-uniform mat4 model;
+// one matrix per instance, a plain draw uses models[0]; main.cpp injects MAX_INSTANCES
+uniform mat4 models[MAX_INSTANCES];
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-    vec4 worldPos = model * vec4(aPos, 1.0);
+    mat4 model = models[gl_InstanceID];
+#ifdef COMPACT_VERTICES
+    vec3 position = decodePosition(aPos);
+    vec3 normal = decodeOctahedral(aNormal);
+#else
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+#endif
+    vec4 worldPos = model * vec4(position, 1.0);
     FragPos = worldPos.xyz;
 
     TexCoords = aTexCoords;
 
     mat3 normalMatrix = transpose(inverse(mat3(model)));
-    Normal = normalMatrix * aNormal;
+    Normal = normalMatrix * normal;
 
     gl_Position = projection * view * worldPos;
 }
\ No newline at end of file
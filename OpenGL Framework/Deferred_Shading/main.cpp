@@ -7,6 +7,11 @@
 #include <Shader.h>
 #include <model.h>
 #include <Camera.h>
+#include <GLStateCache.h>
+#include <RenderQueue.h>
+#include <FrustumCuller.h>
+#define ALLOCATION_COUNTER_IMPLEMENTATION
+#include <AllocationCounter.h>
 
 using namespace std;
 
@@ -22,6 +27,8 @@ void renderCube();
 // settings
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
+// model matrices per instanced draw, the size of g_buffer.vs' models array
+const unsigned int MAX_INSTANCES = 16;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 5.0f));
 float lastX = (float)SCR_WIDTH / 2.0;
@@ -31,6 +38,14 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// benchmark: C toggles the GL state cache, frame time, call counts and the heap allocations of the
+// last frame are printed every second
+bool stateCacheKeyPressed = false;
+
+// benchmark: I switches between one instanced draw of the packed nanosuit for all objects and one draw per object
+bool instancedDraw = true;
+bool instancedKeyPressed = false;
+
 int main()
 {
     // glfw: initialize and configure
@@ -64,167 +79,297 @@ int main()
         return -1;
     }
 
-    Shader shaderGeometryPass("g_buffer.vs", "g_buffer.fs");
-    Shader shaderLightingPass("defered_shading.vs", "defered_shading.fs");
-    Shader shaderLightBox("defered_light_box.vs", "defered_light_box.fs");
-
-    std::string path = "model/nanosuit.obj";
-    Model nanosuit(path.c_str());
-
-    std::vector<glm::vec3> objectPositions;
-    objectPositions.emplace_back(glm::vec3(-3.0, -3.0, -3.0));
-    objectPositions.emplace_back(glm::vec3(0.0, -3.0, -3.0));
-    objectPositions.emplace_back(glm::vec3(3.0, -3.0, -3.0));
-    objectPositions.emplace_back(glm::vec3(-3.0, -3.0, 0.0));
-    objectPositions.emplace_back(glm::vec3(0.0, -3.0, 0.0));
-    objectPositions.emplace_back(glm::vec3(3.0, -3.0, 0.0));
-    objectPositions.emplace_back(glm::vec3(-3.0, -3.0, 3.0));
-    objectPositions.emplace_back(glm::vec3(0.0, -3.0, 3.0));
-    objectPositions.emplace_back(glm::vec3(3.0, -3.0, 3.0));
-    // gBuffer
-    unsigned int gBuffer;
-    glGenFramebuffers(1, &gBuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-    
-    unsigned int gPosition, gNormal, gAlbedoSpec;
-    glGenTextures(1, &gPosition);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
-
-    glGenTextures(1, &gNormal);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
-
-    glGenTextures(1, &gAlbedoSpec);
-    glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedoSpec, 0);
-
-    unsigned int attachments[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
-    glDrawBuffers(3, attachments);
-
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    shaderLightingPass.use();
-    shaderLightingPass.setInt("gPosition", 0);
-    shaderLightingPass.setInt("gNormal", 1);
-    shaderLightingPass.setInt("gAlbedoSpec", 2);
-
-
-    //lighting
-    const unsigned int NR_LIGHTS = 32;
-    std::vector<glm::vec3> lightPositions;
-    std::vector<glm::vec3> lightColors;
-    srand(13);
-    for (auto i = 0; i < NR_LIGHTS; ++i)
-    {
-        // calculate slightly random offsets
-        float xPos = ((rand() % 100) / 100.0) * 6.0 - 3.0;
-        float yPos = ((rand() % 100) / 100.0) * 6.0 - 4.0;
-        float zPos = ((rand() % 100) / 100.0) * 6.0 - 3.0;
-        lightPositions.push_back(glm::vec3(xPos, yPos, zPos));
-        // also calculate random color
-        float rColor = ((rand() % 100) / 200.0f) + 0.5; // between 0.5 and 1.0
-        float gColor = ((rand() % 100) / 200.0f) + 0.5; // between 0.5 and 1.0
-        float bColor = ((rand() % 100) / 200.0f) + 0.5; // between 0.5 and 1.0
-        lightColors.push_back(glm::vec3(rColor, gColor, bColor));
-    }
+    GLStateCache::install();
 
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(window))
+    // everything owning GL objects lives in this block, so it is destroyed while the context is still current
     {
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
-
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), float(SCR_WIDTH) / float(SCR_HEIGHT), 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 model = glm::mat4(1.0f);
-        shaderGeometryPass.use();
-        shaderGeometryPass.setMat4("projection", projection);
-        shaderGeometryPass.setMat4("view", view);
-        for (unsigned int i = 0; i < objectPositions.size(); i++)
+        Shader shaderGeometryPass("g_buffer.vs", "g_buffer.fs", nullptr, { { "COMPACT_VERTICES" }, { "MAX_INSTANCES", (int)MAX_INSTANCES } });
+        Shader shaderLightingPass("defered_shading.vs", "defered_shading.fs");
+        Shader shaderLightBox("defered_light_box.vs", "defered_light_box.fs");
+
+        // reorder the nanosuit for the vertex cache on import, the ACMR/ATVR before and after are printed
+        MeshOptimizer::enabled() = true;
+        // and build LODs with half, a quarter and an eighth of the triangles, their error is printed
+        MeshSimplifier::lodRatios() = { 0.5f, 0.25f, 0.125f };
+        // and split it into meshlets of up to 64 vertices and 124 triangles
+        MeshletBuilder::enabled() = true;
+        std::string path = "model/nanosuit.obj";
+
+        Model nanosuit(path.c_str(), false, true, VertexFormat::Compact);
+
+        std::vector<glm::vec3> objectPositions;
+        objectPositions.emplace_back(glm::vec3(-3.0, -3.0, -3.0));
+        objectPositions.emplace_back(glm::vec3(0.0, -3.0, -3.0));
+        objectPositions.emplace_back(glm::vec3(3.0, -3.0, -3.0));
+        objectPositions.emplace_back(glm::vec3(-3.0, -3.0, 0.0));
+        objectPositions.emplace_back(glm::vec3(0.0, -3.0, 0.0));
+        objectPositions.emplace_back(glm::vec3(3.0, -3.0, 0.0));
+        objectPositions.emplace_back(glm::vec3(-3.0, -3.0, 3.0));
+        objectPositions.emplace_back(glm::vec3(0.0, -3.0, 3.0));
+        objectPositions.emplace_back(glm::vec3(3.0, -3.0, 3.0));
+        std::vector<glm::mat4> objectModels;
+        for (const glm::vec3 & position : objectPositions)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, objectPositions[i]);
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, position);
             model = glm::scale(model, glm::vec3(0.25f));
-            shaderGeometryPass.setMat4("model", model);
-            nanosuit.Draw(shaderGeometryPass);
+            objectModels.push_back(model);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // the nanosuits do not move, their world-space boxes are computed once
+        FrustumCuller objectCuller;
+        for (const glm::mat4 & objectModel : objectModels)
+        {
+            objectCuller.add(nanosuit.bounds().transformed(objectModel));
+        }
+        std::vector<unsigned char> objectVisible(objectModels.size() + 8, 1);
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        shaderLightingPass.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gPosition);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gNormal);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-        for (unsigned int i = 0; i < lightPositions.size(); i++)
+        // the model matrices of one frame sorted by LOD, reserved up front so the render loop does not allocate
+        std::vector<std::vector<glm::mat4>> lodModels(nanosuit.lodCount());
+        for (std::vector<glm::mat4> & models : lodModels)
         {
-            shaderLightingPass.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-            shaderLightingPass.setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
-            // update attenuation parameters and calculate radius
-            const float constant = 1.0; // note that we don't send this to the shader, we assume it is always 1.0 (in our case)
-            const float linear = 0.7;
-            const float quadratic = 1.8;
-            shaderLightingPass.setFloat("lights[" + std::to_string(i) + "].Linear", linear);
-            shaderLightingPass.setFloat("lights[" + std::to_string(i) + "].Quadratic", quadratic);
+            models.reserve(objectModels.size());
         }
-        shaderLightingPass.setVec3("viewPos", camera.Position);
-        renderQuad();
 
-        glBindFramebuffer(GL_READ_BUFFER, gBuffer);
-        glBindFramebuffer(GL_DRAW_BUFFER, 0);
+        // the geometry pass goes through a render queue: packets sorted by shader, material and depth
+        const unsigned int GEOMETRY_PASS = 0;
+        RenderQueue renderQueue;
+        renderQueue.setDepthRange(0.1f, 100.0f);
+        // gBuffer
+        unsigned int gBuffer;
+        glGenFramebuffers(1, &gBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    
+        unsigned int gPosition, gNormal, gAlbedoSpec;
+        glGenTextures(1, &gPosition);
+        glBindTexture(GL_TEXTURE_2D, gPosition);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
 
-        glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glGenTextures(1, &gNormal);
+        glBindTexture(GL_TEXTURE_2D, gNormal);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
+
+        glGenTextures(1, &gAlbedoSpec);
+        glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedoSpec, 0);
+
+        unsigned int attachments[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, attachments);
+
+        unsigned int rboDepth;
+        glGenRenderbuffers(1, &rboDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Framebuffer not complete!" << std::endl;
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        shaderLightBox.use();
-        shaderLightBox.setMat4("projection", projection);
-        shaderLightBox.setMat4("view", view);
-        for (unsigned int i = 0; i < lightPositions.size(); i++)
+        shaderLightingPass.use();
+        shaderLightingPass.setInt("gPosition", 0);
+        shaderLightingPass.setInt("gNormal", 1);
+        shaderLightingPass.setInt("gAlbedoSpec", 2);
+
+
+        //lighting
+        const unsigned int NR_LIGHTS = 32;
+        std::vector<glm::vec3> lightPositions;
+        std::vector<glm::vec3> lightColors;
+        srand(13);
+        for (unsigned int i = 0; i < NR_LIGHTS; ++i)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, lightPositions[i]);
-            model = glm::scale(model, glm::vec3(0.125f));
-            shaderLightBox.setMat4("model", model);
-            shaderLightBox.setVec3("lightColor", lightColors[i]);
-            renderCube();
+            // calculate slightly random offsets
+            float xPos = ((rand() % 100) / 100.0) * 6.0 - 3.0;
+            float yPos = ((rand() % 100) / 100.0) * 6.0 - 4.0;
+            float zPos = ((rand() % 100) / 100.0) * 6.0 - 3.0;
+            lightPositions.push_back(glm::vec3(xPos, yPos, zPos));
+            // also calculate random color
+            float rColor = ((rand() % 100) / 200.0f) + 0.5; // between 0.5 and 1.0
+            float gColor = ((rand() % 100) / 200.0f) + 0.5; // between 0.5 and 1.0
+            float bColor = ((rand() % 100) / 200.0f) + 0.5; // between 0.5 and 1.0
+            lightColors.push_back(glm::vec3(rColor, gColor, bColor));
         }
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // resolve the per-frame uniforms once, the render loop only uses these handles
+        Uniform<glm::mat4> geometryProjection = shaderGeometryPass.uniform<glm::mat4>("projection");
+        Uniform<glm::mat4> geometryView = shaderGeometryPass.uniform<glm::mat4>("view");
+        Uniform<glm::mat4> geometryModels = shaderGeometryPass.uniform<glm::mat4>("models");
+        std::vector<Uniform<glm::vec3>> lightPositionUniforms = shaderLightingPass.uniformArray<glm::vec3>("lights", NR_LIGHTS, "Position");
+        std::vector<Uniform<glm::vec3>> lightColorUniforms = shaderLightingPass.uniformArray<glm::vec3>("lights", NR_LIGHTS, "Color");
+        std::vector<Uniform<float>> lightLinearUniforms = shaderLightingPass.uniformArray<float>("lights", NR_LIGHTS, "Linear");
+        std::vector<Uniform<float>> lightQuadraticUniforms = shaderLightingPass.uniformArray<float>("lights", NR_LIGHTS, "Quadratic");
+        Uniform<glm::vec3> lightingViewPos = shaderLightingPass.uniform<glm::vec3>("viewPos");
+        Uniform<glm::mat4> lightBoxProjection = shaderLightBox.uniform<glm::mat4>("projection");
+        Uniform<glm::mat4> lightBoxView = shaderLightBox.uniform<glm::mat4>("view");
+        Uniform<glm::mat4> lightBoxModel = shaderLightBox.uniform<glm::mat4>("model");
+        Uniform<glm::vec3> lightBoxColor = shaderLightBox.uniform<glm::vec3>("lightColor");
+
+        unsigned int benchmarkFrames = 0;
+        float benchmarkStart = glfwGetTime();
+        AllocationCounter::Counters frameAllocations = { 0, 0 };
+        unsigned long long frameTriangles = 0;
+        RenderQueue::Stats frameQueue = renderQueue.stats();
+        size_t frameVisibleObjects = objectModels.size();
+
+        // render loop
+        // -----------
+        while (!glfwWindowShouldClose(window))
+        {
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            benchmarkFrames++;
+            if (currentFrame - benchmarkStart >= 1.0f)
+            {
+                GLStateCache::Counters counters = GLStateCache::counters();
+                std::cout << "state cache " << (GLStateCache::enabled() ? "on" : "off") << ", "
+                    << (instancedDraw ? "instanced" : "per object") << ": "
+                    << 1000.0f * (currentFrame - benchmarkStart) / benchmarkFrames << " ms/frame, "
+                    << counters.issued / benchmarkFrames << " state calls issued, "
+                    << counters.elided / benchmarkFrames << " elided per frame, "
+                    << frameAllocations.allocations << " allocations (" << frameAllocations.bytes << " bytes), "
+                    << frameTriangles << " triangles in the last frame, geometry pass: " << frameQueue.packets << " packets, "
+                    << frameQueue.drawCalls << " draw calls, " << frameQueue.stateChanges() << " state changes ("
+                    << frameQueue.shaderChanges << " shader, " << frameQueue.materialChanges << " material, "
+                    << frameQueue.vertexArrayChanges << " VAO), " << frameVisibleObjects << " of " << objectModels.size()
+                    << " objects in the frustum" << std::endl;
+                GLStateCache::resetCounters();
+                benchmarkFrames = 0;
+                benchmarkStart = currentFrame;
+            }
+
+            // the report above may allocate, count from here to the swap
+            AllocationCounter::Counters frameStart = AllocationCounter::threadCounters();
+
+            // input
+            // -----
+            processInput(window);
+
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), float(SCR_WIDTH) / float(SCR_HEIGHT), 0.1f, 100.0f);
+            glm::mat4 view = camera.GetViewMatrix();
+            glm::mat4 model = glm::mat4(1.0f);
+            shaderGeometryPass.use();
+            geometryProjection.set(projection);
+            geometryView.set(view);
+            LodCamera lodCamera(camera.Position, glm::radians(camera.Zoom), float(SCR_HEIGHT));
+            Frustum frustum = camera.GetFrustum(projection);
+            frameVisibleObjects = objectCuller.cull(frustum, objectVisible.data());
+            for (std::vector<glm::mat4> & models : lodModels)
+            {
+                models.clear();
+            }
+            renderQueue.clear();
+            for (unsigned int i = 0; i < objectModels.size(); i++)
+            {
+                if (!objectVisible[i])
+                {
+                    continue;
+                }
+                const glm::mat4 & objectModel = objectModels[i];
+                unsigned int lod = nanosuit.selectLod(lodCamera, objectModel);
+                float depth = glm::length(glm::vec3(objectModel[3]) - camera.Position);
+                if (lod == 0)
+                {
+                    nanosuit.SubmitClusters(renderQueue, GEOMETRY_PASS, shaderGeometryPass, geometryModels, frustum, camera.Position, objectModel, depth);
+                }
+                else if (!instancedDraw)
+                {
+                    nanosuit.Submit(renderQueue, GEOMETRY_PASS, shaderGeometryPass, geometryModels, &objectModel, 1, lod, depth);
+                }
+                else
+                {
+                    lodModels[lod].push_back(objectModel);
+                }
+            }
+            for (unsigned int lod = 0; lod < lodModels.size(); lod++)
+            {
+                const std::vector<glm::mat4> & models = lodModels[lod];
+                for (unsigned int first = 0; first < models.size(); first += MAX_INSTANCES)
+                {
+                    // a batch sorts by its nearest copy
+                    unsigned int count = std::min(MAX_INSTANCES, (unsigned int)models.size() - first);
+                    float depth = FLT_MAX;
+                    for (unsigned int i = first; i < first + count; i++)
+                    {
+                        depth = std::min(depth, glm::length(glm::vec3(models[i][3]) - camera.Position));
+                    }
+                    nanosuit.Submit(renderQueue, GEOMETRY_PASS, shaderGeometryPass, geometryModels, models.data() + first, count, lod, depth);
+                }
+            }
+            renderQueue.sort();
+            renderQueue.submit();
+            frameQueue = renderQueue.stats();
+            frameTriangles = frameQueue.triangles;
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            shaderLightingPass.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, gPosition);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, gNormal);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
+            for (unsigned int i = 0; i < lightPositions.size(); i++)
+            {
+                lightPositionUniforms[i].set(lightPositions[i]);
+                lightColorUniforms[i].set(lightColors[i]);
+                // update attenuation parameters, the constant term is always 1.0 and not sent to the shader
+                const float linear = 0.7;
+                const float quadratic = 1.8;
+                lightLinearUniforms[i].set(linear);
+                lightQuadraticUniforms[i].set(quadratic);
+            }
+            lightingViewPos.set(camera.Position);
+            renderQuad();
+
+            glBindFramebuffer(GL_READ_BUFFER, gBuffer);
+            glBindFramebuffer(GL_DRAW_BUFFER, 0);
+
+            glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            shaderLightBox.use();
+            lightBoxProjection.set(projection);
+            lightBoxView.set(view);
+            for (unsigned int i = 0; i < lightPositions.size(); i++)
+            {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, lightPositions[i]);
+                model = glm::scale(model, glm::vec3(0.125f));
+                lightBoxModel.set(model);
+                lightBoxColor.set(lightColors[i]);
+                renderCube();
+            }
+
+            AllocationCounter::Counters frameEnd = AllocationCounter::threadCounters();
+            frameAllocations.allocations = frameEnd.allocations - frameStart.allocations;
+            frameAllocations.bytes = frameEnd.bytes - frameStart.bytes;
+
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            // -------------------------------------------------------------------------------
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
     }
 
+    // textures kept alive for the whole run are released before the context goes away
+    TextureCache::releasePinned();
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -353,6 +498,27 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !stateCacheKeyPressed)
+    {
+        GLStateCache::setEnabled(!GLStateCache::enabled());
+        stateCacheKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+    {
+        stateCacheKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS && !instancedKeyPressed)
+    {
+        instancedDraw = !instancedDraw;
+        instancedKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_RELEASE)
+    {
+        instancedKeyPressed = false;
+    }
+
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -0,0 +1,2290 @@
+#include <glad/glad.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstdint>
+#include <cfloat>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <atomic>
+
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <stb_image.h>
+
+#include <model.h>
+#include <ModelLoader.h>
+#include <Camera.h>
+#include <FrustumCuller.h>
+#include <OcclusionCuller.h>
+#include <TextureLoader.h>
+#include <MaterialCooker.h>
+#include <MipGenerator.h>
+#include <TextureStreamer.h>
+#define ALLOCATION_COUNTER_IMPLEMENTATION
+#include <AllocationCounter.h>
+
+#include "../Animation/SkinnedMesh.h"
+
+// Checks and benchmarks of the framework headers that need no window and no GL context. Every
+// check prints what it measured and returns false on a failure, main() returns the number of
+// failed checks, so the project can run unattended. A name on the command line runs only the checks
+// whose name contains it.
+
+bool checkUniformLookups();
+bool checkStateCache();
+bool checkProgramBinaryCache();
+bool checkOcclusionCuller();
+bool checkFrustumCuller();
+bool checkMeshletCuller();
+bool checkLods();
+bool checkVertexCompression();
+bool checkAsyncImport();
+bool checkModelLoader();
+bool checkModelMemory();
+bool checkTextureGamma();
+bool checkTextureDecoding();
+bool checkTextureCompression();
+bool checkMaterialPacking();
+bool checkMipGeneration();
+bool checkTextureStreaming();
+
+// the screen the checks project to, the same as the samples'
+const unsigned int SCR_WIDTH = 1280;
+const unsigned int SCR_HEIGHT = 720;
+
+// the assets of the samples the checks come from, relative to this project. Not every material
+// has all five maps, the texture checks skip what is missing.
+const std::string NANOSUIT = "../Deferred_Shading/model/nanosuit.obj";
+const std::string BOB_LAMP = "../Animation/model/boblampclean.md5mesh";
+const std::string PBR_DIRECTORY = "../IBL_Specular_Textured/pbr";
+const std::string HDR_IMAGE = "../IBL_Specular_Textured/newport_loft.hdr";
+const std::string GEOMETRY_VERTEX = "../Deferred_Shading/g_buffer.vs";
+const std::string GEOMETRY_FRAGMENT = "../Deferred_Shading/g_buffer.fs";
+const std::string LIGHTING_VERTEX = "../Deferred_Shading/defered_shading.vs";
+const std::string LIGHTING_FRAGMENT = "../Deferred_Shading/defered_shading.fs";
+const char* PBR_MATERIALS[] = { "rusted_iron", "gold", "grass", "plastic", "wall" };
+
+struct Check
+{
+	const char* name;
+	bool (*run)();
+};
+
+int main(int argc, char* argv[])
+{
+	// import the nanosuit as Deferred_Shading does, and cook models, textures and programs in memory
+	// so every run measures the same work
+	MeshOptimizer::enabled() = true;
+	MeshSimplifier::lodRatios() = { 0.5f, 0.25f, 0.125f };
+	MeshletBuilder::enabled() = true;
+	ModelCache::directory() = "";
+	TextureLoader::cacheDirectory() = "";
+	ProgramBinaryCache::directory() = "";
+
+	const Check checks[] = {
+		{ "uniform lookups", checkUniformLookups },
+		{ "state cache", checkStateCache },
+		{ "program binary cache", checkProgramBinaryCache },
+		{ "occlusion culling", checkOcclusionCuller },
+		{ "frustum culling", checkFrustumCuller },
+		{ "meshlet culling", checkMeshletCuller },
+		{ "lods", checkLods },
+		{ "vertex compression", checkVertexCompression },
+		{ "async import", checkAsyncImport },
+		{ "model loader", checkModelLoader },
+		{ "model memory", checkModelMemory },
+		{ "texture gamma", checkTextureGamma },
+		{ "texture decoding", checkTextureDecoding },
+		{ "texture compression", checkTextureCompression },
+		{ "material packing", checkMaterialPacking },
+		{ "mip generation", checkMipGeneration },
+		{ "texture streaming", checkTextureStreaming },
+	};
+
+	std::string filter = argc > 1 ? argv[1] : "";
+	int run = 0;
+	int failed = 0;
+	for (const Check & check : checks)
+	{
+		if (std::string(check.name).find(filter) == std::string::npos)
+		{
+			continue;
+		}
+		std::cout << "[ RUN  ] " << check.name << std::endl;
+		bool passed = check.run();
+		std::cout << (passed ? "[ PASS ] " : "[ FAIL ] ") << check.name << std::endl;
+		run++;
+		failed += passed ? 0 : 1;
+	}
+	std::cout << run - failed << " of " << run << " checks passed" << std::endl;
+	return failed;
+}
+
+// The nanosuit as Deferred_Shading imports it, reordered, with LODs and meshlets and without its
+// textures decoded. Imported once for every check that needs real geometry.
+const ModelData & nanosuit()
+{
+	static ModelData data;
+	static bool imported = false;
+	if (!imported)
+	{
+		Model::import(NANOSUIT, VertexFormat::Compact, false, data);
+		imported = true;
+	}
+	if (!data.valid)
+	{
+		std::cout << "ERROR::TESTS::MODEL_NOT_LOADED " << NANOSUIT << std::endl;
+	}
+	return data;
+}
+
+// Just enough of a driver to build a Shader and set its uniforms without a context. The program has
+// the uniforms of Deferred_Shading's lighting pass, glGetUniformLocation calls are counted and the
+// uploads summed up by location, so frames that set the same uniforms differently can be compared.
+// Compiles and program binaries are counted too: every linked program has the same binary, which
+// glProgramBinary accepts and anything else it rejects. Buffers keep the bytes glBufferData and
+// glBufferSubData gave them and draws are recorded with the buffers, textures and position decoding
+// they use, so a model built one way can be compared with the same model built another.
+namespace FakeGL
+{
+	std::vector<std::string> uniforms;
+	unsigned long long locationLookups = 0;
+	unsigned long long uploads = 0;
+	unsigned long long invalidUploads = 0;
+	long long uploadedLocations = 0;
+	unsigned long long compiles = 0;
+	unsigned long long binariesLoaded = 0;
+	unsigned long long binariesRejected = 0;
+	const char BINARY[] = "FakeGL program";
+	const GLenum BINARY_FORMAT = 1;
+
+	struct Buffer
+	{
+		GLenum target;
+		size_t size;
+		// empty unless keepBufferBytes was set when the data came
+		std::vector<unsigned char> bytes;
+
+		Buffer() : target(0), size(0) {}
+	};
+
+	// what glVertexAttribPointer and the element buffer binding store in a vertex array
+	struct VertexArray
+	{
+		GLuint vertexBuffer;
+		GLuint elementBuffer;
+
+		VertexArray() : vertexBuffer(0), elementBuffer(0) {}
+	};
+
+	struct Draw
+	{
+		GLsizei count;
+		size_t firstIndex;
+		GLsizei instances;
+		GLint baseVertex;
+		uint64_t vertices;
+		uint64_t indices;
+		// unit and texture of every bound texture
+		std::vector<std::pair<GLenum, GLuint>> textures;
+		// the vec3 uniforms by location, the position decoding of compact vertices among them
+		std::vector<std::pair<GLint, glm::vec3>> vectors;
+		GLuint program;
+		GLuint framebuffer;
+
+		bool operator==(const Draw & other) const
+		{
+			return count == other.count && firstIndex == other.firstIndex && instances == other.instances && baseVertex == other.baseVertex
+				&& vertices == other.vertices && indices == other.indices && textures == other.textures && vectors == other.vectors
+				&& program == other.program && framebuffer == other.framebuffer;
+		}
+	};
+
+	// names are never reused, so the objects created after a point are those with a larger name
+	GLuint nextName = 1;
+	std::map<GLuint, Buffer> buffers;
+	std::map<GLenum, GLuint> boundBuffers;
+	std::map<GLuint, VertexArray> vertexArrays;
+	GLuint boundVertexArray = 0;
+	GLenum activeUnit = GL_TEXTURE0;
+	std::map<GLenum, GLuint> boundTextures;
+	GLuint usedProgram = 0;
+	GLuint boundFramebuffer = 0;
+	// calls of the state setters GLStateCache filters that got through to here
+	unsigned long long stateCalls = 0;
+	// the internal format of level 0 of every texture
+	std::map<GLuint, GLint> textureFormats;
+	std::map<GLint, glm::vec3> vectors;
+	// off for measuring the process's own memory, which the copies would add to
+	bool keepBufferBytes = true;
+	unsigned long long bufferUploads = 0;
+	unsigned long long bufferDeletes = 0;
+	unsigned long long arrayDraws = 0;
+	std::vector<Draw> draws;
+
+	GLuint APIENTRY createObject() { return 1; }
+	GLuint APIENTRY createShader(GLenum) { return 1; }
+	void APIENTRY objectCall(GLuint) {}
+	void APIENTRY compileShader(GLuint) { compiles++; }
+	void APIENTRY attachShader(GLuint, GLuint) {}
+	void APIENTRY shaderSource(GLuint, GLsizei, const GLchar* const*, const GLint*) {}
+	void APIENTRY programParameteri(GLuint, GLenum, GLint) {}
+
+	const GLubyte* APIENTRY getString(GLenum)
+	{
+		return (const GLubyte*)"FakeGL";
+	}
+
+	void APIENTRY getIntegerv(GLenum pname, GLint* data)
+	{
+		*data = pname == GL_NUM_PROGRAM_BINARY_FORMATS ? 1 : 0;
+	}
+
+	void APIENTRY getProgramBinary(GLuint, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary)
+	{
+		GLsizei copied = std::min((GLsizei)sizeof(BINARY), bufSize);
+		memcpy(binary, BINARY, copied);
+		if (length != nullptr)
+		{
+			*length = copied;
+		}
+		*binaryFormat = BINARY_FORMAT;
+	}
+
+	void APIENTRY programBinary(GLuint, GLenum binaryFormat, const void* binary, GLsizei length)
+	{
+		bool valid = binaryFormat == BINARY_FORMAT && length == (GLsizei)sizeof(BINARY) && memcmp(binary, BINARY, length) == 0;
+		binariesLoaded += valid ? 1 : 0;
+		binariesRejected += valid ? 0 : 1;
+	}
+
+	void APIENTRY getShaderiv(GLuint, GLenum, GLint* params)
+	{
+		*params = GL_TRUE;
+	}
+
+	void APIENTRY getProgramiv(GLuint, GLenum pname, GLint* params)
+	{
+		if (pname == GL_ACTIVE_UNIFORMS)
+		{
+			*params = (GLint)uniforms.size();
+		}
+		else if (pname == GL_ACTIVE_UNIFORM_MAX_LENGTH)
+		{
+			size_t length = 0;
+			for (const std::string & name : uniforms)
+			{
+				length = std::max(length, name.size() + 1);
+			}
+			*params = (GLint)length;
+		}
+		else if (pname == GL_PROGRAM_BINARY_LENGTH)
+		{
+			*params = (GLint)sizeof(BINARY);
+		}
+		else
+		{
+			*params = GL_TRUE;
+		}
+	}
+
+	void APIENTRY getActiveUniform(GLuint, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name)
+	{
+		GLsizei copied = std::min((GLsizei)uniforms[index].size(), bufSize - 1);
+		memcpy(name, uniforms[index].c_str(), copied);
+		name[copied] = '\0';
+		*length = copied;
+		*size = 1;
+		*type = GL_FLOAT;
+	}
+
+	GLint APIENTRY getUniformLocation(GLuint, const GLchar* name)
+	{
+		locationLookups++;
+		for (size_t i = 0; i < uniforms.size(); i++)
+		{
+			if (uniforms[i] == name)
+			{
+				return (GLint)i;
+			}
+		}
+		return -1;
+	}
+
+	void upload(GLint location)
+	{
+		uploads++;
+		invalidUploads += location < 0 ? 1 : 0;
+		uploadedLocations += location;
+	}
+
+	void APIENTRY uniform1i(GLint location, GLint) { upload(location); }
+	void APIENTRY uniform1f(GLint location, GLfloat) { upload(location); }
+	void APIENTRY uniform3fv(GLint location, GLsizei, const GLfloat* value)
+	{
+		upload(location);
+		vectors[location] = glm::vec3(value[0], value[1], value[2]);
+	}
+
+	void APIENTRY genObjects(GLsizei n, GLuint* names)
+	{
+		for (GLsizei i = 0; i < n; i++)
+		{
+			names[i] = nextName++;
+		}
+	}
+
+	void APIENTRY genBuffers(GLsizei n, GLuint* names)
+	{
+		genObjects(n, names);
+		for (GLsizei i = 0; i < n; i++)
+		{
+			buffers[names[i]] = Buffer();
+		}
+	}
+
+	void APIENTRY bindBuffer(GLenum target, GLuint buffer)
+	{
+		boundBuffers[target] = buffer;
+		if (target == GL_ELEMENT_ARRAY_BUFFER)
+		{
+			vertexArrays[boundVertexArray].elementBuffer = buffer;
+		}
+	}
+
+	void APIENTRY bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum)
+	{
+		Buffer & buffer = buffers[boundBuffers[target]];
+		buffer.target = target;
+		buffer.size = (size_t)size;
+		buffer.bytes.assign(keepBufferBytes ? (size_t)size : 0, 0);
+		if (data != nullptr && keepBufferBytes)
+		{
+			memcpy(buffer.bytes.data(), data, (size_t)size);
+		}
+		bufferUploads++;
+	}
+
+	void APIENTRY bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+	{
+		Buffer & buffer = buffers[boundBuffers[target]];
+		if ((size_t)(offset + size) > buffer.size)
+		{
+			invalidUploads++;
+			return;
+		}
+		if (!buffer.bytes.empty())
+		{
+			memcpy(buffer.bytes.data() + offset, data, (size_t)size);
+		}
+		bufferUploads++;
+	}
+
+	void APIENTRY deleteBuffers(GLsizei n, const GLuint* names)
+	{
+		for (GLsizei i = 0; i < n; i++)
+		{
+			// deleting 0 is allowed and does nothing
+			bufferDeletes += buffers.erase(names[i]);
+		}
+	}
+
+	void APIENTRY deleteObjects(GLsizei, const GLuint*) {}
+
+	void APIENTRY bindVertexArray(GLuint vertexArray)
+	{
+		stateCalls++;
+		boundVertexArray = vertexArray;
+	}
+
+	void APIENTRY enableVertexAttribArray(GLuint) {}
+
+	void APIENTRY vertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*)
+	{
+		vertexArrays[boundVertexArray].vertexBuffer = boundBuffers[GL_ARRAY_BUFFER];
+	}
+
+	void APIENTRY vertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer)
+	{
+		vertexAttribPointer(index, size, type, GL_FALSE, stride, pointer);
+	}
+
+	GLenum APIENTRY getError()
+	{
+		return GL_NO_ERROR;
+	}
+
+	void APIENTRY activeTexture(GLenum unit)
+	{
+		stateCalls++;
+		activeUnit = unit;
+	}
+
+	void APIENTRY bindTexture(GLenum, GLuint texture)
+	{
+		stateCalls++;
+		boundTextures[activeUnit] = texture;
+	}
+
+	void APIENTRY bindTextureUnit(GLuint unit, GLuint texture)
+	{
+		stateCalls++;
+		boundTextures[GL_TEXTURE0 + unit] = texture;
+	}
+
+	void APIENTRY useProgram(GLuint program)
+	{
+		stateCalls++;
+		usedProgram = program;
+	}
+
+	void APIENTRY bindFramebuffer(GLenum, GLuint framebuffer)
+	{
+		stateCalls++;
+		boundFramebuffer = framebuffer;
+	}
+
+	void APIENTRY stateCall(GLenum) { stateCalls++; }
+	void APIENTRY blendFunc(GLenum, GLenum) { stateCalls++; }
+	void APIENTRY blendFuncSeparate(GLenum, GLenum, GLenum, GLenum) { stateCalls++; }
+	void APIENTRY depthMask(GLboolean) { stateCalls++; }
+	void APIENTRY viewport(GLint, GLint, GLsizei, GLsizei) { stateCalls++; }
+
+	void APIENTRY texImage2D(GLenum, GLint level, GLint internalFormat, GLsizei, GLsizei, GLint, GLenum, GLenum, const void*)
+	{
+		if (level == 0)
+		{
+			textureFormats[boundTextures[activeUnit]] = internalFormat;
+		}
+	}
+	void APIENTRY compressedTexImage2D(GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei, const void*) {}
+	void APIENTRY texParameteri(GLenum, GLenum, GLint) {}
+	void APIENTRY generateMipmap(GLenum) {}
+
+	// Bytes are compared by an FNV-1a hash, so a recorded draw stays small.
+	uint64_t fingerprint(const std::vector<unsigned char> & bytes)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (unsigned char byte : bytes)
+		{
+			hash = (hash ^ byte) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	void record(GLsizei count, size_t firstIndex, GLsizei instances, GLint baseVertex)
+	{
+		const VertexArray & vertexArray = vertexArrays[boundVertexArray];
+		Draw draw;
+		draw.count = count;
+		draw.firstIndex = firstIndex;
+		draw.instances = instances;
+		draw.baseVertex = baseVertex;
+		draw.vertices = fingerprint(buffers[vertexArray.vertexBuffer].bytes);
+		draw.indices = fingerprint(buffers[vertexArray.elementBuffer].bytes);
+		for (const std::pair<const GLenum, GLuint> & texture : boundTextures)
+		{
+			if (texture.second != 0)
+			{
+				draw.textures.push_back(texture);
+			}
+		}
+		draw.vectors.assign(vectors.begin(), vectors.end());
+		draw.program = usedProgram;
+		draw.framebuffer = boundFramebuffer;
+		draws.push_back(draw);
+	}
+
+	void APIENTRY drawElementsInstancedBaseVertex(GLenum, GLsizei count, GLenum, const void* indices, GLsizei instances, GLint baseVertex)
+	{
+		record(count, (size_t)indices / sizeof(unsigned int), instances, baseVertex);
+	}
+
+	void APIENTRY drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex)
+	{
+		drawElementsInstancedBaseVertex(mode, count, type, indices, 1, baseVertex);
+	}
+
+	// Draws the commands in the bound indirect buffer one by one, as the driver would.
+	void APIENTRY multiDrawElementsIndirect(GLenum, GLenum, const void* indirect, GLsizei drawCount, GLsizei)
+	{
+		const std::vector<unsigned char> & bytes = buffers[boundBuffers[GL_DRAW_INDIRECT_BUFFER]].bytes;
+		for (GLsizei i = 0; i < drawCount; i++)
+		{
+			size_t offset = (size_t)indirect + i * sizeof(DrawElementsIndirectCommand);
+			if (offset + sizeof(DrawElementsIndirectCommand) > bytes.size())
+			{
+				invalidUploads++;
+				return;
+			}
+			DrawElementsIndirectCommand command;
+			memcpy(&command, bytes.data() + offset, sizeof(command));
+			record(command.count, command.firstIndex, command.instanceCount, command.baseVertex);
+		}
+	}
+
+	void APIENTRY drawArraysInstanced(GLenum, GLint, GLsizei, GLsizei)
+	{
+		arrayDraws++;
+	}
+
+	// The live buffers created after name first, their target, size and bytes, sorted so two sets
+	// created in different orders compare equal.
+	std::vector<std::tuple<GLenum, size_t, uint64_t>> buffersSince(GLuint first)
+	{
+		std::vector<std::tuple<GLenum, size_t, uint64_t>> live;
+		for (const std::pair<const GLuint, Buffer> & buffer : buffers)
+		{
+			if (buffer.first >= first)
+			{
+				live.emplace_back(buffer.second.target, buffer.second.size, fingerprint(buffer.second.bytes));
+			}
+		}
+		std::sort(live.begin(), live.end());
+		return live;
+	}
+
+	// Points the glad functions a Shader, a Model and its textures call at the fake, or back at nothing.
+	void install(bool fake)
+	{
+		glCreateProgram = fake ? createObject : nullptr;
+		glCreateShader = fake ? createShader : nullptr;
+		glShaderSource = fake ? shaderSource : nullptr;
+		glCompileShader = fake ? compileShader : nullptr;
+		glAttachShader = fake ? attachShader : nullptr;
+		glLinkProgram = fake ? objectCall : nullptr;
+		glDeleteShader = fake ? objectCall : nullptr;
+		glDeleteProgram = fake ? objectCall : nullptr;
+		glUseProgram = fake ? useProgram : nullptr;
+		glGetShaderiv = fake ? getShaderiv : nullptr;
+		glGetProgramiv = fake ? getProgramiv : nullptr;
+		glGetActiveUniform = fake ? getActiveUniform : nullptr;
+		glGetUniformLocation = fake ? getUniformLocation : nullptr;
+		glUniform1i = fake ? uniform1i : nullptr;
+		glUniform1f = fake ? uniform1f : nullptr;
+		glUniform3fv = fake ? uniform3fv : nullptr;
+		glGetString = fake ? getString : nullptr;
+		glGetIntegerv = fake ? getIntegerv : nullptr;
+		glGetProgramBinary = fake ? getProgramBinary : nullptr;
+		glProgramBinary = fake ? programBinary : nullptr;
+		glProgramParameteri = fake ? programParameteri : nullptr;
+		glGenBuffers = fake ? genBuffers : nullptr;
+		glBindBuffer = fake ? bindBuffer : nullptr;
+		glBufferData = fake ? bufferData : nullptr;
+		glBufferSubData = fake ? bufferSubData : nullptr;
+		glDeleteBuffers = fake ? deleteBuffers : nullptr;
+		glGenVertexArrays = fake ? genObjects : nullptr;
+		glBindVertexArray = fake ? bindVertexArray : nullptr;
+		glDeleteVertexArrays = fake ? deleteObjects : nullptr;
+		glEnableVertexAttribArray = fake ? enableVertexAttribArray : nullptr;
+		glVertexAttribPointer = fake ? vertexAttribPointer : nullptr;
+		glVertexAttribIPointer = fake ? vertexAttribIPointer : nullptr;
+		glGetError = fake ? getError : nullptr;
+		glGenTextures = fake ? genObjects : nullptr;
+		glActiveTexture = fake ? activeTexture : nullptr;
+		glBindTexture = fake ? bindTexture : nullptr;
+		glBindTextureUnit = fake ? bindTextureUnit : nullptr;
+		glBindFramebuffer = fake ? bindFramebuffer : nullptr;
+		glEnable = fake ? stateCall : nullptr;
+		glDisable = fake ? stateCall : nullptr;
+		glBlendFunc = fake ? blendFunc : nullptr;
+		glBlendFuncSeparate = fake ? blendFuncSeparate : nullptr;
+		glBlendEquation = fake ? stateCall : nullptr;
+		glDepthFunc = fake ? stateCall : nullptr;
+		glDepthMask = fake ? depthMask : nullptr;
+		glViewport = fake ? viewport : nullptr;
+		glTexImage2D = fake ? texImage2D : nullptr;
+		glCompressedTexImage2D = fake ? compressedTexImage2D : nullptr;
+		glTexParameteri = fake ? texParameteri : nullptr;
+		glGenerateMipmap = fake ? generateMipmap : nullptr;
+		glDeleteTextures = fake ? deleteObjects : nullptr;
+		glDrawElementsInstancedBaseVertex = fake ? drawElementsInstancedBaseVertex : nullptr;
+		glDrawElementsBaseVertex = fake ? drawElementsBaseVertex : nullptr;
+		glMultiDrawElementsIndirect = fake ? multiDrawElementsIndirect : nullptr;
+		glDrawArraysInstanced = fake ? drawArraysInstanced : nullptr;
+	}
+}
+
+struct UniformFrameStats
+{
+	double lookups;
+	double allocations;
+	double microseconds;
+	unsigned long long uploads;
+	unsigned long long invalidUploads;
+	long long uploadedLocations;
+};
+
+// Runs frame 1000 times and returns what one frame cost on average.
+template <typename Frame>
+UniformFrameStats measureUniformFrame(Frame frame)
+{
+	const int frames = 1000;
+	FakeGL::locationLookups = 0;
+	FakeGL::uploads = 0;
+	FakeGL::invalidUploads = 0;
+	FakeGL::uploadedLocations = 0;
+	AllocationCounter::Counters before = AllocationCounter::threadCounters();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; i++)
+	{
+		frame();
+	}
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+	AllocationCounter::Counters after = AllocationCounter::threadCounters();
+
+	UniformFrameStats stats;
+	stats.lookups = double(FakeGL::locationLookups) / frames;
+	stats.allocations = double(after.allocations - before.allocations) / frames;
+	stats.microseconds = elapsed.count() / frames;
+	stats.uploads = FakeGL::uploads / frames;
+	stats.invalidUploads = FakeGL::invalidUploads / frames;
+	stats.uploadedLocations = FakeGL::uploadedLocations / frames;
+	return stats;
+}
+
+// Sets the per-frame uniforms of Deferred_Shading's lighting pass three ways: with a
+// glGetUniformLocation per call as Shader did before it had a location table, by name through the
+// table, and through Uniform handles resolved once. Prints location lookups, heap allocations and
+// time per frame of each. All three must upload the same uniforms, and the handles must need
+// neither lookups nor allocations.
+bool checkUniformLookups()
+{
+	const unsigned int NR_LIGHTS = 32;
+	FakeGL::uniforms = { "gPosition", "gNormal", "gAlbedoSpec", "viewPos" };
+	const char* members[] = { "Position", "Color", "Linear", "Quadratic" };
+	for (unsigned int i = 0; i < NR_LIGHTS; i++)
+	{
+		for (const char* member : members)
+		{
+			FakeGL::uniforms.push_back("lights[" + std::to_string(i) + "]." + member);
+		}
+	}
+	FakeGL::install(true);
+
+	Shader shader(LIGHTING_VERTEX.c_str(), LIGHTING_FRAGMENT.c_str());
+	shader.use();
+	std::vector<Uniform<glm::vec3>> positionUniforms = shader.uniformArray<glm::vec3>("lights", NR_LIGHTS, "Position");
+	std::vector<Uniform<glm::vec3>> colorUniforms = shader.uniformArray<glm::vec3>("lights", NR_LIGHTS, "Color");
+	std::vector<Uniform<float>> linearUniforms = shader.uniformArray<float>("lights", NR_LIGHTS, "Linear");
+	std::vector<Uniform<float>> quadraticUniforms = shader.uniformArray<float>("lights", NR_LIGHTS, "Quadratic");
+	Uniform<glm::vec3> viewPosUniform = shader.uniform<glm::vec3>("viewPos");
+
+	std::vector<glm::vec3> lightPositions(NR_LIGHTS, glm::vec3(1.0f, 0.0f, 1.0f));
+	std::vector<glm::vec3> lightColors(NR_LIGHTS, glm::vec3(0.75f));
+	glm::vec3 viewPos(0.0f, 0.0f, 5.0f);
+	const float linear = 0.7f;
+	const float quadratic = 1.8f;
+
+	const char* names[3] = { "glGetUniformLocation per call", "location table by name", "Uniform handles" };
+	UniformFrameStats stats[3];
+	stats[0] = measureUniformFrame([&]()
+	{
+		for (unsigned int i = 0; i < NR_LIGHTS; i++)
+		{
+			glUniform3fv(glGetUniformLocation(shader.ID, ("lights[" + std::to_string(i) + "].Position").c_str()), 1, &lightPositions[i][0]);
+			glUniform3fv(glGetUniformLocation(shader.ID, ("lights[" + std::to_string(i) + "].Color").c_str()), 1, &lightColors[i][0]);
+			glUniform1f(glGetUniformLocation(shader.ID, ("lights[" + std::to_string(i) + "].Linear").c_str()), linear);
+			glUniform1f(glGetUniformLocation(shader.ID, ("lights[" + std::to_string(i) + "].Quadratic").c_str()), quadratic);
+		}
+		glUniform3fv(glGetUniformLocation(shader.ID, "viewPos"), 1, &viewPos[0]);
+	});
+	stats[1] = measureUniformFrame([&]()
+	{
+		for (unsigned int i = 0; i < NR_LIGHTS; i++)
+		{
+			shader.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
+			shader.setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
+			shader.setFloat("lights[" + std::to_string(i) + "].Linear", linear);
+			shader.setFloat("lights[" + std::to_string(i) + "].Quadratic", quadratic);
+		}
+		shader.setVec3("viewPos", viewPos);
+	});
+	stats[2] = measureUniformFrame([&]()
+	{
+		for (unsigned int i = 0; i < NR_LIGHTS; i++)
+		{
+			positionUniforms[i].set(lightPositions[i]);
+			colorUniforms[i].set(lightColors[i]);
+			linearUniforms[i].set(linear);
+			quadraticUniforms[i].set(quadratic);
+		}
+		viewPosUniform.set(viewPos);
+	});
+	FakeGL::install(false);
+
+	bool passed = true;
+	for (int i = 0; i < 3; i++)
+	{
+		std::cout << "uniform lookups, " << names[i] << ": " << stats[i].uploads << " uniforms, " << stats[i].lookups << " glGetUniformLocation calls, "
+			<< stats[i].allocations << " allocations, " << stats[i].microseconds << " us per frame" << std::endl;
+		if (stats[i].invalidUploads != 0 || stats[i].uploads != stats[0].uploads || stats[i].uploadedLocations != stats[0].uploadedLocations)
+		{
+			std::cout << "ERROR::UNIFORM_LOOKUPS::WRONG_LOCATIONS " << names[i] << std::endl;
+			passed = false;
+		}
+	}
+	if (stats[1].lookups != 0.0 || stats[2].lookups != 0.0)
+	{
+		std::cout << "ERROR::UNIFORM_LOOKUPS::LOCATION_LOOKED_UP_PER_FRAME" << std::endl;
+		passed = false;
+	}
+	if (stats[2].allocations != 0.0)
+	{
+		std::cout << "ERROR::UNIFORM_LOOKUPS::HANDLES_ALLOCATE" << std::endl;
+		passed = false;
+	}
+	return passed;
+}
+
+// Draws the Deferred_Shading frame, the nanosuit grid into the gBuffer and the lighting pass, on
+// FakeGL through GLStateCache, once with the cache off and once on. Every call must be counted as
+// issued or elided, only the issued ones may reach GL and the draws must see the same state either
+// way. Then a bind by unit and separate blend functions must not leave the cache eliding calls that
+// change state.
+bool checkStateCache()
+{
+	FakeGL::uniforms = { "texture_diffuse1", "texture_specular1", "texture_normal1", "texture_height1", "positionOffset", "positionScale" };
+	FakeGL::install(true);
+	GLStateCache::install();
+	bool passed = true;
+	{
+		Shader geometry(GEOMETRY_VERTEX.c_str(), GEOMETRY_FRAGMENT.c_str(), nullptr, { { "COMPACT_VERTICES" }, { "MAX_INSTANCES", 16 } });
+		Shader lighting(LIGHTING_VERTEX.c_str(), LIGHTING_FRAGMENT.c_str());
+		Model nanosuit(NANOSUIT.c_str(), false, true, VertexFormat::Compact);
+
+		std::vector<glm::mat4> objectModels;
+		for (int z = -1; z <= 1; z++)
+		{
+			for (int x = -1; x <= 1; x++)
+			{
+				objectModels.push_back(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x, -3.0f, 3.0f * z)), glm::vec3(0.25f)));
+			}
+		}
+		LodCamera camera(glm::vec3(0.0f, 0.0f, 5.0f), glm::radians(45.0f), (float)SCR_HEIGHT);
+		GLuint gBuffer = FakeGL::nextName++;
+		GLuint gTextures[3];
+		glGenTextures(3, gTextures);
+		GLuint quadVAO;
+		glGenVertexArrays(1, &quadVAO);
+
+		auto frame = [&]()
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+			glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+			glEnable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			geometry.use();
+			for (const glm::mat4 & objectModel : objectModels)
+			{
+				nanosuit.Draw(geometry, camera, objectModel);
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			lighting.use();
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				glActiveTexture(GL_TEXTURE0 + i);
+				glBindTexture(GL_TEXTURE_2D, gTextures[i]);
+			}
+			glBindVertexArray(quadVAO);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 1);
+		};
+
+		// the second frame of each, the first one after switching starts from unknown state
+		GLStateCache::Counters counters[2];
+		unsigned long long stateCalls[2];
+		std::vector<FakeGL::Draw> draws[2];
+		for (int cached = 0; cached < 2; cached++)
+		{
+			GLStateCache::setEnabled(cached != 0);
+			frame();
+			GLStateCache::resetCounters();
+			FakeGL::stateCalls = 0;
+			FakeGL::draws.clear();
+			frame();
+			counters[cached] = GLStateCache::counters();
+			stateCalls[cached] = FakeGL::stateCalls;
+			draws[cached] = FakeGL::draws;
+		}
+		std::cout << "state cache: " << counters[0].issued << " state calls per frame of " << objectModels.size() << " nanosuits, "
+			<< counters[1].issued << " issued and " << counters[1].elided << " elided with the cache" << std::endl;
+
+		if (counters[0].elided != 0 || counters[0].issued != stateCalls[0])
+		{
+			std::cout << "ERROR::STATE_CACHE::ELIDED_WHILE_OFF " << counters[0].elided << std::endl;
+			passed = false;
+		}
+		if (counters[1].issued + counters[1].elided != counters[0].issued || counters[1].issued != stateCalls[1])
+		{
+			std::cout << "ERROR::STATE_CACHE::COUNTERS_WRONG issued " << counters[1].issued << ", elided " << counters[1].elided
+				<< ", reached GL " << stateCalls[1] << std::endl;
+			passed = false;
+		}
+		// at least the arena VAO of every nanosuit after the first and the viewport, depth test and blend
+		if (counters[1].elided < objectModels.size() - 1 + 3)
+		{
+			std::cout << "ERROR::STATE_CACHE::TOO_FEW_ELIDED " << counters[1].elided << std::endl;
+			passed = false;
+		}
+		if (draws[0].empty() || draws[1] != draws[0])
+		{
+			std::cout << "ERROR::STATE_CACHE::DRAWS_DIFFER " << draws[0].size() << " without, " << draws[1].size() << " with the cache" << std::endl;
+			passed = false;
+		}
+
+		// unit 0 holds gTextures[0] now, binding another one by unit must not hide the bind back
+		glBindTextureUnit(0, gTextures[1]);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, gTextures[0]);
+		if (FakeGL::boundTextures[GL_TEXTURE0] != gTextures[0])
+		{
+			std::cout << "ERROR::STATE_CACHE::BIND_BY_UNIT_NOT_FOLLOWED" << std::endl;
+			passed = false;
+		}
+		glBlendFunc(GL_ONE, GL_ONE);
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ZERO);
+		FakeGL::stateCalls = 0;
+		glBlendFunc(GL_ONE, GL_ONE);
+		if (FakeGL::stateCalls != 1)
+		{
+			std::cout << "ERROR::STATE_CACHE::SEPARATE_BLEND_NOT_FOLLOWED" << std::endl;
+			passed = false;
+		}
+	}
+	GLStateCache::uninstall();
+	FakeGL::install(false);
+	return passed;
+}
+
+// The programs a sample builds at startup, with its shader paths relative to this project.
+struct SamplePrograms
+{
+	struct Program
+	{
+		const char* vertex;
+		const char* fragment;
+		const char* geometry;
+		ShaderDefines defines;
+	};
+
+	const char* sample;
+	std::vector<Program> programs;
+};
+
+// Builds the startup programs of several samples through ProgramBinaryCache twice, the first time
+// into an empty cache. The cold start must compile every stage and store the binaries, except for
+// programs an earlier sample already built from the same sources, and the warm start must restore
+// every program with glProgramBinary and compile nothing. Prints both times per sample;
+// the fake driver compiles for free, so they only cover reading, preprocessing and the cache files.
+// The samples print their real compile times at startup.
+bool checkProgramBinaryCache()
+{
+	const ShaderDefines pbrDefines = { { "NR_LIGHTS", 4 }, { "HAS_MATERIAL_MAPS" }, { "MATERIAL_ARRAYS" }, { "SRGB_ALBEDO" }, { "NORMAL_MAP_RG" }, { "IBL_SPECULAR" } };
+	const std::vector<SamplePrograms> samples = {
+		{ "Deferred_Shading", {
+			{ "../Deferred_Shading/g_buffer.vs", "../Deferred_Shading/g_buffer.fs", nullptr, { { "COMPACT_VERTICES" }, { "MAX_INSTANCES", 16 } } },
+			{ "../Deferred_Shading/defered_shading.vs", "../Deferred_Shading/defered_shading.fs", nullptr, ShaderDefines() },
+			{ "../Deferred_Shading/defered_light_box.vs", "../Deferred_Shading/defered_light_box.fs", nullptr, ShaderDefines() } } },
+		{ "IBL_Specular_Textured", {
+			{ "../IBL_Specular_Textured/pbr.vs", "../IBL_Specular_Textured/pbr.fs", nullptr, pbrDefines },
+			{ "../IBL_Specular_Textured/background.vs", "../IBL_Specular_Textured/background.fs", nullptr, ShaderDefines() },
+			{ "../IBL_Specular_Textured/irradiance_convolution.vs", "../IBL_Specular_Textured/irradiance_convolution.fs", nullptr, ShaderDefines() },
+			{ "../IBL_Specular_Textured/cubemap.vs", "../IBL_Specular_Textured/cubemap.fs", nullptr, ShaderDefines() },
+			{ "../IBL_Specular_Textured/cubemap.vs", "../IBL_Specular_Textured/prefilter.fs", nullptr, ShaderDefines() },
+			{ "../IBL_Specular_Textured/brdf.vs", "../IBL_Specular_Textured/brdf.fs", nullptr, ShaderDefines() } } },
+		{ "IBL_Irradiance_Conversion", {
+			{ "../IBL_Irradiance_Conversion/CubeMap.vs", "../IBL_Irradiance_Conversion/CubeMap.fs", nullptr, ShaderDefines() },
+			{ "../IBL_Irradiance_Conversion/Background.vs", "../IBL_Irradiance_Conversion/Background.fs", nullptr, ShaderDefines() },
+			{ "../IBL_Irradiance_Conversion/Vertex.vs", "../IBL_Irradiance_Conversion/Fragment.fs", nullptr, ShaderDefines() } } },
+		{ "Lighting", {
+			{ "../Lighting/Light.vs", "../Lighting/Light.fs", nullptr, ShaderDefines() },
+			{ "../Lighting/Cube.vs", "../Lighting/Cube.fs", nullptr, ShaderDefines() } } },
+		{ "Shadow Mapping", {
+			{ "../Shadow Mapping/shadow_mappinng_depth.vs", "../Shadow Mapping/shadow_mappinng_depth.fs", nullptr, ShaderDefines() },
+			{ "../Shadow Mapping/debug_quad.vs", "../Shadow Mapping/debug_quad.fs", nullptr, ShaderDefines() },
+			{ "../Shadow Mapping/shadow_mapping.vs", "../Shadow Mapping/shadow_mapping.fs", nullptr, ShaderDefines() } } },
+		{ "Point Shadows", {
+			{ "../Point Shadows/point_shadows.vs", "../Point Shadows/point_shadows.fs", nullptr, ShaderDefines() },
+			{ "../Point Shadows/point_shadows_depth.vs", "../Point Shadows/point_shadows_depth.fs", "../Point Shadows/point_shadows_depth.gs", ShaderDefines() } } },
+	};
+
+	FakeGL::uniforms.clear();
+	FakeGL::install(true);
+	ProgramBinaryCache::directory() = "shader_cache";
+
+	// the files this check writes, removed before so the first build is cold and after so nothing stays
+	std::vector<std::string> cacheFiles;
+	for (const SamplePrograms & sample : samples)
+	{
+		for (const SamplePrograms::Program & program : sample.programs)
+		{
+			std::string geometry = program.geometry != nullptr ? ShaderPreprocessor::load(program.geometry, program.defines) : std::string();
+			std::string file = ProgramBinaryCache::path(ProgramBinaryCache::key({ ShaderPreprocessor::load(program.vertex, program.defines),
+				ShaderPreprocessor::load(program.fragment, program.defines), geometry }));
+			cacheFiles.push_back(file);
+		}
+	}
+	for (const std::string & file : cacheFiles)
+	{
+		std::remove(file.c_str());
+	}
+
+	bool passed = true;
+	size_t file = 0;
+	for (const SamplePrograms & sample : samples)
+	{
+		// stages compiled and programs restored on the cold start
+		unsigned long long stages = 0;
+		unsigned long long shared = 0;
+		for (const SamplePrograms::Program & program : sample.programs)
+		{
+			if (std::find(cacheFiles.begin(), cacheFiles.begin() + file, cacheFiles[file]) != cacheFiles.begin() + file)
+			{
+				shared++;
+			}
+			else
+			{
+				stages += program.geometry != nullptr ? 3 : 2;
+			}
+			file++;
+		}
+
+		double milliseconds[2];
+		unsigned long long compiles[2];
+		unsigned long long binaries[2];
+		for (int warm = 0; warm < 2; warm++)
+		{
+			FakeGL::compiles = 0;
+			FakeGL::binariesLoaded = 0;
+			FakeGL::binariesRejected = 0;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (const SamplePrograms::Program & program : sample.programs)
+			{
+				Shader shader(program.vertex, program.fragment, program.geometry, program.defines);
+			}
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			milliseconds[warm] = elapsed.count();
+			compiles[warm] = FakeGL::compiles;
+			binaries[warm] = FakeGL::binariesLoaded;
+			if (FakeGL::binariesRejected != 0)
+			{
+				std::cout << "ERROR::PROGRAM_BINARY_CACHE::BINARY_REJECTED " << sample.sample << std::endl;
+				passed = false;
+			}
+		}
+
+		std::cout << "program binary cache, " << sample.sample << ": " << sample.programs.size() << " programs, cold " << milliseconds[0] << " ms with "
+			<< compiles[0] << " compiles and " << binaries[0] << " glProgramBinary, warm " << milliseconds[1] << " ms with " << compiles[1] << " compiles and "
+			<< binaries[1] << " glProgramBinary" << std::endl;
+		if (compiles[0] != stages || binaries[0] != shared)
+		{
+			std::cout << "ERROR::PROGRAM_BINARY_CACHE::COLD_START_NOT_COMPILED " << sample.sample << std::endl;
+			passed = false;
+		}
+		if (compiles[1] != 0 || binaries[1] != sample.programs.size())
+		{
+			std::cout << "ERROR::PROGRAM_BINARY_CACHE::WARM_START_COMPILED " << sample.sample << std::endl;
+			passed = false;
+		}
+	}
+
+	for (const std::string & file : cacheFiles)
+	{
+		std::remove(file.c_str());
+	}
+	ProgramBinaryCache::directory() = "";
+	FakeGL::install(false);
+	return passed;
+}
+
+// Culls random boxes in front of, beside and behind a wall whose outline on screen is known exactly,
+// and compares with that outline. Boxes reported hidden that are not must stick out by less than a
+// pixel, see OcclusionCuller. Then times rendering and testing 100k boxes.
+bool checkOcclusionCuller()
+{
+	OcclusionCuller culler;
+	BoundingBox wall(glm::vec3(-2.0f, -1.0f, -5.5f), glm::vec3(2.0f, 1.0f, -5.0f));
+	culler.addOccluder(wall);
+	glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 2.0f, 0.1f, 100.0f)
+		* glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	culler.render(viewProjection);
+
+	// the wall is centered on the view axis, so its front face is its outline
+	auto project = [&](const glm::vec3 & point)
+	{
+		glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+		return glm::vec2(clip) / clip.w;
+	};
+	glm::vec2 wallMin = project(glm::vec3(wall.min.x, wall.min.y, wall.max.z));
+	glm::vec2 wallMax = project(glm::vec3(wall.max.x, wall.max.y, wall.max.z));
+
+	std::vector<BoundingBox> boxes;
+	srand(5);
+	for (int i = 0; i < 100000; i++)
+	{
+		glm::vec3 position((rand() % 2000) / 100.0f - 10.0f, (rand() % 1000) / 100.0f - 5.0f, -(rand() % 3000) / 100.0f - 1.0f);
+		boxes.push_back(BoundingBox(position, position + glm::vec3(0.1f + (rand() % 100) / 100.0f)));
+	}
+
+	size_t hidden = 0, found = 0, foundAtFullResolution = 0, wronglyHidden = 0;
+	float worstOverhang = 0.0f;
+	for (const BoundingBox & box : boxes)
+	{
+		glm::vec2 boxMin(FLT_MAX), boxMax(-FLT_MAX);
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec2 corner = project(glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z));
+			boxMin = glm::min(boxMin, corner);
+			boxMax = glm::max(boxMax, corner);
+		}
+		bool behindWall = box.max.z < wall.min.z && boxMin.x >= wallMin.x && boxMin.y >= wallMin.y && boxMax.x <= wallMax.x && boxMax.y <= wallMax.y;
+		bool visible = culler.visible(box);
+		hidden += behindWall;
+		found += behindWall && !visible;
+		foundAtFullResolution += behindWall && !culler.visibleAtFullResolution(box);
+		if (!behindWall && !visible)
+		{
+			wronglyHidden++;
+			glm::vec2 overhang = glm::max(wallMin - boxMin, boxMax - wallMax) * 0.5f * glm::vec2(culler.bufferWidth(), culler.bufferHeight());
+			worstOverhang = std::max(worstOverhang, std::max(overhang.x, overhang.y));
+		}
+	}
+	std::cout << "occlusion culling: " << hidden << " of " << boxes.size() << " boxes hidden, " << found << " found with the pyramid, "
+		<< foundAtFullResolution << " at full resolution, " << wronglyHidden << " visible ones culled, sticking out at most "
+		<< worstOverhang << " pixels" << std::endl;
+
+	std::vector<unsigned char> visible(boxes.size());
+	int asyncMismatches = 0;
+	// at least four threads so the pool is used even on a single core
+	unsigned int threads[2] = { 1, std::max(std::thread::hardware_concurrency(), 4u) };
+	for (unsigned int workers : threads)
+	{
+		culler.setWorkers(workers);
+		const int runs = 20;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < runs; i++)
+		{
+			culler.render(viewProjection);
+		}
+		auto rendered = std::chrono::steady_clock::now();
+		for (int i = 0; i < runs; i++)
+		{
+			culler.test(boxes.data(), boxes.size(), visible.data());
+		}
+		auto tested = std::chrono::steady_clock::now();
+		// the same frame through start() and finish() on the pool must give the same answers
+		for (int i = 0; i < runs; i++)
+		{
+			culler.start(viewProjection, boxes.data(), boxes.size());
+			asyncMismatches += culler.finish() != visible;
+		}
+		auto finished = std::chrono::steady_clock::now();
+		std::cout << "occlusion culling on " << workers << " threads: " << std::chrono::duration<double, std::milli>(rendered - start).count() / runs
+			<< " ms to render, " << std::chrono::duration<double, std::nano>(tested - rendered).count() / runs / boxes.size() << " ns per box, "
+			<< std::chrono::duration<double, std::milli>(finished - tested).count() / runs << " ms per start() and finish()" << std::endl;
+	}
+
+	if (worstOverhang >= 1.0f)
+	{
+		std::cout << "ERROR::OCCLUSION_CULLING::VISIBLE_BOX_CULLED" << std::endl;
+		return false;
+	}
+	if (found == 0)
+	{
+		std::cout << "ERROR::OCCLUSION_CULLING::NOTHING_OCCLUDED" << std::endl;
+		return false;
+	}
+	if (asyncMismatches != 0)
+	{
+		std::cout << "ERROR::OCCLUSION_CULLING::ASYNC_RESULT_DIFFERS " << asyncMismatches << " frames" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Culls 100k random boxes and spheres with the SIMD and the scalar kernel for a camera turning
+// around once, prints ns per object of both and checks that they agree on every object.
+bool checkFrustumCuller()
+{
+	const unsigned int OBJECTS = 100000;
+	const int FRAMES = 100;
+
+	FrustumCuller culler;
+	srand(7);
+	for (unsigned int i = 0; i < OBJECTS; i++)
+	{
+		glm::vec3 position((rand() % 2000) / 10.0f - 100.0f, (rand() % 2000) / 10.0f - 100.0f, (rand() % 2000) / 10.0f - 100.0f);
+		if (i % 2 == 0)
+		{
+			culler.add(BoundingBox(position, position + glm::vec3(0.5f + (rand() % 100) / 50.0f)));
+		}
+		else
+		{
+			culler.add(BoundingSphere(position, 0.5f + (rand() % 100) / 100.0f));
+		}
+	}
+
+	std::vector<unsigned char> visible(OBJECTS + 8), reference(OBJECTS + 8);
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+	double simdTime = 0.0, scalarTime = 0.0;
+	size_t visibleCount = 0;
+	int disagreements = 0;
+	for (int frame = 0; frame < FRAMES; frame++)
+	{
+		float angle = glm::radians(360.0f) * frame / FRAMES;
+		glm::vec3 forward(std::cos(angle), 0.0f, std::sin(angle));
+		Frustum frustum = Frustum::fromMatrix(projection * glm::lookAt(glm::vec3(0.0f), forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		visibleCount += culler.cull(frustum, visible.data());
+		std::chrono::steady_clock::time_point culled = std::chrono::steady_clock::now();
+		culler.cullScalar(frustum, reference.data());
+		std::chrono::steady_clock::time_point culledScalar = std::chrono::steady_clock::now();
+		simdTime += std::chrono::duration<double, std::nano>(culled - start).count();
+		scalarTime += std::chrono::duration<double, std::nano>(culledScalar - culled).count();
+		if (!std::equal(visible.begin(), visible.begin() + OBJECTS, reference.begin()))
+		{
+			disagreements++;
+		}
+	}
+	std::cout << "frustum culling: " << OBJECTS << " objects, " << visibleCount / FRAMES << " visible per frame, "
+		<< simdTime / FRAMES / OBJECTS << " ns per object " << FrustumCuller::kernel() << ", "
+		<< scalarTime / FRAMES / OBJECTS << " ns scalar" << std::endl;
+	if (disagreements > 0)
+	{
+		std::cout << "ERROR::FRUSTUM_CULLING::SIMD_AND_SCALAR_DISAGREE in " << disagreements << " frames" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Culls the meshlets of the nanosuit in the middle of Deferred_Shading's grid as the camera sees it
+// at startup, with the SSE and the scalar kernel, and checks that both agree.
+bool checkMeshletCuller()
+{
+	const ModelData & model = nanosuit();
+	std::vector<MeshletBounds> bounds;
+	for (const ModelData::MeshData & mesh : model.meshes)
+	{
+		bounds.insert(bounds.end(), mesh.meshletBounds.begin(), mesh.meshletBounds.end());
+	}
+	if (bounds.empty())
+	{
+		std::cout << "ERROR::MESHLET_CULLING::NO_MESHLETS" << std::endl;
+		return false;
+	}
+
+	MeshletCuller culler;
+	culler.reset(bounds);
+	std::vector<unsigned char> visible((bounds.size() + 3) & ~3), reference(visible.size());
+	Camera camera(glm::vec3(0.0f, 0.0f, 5.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+	glm::mat4 objectModel = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -3.0f, 0.0f)), glm::vec3(0.25f));
+	Frustum frustum = camera.GetFrustum(projection).transformed(objectModel);
+	glm::vec3 localCamera = glm::vec3(glm::inverse(objectModel) * glm::vec4(camera.Position, 1.0f));
+
+	const int runs = 1000;
+	size_t visibleCount = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < runs; i++)
+	{
+		visibleCount = culler.cull(frustum.planes, localCamera, visible.data());
+	}
+	std::chrono::steady_clock::time_point culled = std::chrono::steady_clock::now();
+	for (int i = 0; i < runs; i++)
+	{
+		culler.cullScalar(frustum.planes, localCamera, reference.data());
+	}
+	std::chrono::steady_clock::time_point culledScalar = std::chrono::steady_clock::now();
+	double simd = std::chrono::duration<double, std::nano>(culled - start).count();
+	double scalar = std::chrono::duration<double, std::nano>(culledScalar - culled).count();
+	std::cout << "meshlet culling: " << bounds.size() << " meshlets, " << visibleCount << " visible, "
+		<< simd / runs / bounds.size() << " ns per meshlet SSE, " << scalar / runs / bounds.size() << " ns scalar" << std::endl;
+	if (!std::equal(visible.begin(), visible.begin() + bounds.size(), reference.begin()))
+	{
+		std::cout << "ERROR::MESHLET_CULLING::SSE_AND_SCALAR_DISAGREE" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Prints the triangles and error of every LOD of the nanosuit and checks that each level is smaller
+// and no more accurate than the one before. Then picks the LODs of a 20 x 20 grid of nanosuits as
+// Deferred_Shading's camera sees them at startup and prints the triangles with and without LODs.
+bool checkLods()
+{
+	const ModelData & model = nanosuit();
+	size_t levels = 0;
+	for (const ModelData::MeshData & mesh : model.meshes)
+	{
+		levels = std::max(levels, mesh.lods.size());
+	}
+	if (levels < 2)
+	{
+		std::cout << "ERROR::LOD::NO_LODS" << std::endl;
+		return false;
+	}
+
+	// a mesh whose chain stopped early draws its coarsest level instead, as Mesh::lod() does
+	std::vector<unsigned long long> triangles(levels, 0);
+	std::vector<float> errors(levels, 0.0f);
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for (const ModelData::MeshData & mesh : model.meshes)
+	{
+		for (size_t lod = 0; lod < levels; lod++)
+		{
+			const MeshLod & level = mesh.lods[std::min(lod, mesh.lods.size() - 1)];
+			triangles[lod] += level.indexCount / 3;
+			errors[lod] = std::max(errors[lod], level.error);
+		}
+		boundsMin = glm::min(boundsMin, mesh.boundsMin);
+		boundsMax = glm::max(boundsMax, mesh.boundsMax);
+	}
+
+	bool ordered = true;
+	for (size_t lod = 0; lod < levels; lod++)
+	{
+		std::cout << "LOD " << lod << ": " << triangles[lod] << " triangles (" << 100.0f * triangles[lod] / triangles[0] << "%), error " << errors[lod] << std::endl;
+		if (lod > 0 && (triangles[lod] >= triangles[lod - 1] || errors[lod] < errors[lod - 1]))
+		{
+			ordered = false;
+		}
+	}
+
+	// the sphere around the box, Model's own sphere is at most this large
+	BoundingBox box(boundsMin, boundsMax);
+	BoundingSphere sphere(box.center(), glm::length(box.extent()));
+	Camera camera(glm::vec3(0.0f, 0.0f, 5.0f));
+	LodCamera lodCamera(camera.Position, glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+	std::vector<unsigned int> instances(levels, 0);
+	unsigned long long selectedTriangles = 0;
+	for (int z = 0; z < 20; z++)
+	{
+		for (int x = 0; x < 20; x++)
+		{
+			glm::mat4 objectModel = glm::translate(glm::mat4(1.0f), glm::vec3(-28.5 + 3.0 * x, -3.0, 3.0 - 3.0 * z));
+			objectModel = glm::scale(objectModel, glm::vec3(0.25f));
+			unsigned int lod = lodCamera.select(sphere, errors, objectModel);
+			instances[lod]++;
+			selectedTriangles += triangles[lod];
+		}
+	}
+	std::cout << "LOD scene: 400 nanosuits, " << selectedTriangles << " triangles with LODs against " << 400 * triangles[0] << " without, per level";
+	for (unsigned int count : instances)
+	{
+		std::cout << " " << count;
+	}
+	std::cout << std::endl;
+
+	if (!ordered)
+	{
+		std::cout << "ERROR::LOD::LEVELS_OUT_OF_ORDER" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Vertices the nanosuit does not have: zero tangents, normals at both poles of the octahedral map
+// and on its folded edges, a flipped bitangent, a flat box axis and texture coordinates far outside
+// [0, 1] and near zero.
+std::vector<Vertex> compressionEdgeCases(glm::vec3 & boundsMin, glm::vec3 & boundsMax)
+{
+	const glm::vec3 directions[] = {
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::normalize(glm::vec3(1.0f, 1.0f, -1.0f)), glm::normalize(glm::vec3(-1.0f, 1.0f, -1e-4f)), glm::normalize(glm::vec3(1e-4f, -1e-4f, -1.0f)),
+	};
+	const glm::vec2 texCoords[] = { glm::vec2(0.0f), glm::vec2(1.0f), glm::vec2(1000.37f, -250.5f), glm::vec2(4095.9f, 17.001f), glm::vec2(1e-5f, -3e-7f) };
+
+	std::vector<Vertex> vertices;
+	for (size_t i = 0; i < sizeof(directions) / sizeof(directions[0]); i++)
+	{
+		for (size_t t = 0; t < sizeof(texCoords) / sizeof(texCoords[0]); t++)
+		{
+			Vertex vertex;
+			// y stays 0, the box is flat along it
+			vertex.Position = glm::vec3(-3.0f + 0.37f * i, 0.0f, 12.5f - 1.1f * t);
+			vertex.Normal = directions[i];
+			vertex.Tangent = t == 0 ? glm::vec3(0.0f) : directions[(i + 2) % (sizeof(directions) / sizeof(directions[0]))];
+			vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent) * (t % 2 == 0 ? -1.0f : 1.0f);
+			vertex.TexCoords = texCoords[t];
+			vertices.push_back(vertex);
+		}
+	}
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+	for (const Vertex & vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.Position);
+		boundsMax = glm::max(boundsMax, vertex.Position);
+	}
+	return vertices;
+}
+
+// Encodes the nanosuit and the edge cases above in the compact layout and fails when the largest
+// decode error VertexCompression measured is out of tolerance, or when decodeVertices does not give
+// back unit directions and the bitangent sign. Bone weights that do not split evenly into 255 must
+// still sum to exactly 255, each within two steps of its weight.
+bool checkVertexCompression()
+{
+	const ModelData & model = nanosuit();
+	bool passed = true;
+
+	VertexCompression::resetError();
+	std::vector<unsigned char> encoded;
+	for (const ModelData::MeshData & mesh : model.meshes)
+	{
+		encodeVertices(mesh.vertices.data(), (unsigned int)mesh.vertices.size(), model.layout, encoded);
+	}
+	VertexCompression::Error nanosuitError = VertexCompression::error();
+
+	VertexCompression::resetError();
+	glm::vec3 boundsMin, boundsMax;
+	std::vector<Vertex> edgeCases = compressionEdgeCases(boundsMin, boundsMax);
+	VertexLayout layout = VertexLayout::compact(boundsMin, boundsMax);
+	encoded.clear();
+	encodeVertices(edgeCases.data(), (unsigned int)edgeCases.size(), layout, encoded);
+	VertexCompression::Error edgeCaseError = VertexCompression::error();
+
+	const char* names[2] = { "nanosuit", "edge cases" };
+	const VertexCompression::Error* errors[2] = { &nanosuitError, &edgeCaseError };
+	for (int i = 0; i < 2; i++)
+	{
+		const VertexCompression::Error & error = *errors[i];
+		std::cout << "vertex compression, " << names[i] << ": " << error.vertices << " vertices, max error " << error.position << " steps, "
+			<< error.normal << " deg normal, " << error.tangent << " deg tangent, " << error.texCoord << " uv" << std::endl;
+		if (error.vertices == 0 || !error.withinTolerance())
+		{
+			std::cout << "ERROR::VERTEX_COMPRESSION::OUT_OF_TOLERANCE " << names[i] << std::endl;
+			passed = false;
+		}
+	}
+
+	std::vector<Vertex> decoded;
+	decodeVertices(encoded.data(), (unsigned int)edgeCases.size(), layout, decoded);
+	unsigned int broken = 0;
+	for (size_t i = 0; i < edgeCases.size(); i++)
+	{
+		const Vertex & vertex = decoded[i];
+		bool unit = std::fabs(glm::length(vertex.Normal) - 1.0f) < 1e-3f && std::fabs(glm::length(vertex.Tangent) - 1.0f) < 1e-3f;
+		bool flat = vertex.Position.y == boundsMin.y;
+		bool sameSign = glm::length(edgeCases[i].Tangent) == 0.0f
+			|| glm::dot(vertex.Bitangent, edgeCases[i].Bitangent) > 0.0f;
+		broken += unit && flat && sameSign ? 0 : 1;
+	}
+	if (broken > 0)
+	{
+		std::cout << "ERROR::VERTEX_COMPRESSION::DECODED_VERTICES_BROKEN " << broken << " of " << edgeCases.size() << std::endl;
+		passed = false;
+	}
+
+	const float weights[][4] = {
+		{ 1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f, 0.0f },
+		{ 0.25f, 0.25f, 0.25f, 0.25f },
+		{ 0.9996f, 0.0002f, 0.0001f, 0.0001f },
+		{ 0.126f, 0.125f, 0.125f, 0.624f },
+		{ 0.002f, 0.002f, 0.002f, 0.994f },
+		{ 0.5f, 0.5f, 0.0f, 0.0f },
+	};
+	unsigned int badWeights = 0;
+	for (const float (&set)[4] : weights)
+	{
+		uint8_t quantized[4];
+		VertexCompression::encodeWeights(set, quantized);
+		int sum = 0;
+		bool close = true;
+		for (int w = 0; w < 4; w++)
+		{
+			sum += quantized[w];
+			close = close && std::fabs(quantized[w] / 255.0f - set[w]) <= 2.0f / 255.0f;
+		}
+		badWeights += sum == 255 && close ? 0 : 1;
+	}
+	std::cout << "vertex compression: " << edgeCases.size() << " edge case vertices, " << broken << " decoded wrong, "
+		<< sizeof(weights) / sizeof(weights[0]) - badWeights << " of " << sizeof(weights) / sizeof(weights[0]) << " weight sets sum to 255" << std::endl;
+	if (badWeights > 0)
+	{
+		std::cout << "ERROR::VERTEX_COMPRESSION::WEIGHTS_DO_NOT_SUM_TO_ONE " << badWeights << std::endl;
+		passed = false;
+	}
+	return passed;
+}
+
+// True when both imports hold the same meshes, LODs, meshlets, textures and decoded pixels.
+bool sameData(const ModelData & a, const ModelData & b)
+{
+	if (a.valid != b.valid || a.layout.format != b.layout.format || a.layout.positionOffset != b.layout.positionOffset
+		|| a.layout.positionScale != b.layout.positionScale || a.meshes.size() != b.meshes.size() || a.textures != b.textures
+		|| a.images.size() != b.images.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < a.meshes.size(); i++)
+	{
+		const ModelData::MeshData & x = a.meshes[i];
+		const ModelData::MeshData & y = b.meshes[i];
+		if (x.vertexCount != y.vertexCount || x.indexCount != y.indexCount || x.textures != y.textures || x.boundsMin != y.boundsMin
+			|| x.boundsMax != y.boundsMax || x.sphere.center != y.sphere.center || x.sphere.radius != y.sphere.radius || x.lods.size() != y.lods.size() || x.meshlets.size() != y.meshlets.size()
+			|| x.meshletBounds.size() != y.meshletBounds.size())
+		{
+			return false;
+		}
+		if (memcmp(x.vertexData, y.vertexData, x.vertexCount * a.layout.vertexSize()) != 0 || memcmp(x.indexData, y.indexData, x.indexCount * sizeof(unsigned int)) != 0
+			|| memcmp(x.meshletBounds.data(), y.meshletBounds.data(), x.meshletBounds.size() * sizeof(MeshletBounds)) != 0)
+		{
+			return false;
+		}
+		for (size_t l = 0; l < x.lods.size(); l++)
+		{
+			if (x.lods[l].firstIndex != y.lods[l].firstIndex || x.lods[l].indexCount != y.lods[l].indexCount || x.lods[l].error != y.lods[l].error)
+			{
+				return false;
+			}
+		}
+		for (size_t m = 0; m < x.meshlets.size(); m++)
+		{
+			if (x.meshlets[m].firstIndex != y.meshlets[m].firstIndex || x.meshlets[m].triangleCount != y.meshlets[m].triangleCount)
+			{
+				return false;
+			}
+		}
+	}
+	for (size_t i = 0; i < a.images.size(); i++)
+	{
+		const TextureLoader::Image & x = a.images[i];
+		const TextureLoader::Image & y = b.images[i];
+		if (x.width != y.width || x.height != y.height || x.components != y.components || (x.data == nullptr) != (y.data == nullptr)
+			|| (x.data != nullptr && memcmp(x.data, y.data, (size_t)x.width * x.height * x.components) != 0))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Imports the nanosuit in both vertex formats at once through ModelImport, the worker half of
+// ModelLoader, and compares each with a synchronous Model::import, bounds and decoded textures
+// included.
+bool checkAsyncImport()
+{
+	const VertexFormat formats[2] = { VertexFormat::Full, VertexFormat::Compact };
+	ModelImport imports[2];
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < 2; i++)
+	{
+		imports[i].start(NANOSUIT, formats[i]);
+	}
+	std::unique_ptr<ModelData> results[2];
+	for (int i = 0; i < 2; i++)
+	{
+		results[i] = imports[i].take();
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "async import: 2 imports in " << elapsed.count() << " ms" << std::endl;
+
+	unsigned int matching = 0;
+	for (int i = 0; i < 2; i++)
+	{
+		glm::vec3 boundsMin, boundsMax, referenceMin, referenceMax;
+		bool hasBounds = imports[i].bounds(boundsMin, boundsMax);
+		ModelData reference;
+		Model::import(NANOSUIT, formats[i], true, reference, [&](const glm::vec3 & min, const glm::vec3 & max)
+		{
+			referenceMin = min;
+			referenceMax = max;
+		});
+		if (!reference.valid)
+		{
+			std::cout << "ERROR::TESTS::MODEL_NOT_LOADED " << NANOSUIT << std::endl;
+		}
+		else if (!hasBounds || boundsMin != referenceMin || boundsMax != referenceMax || !sameData(*results[i], reference))
+		{
+			std::cout << "ERROR::MODEL_LOADER::ASYNC_AND_SYNC_IMPORTS_DIFFER " << i << std::endl;
+		}
+		else
+		{
+			matching++;
+		}
+	}
+	std::cout << "async import: " << matching << " of 2 imports match" << std::endl;
+	return matching == 2;
+}
+
+// True when both models have the same meshes, ranges in the packed buffers, bounds and LODs.
+bool sameMeshes(const Model & a, const Model & b)
+{
+	if (a.meshes.size() != b.meshes.size() || a.lodCount() != b.lodCount() || a.bounds().min != b.bounds().min || a.bounds().max != b.bounds().max
+		|| a.boundingSphere().center != b.boundingSphere().center || a.boundingSphere().radius != b.boundingSphere().radius)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < a.meshes.size(); i++)
+	{
+		const Mesh & x = a.meshes[i];
+		const Mesh & y = b.meshes[i];
+		if (x.firstIndex != y.firstIndex || x.baseVertex != y.baseVertex || x.indexCount != y.indexCount || x.boundsMin != y.boundsMin
+			|| x.boundsMax != y.boundsMax || x.boundingSphere.center != y.boundingSphere.center || x.boundingSphere.radius != y.boundingSphere.radius
+			|| x.lods.size() != y.lods.size() || x.meshlets.size() != y.meshlets.size() || x.textures.size() != y.textures.size())
+		{
+			return false;
+		}
+		for (size_t l = 0; l < x.lods.size(); l++)
+		{
+			if (x.lods[l].firstIndex != y.lods[l].firstIndex || x.lods[l].indexCount != y.lods[l].indexCount || x.lods[l].error != y.lods[l].error)
+			{
+				return false;
+			}
+		}
+		for (size_t t = 0; t < x.textures.size(); t++)
+		{
+			if (x.textures[t].id != y.textures[t].id || x.textures[t].type != y.textures[t].type)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// The draws of every LOD of model, each from unbound textures.
+std::vector<FakeGL::Draw> recordDraws(Model & model, Shader & shader, unsigned int lodCount)
+{
+	FakeGL::draws.clear();
+	for (unsigned int lod = 0; lod < lodCount; lod++)
+	{
+		FakeGL::boundTextures.clear();
+		FakeGL::vectors.clear();
+		model.Draw(shader, 1, lod);
+	}
+	return FakeGL::draws;
+}
+
+// Loads the nanosuit through ModelLoader unpacked and packed in both vertex formats at once, with
+// update(0.1) once a frame and every handle drawn every frame as a sample does, then builds the same
+// four models with the synchronous Model constructor. Compares what reached the driver: the bytes of
+// every buffer, the draws of every LOD with their buffers, textures and position decoding, and the
+// mesh ranges, bounds and LODs. The placeholders must have been drawn while the models were loading
+// and deleted once they were ready.
+bool checkModelLoader()
+{
+	struct Load
+	{
+		const char* name;
+		bool packed;
+		VertexFormat format;
+	};
+	const Load loads[] = {
+		{ "unpacked full", false, VertexFormat::Full },
+		{ "unpacked compact", false, VertexFormat::Compact },
+		{ "packed full", true, VertexFormat::Full },
+		{ "packed compact", true, VertexFormat::Compact },
+	};
+	const size_t LOADS = sizeof(loads) / sizeof(loads[0]);
+
+	FakeGL::uniforms = { "texture_diffuse1", "texture_specular1", "texture_normal1", "texture_height1", "positionOffset", "positionScale" };
+	FakeGL::install(true);
+	bool passed = true;
+	{
+		Shader shader(LIGHTING_VERTEX.c_str(), LIGHTING_FRAGMENT.c_str());
+		FakeGL::invalidUploads = 0;
+		unsigned long long deletesBefore = FakeGL::bufferDeletes;
+		unsigned long long arrayDrawsBefore = FakeGL::arrayDraws;
+		GLuint first = FakeGL::nextName;
+
+		std::vector<ModelHandle> handles;
+		for (const Load & load : loads)
+		{
+			handles.push_back(ModelLoader::load(NANOSUIT, false, load.packed, load.format));
+		}
+		// frames in which the uploads went on, more than one per model when the budget sliced them
+		unsigned int frames = 0;
+		unsigned int uploadFrames = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		while (ModelLoader::pendingCount() > 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(60))
+		{
+			unsigned long long uploadsBefore = FakeGL::bufferUploads;
+			ModelLoader::update(0.1);
+			uploadFrames += FakeGL::bufferUploads != uploadsBefore ? 1 : 0;
+			for (ModelHandle & handle : handles)
+			{
+				handle.Draw(shader);
+			}
+			frames++;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		unsigned long long placeholderDraws = FakeGL::arrayDraws - arrayDrawsBefore;
+		unsigned long long placeholderDeletes = FakeGL::bufferDeletes - deletesBefore;
+		std::cout << "model loader: " << LOADS << " loads in " << frames << " frames, " << uploadFrames << " of them uploading, "
+			<< placeholderDraws << " placeholder draws" << std::endl;
+
+		// every buffer of the loaded models against every buffer of the same models built at once,
+		// the placeholders are gone by now
+		std::vector<FakeGL::Draw> loadedDraws[LOADS];
+		for (size_t i = 0; i < LOADS; i++)
+		{
+			if (handles[i].model() != nullptr)
+			{
+				loadedDraws[i] = recordDraws(*handles[i].model(), shader, handles[i].model()->lodCount());
+			}
+		}
+		std::vector<std::tuple<GLenum, size_t, uint64_t>> loadedBuffers = FakeGL::buffersSince(first);
+
+		first = FakeGL::nextName;
+		std::vector<std::unique_ptr<Model>> built;
+		std::vector<FakeGL::Draw> builtDraws[LOADS];
+		for (size_t i = 0; i < LOADS; i++)
+		{
+			built.emplace_back(new Model(NANOSUIT.c_str(), false, loads[i].packed, loads[i].format));
+			builtDraws[i] = recordDraws(*built[i], shader, built[i]->lodCount());
+		}
+		std::vector<std::tuple<GLenum, size_t, uint64_t>> builtBuffers = FakeGL::buffersSince(first);
+		if (loadedBuffers != builtBuffers || builtBuffers.empty())
+		{
+			std::cout << "ERROR::MODEL_LOADER::LOADED_AND_BUILT_BUFFERS_DIFFER " << loadedBuffers.size() << " and " << builtBuffers.size() << " buffers" << std::endl;
+			passed = false;
+		}
+
+		unsigned int matching = 0;
+		for (size_t i = 0; i < LOADS; i++)
+		{
+			if (handles[i].model() == nullptr)
+			{
+				std::cout << "ERROR::MODEL_LOADER::NOT_READY " << loads[i].name << std::endl;
+				continue;
+			}
+			bool drawsMatch = loadedDraws[i] == builtDraws[i] && !builtDraws[i].empty();
+			bool meshesMatch = sameMeshes(*handles[i].model(), *built[i]);
+			if (!drawsMatch || !meshesMatch)
+			{
+				std::cout << "ERROR::MODEL_LOADER::LOADED_AND_BUILT_MODELS_DIFFER " << loads[i].name << (drawsMatch ? "" : " draws")
+					<< (meshesMatch ? "" : " meshes") << std::endl;
+				continue;
+			}
+			std::cout << "model loader: " << loads[i].name << ", " << builtDraws[i].size() << " draws match" << std::endl;
+			matching++;
+		}
+		std::cout << "model loader: " << builtBuffers.size() << " buffers, " << matching << " of " << LOADS << " models match" << std::endl;
+		passed = passed && matching == LOADS;
+
+		if (placeholderDraws == 0)
+		{
+			std::cout << "ERROR::MODEL_LOADER::PLACEHOLDERS_NOT_DRAWN" << std::endl;
+			passed = false;
+		}
+		if (placeholderDeletes != LOADS)
+		{
+			std::cout << "ERROR::MODEL_LOADER::PLACEHOLDERS_NOT_DELETED " << placeholderDeletes << " of " << LOADS << std::endl;
+			passed = false;
+		}
+		if (uploadFrames <= LOADS)
+		{
+			std::cout << "ERROR::MODEL_LOADER::UPLOADS_NOT_SLICED " << uploadFrames << " frames" << std::endl;
+			passed = false;
+		}
+		if (FakeGL::invalidUploads != 0)
+		{
+			std::cout << "ERROR::MODEL_LOADER::INVALID_BUFFER_ACCESS " << FakeGL::invalidUploads << std::endl;
+			passed = false;
+		}
+	}
+	FakeGL::install(false);
+	return passed;
+}
+
+struct MemoryUse
+{
+	// bytes resident memory rose by at its highest during the load and after it, relative to before
+	long long peak;
+	long long steady;
+	// bytes the load left allocated on the heap, which does not depend on the allocator returning
+	// freed memory to the system like the resident memory does
+	long long heap;
+};
+
+// Runs load while a thread samples the resident memory every millisecond and returns its rise.
+// Whatever load creates is measured while it still exists, so it must return it.
+template <typename Load>
+MemoryUse measureLoad(Load load)
+{
+	long long before = (long long)ProcessMemory::current().resident;
+	long long heapBefore = AllocationCounter::liveBytes();
+	std::atomic<bool> loading(true);
+	std::atomic<long long> highest(before);
+	std::thread sampler([&]()
+	{
+		while (loading)
+		{
+			long long resident = (long long)ProcessMemory::current().resident;
+			if (resident > highest)
+			{
+				highest = resident;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+	auto loaded = load();
+	loading = false;
+	sampler.join();
+	long long after = (long long)ProcessMemory::current().resident;
+	long long heapAfter = AllocationCounter::liveBytes();
+
+	MemoryUse use;
+	use.peak = std::max(highest.load(), after) - before;
+	use.steady = after - before;
+	use.heap = heapAfter - heapBefore;
+	return use;
+}
+
+// Loads the nanosuit and the Animation sample's SkinnedMesh with and without keepCpuCopy and
+// reports how far resident memory peaked during each load and what the loaded model keeps. Each
+// model is destroyed before the next load, so every load decodes its textures again, and a first
+// unmeasured load grows the heap to its working size. The allocator keeps freed memory resident, so
+// whether a model without its CPU copy keeps less is decided on the heap bytes it leaves allocated.
+bool checkModelMemory()
+{
+	FakeGL::uniforms.clear();
+	FakeGL::install(true);
+	FakeGL::keepBufferBytes = false;
+	bool passed = true;
+
+	std::unique_ptr<Model>(new Model(NANOSUIT.c_str()));
+	MemoryUse models[2];
+	MemoryUse skinnedMeshes[2];
+	bool skinnedLoaded = true;
+	for (int keepCpuCopy = 0; keepCpuCopy < 2; keepCpuCopy++)
+	{
+		models[keepCpuCopy] = measureLoad([&]()
+		{
+			return std::unique_ptr<Model>(new Model(NANOSUIT.c_str(), false, false, VertexFormat::Full, keepCpuCopy != 0));
+		});
+		skinnedMeshes[keepCpuCopy] = measureLoad([&]()
+		{
+			std::unique_ptr<SkinnedMesh> mesh(new SkinnedMesh(true, keepCpuCopy != 0));
+			skinnedLoaded = mesh->LoadMesh(BOB_LAMP) && skinnedLoaded;
+			return mesh;
+		});
+	}
+
+	const char* names[2] = { "nanosuit", "skinned mesh" };
+	const MemoryUse* uses[2] = { models, skinnedMeshes };
+	for (int i = 0; i < 2; i++)
+	{
+		for (int keepCpuCopy = 0; keepCpuCopy < 2; keepCpuCopy++)
+		{
+			std::cout << "model memory, " << names[i] << (keepCpuCopy ? " with" : " without") << " CPU copy: peak +"
+				<< uses[i][keepCpuCopy].peak / (1024.0 * 1024.0) << " MB, steady +" << uses[i][keepCpuCopy].steady / (1024.0 * 1024.0) << " MB, heap +"
+				<< uses[i][keepCpuCopy].heap / (1024.0 * 1024.0) << " MB" << std::endl;
+		}
+		if (uses[i][0].heap >= uses[i][1].heap)
+		{
+			std::cout << "ERROR::MODEL_MEMORY::CPU_COPY_NOT_RELEASED " << names[i] << std::endl;
+			passed = false;
+		}
+	}
+	if (!skinnedLoaded)
+	{
+		std::cout << "ERROR::MODEL_MEMORY::SKINNED_MESH_NOT_LOADED " << BOB_LAMP << std::endl;
+		passed = false;
+	}
+
+	FakeGL::keepBufferBytes = true;
+	FakeGL::install(false);
+	return passed;
+}
+
+// Loads the nanosuit with and without gamma correction. With it only the diffuse maps are sRGB and
+// get their own textures, the other maps stay linear and are shared with the linear model.
+bool checkTextureGamma()
+{
+	FakeGL::install(true);
+	bool passed = true;
+	{
+		Model linear(NANOSUIT.c_str(), false);
+		Model gamma(NANOSUIT.c_str(), true);
+		if (gamma.texture_loads.empty() || gamma.texture_loads.size() != linear.texture_loads.size())
+		{
+			std::cout << "ERROR::TEXTURE_GAMMA::NO_TEXTURES " << NANOSUIT << std::endl;
+			passed = false;
+		}
+
+		size_t srgbTextures = 0;
+		for (size_t i = 0; passed && i < gamma.texture_loads.size(); i++)
+		{
+			const Texture & texture = gamma.texture_loads[i];
+			bool diffuse = texture.type == "texture_diffuse";
+			GLint format = FakeGL::textureFormats[texture.id];
+			bool srgb = format == GL_SRGB || format == GL_SRGB_ALPHA;
+			GLint linearFormat = FakeGL::textureFormats[linear.texture_loads[i].id];
+			bool shared = texture.id == linear.texture_loads[i].id;
+			srgbTextures += srgb ? 1 : 0;
+			if (srgb != diffuse || linearFormat == GL_SRGB || linearFormat == GL_SRGB_ALPHA || shared == diffuse)
+			{
+				std::cout << "ERROR::TEXTURE_GAMMA::WRONG_FORMAT " << texture.type << " " << texture.path << std::endl;
+				passed = false;
+			}
+		}
+		std::cout << "texture gamma: " << srgbTextures << " of " << gamma.texture_loads.size() << " textures sRGB" << std::endl;
+	}
+	FakeGL::install(false);
+	return passed;
+}
+
+// Decodes the nanosuit textures on 1, 2, 4 and 8 threads and prints the time of each.
+bool checkTextureDecoding()
+{
+	const ModelData & model = nanosuit();
+	std::vector<std::string> files;
+	for (const std::pair<std::string, std::string> & texture : model.textures)
+	{
+		files.push_back(model.directory + '/' + texture.second);
+	}
+	if (files.empty())
+	{
+		std::cout << "ERROR::TEXTURE_DECODING::NO_TEXTURES" << std::endl;
+		return false;
+	}
+
+	bool decoded = true;
+	const unsigned int threadCounts[] = { 1, 2, 4, 8 };
+	for (unsigned int threads : threadCounts)
+	{
+		TextureLoader::threadCount() = threads;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<TextureLoader::Image> images = TextureLoader::decodeAll(files);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << "texture decoding: " << files.size() << " textures on " << threads << " threads in " << elapsed.count() << " ms" << std::endl;
+		for (TextureLoader::Image & image : images)
+		{
+			decoded = decoded && image.data != nullptr;
+			stbi_image_free(image.data);
+		}
+	}
+	TextureLoader::threadCount() = 0;
+
+	if (!decoded)
+	{
+		std::cout << "ERROR::TEXTURE_DECODING::TEXTURE_NOT_DECODED" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// The flags IBL_Specular_Textured loads each material map with.
+unsigned int materialMapFlags(const std::string & map)
+{
+	return map == "normal" ? TEXTURE_COMPRESSED | TEXTURE_NORMAL_MAP : map == "albedo" ? TEXTURE_COMPRESSED | TEXTURE_SRGB : TEXTURE_COMPRESSED;
+}
+
+// Compresses every material map to every BC format and prints PSNR and MPix/s of each, the format
+// the cooker picks and the size of the cooked mip chain against RGBA8. Fails when the format the
+// cooker picks keeps less than MIN_PSNR of a map or no map could be read.
+bool checkTextureCompression()
+{
+	const double MIN_PSNR = 30.0;
+	const char* maps[] = { "albedo", "normal", "metallic", "roughness", "ao" };
+	const BlockFormat formats[] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7 };
+	const char* formatNames[] = { "BC1", "BC3", "BC4", "BC5", "BC7" };
+	// the channels each format keeps
+	const unsigned int channels[] = { 0x7, 0xF, 0x1, 0x3, 0xF };
+
+	bool passed = true;
+	int checked = 0;
+	for (const char* material : PBR_MATERIALS)
+	{
+		for (const char* map : maps)
+		{
+			std::string path = PBR_DIRECTORY + "/" + material + "/" + map + ".png";
+			int width, height, components;
+			unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &components, 4);
+			if (pixels == nullptr)
+			{
+				continue;
+			}
+			checked++;
+			unsigned int flags = materialMapFlags(map);
+			BlockFormat cookedFormat = TextureLoader::compressedFormat(pixels, width, height, components, flags);
+			std::cout << path << " " << width << "x" << height << ", cooked as " << formatNames[(int)cookedFormat] << std::endl;
+
+			std::vector<unsigned char> decoded((size_t)width * height * 4);
+			for (int f = 0; f < 5; f++)
+			{
+				std::vector<unsigned char> blocks(BlockCompression::imageBytes(formats[f], width, height));
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				BlockCompression::compress(formats[f], pixels, width, height, blocks.data());
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				BlockCompression::decompress(formats[f], blocks.data(), width, height, decoded.data());
+				double psnr = BlockCompression::psnr(pixels, decoded.data(), width, height, channels[f]);
+				std::cout << "  " << formatNames[f] << ": " << psnr << " dB, "
+					<< (double)width * height / elapsed.count() / 1e6 << " MPix/s on " << std::thread::hardware_concurrency() << " threads" << std::endl;
+				if (formats[f] == cookedFormat && psnr < MIN_PSNR)
+				{
+					std::cout << "ERROR::TEXTURE_COMPRESSION::PSNR_TOO_LOW " << path << std::endl;
+					passed = false;
+				}
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			KtxTexture cooked(TextureLoader::cook(pixels, width, height, components, flags, std::string()));
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			size_t uncompressed = (size_t)width * height * 4 * 4 / 3;
+			std::cout << "  cooked " << cooked.levelCount() << " levels in " << elapsed.count() << " ms, " << cooked.dataSize() << " bytes against "
+				<< uncompressed << " as RGBA8, " << (double)uncompressed / (double)cooked.dataSize() << "x smaller" << std::endl;
+			if (!cooked.valid())
+			{
+				std::cout << "ERROR::TEXTURE_COMPRESSION::COOKED_FILE_INVALID " << path << std::endl;
+				passed = false;
+			}
+			stbi_image_free(pixels);
+		}
+	}
+	if (checked == 0)
+	{
+		std::cout << "ERROR::TEXTURE_COMPRESSION::NO_MAPS in " << PBR_DIRECTORY << std::endl;
+		return false;
+	}
+	return passed;
+}
+
+// Cooks the materials with all five maps once as separate maps and once as MaterialCooker packs
+// them, albedo, normal and ORM, and prints textures, bytes and cooking time of both. The shader
+// samples as many textures per pixel as a material has. ORM is cooked as BC1 here, the samples pick
+// BC7 where the context samples it.
+bool checkMaterialPacking()
+{
+	const char* maps[] = { "albedo", "normal", "metallic", "roughness", "ao" };
+	std::vector<std::string> directories, paths, packedPaths;
+	std::vector<unsigned int> flags, packedFlags;
+	for (const char* material : PBR_MATERIALS)
+	{
+		std::string directory = PBR_DIRECTORY + "/" + material;
+		bool complete = true;
+		for (const char* map : maps)
+		{
+			int width, height, components;
+			complete = complete && stbi_info((directory + "/" + map + ".png").c_str(), &width, &height, &components) != 0;
+		}
+		if (!complete)
+		{
+			continue;
+		}
+		directories.push_back(directory);
+		for (const char* map : maps)
+		{
+			paths.push_back(directory + "/" + map + ".png");
+			flags.push_back(materialMapFlags(map));
+		}
+		packedPaths.push_back(directory + "/albedo.png");
+		packedFlags.push_back(materialMapFlags("albedo"));
+		packedPaths.push_back(directory + "/normal.png");
+		packedFlags.push_back(materialMapFlags("normal"));
+	}
+	if (directories.empty())
+	{
+		std::cout << "ERROR::MATERIAL_PACKING::NO_COMPLETE_MATERIAL in " << PBR_DIRECTORY << std::endl;
+		return false;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<TextureLoader::Image> separate = TextureLoader::decodeAll(paths, flags);
+	std::chrono::duration<double, std::milli> separateTime = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	std::vector<TextureLoader::Image> packed = TextureLoader::decodeAll(packedPaths, packedFlags);
+	for (const std::string & directory : directories)
+	{
+		packed.push_back(MaterialCooker::cookOrm(directory, TEXTURE_COMPRESSED));
+	}
+	std::chrono::duration<double, std::milli> packedTime = std::chrono::steady_clock::now() - start;
+
+	bool cooked = true;
+	size_t bytes[2] = { 0, 0 };
+	std::vector<TextureLoader::Image>* images[2] = { &separate, &packed };
+	for (int i = 0; i < 2; i++)
+	{
+		for (TextureLoader::Image & image : *images[i])
+		{
+			cooked = cooked && image.compressed;
+			bytes[i] += image.compressed ? image.compressed->dataSize() : 0;
+			stbi_image_free(image.data);
+		}
+	}
+	std::cout << "separate maps: " << separate.size() << " textures, 5 per material, " << bytes[0] << " bytes, " << separateTime.count() << " ms" << std::endl;
+	std::cout << "packed maps:   " << packed.size() << " textures, 3 per material, " << bytes[1] << " bytes, " << packedTime.count() << " ms" << std::endl;
+
+	if (!cooked)
+	{
+		std::cout << "ERROR::MATERIAL_PACKING::TEXTURE_NOT_COOKED" << std::endl;
+		return false;
+	}
+	if (bytes[1] >= bytes[0])
+	{
+		std::cout << "ERROR::MATERIAL_PACKING::PACKED_NOT_SMALLER" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Builds every level of a mip chain from image with downsample and returns the seconds of the
+// fastest of three runs.
+template <typename T, typename Downsample>
+double buildMipChain(const std::vector<T> & image, int width, int height, int channels, Downsample downsample, std::vector<std::vector<T>> & levels)
+{
+	double best = 0.0;
+	for (int run = 0; run < 3; run++)
+	{
+		levels.assign(1, image);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int levelWidth = width;
+		int levelHeight = height;
+		while (levelWidth > 1 || levelHeight > 1)
+		{
+			levels.push_back(std::vector<T>((size_t)MipGenerator::mipSize(levelWidth) * MipGenerator::mipSize(levelHeight) * channels));
+			downsample(levels[levels.size() - 2].data(), levelWidth, levelHeight, levels.back().data());
+			levelWidth = MipGenerator::mipSize(levelWidth);
+			levelHeight = MipGenerator::mipSize(levelHeight);
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		best = run == 0 ? elapsed.count() : std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+// Prints MPix/s of the source level for both chains and the largest difference of any value below
+// it, measured by difference. False when that is more than tolerance.
+template <typename T, typename Fast, typename Reference, typename Difference>
+bool compareMipChain(const char* name, const std::vector<T> & image, int width, int height, int channels, Fast fast, Reference reference,
+	Difference difference, double tolerance, const char* unit)
+{
+	std::vector<std::vector<T>> fastLevels, referenceLevels;
+	double fastTime = buildMipChain(image, width, height, channels, fast, fastLevels);
+	double referenceTime = buildMipChain(image, width, height, channels, reference, referenceLevels);
+	double largest = 0.0;
+	for (size_t level = 1; level < fastLevels.size(); level++)
+	{
+		for (size_t i = 0; i < fastLevels[level].size(); i++)
+		{
+			largest = std::max(largest, difference(fastLevels[level][i], referenceLevels[level][i]));
+		}
+	}
+	double megapixels = (double)width * height / 1e6;
+	std::cout << "  " << name << ": " << megapixels / fastTime << " MPix/s against " << megapixels / referenceTime << " MPix/s scalar, "
+		<< referenceTime / fastTime << "x, largest difference " << largest << " " << unit << std::endl;
+	if (largest > tolerance)
+	{
+		std::cout << "ERROR::MIP_GENERATION::KERNEL_DIFFERS_FROM_REFERENCE " << name << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Builds the mip chains of an albedo, a normal map and the HDR environment with the SIMD kernels and
+// the scalar reference and checks that both agree.
+bool checkMipGeneration()
+{
+	std::cout << "mip generation with " << MipGenerator::kernel() << " kernels, RGB16F with " << MipGenerator::halfKernel() << std::endl;
+	auto byteDifference = [](unsigned char a, unsigned char b) { return (double)std::abs(a - b); };
+
+	bool passed = true;
+	std::string albedo = PBR_DIRECTORY + "/plastic/albedo.png";
+	int width, height, components;
+	unsigned char* pixels = stbi_load(albedo.c_str(), &width, &height, &components, 4);
+	if (pixels != nullptr)
+	{
+		std::vector<unsigned char> rgba(pixels, pixels + (size_t)width * height * 4);
+		stbi_image_free(pixels);
+		for (int srgb = 0; srgb < 2; srgb++)
+		{
+			passed = compareMipChain(srgb != 0 ? "RGBA8 sRGB" : "RGBA8 linear", rgba, width, height, 4,
+				[=](const unsigned char* source, int w, int h, unsigned char* target) { MipGenerator::downsampleRGBA8(source, w, h, srgb != 0, target); },
+				[=](const unsigned char* source, int w, int h, unsigned char* target) { MipGenerator::downsampleRGBA8Reference(source, w, h, srgb != 0, target); },
+				byteDifference, 0.0, "LSB") && passed;
+		}
+	}
+	else
+	{
+		std::cout << "ERROR::MIP_GENERATION::MISSING_IMAGE " << albedo << std::endl;
+		passed = false;
+	}
+
+	std::string normal = PBR_DIRECTORY + "/gold/normal.png";
+	pixels = stbi_load(normal.c_str(), &width, &height, &components, 4);
+	if (pixels != nullptr)
+	{
+		std::vector<unsigned char> rg((size_t)width * height * 2);
+		for (size_t i = 0; i < (size_t)width * height; i++)
+		{
+			rg[i * 2] = pixels[i * 4];
+			rg[i * 2 + 1] = pixels[i * 4 + 1];
+		}
+		stbi_image_free(pixels);
+		passed = compareMipChain("RG8 normal", rg, width, height, 2, MipGenerator::downsampleRG8Normal, MipGenerator::downsampleRG8NormalReference,
+			byteDifference, 0.0, "LSB") && passed;
+	}
+	else
+	{
+		std::cout << "ERROR::MIP_GENERATION::MISSING_IMAGE " << normal << std::endl;
+		passed = false;
+	}
+
+	float* hdr = stbi_loadf(HDR_IMAGE.c_str(), &width, &height, &components, 3);
+	if (hdr != nullptr)
+	{
+		std::vector<float> rgb(hdr, hdr + (size_t)width * height * 3);
+		stbi_image_free(hdr);
+		passed = compareMipChain("RGB32F", rgb, width, height, 3, MipGenerator::downsampleRGB32F, MipGenerator::downsampleRGB32FReference,
+			[](float a, float b) { return (double)std::abs(a - b) / std::max((double)std::abs(b), 1e-6); }, 0.0, "relative") && passed;
+
+		std::vector<uint16_t> half(rgb.size());
+		MipGenerator::floatsToHalf(rgb.data(), rgb.size(), half.data());
+		passed = compareMipChain("RGB16F", half, width, height, 3, MipGenerator::downsampleRGB16F, MipGenerator::downsampleRGB16FReference,
+			[](uint16_t a, uint16_t b) { return (double)std::abs((int)a - (int)b); }, 0.0, "ULP") && passed;
+	}
+	else
+	{
+		std::cout << "ERROR::MIP_GENERATION::MISSING_IMAGE " << HDR_IMAGE << std::endl;
+		passed = false;
+	}
+	return passed;
+}
+
+// Streams a synthetic ground of 64 x 64 tiles, each with a texture of its own of 256 to 2048 texels
+// a side, while the camera flies a circle over it and then stands still. Runs the residency policy
+// only, uploads finish one frame after they start. Checks that the budget holds, that no level a
+// request of the frame needs is evicted and that the visible tiles reach their level once the
+// camera stops.
+bool checkTextureStreaming()
+{
+	const int GRID = 64;
+	const float TILE = 4.0f;
+	const size_t BUDGET = 32 << 20;
+	const size_t FRAME_BYTES = 8 << 20;
+	const int FLIGHT_FRAMES = 1200;
+	const int STILL_FRAMES = 120;
+
+	TextureResidency residency(BUDGET);
+	std::vector<int> sizes;
+	srand(7);
+	for (int i = 0; i < GRID * GRID; i++)
+	{
+		int size = 256 << (rand() % 4);
+		BlockFormat format = rand() % 2 == 0 ? BlockFormat::BC1 : BlockFormat::BC7;
+		std::vector<size_t> bytes;
+		for (int level = 0; (size >> level) > 0; level++)
+		{
+			bytes.push_back(BlockCompression::imageBytes(format, size >> level, size >> level));
+		}
+		sizes.push_back(size);
+		residency.add(size, size, bytes);
+	}
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 200.0f);
+	std::vector<TextureResidency::Load> loads, inFlight;
+	std::vector<TextureResidency::Eviction> evictions;
+	size_t overBudget = 0, neededEvicted = 0, visibleSum = 0, satisfiedSum = 0;
+	size_t stillVisible = 0, stillSatisfied = 0, stillStarved = 0;
+	double updateTime = 0.0;
+	for (int frame = 0; frame < FLIGHT_FRAMES + STILL_FRAMES; frame++)
+	{
+		for (const TextureResidency::Load & load : inFlight)
+		{
+			residency.loaded(load);
+		}
+		float angle = glm::radians(360.0f) * (float)std::min(frame, FLIGHT_FRAMES) / (float)FLIGHT_FRAMES;
+		glm::vec3 eye(std::cos(angle) * 60.0f, 3.0f, std::sin(angle) * 60.0f);
+		glm::vec3 forward(-std::sin(angle), -0.2f, std::cos(angle));
+		Frustum frustum = Frustum::fromMatrix(projection * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+		std::vector<int> visible;
+		for (int i = 0; i < GRID * GRID; i++)
+		{
+			glm::vec3 center(((i % GRID) - GRID / 2 + 0.5f) * TILE, 0.0f, ((i / GRID) - GRID / 2 + 0.5f) * TILE);
+			float radius = TILE * 0.7072f;
+			bool inside = true;
+			for (const glm::vec4 & plane : frustum.planes)
+			{
+				inside = inside && glm::dot(glm::vec3(plane), center) + plane.w > -radius;
+			}
+			if (inside)
+			{
+				float pixels = TextureStreamer::projectedSize(TILE, std::max(glm::distance(eye, center) - radius, 0.1f), glm::radians(45.0f), SCR_HEIGHT);
+				residency.request(i, TextureResidency::levelForSize(sizes[i], pixels));
+				visible.push_back(i);
+			}
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		residency.update(FRAME_BYTES, loads, evictions);
+		updateTime += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		inFlight = loads;
+
+		for (const TextureResidency::Eviction & eviction : evictions)
+		{
+			const TextureResidency::TextureStats & stats = residency.textureStats(eviction.texture);
+			neededEvicted += stats.lastUsed == (uint64_t)frame && eviction.level >= stats.wantedLevel;
+		}
+		overBudget += residency.stats().residentBytes > BUDGET;
+		size_t satisfied = 0;
+		for (int i : visible)
+		{
+			const TextureResidency::TextureStats & stats = residency.textureStats(i);
+			satisfied += stats.residentLevel <= stats.wantedLevel;
+		}
+		visibleSum += visible.size();
+		satisfiedSum += satisfied;
+		if (frame == FLIGHT_FRAMES + STILL_FRAMES - 1)
+		{
+			stillVisible = visible.size();
+			stillSatisfied = satisfied;
+			stillStarved = residency.stats().starved;
+		}
+	}
+
+	// the per texture stats add up to the totals, the loads of the last frame are still reserved
+	size_t residentBytes = 0;
+	for (size_t i = 0; i < residency.textureCount(); i++)
+	{
+		residentBytes += residency.textureStats((int)i).residentBytes;
+	}
+	for (const TextureResidency::Load & load : inFlight)
+	{
+		residentBytes += load.bytes;
+	}
+
+	const TextureResidency::Stats & stats = residency.stats();
+	std::cout << "texture streaming: " << residency.textureCount() << " textures, " << stats.fullBytes / 1048576 << " MB with every level, "
+		<< stats.tailBytes / 1048576.0 << " MB of tails, budget " << BUDGET / 1048576 << " MB, peak " << stats.peakBytes / 1048576.0 << " MB" << std::endl;
+	std::cout << "texture streaming: " << stats.loads << " loads of " << stats.loadedBytes / 1048576 << " MB, " << stats.evictions << " evictions, "
+		<< 100.0 * satisfiedSum / std::max(visibleSum, (size_t)1) << "% of visible textures at their level while flying, " << stillSatisfied << " of "
+		<< stillVisible << " after standing still (" << stillStarved << " short of the budget), " << updateTime / (FLIGHT_FRAMES + STILL_FRAMES) << " us per update" << std::endl;
+
+	bool passed = true;
+	if (overBudget > 0)
+	{
+		std::cout << "ERROR::TEXTURE_STREAMING::OVER_BUDGET in " << overBudget << " frames" << std::endl;
+		passed = false;
+	}
+	if (neededEvicted > 0)
+	{
+		std::cout << "ERROR::TEXTURE_STREAMING::NEEDED_LEVEL_EVICTED " << neededEvicted << " times" << std::endl;
+		passed = false;
+	}
+	if (residentBytes != stats.residentBytes)
+	{
+		std::cout << "ERROR::TEXTURE_STREAMING::RESIDENT_BYTES_MISMATCH" << std::endl;
+		passed = false;
+	}
+	// a visible texture may only stay short of its level when the budget is full of other visible ones
+	if (stillSatisfied + stillStarved < stillVisible)
+	{
+		std::cout << "ERROR::TEXTURE_STREAMING::VISIBLE_TEXTURES_BELOW_LEVEL" << std::endl;
+		passed = false;
+	}
+	return passed;
+}
@@ -0,0 +1,4 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+//ͨSTB_IMAGE_IMPLEMENTATIONԤ޸ͷļֻصĺԴ룬ǽͷļΪһ .cpp ļ
\ No newline at end of file
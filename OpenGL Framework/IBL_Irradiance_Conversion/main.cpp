@@ -12,6 +12,7 @@
 
 #include <Shader.h>
 #include <camera.h>
+#include <TextureCache.h>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -142,13 +143,13 @@ int main()
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, hdrTexture);
 	equirectangularCubemapShader.setInt("equirectangularMap", 0);
-	equirectangularCubemapShader.SetMat4("projection", captureProjection);
+	equirectangularCubemapShader.setMat4("projection", captureProjection);
 
 	glViewport(0, 0, 512, 512);
 	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 	for (size_t i = 0; i < 6; ++i)
 	{
-		equirectangularCubemapShader.SetMat4("view", captureViews[i]);
+		equirectangularCubemapShader.setMat4("view", captureViews[i]);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -160,13 +161,13 @@ int main()
 	shader.use();
 
 	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
-	shader.SetMat4("projection", projection);
+	shader.setMat4("projection", projection);
 
-	shader.SetVec3("albedo", glm::vec3(0.5f, 0.0f, 0.0f));
+	shader.setVec3("albedo", glm::vec3(0.5f, 0.0f, 0.0f));
 	shader.setFloat("ao", 1.0f);
 
 	backgroundShader.use();
-	backgroundShader.SetMat4("projection", projection);
+	backgroundShader.setMat4("projection", projection);
 
 	glm::vec3 lightPositions[] = {
 		glm::vec3(-10.0f, 10.0f, 10.0f),
@@ -210,8 +211,8 @@ int main()
 		shader.use();
 
 		glm::mat4 view = camera.GetViewMatrix();
-		shader.SetMat4("view", view);
-		shader.SetVec3("camPos", camera.Position);
+		shader.setMat4("view", view);
+		shader.setVec3("camPos", camera.Position);
 
 		glm::mat4 model;
 		for (int row = 0; row < nrRows; ++row)
@@ -228,7 +229,7 @@ int main()
 					0.0f
 				));
 
-				shader.SetMat4("model", model);
+				shader.setMat4("model", model);
 				renderSphere();
 			}
 		}
@@ -237,25 +238,25 @@ int main()
 		{
 			glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
 			newPos = lightPositions[i];
-			shader.SetVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-			shader.SetVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
+			shader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
+			shader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
 
 			model = glm::mat4();
 			model = glm::translate(model, newPos);
 			model = glm::scale(model, glm::vec3(0.5f));
-			shader.SetMat4("model", model);
+			shader.setMat4("model", model);
 			renderSphere();
 		}
 
 		equirectangularCubemapShader.use();
-		equirectangularCubemapShader.SetMat4("view", view);
+		equirectangularCubemapShader.setMat4("view", view);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, hdrTexture);
 
 		renderCube();
 
 		backgroundShader.use();
-		backgroundShader.SetMat4("view", view);
+		backgroundShader.setMat4("view", view);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 		renderCube();
@@ -444,46 +445,7 @@ void renderCube()
 
 unsigned int loadTexture(char* const path)
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-		{
-			format = GL_RED;
-		}
-		else if (nrComponents == 3)
-		{
-			format = GL_RGB;
-		}
-		else if (nrComponents == 4)
-		{
-			format = GL_RGBA;
-		}
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
+	return TextureCache::load(path);
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -11,7 +11,8 @@
 #include <stb_image.h>
 
 #include <Shader.h>
-#include <camera.h>
+#include <Camera.h>
+#include <TextureCache.h>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -147,7 +148,7 @@ int main()
 
 	equirectangularToCubemapShader.use();
 	equirectangularToCubemapShader.setInt("equirectangularMap", 0);
-	equirectangularToCubemapShader.SetMat4("projection", captureProjection);
+	equirectangularToCubemapShader.setMat4("projection", captureProjection);
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, hdrTexture);
@@ -156,7 +157,7 @@ int main()
 	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 	for (size_t i = 0; i < 6; ++i)
 	{
-		equirectangularToCubemapShader.SetMat4("view", captureViews[i]);
+		equirectangularToCubemapShader.setMat4("view", captureViews[i]);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -183,7 +184,7 @@ int main()
 
 	irradianceShader.use();
 	irradianceShader.setInt("environmentMap", 0);
-	irradianceShader.SetMat4("projection", captureProjection);
+	irradianceShader.setMat4("projection", captureProjection);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 
@@ -191,7 +192,7 @@ int main()
 	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 	for (size_t i = 0; i < 6; ++i)
 	{ 
-		irradianceShader.SetMat4("view", captureViews[i]);
+		irradianceShader.setMat4("view", captureViews[i]);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -215,7 +216,7 @@ int main()
 
 	prefilterShader.use();
 	prefilterShader.setInt("environmentMap", 0);
-	prefilterShader.SetMat4("projection", captureProjection);
+	prefilterShader.setMat4("projection", captureProjection);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 
@@ -233,7 +234,7 @@ int main()
 		prefilterShader.setFloat("roughness", roughness);
 		for (unsigned int i = 0; i < 6; ++i)
 		{
-			prefilterShader.SetMat4("view", captureViews[i]);
+			prefilterShader.setMat4("view", captureViews[i]);
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
 
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -263,13 +264,14 @@ int main()
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	
-	Shader shader("pbr.vs", "pbr.fs");
+	const unsigned int NR_LIGHTS = 4;
+	Shader shader("pbr.vs", "pbr.fs", nullptr, { { "NR_LIGHTS", NR_LIGHTS }, { "IBL_SPECULAR" } });
 	shader.use();
 
 	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	shader.SetMat4("projection", projection);
+	shader.setMat4("projection", projection);
 
-	shader.SetVec3("albedo", glm::vec3(0.5f, 0.0f, 0.0f));
+	shader.setVec3("albedo", glm::vec3(0.5f, 0.0f, 0.0f));
 	shader.setFloat("ao", 1.0f);
 
 	shader.setInt("irradianceMap", 0);
@@ -277,16 +279,16 @@ int main()
 	shader.setInt("brdfLUT", 2);
 
 	backgroundShader.use();
-	backgroundShader.SetMat4("projection", projection);
+	backgroundShader.setMat4("projection", projection);
 
-	glm::vec3 lightPositions[] = {
+	glm::vec3 lightPositions[NR_LIGHTS] = {
 		glm::vec3(-10.0f, 10.0f, 10.0f),
 		glm::vec3(10.0f, 10.0f, 10.0f),
 		glm::vec3(-10.0f, -10.0f, 10.0f),
 		glm::vec3(10.0f, -10.0f, 10.0f)
 	};
 
-	glm::vec3 lightColors[] = {
+	glm::vec3 lightColors[NR_LIGHTS] = {
 		glm::vec3(300.0f, 300.0f, 300.0f),
 		glm::vec3(300.0f, 300.0f, 300.0f),
 		glm::vec3(300.0f, 300.0f, 300.0f),
@@ -328,8 +330,8 @@ int main()
 		glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
 
 		glm::mat4 view = camera.GetViewMatrix();
-		shader.SetMat4("view", view);
-		shader.SetVec3("camPos", camera.Position);
+		shader.setMat4("view", view);
+		shader.setVec3("camPos", camera.Position);
 
 		glm::mat4 model;
 		for (int row = 0; row < nrRows; ++row)
@@ -346,7 +348,7 @@ int main()
 					0.0f
 				));
 
-				shader.SetMat4("model", model);
+				shader.setMat4("model", model);
 				renderSphere();
 			}
 		}
@@ -355,18 +357,18 @@ int main()
 		{
 			glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
 			newPos = lightPositions[i];
-			shader.SetVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-			shader.SetVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
+			shader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
+			shader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
 
 			model = glm::mat4();
 			model = glm::translate(model, newPos);
 			model = glm::scale(model, glm::vec3(0.5f));
-			shader.SetMat4("model", model);
+			shader.setMat4("model", model);
 			renderSphere();
 		}
 
 		backgroundShader.use();
-		backgroundShader.SetMat4("view", view);
+		backgroundShader.setMat4("view", view);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 		renderCube();
@@ -584,46 +586,7 @@ void renderQuad()
 
 unsigned int loadTexture(char* const path)
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-		{
-			format = GL_RED;
-		}
-		else if (nrComponents == 3)
-		{
-			format = GL_RGB;
-		}
-		else if (nrComponents == 4)
-		{
-			format = GL_RGBA;
-		}
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
+	return TextureCache::load(path);
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -3,6 +3,9 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
 
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
@@ -11,16 +14,18 @@
 #include <stb_image.h>
 
 #include <Shader.h>
-#include <camera.h>
+#include <ShaderVariants.h>
+#include <Camera.h>
+#include <TextureCache.h>
+#include <MaterialAtlas.h>
+#include <MipGenerator.h>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 
-unsigned int loadTexture(std::string path);
-
-void renderSphere();
+void renderSphere(unsigned int instanceBuffer, size_t firstInstance, unsigned int instanceCount);
 void renderCube();
 void renderQuad();
 
@@ -39,6 +44,21 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// B switches the ambient light between the shader variants with and without the specular IBL term
+bool specularIbl = true;
+bool specularIblKeyPressed = false;
+
+// per-instance attributes of the PBR spheres, locations 3 to 7 of pbr_vertex.glsl
+struct SphereInstance
+{
+	glm::mat4 model;
+	float layer;
+};
+
+// adds a 20 x 20 grid of spheres behind the row, cycling through the materials; they still draw in
+// one instanced call per atlas batch
+bool drawSphereGrid = false;
+
 int main()
 {
 	// glfw: initialize and configure
@@ -79,46 +99,32 @@ int main()
 
 	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
-	Shader backgroundShader("background.vs", "background.fs");
-	Shader irradianceShader("irradiance_convolution.vs", "irradiance_convolution.fs");
-	Shader equirectangularToCubemapShader("cubemap.vs", "cubemap.fs");
-	Shader prefilterShader("cubemap.vs", "prefilter.fs");
-	Shader brdfShader("brdf.vs", "brdf.fs");
-
-	//rusted iron
-	unsigned int ironAlbedoMap = loadTexture("pbr/rusted_iron/albedo.png");
-	unsigned int ironNormalMap = loadTexture("pbr/rusted_iron/normal.png");
-	unsigned int ironMetallicMap = loadTexture("pbr/rusted_iron/metallic.png");
-	unsigned int ironRoughnessMap = loadTexture("pbr/rusted_iron/roughness.png");
-	unsigned int ironAOMap = loadTexture("pbr/rusted_iron/ao.png");
-
-	// gold
-	unsigned int goldAlbedoMap = loadTexture("pbr/gold/albedo.png");
-	unsigned int goldNormalMap = loadTexture("pbr/gold/normal.png");
-	unsigned int goldMetallicMap = loadTexture("pbr/gold/metallic.png");
-	unsigned int goldRoughnessMap = loadTexture("pbr/gold/roughness.png");
-	unsigned int goldAOMap = loadTexture("pbr/gold/ao.png");
-
-	// grass
-	unsigned int grassAlbedoMap = loadTexture("pbr/grass/albedo.png");
-	unsigned int grassNormalMap = loadTexture("pbr/grass/normal.png");
-	unsigned int grassMetallicMap = loadTexture("pbr/grass/metallic.png");
-	unsigned int grassRoughnessMap = loadTexture("pbr/grass/roughness.png");
-	unsigned int grassAOMap = loadTexture("pbr/grass/ao.png");
-
-	// plastic
-	unsigned int plasticAlbedoMap = loadTexture("pbr/plastic/albedo.png");
-	unsigned int plasticNormalMap = loadTexture("pbr/plastic/normal.png");
-	unsigned int plasticMetallicMap = loadTexture("pbr/plastic/metallic.png");
-	unsigned int plasticRoughnessMap = loadTexture("pbr/plastic/roughness.png");
-	unsigned int plasticAOMap = loadTexture("pbr/plastic/ao.png");
-
-	// wall
-	unsigned int wallAlbedoMap = loadTexture("pbr/wall/albedo.png");
-	unsigned int wallNormalMap = loadTexture("pbr/wall/normal.png");
-	unsigned int wallMetallicMap = loadTexture("pbr/wall/metallic.png");
-	unsigned int wallRoughnessMap = loadTexture("pbr/wall/roughness.png");
-	unsigned int wallAOMap = loadTexture("pbr/wall/ao.png");
+	// all programs are read on worker threads and compiled together, link status is only
+	// queried when a program is first used
+	// the diffuse only PBR variant is built the first time B is pressed
+	const unsigned int NR_LIGHTS = 4;
+	ShaderVariants pbrShaders("pbr.vs", "pbr.fs", "", ShaderBuild::Async);
+	const ShaderDefines specularDefines = { { "NR_LIGHTS", NR_LIGHTS }, { "HAS_MATERIAL_MAPS" }, { "MATERIAL_ARRAYS" }, { "SRGB_ALBEDO" }, { "NORMAL_MAP_RG" }, { "IBL_SPECULAR" } };
+	const ShaderDefines diffuseDefines = { { "NR_LIGHTS", NR_LIGHTS }, { "HAS_MATERIAL_MAPS" }, { "MATERIAL_ARRAYS" }, { "SRGB_ALBEDO" }, { "NORMAL_MAP_RG" }, { "IBL_DIFFUSE" } };
+	Shader backgroundShader("background.vs", "background.fs", nullptr, ShaderDefines(), ShaderBuild::Async);
+	Shader irradianceShader("irradiance_convolution.vs", "irradiance_convolution.fs", nullptr, ShaderDefines(), ShaderBuild::Async);
+	Shader equirectangularToCubemapShader("cubemap.vs", "cubemap.fs", nullptr, ShaderDefines(), ShaderBuild::Async);
+	Shader prefilterShader("cubemap.vs", "prefilter.fs", nullptr, ShaderDefines(), ShaderBuild::Async);
+	Shader brdfShader("brdf.vs", "brdf.fs", nullptr, ShaderDefines(), ShaderBuild::Async);
+	pbrShaders.get(specularDefines).submit();
+	backgroundShader.submit();
+	irradianceShader.submit();
+	equirectangularToCubemapShader.submit();
+	prefilterShader.submit();
+	brdfShader.submit();
+	prefilterShader.enableHotReload();
+
+	// albedo, normal and a packed occlusion/roughness/metallic texture per material, stored as layers
+	// of texture arrays so spheres of every material draw together
+	std::vector<std::string> materialDirectories = { "pbr/rusted_iron", "pbr/gold", "pbr/grass", "pbr/plastic", "pbr/wall" };
+	MaterialAtlas atlas;
+	std::vector<PbrMaterialImages> materialImages = MaterialCooker::decodeAll(materialDirectories);
+	std::vector<MaterialSlot> materials = atlas.add(materialImages);
 
 	unsigned int captureFBO;
 	unsigned int captureRBO;
@@ -134,19 +140,41 @@ int main()
 
 	stbi_set_flip_vertically_on_load(true);
 	int width, height, nrComponents;
-	float *data = stbi_loadf("Mans_Outside_2k.hdr", &width, &height, &nrComponents, 0);
+	float *data = stbi_loadf("Mans_Outside_2k.hdr", &width, &height, &nrComponents, 3);
 	if (data)
 	{
+		// half float mips built on the CPU, so the 2k map is filtered when it is drawn into the 512
+		// cube faces instead of skipping texels
+		std::vector<uint16_t> level((size_t)width * height * 3);
+		MipGenerator::floatsToHalf(data, level.size(), level.data());
+		stbi_image_free(data);
+
 		glGenTextures(1, &hdrTexture);
 		glBindTexture(GL_TEXTURE_2D, hdrTexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
+		// rows of 6 byte texels are not 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+		std::vector<uint16_t> next;
+		int levelWidth = width;
+		int levelHeight = height;
+		for (int mip = 0; ; mip++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, mip, GL_RGB16F, levelWidth, levelHeight, 0, GL_RGB, GL_HALF_FLOAT, level.data());
+			if (levelWidth == 1 && levelHeight == 1)
+			{
+				break;
+			}
+			next.resize((size_t)MipGenerator::mipSize(levelWidth) * MipGenerator::mipSize(levelHeight) * 3);
+			MipGenerator::downsampleRGB16F(level.data(), levelWidth, levelHeight, next.data());
+			level.swap(next);
+			levelWidth = MipGenerator::mipSize(levelWidth);
+			levelHeight = MipGenerator::mipSize(levelHeight);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
 	}
 	else
 	{
@@ -182,7 +210,7 @@ int main()
 
 	equirectangularToCubemapShader.use();
 	equirectangularToCubemapShader.setInt("equirectangularMap", 0);
-	equirectangularToCubemapShader.SetMat4("projection", captureProjection);
+	equirectangularToCubemapShader.setMat4("projection", captureProjection);
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, hdrTexture);
@@ -191,7 +219,7 @@ int main()
 	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 	for (size_t i = 0; i < 6; ++i)
 	{
-		equirectangularToCubemapShader.SetMat4("view", captureViews[i]);
+		equirectangularToCubemapShader.setMat4("view", captureViews[i]);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -218,7 +246,7 @@ int main()
 
 	irradianceShader.use();
 	irradianceShader.setInt("environmentMap", 0);
-	irradianceShader.SetMat4("projection", captureProjection);
+	irradianceShader.setMat4("projection", captureProjection);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 
@@ -226,7 +254,7 @@ int main()
 	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 	for (size_t i = 0; i < 6; ++i)
 	{ 
-		irradianceShader.SetMat4("view", captureViews[i]);
+		irradianceShader.setMat4("view", captureViews[i]);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -248,34 +276,39 @@ int main()
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
-	prefilterShader.use();
-	prefilterShader.setInt("environmentMap", 0);
-	prefilterShader.SetMat4("projection", captureProjection);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	unsigned int maxMipLevels = 5;
-	for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
+	// prefilter.fs is hot reloaded, so the bake can run again from the render loop
+	auto bakePrefilterMap = [&]()
 	{
-		unsigned int mipWidth = 128 * std::pow(0.5, mip);
-		unsigned int mipHeight = 128 * std::pow(0.5, mip);
-		glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-		glViewport(0, 0, mipWidth, mipHeight);
-
-		float roughness = (float)mip / (float)(maxMipLevels - 1);
-		prefilterShader.setFloat("roughness", roughness);
-		for (unsigned int i = 0; i < 6; ++i)
+		prefilterShader.use();
+		prefilterShader.setInt("environmentMap", 0);
+		prefilterShader.setMat4("projection", captureProjection);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		unsigned int maxMipLevels = 5;
+		for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
 		{
-			prefilterShader.SetMat4("view", captureViews[i]);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
+			unsigned int mipWidth = 128 * std::pow(0.5, mip);
+			unsigned int mipHeight = 128 * std::pow(0.5, mip);
+			glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
+			glViewport(0, 0, mipWidth, mipHeight);
+
+			float roughness = (float)mip / (float)(maxMipLevels - 1);
+			prefilterShader.setFloat("roughness", roughness);
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				prefilterShader.setMat4("view", captureViews[i]);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
 
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			renderCube();
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				renderCube();
+			}
 		}
-	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	};
+	bakePrefilterMap();
 
 	unsigned int brdfLUTTexture;
 	glGenTextures(1, &brdfLUTTexture);
@@ -298,45 +331,84 @@ int main()
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	
-	Shader shader("pbr.vs", "pbr.fs");
-	shader.use();
-
 	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	shader.SetMat4("projection", projection);
+	pbrShaders.setup([&](Shader & shader)
+	{
+		shader.setMat4("projection", projection);
 
-	shader.SetVec3("albedo", glm::vec3(0.5f, 0.0f, 0.0f));
-	shader.setFloat("ao", 1.0f);
+		shader.setVec3("albedo", glm::vec3(0.5f, 0.0f, 0.0f));
+		shader.setFloat("ao", 1.0f);
 
-	shader.setInt("irradianceMap", 0);
-	shader.setInt("prefilterMap", 1);
-	shader.setInt("brdfLUT", 2);
-	shader.setInt("albedoMap", 3);
-	shader.setInt("normalMap", 4);
-	shader.setInt("metallicMap", 5);
-	shader.setInt("roughnessMap", 6);
-	shader.setInt("aoMap", 7);
+		shader.setInt("irradianceMap", 0);
+		shader.setInt("prefilterMap", 1);
+		shader.setInt("brdfLUT", 2);
+		shader.setInt("albedoMap", 3);
+		shader.setInt("normalMap", 4);
+		shader.setInt("ormMap", 5);
+	});
 
 	backgroundShader.use();
-	backgroundShader.SetMat4("projection", projection);
+	backgroundShader.setMat4("projection", projection);
 
-	glm::vec3 lightPositions[] = {
+	glm::vec3 lightPositions[NR_LIGHTS] = {
 		glm::vec3(-10.0f, 10.0f, 10.0f),
 		glm::vec3(10.0f, 10.0f, 10.0f),
 		glm::vec3(-10.0f, -10.0f, 10.0f),
 		glm::vec3(10.0f, -10.0f, 10.0f)
 	};
 
-	glm::vec3 lightColors[] = {
+	glm::vec3 lightColors[NR_LIGHTS] = {
 		glm::vec3(300.0f, 300.0f, 300.0f),
 		glm::vec3(300.0f, 300.0f, 300.0f),
 		glm::vec3(300.0f, 300.0f, 300.0f),
 		glm::vec3(300.0f, 300.0f, 300.0f)
 	};
 
-	int nrRows = 7;
-	int nrColumns = 7;
 	float spacing = 2.5;
 
+	// the material row, the lights with the last material and the optional grid, grouped by batch
+	std::vector<std::vector<SphereInstance>> batchInstances(atlas.batchCount());
+	auto addSphere = [&](const MaterialSlot & material, const glm::mat4 & model)
+	{
+		SphereInstance instance;
+		instance.model = model;
+		instance.layer = (float)material.layer;
+		batchInstances[material.batch].push_back(instance);
+	};
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		addSphere(materials[i], glm::translate(glm::mat4(), glm::vec3(-5.0 + 2.0 * i, 0.0, 2.0)));
+	}
+	for (unsigned int i = 0; i < NR_LIGHTS; i++)
+	{
+		addSphere(materials.back(), glm::scale(glm::translate(glm::mat4(), lightPositions[i]), glm::vec3(0.5f)));
+	}
+	if (drawSphereGrid)
+	{
+		const int gridSize = 20;
+		for (int row = 0; row < gridSize; row++)
+		{
+			for (int column = 0; column < gridSize; column++)
+			{
+				glm::vec3 position((column - gridSize / 2) * spacing, (row - gridSize / 2) * spacing, -10.0f);
+				addSphere(materials[(row * gridSize + column) % materials.size()], glm::translate(glm::mat4(), position));
+			}
+		}
+	}
+
+	std::vector<SphereInstance> instances;
+	std::vector<size_t> batchFirst;
+	for (const std::vector<SphereInstance> & batch : batchInstances)
+	{
+		batchFirst.push_back(instances.size());
+		instances.insert(instances.end(), batch.begin(), batch.end());
+	}
+	unsigned int instanceVBO;
+	glGenBuffers(1, &instanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(SphereInstance), instances.data(), GL_STATIC_DRAW);
+	std::cout << instances.size() << " spheres in " << atlas.batchCount() << " instanced draws, " << atlas.memory() << " bytes of texture arrays" << std::endl;
+
 	int scrWidth, scrHeight;
 	glfwGetFramebufferSize(window, &scrWidth, &scrHeight);
 	glViewport(0, 0, scrWidth, scrHeight);
@@ -353,11 +425,18 @@ int main()
 		// -----
 		processInput(window);
 
+		if (prefilterShader.updateHotReload())
+		{
+			bakePrefilterMap();
+			glViewport(0, 0, scrWidth, scrHeight);
+		}
+
 		// render
 		// ------
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		Shader & shader = pbrShaders.get(specularIbl ? specularDefines : diffuseDefines);
 		shader.use();
 
 		glActiveTexture(GL_TEXTURE0);
@@ -367,114 +446,25 @@ int main()
 		glActiveTexture(GL_TEXTURE2);
 		glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
 
-		// rusted iron
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, ironAlbedoMap);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, ironNormalMap);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, ironMetallicMap);
-		glActiveTexture(GL_TEXTURE6);
-		glBindTexture(GL_TEXTURE_2D, ironRoughnessMap);
-		glActiveTexture(GL_TEXTURE7);
-		glBindTexture(GL_TEXTURE_2D, ironAOMap);
-
 		glm::mat4 view = camera.GetViewMatrix();
-		shader.SetMat4("view", view);
-		shader.SetVec3("camPos", camera.Position);
-
-		glm::mat4 model = glm::mat4();
-		model = glm::translate(model, glm::vec3(-5.0, 0.0, 2.0));
-		shader.SetMat4("model", model);
-		renderSphere();
-
-		// gold
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, goldAlbedoMap);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, goldNormalMap);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, goldMetallicMap);
-		glActiveTexture(GL_TEXTURE6);
-		glBindTexture(GL_TEXTURE_2D, goldRoughnessMap);
-		glActiveTexture(GL_TEXTURE7);
-		glBindTexture(GL_TEXTURE_2D, goldAOMap);
-
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(-3.0, 0.0, 2.0));
-		shader.SetMat4("model", model);
-		renderSphere();
-
-		// grass
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, grassAlbedoMap);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, grassNormalMap);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, grassMetallicMap);
-		glActiveTexture(GL_TEXTURE6);
-		glBindTexture(GL_TEXTURE_2D, grassRoughnessMap);
-		glActiveTexture(GL_TEXTURE7);
-		glBindTexture(GL_TEXTURE_2D, grassAOMap);
-
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(-1.0, 0.0, 2.0));
-		shader.SetMat4("model", model);
-		renderSphere();
-
-		// plastic
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, plasticAlbedoMap);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, plasticNormalMap);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, plasticMetallicMap);
-		glActiveTexture(GL_TEXTURE6);
-		glBindTexture(GL_TEXTURE_2D, plasticRoughnessMap);
-		glActiveTexture(GL_TEXTURE7);
-		glBindTexture(GL_TEXTURE_2D, plasticAOMap);
-
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(1.0, 0.0, 2.0));
-		shader.SetMat4("model", model);
-		renderSphere();
-
-		// wall
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, wallAlbedoMap);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, wallNormalMap);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, wallMetallicMap);
-		glActiveTexture(GL_TEXTURE6);
-		glBindTexture(GL_TEXTURE_2D, wallRoughnessMap);
-		glActiveTexture(GL_TEXTURE7);
-		glBindTexture(GL_TEXTURE_2D, wallAOMap);
-
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(3.0, 0.0, 2.0));
-		shader.SetMat4("model", model);
-		renderSphere();
-
-
-
-
-		for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); i++)
+		shader.setMat4("view", view);
+		shader.setVec3("camPos", camera.Position);
+
+		for (unsigned int i = 0; i < NR_LIGHTS; i++)
 		{
-			glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
-			newPos = lightPositions[i];
-			shader.SetVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-			shader.SetVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
-
-			model = glm::mat4();
-			model = glm::translate(model, newPos);
-			model = glm::scale(model, glm::vec3(0.5f));
-			shader.SetMat4("model", model);
-			renderSphere();
+			shader.setVec3("lightPositions[" + std::to_string(i) + "]", lightPositions[i]);
+			shader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
+		}
+
+		// every batch of the atlas is one draw, whatever the materials of its spheres
+		for (size_t i = 0; i < atlas.batchCount(); i++)
+		{
+			atlas.batch(i).bind(3);
+			renderSphere(instanceVBO, batchFirst[i], (unsigned int)batchInstances[i].size());
 		}
 
 		backgroundShader.use();
-		backgroundShader.SetMat4("view", view);
+		backgroundShader.setMat4("view", view);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 		renderCube();
@@ -485,6 +475,10 @@ int main()
 		glfwPollEvents();
 	}
 
+	// the arrays are deleted while the context still exists
+	glDeleteBuffers(1, &instanceVBO);
+	atlas.clear();
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 // ------------------------------------------------------------------
 	glfwTerminate();
@@ -494,7 +488,9 @@ int main()
 unsigned int sphereVAO = 0;
 unsigned int indexCount;
 
-void renderSphere()
+// Draws instanceCount spheres whose SphereInstance attributes start at firstInstance in
+// instanceBuffer. GL 3.3 has no base instance, so the attributes are pointed at it instead.
+void renderSphere(unsigned int instanceBuffer, size_t firstInstance, unsigned int instanceCount)
 {
 	if (sphereVAO == 0)
 	{
@@ -529,11 +525,11 @@ void renderSphere()
 		}
 
 		bool oddRow = false;
-		for (int y = 0; y < Y_SEGMENTS; ++y)
+		for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
 		{
 			if (!oddRow) // even rows: y == 0, y == 2; and so on
 			{
-				for (int x = 0; x <= X_SEGMENTS; ++x)
+				for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
 				{
 					indices.push_back(y       * (X_SEGMENTS + 1) + x);
 					indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
@@ -541,7 +537,7 @@ void renderSphere()
 			}
 			else
 			{
-				for (int x = X_SEGMENTS; x >= 0; --x)
+				for (int x = (int)X_SEGMENTS; x >= 0; --x)
 				{
 					indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
 					indices.push_back(y       * (X_SEGMENTS + 1) + x);
@@ -584,7 +580,18 @@ void renderSphere()
 	}
 
 	glBindVertexArray(sphereVAO);
-	glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	size_t offset = firstInstance * sizeof(SphereInstance);
+	for (unsigned int column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(3 + column);
+		glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance), (void*)(offset + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(3 + column, 1);
+	}
+	glEnableVertexAttribArray(7);
+	glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(SphereInstance), (void*)(offset + offsetof(SphereInstance, layer)));
+	glVertexAttribDivisor(7, 1);
+	glDrawElementsInstanced(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0, instanceCount);
 }
 
 unsigned int cubeVAO = 0;
@@ -690,50 +697,6 @@ void renderQuad()
 	glBindVertexArray(0);
 }
 
-unsigned int loadTexture(std::string path)
-{
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0);
-
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-		{
-			format = GL_RED;
-		}
-		else if (nrComponents == 3)
-		{
-			format = GL_RGB;
-		}
-		else if (nrComponents == 4)
-		{
-			format = GL_RGBA;
-		}
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
-}
-
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window)
@@ -750,6 +713,16 @@ void processInput(GLFWwindow *window)
 		camera.ProcessKeyboard(LEFT, cameraSpeed);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		camera.ProcessKeyboard(RIGHT, cameraSpeed);
+
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !specularIblKeyPressed)
+	{
+		specularIbl = !specularIbl;
+		specularIblKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE)
+	{
+		specularIblKeyPressed = false;
+	}
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -782,4 +755,4 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
 	camera.ProcessMouseScroll(yoffset);
-}
\ No newline at end of file
+}
@@ -141,33 +141,33 @@ int main()
 		glCullFace(GL_FRONT);
 
 		cubeShader.use();
-		cubeShader.SetVector("objectColor", 1.0f, 0.5f, 0.31f, 1.0f);
-		cubeShader.SetVector("lightColor", 1.0f, 0.0f, 0.0f, 1.0f);
+		cubeShader.setVector("objectColor", 1.0f, 0.5f, 0.31f, 1.0f);
+		cubeShader.setVector("lightColor", 1.0f, 0.0f, 0.0f, 1.0f);
 
 		glm::mat4 view;
 		view = glm::lookAt(glm::vec3(1.0f, 1.0f, -3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		cubeShader.SetMat4("view", view);
+		cubeShader.setMat4("view", view);
 
 		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		cubeShader.SetMat4("projection", projection);
+		cubeShader.setMat4("projection", projection);
 
 		glm::mat4 model;
-		cubeShader.SetMat4("model", model);
-		cubeShader.SetVec3("lightPos", lightPos);
-		cubeShader.SetVec3("viewPos", glm::vec3(1.0f,1.0f,-3.0f));
+		cubeShader.setMat4("model", model);
+		cubeShader.setVec3("lightPos", lightPos);
+		cubeShader.setVec3("viewPos", glm::vec3(1.0f,1.0f,-3.0f));
 
 		glBindVertexArray(VAO);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
 
 		lightShader.use();
-		lightShader.SetMat4("projection", projection);
-		lightShader.SetMat4("view", view);
+		lightShader.setMat4("projection", projection);
+		lightShader.setMat4("view", view);
 
 		model = glm::mat4();
 		model = glm::translate(model, lightPos);
 		model = glm::scale(model, glm::vec3(0.2f,0.2f,0.2f));
 
-		lightShader.SetMat4("model", model);
+		lightShader.setMat4("model", model);
 		
 
 		glBindVertexArray(lightVAO);
@@ -95,15 +95,15 @@ int main()
 		shader.use();
 
 		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		shader.SetMat4("projection", projection);
+		shader.setMat4("projection", projection);
 		glm::mat4 view = camera.GetViewMatrix();
-		shader.SetMat4("view", view);
+		shader.setMat4("view", view);
 
 
 		glm::mat4 model = glm::mat4();
 		model = glm::translate(model, glm::vec3(0.0f, -1.75f, 0.0f)); // translate it down so it's at the center of the scene
 		model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));	// it's a bit too big for our scene, so scale it down
-		shader.SetMat4("model", model);
+		shader.setMat4("model", model);
 		oModel.Draw(shader);
 		
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
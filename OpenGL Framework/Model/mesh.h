@@ -17,8 +17,8 @@ struct Vertex
 	glm::vec3 Position;
 	glm::vec3 Normal;
 	glm::vec2 TexCoords;
-	glm::vec2 Tangent;
-	glm::vec2 Bitangent;
+	glm::vec3 Tangent;
+	glm::vec3 Bitangent;
 };
 
 struct Texture
@@ -76,8 +76,6 @@ public:
 
 			glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
 
-            std::cout << "bind texture id :" << (name + number).c_str() << "to the mesh." << std::endl;
-
 			glBindTexture(GL_TEXTURE_2D, textures[i].id);
 		}
 
@@ -11,7 +11,8 @@
 #include <stb_image.h>
 
 #include <Shader.h>
-#include <camera.h>
+#include <Camera.h>
+#include <TextureCache.h>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -72,23 +73,24 @@ int main()
 		return -1;
 	}
 
-	Shader shader("Vertex.vs", "Fragment.fs");
+	const unsigned int NR_LIGHTS = 4;
+	Shader shader("Vertex.vs", "Fragment.fs", nullptr, { { "NR_LIGHTS", NR_LIGHTS } });
 	shader.use();
 
 	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	shader.SetMat4("projection", projection);
+	shader.setMat4("projection", projection);
 
-	shader.SetVec3("albedo", glm::vec3(0.5f, 0.0f, 0.0f));
+	shader.setVec3("albedo", glm::vec3(0.5f, 0.0f, 0.0f));
 	shader.setFloat("ao", 1.0f);
 
-	glm::vec3 lightPositions[] = {
+	glm::vec3 lightPositions[NR_LIGHTS] = {
 		glm::vec3(-10.0f, 10.0f, 10.0f),
 		glm::vec3(10.0f, 10.0f, 10.0f),
 		glm::vec3(-10.0f, -10.0f, 10.0f),
 		glm::vec3(10.0f, -10.0f, 10.0f)
 	};
 
-	glm::vec3 lightColors[] = {
+	glm::vec3 lightColors[NR_LIGHTS] = {
 		glm::vec3(300.0f, 300.0f, 300.0f),
 		glm::vec3(300.0f, 300.0f, 300.0f),
 		glm::vec3(300.0f, 300.0f, 300.0f),
@@ -121,8 +123,8 @@ int main()
 		shader.use();
 
 		glm::mat4 view = camera.GetViewMatrix();
-		shader.SetMat4("view", view);
-		shader.SetVec3("camPos", camera.Position);
+		shader.setMat4("view", view);
+		shader.setVec3("camPos", camera.Position);
 
 		glm::mat4 model;
 		for (int row = 0; row < nrRows; ++row)
@@ -139,7 +141,7 @@ int main()
 					0.0f
 				));
 
-				shader.SetMat4("model", model);
+				shader.setMat4("model", model);
 				renderSphere();
 			}
 		}
@@ -148,13 +150,13 @@ int main()
 		{
 			glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
 			newPos = lightPositions[i];
-			shader.SetVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-			shader.SetVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
+			shader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
+			shader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
 
 			model = glm::mat4();
 			model = glm::translate(model, newPos);
 			model = glm::scale(model, glm::vec3(0.5f));
-			shader.SetMat4("model", model);
+			shader.setMat4("model", model);
 			renderSphere();
 		}
 
@@ -268,46 +270,7 @@ void renderSphere()
 
 unsigned int loadTexture(char* const path)
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-		{
-			format = GL_RED;
-		}
-		else if (nrComponents == 3)
-		{
-			format = GL_RGB;
-		}
-		else if (nrComponents == 4)
-		{
-			format = GL_RGBA;
-		}
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
+	return TextureCache::load(path);
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <vector>
+#include <cfloat>
 
 #include <string>
 
@@ -13,14 +14,17 @@
 #include <stb_image.h>
 
 #include <Shader.h>
-#include <camera.h>
+#include <ShaderVariants.h>
+#include <Camera.h>
+#include <TextureCache.h>
+#include <MaterialCooker.h>
+#include <TextureStreamer.h>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 
-unsigned int loadTexture(std::string path);
 
 void renderSphere();
 
@@ -39,6 +43,10 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// N switches between the shader variants with and without normal mapping
+bool normalMapping = true;
+bool normalMappingKeyPressed = false;
+
 int main()
 {
 	// glfw: initialize and configure
@@ -74,37 +82,41 @@ int main()
 		return -1;
 	}
 
-	Shader shader("Vertex.vs", "Fragment.fs");
-	shader.use();
-
-	unsigned int albeo = loadTexture("albedo.png");
-	unsigned int normal = loadTexture("normal.png");
-	unsigned int metallic = loadTexture("metallic.png");
-	unsigned int roughness = loadTexture("roughness.png");
-	unsigned int ao = loadTexture("ao.png");
-
-	std::cout << albeo << " " << normal << metallic << roughness << ao;
+	// the variant without normal mapping is only built the first time N is pressed
+	const unsigned int NR_LIGHTS = 4;
+	ShaderVariants pbrShaders("Vertex.vs", "Fragment.fs");
+	const ShaderDefines normalMappedDefines = { { "NR_LIGHTS", NR_LIGHTS }, { "HAS_MATERIAL_MAPS" }, { "PACKED_MATERIAL_MAPS" }, { "SRGB_ALBEDO" }, { "HAS_NORMAL_MAP" }, { "NORMAL_MAP_RG" } };
+	const ShaderDefines flatDefines = { { "NR_LIGHTS", NR_LIGHTS }, { "HAS_MATERIAL_MAPS" }, { "PACKED_MATERIAL_MAPS" }, { "SRGB_ALBEDO" } };
+	pbrShaders.get(normalMappedDefines);
 
-	shader.setInt("albeoMap", 0);
-	shader.setInt("normalMap", 1);
-	shader.setInt("metallicMap", 2);
-	shader.setInt("roughnessMap", 3);
-	shader.setInt("aoMap", 4);
+	// ao, roughness and metallic are packed into one texture. The maps are streamed: the mips of up
+	// to 64 texels a side stay resident and finer ones are loaded as the spheres come closer
+	std::vector<PbrMaterialImages> images = MaterialCooker::decodeAll(std::vector<std::string>(1, ""));
+	TextureStreamer streamer(16 << 20);
+	int materialMaps[3] = { streamer.add(images[0].albedo.compressed), streamer.add(images[0].normal.compressed), streamer.add(images[0].orm.compressed) };
+	images.clear();
 
 	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	shader.SetMat4("projection", projection);
+	pbrShaders.setup([&](Shader & shader)
+	{
+		shader.setInt("albedoMap", 0);
+		shader.setInt("normalMap", 1);
+		shader.setInt("ormMap", 2);
+
+		shader.setMat4("projection", projection);
 
-	shader.SetVec3("albedo", glm::vec3(0.5f, 0.0f, 0.0f));
-	shader.setFloat("ao", 1.0f);
+		shader.setVec3("albedo", glm::vec3(0.5f, 0.0f, 0.0f));
+		shader.setFloat("ao", 1.0f);
+	});
 
-	glm::vec3 lightPositions[] = {
+	glm::vec3 lightPositions[NR_LIGHTS] = {
 		glm::vec3(-10.0f, 10.0f, 10.0f),
 		glm::vec3(10.0f, 10.0f, 10.0f),
 		glm::vec3(-10.0f, -10.0f, 10.0f),
 		glm::vec3(10.0f, -10.0f, 10.0f)
 	};
 
-	glm::vec3 lightColors[] = {
+	glm::vec3 lightColors[NR_LIGHTS] = {
 		glm::vec3(300.0f, 300.0f, 300.0f),
 		glm::vec3(300.0f, 300.0f, 300.0f),
 		glm::vec3(300.0f, 300.0f, 300.0f),
@@ -134,22 +146,18 @@ int main()
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		Shader & shader = pbrShaders.get(normalMapping ? normalMappedDefines : flatDefines);
 		shader.use();
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, albeo);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, normal);
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, metallic);
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, roughness);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, ao);
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D, streamer.id(materialMaps[i]));
+		}
 
 		glm::mat4 view = camera.GetViewMatrix();
-		shader.SetMat4("view", view);
-		shader.SetVec3("camPos", camera.Position);
+		shader.setMat4("view", view);
+		shader.setVec3("camPos", camera.Position);
 
 		glm::mat4 model;
 		for (int row = 0; row < nrRows; ++row)
@@ -166,7 +174,7 @@ int main()
 					0.0f
 				));
 
-				shader.SetMat4("model", model);
+				shader.setMat4("model", model);
 				renderSphere();
 			}
 		}
@@ -175,22 +183,46 @@ int main()
 		{
 			glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
 			newPos = lightPositions[i];
-			shader.SetVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-			shader.SetVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
+			shader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
+			shader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
 
 			model = glm::mat4();
 			model = glm::translate(model, newPos);
 			model = glm::scale(model, glm::vec3(0.5f));
-			shader.SetMat4("model", model);
+			shader.setMat4("model", model);
 			renderSphere();
 		}
 
+		// the textures wrap once around a sphere, so the nearest one decides the level they need
+		float nearest = FLT_MAX;
+		for (int row = 0; row < nrRows; ++row)
+		{
+			for (int col = 0; col < nrColumns; ++col)
+			{
+				glm::vec3 center((col - (nrColumns / 2)) * spacing, (row - (nrRows / 2)) * spacing, 0.0f);
+				nearest = std::min(nearest, glm::distance(camera.Position, center) - 1.0f);
+			}
+		}
+		for (unsigned int i = 0; i < NR_LIGHTS; i++)
+		{
+			nearest = std::min(nearest, glm::distance(camera.Position, lightPositions[i]) - 0.5f);
+		}
+		float pixels = TextureStreamer::projectedSize(2.0f * glm::pi<float>(), nearest, glm::radians(camera.Zoom), SCR_HEIGHT);
+		for (int map : materialMaps)
+		{
+			streamer.request(map, pixels);
+		}
+		streamer.update();
+
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
 
+	// the textures are deleted while the context still exists
+	streamer.clear();
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 // ------------------------------------------------------------------
 	glfwTerminate();
@@ -235,11 +267,11 @@ void renderSphere()
 		}
 
 		bool oddRow = false;
-		for (int y = 0; y < Y_SEGMENTS; ++y)
+		for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
 		{
 			if (!oddRow) // even rows: y == 0, y == 2; and so on
 			{
-				for (int x = 0; x <= X_SEGMENTS; ++x)
+				for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
 				{
 					indices.push_back(y       * (X_SEGMENTS + 1) + x);
 					indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
@@ -247,7 +279,7 @@ void renderSphere()
 			}
 			else
 			{
-				for (int x = X_SEGMENTS; x >= 0; --x)
+				for (int x = (int)X_SEGMENTS; x >= 0; --x)
 				{
 					indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
 					indices.push_back(y       * (X_SEGMENTS + 1) + x);
@@ -293,51 +325,6 @@ void renderSphere()
 	glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
 }
 
-unsigned int loadTexture(std::string path)
-{
-
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0);
-
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-		{
-			format = GL_RED;
-		}
-		else if (nrComponents == 3)
-		{
-			format = GL_RGB;
-		}
-		else if (nrComponents == 4)
-		{
-			format = GL_RGBA;
-		}
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;  
-}
-
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window)
@@ -354,6 +341,16 @@ void processInput(GLFWwindow *window)
 		camera.ProcessKeyboard(LEFT, cameraSpeed);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		camera.ProcessKeyboard(RIGHT, cameraSpeed);
+
+	if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS && !normalMappingKeyPressed)
+	{
+		normalMapping = !normalMapping;
+		normalMappingKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_N) == GLFW_RELEASE)
+	{
+		normalMappingKeyPressed = false;
+	}
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -386,4 +383,4 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
 	camera.ProcessMouseScroll(yoffset);
-}
\ No newline at end of file
+}
@@ -8,6 +8,7 @@
 #include "camera.h"
 #include "Shader.h"
 #include "model.h"
+#include "ModelLoader.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
@@ -76,14 +77,23 @@ int main()
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_MULTISAMPLE);
 
+    // programs compile in the driver while the model is loading
+    Shader shaderGeometryPass("ssao_geometry.vs", "ssao_geometry.fs", nullptr, ShaderDefines(), ShaderBuild::Async);
+    Shader shaderLightingPass("ssao.vs", "ssao_light.fs", nullptr, ShaderDefines(), ShaderBuild::Async);
+    Shader shaderSSAO("ssao.vs", "ssao.fs", nullptr, ShaderDefines(), ShaderBuild::Async);
+    Shader shaderSSAOBlur("ssao.vs", "ssao_blur.fs", nullptr, ShaderDefines(), ShaderBuild::Async);
+    shaderGeometryPass.submit();
+    shaderLightingPass.submit();
+    shaderSSAO.submit();
+    shaderSSAOBlur.submit();
+    shaderSSAO.enableHotReload();
+
+    // the nanosuit drops to a coarser LOD when its simplification error covers less than a pixel
+    MeshSimplifier::lodRatios() = { 0.5f, 0.25f, 0.125f };
     std::string modelPath = "Model/nanosuit.obj";
 
-    Model nanosuit(modelPath.c_str());
-
-    Shader shaderGeometryPass("ssao_geometry.vs", "ssao_geometry.fs");
-    Shader shaderLightingPass("ssao.vs", "ssao_light.fs");
-    Shader shaderSSAO("ssao.vs", "ssao.fs");
-    Shader shaderSSAOBlur("ssao.vs", "ssao_blur.fs");
+    // imported on a worker thread and uploaded by ModelLoader::update, a box stands in for it until then
+    ModelHandle nanosuit = ModelLoader::load(modelPath);
 
     unsigned int gBuffer;
     glGenFramebuffers(1, &gBuffer);
@@ -211,6 +221,7 @@ int main()
 
     // render loop
     // -----------
+    bool firstFrame = true;
     while (!glfwWindowShouldClose(window))
     {
         float currentFrame = glfwGetTime();
@@ -221,6 +232,9 @@ int main()
         // -----
         processInput(window);
 
+        shaderSSAO.updateHotReload();
+        ModelLoader::update();
+
         // render
         // ------
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
@@ -250,7 +264,7 @@ int main()
         model = glm::scale(model, glm::vec3(0.3f));
 
         shaderGeometryPass.setMat4("model", model);
-        nanosuit.Draw(shaderGeometryPass);
+        nanosuit.Draw(shaderGeometryPass, LodCamera(camera.Position, glm::radians(camera.Zoom), (float)SCR_HEIGHT), model);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
@@ -304,6 +318,12 @@ int main()
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (firstFrame)
+        {
+            std::cout << "first frame after " << 1000.0 * glfwGetTime() << " ms" << std::endl;
+            firstFrame = false;
+        }
     }
 
     // glfw: terminate, clearing all previously allocated GLFW resources.